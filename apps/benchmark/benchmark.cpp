@@ -12,314 +12,586 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
-// Used to run various benchmark of the system.
-
+// Runs a pipeline against synthetic cameras and reports how it performed as
+// JSON, so that the effect of a change can be measured the same way on any
+// machine, without camera hardware or a GPU.
+//
+// Every "Camera" operator of the pipeline is replaced by a SyntheticCamera that
+// pushes a fixed number of frames, which are either generated or decoded from
+// a file up front, as fast as the pipeline takes them or at a fixed frame rate.
+// "--streams" runs several copies of the pipeline side by side. Once every
+// copy has processed all of its frames, the report gives the throughput, the
+// latency percentiles, the dropped frames, the CPU time and the memory used,
+// overall and per operator.
+//
+// Given an earlier report with "--baseline", the key metrics are compared with
+// it, and the app exits with status 2 if any of them got worse by more than
+// "--max-regression" percent. E.g.,
+//
+//   benchmark -p examples/json/benchmark.json --frames 2000 -o baseline.json
+//   (make a change)
+//   benchmark -p examples/json/benchmark.json --frames 2000 -b baseline.json
+
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <sstream>
 #include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
 #include <boost/program_options.hpp>
+#include <json/src/json.hpp>
 
 #include "saf.h"
 
 namespace po = boost::program_options;
-using std::cout;
-using std::endl;
-
-// Global arguments
-struct Configurations {
-  // Enable verbose logging or not
-  bool verbose;
-  // The name of operators to use
-  std::vector<std::string> op_names;
-  // The name of cameras to use
-  std::vector<std::string> camera_names;
-  // The encoder to use
-  std::string encoder;
-  // The decoder to use
-  std::string decoder;
-  // The name of the experiment to run
-  std::string experiment;
-  // The network model to use
-  std::string net;
-  // Duration of a test
-  int time;
-  // Device number
-  int device_number;
-  // Store the video or not
-  bool store;
-} CONFIG;
-
-void SLEEP(int sleep_time_in_s) {
-  while (sleep_time_in_s >= 10) {
-    cout << sleep_time_in_s << " to sleep" << endl;
-    std::this_thread::sleep_for(std::chrono::seconds(10));
-    sleep_time_in_s -= 10;
-  }
-  std::this_thread::sleep_for(std::chrono::seconds(sleep_time_in_s));
-}
 
-/**
- * @brief Run end-to-end camera(s)->classifier(NN)->store pipeline.
- */
-void RunEndToEndExperiment() {
-  cout << "Run End To End Experiment" << endl;
-  // Check argument
-  CHECK(CONFIG.camera_names.size() != 0) << "You must give at least one camera";
+// How often to check whether the pipelines have finished.
+constexpr auto kPollInterval = std::chrono::milliseconds(10);
+// The number of distinct images that generated frames cycle through.
+constexpr size_t kNumGeneratedImages = 30;
+
+// What to run, as given on the command line.
+struct BenchmarkConfig {
+  std::string pipeline_filepath;
+  size_t num_streams;
+  unsigned long num_frames;
+  // 0 to push frames as fast as the pipeline takes them.
+  double fps;
+  // The image or video to replay, or empty to generate frames.
+  std::string input_filepath;
+  // -1 to keep the size of the input file.
+  int width;
+  int height;
+  unsigned int seed;
+  bool cpu_accounting;
+  int timeout_s;
+};
+
+// One copy of the pipeline, with the cameras that feed it.
+struct BenchmarkStream {
+  std::shared_ptr<Pipeline> pipeline;
+  std::vector<std::shared_ptr<SyntheticCamera>> cameras;
+};
+
+// A metric that is compared with the baseline, as a path into the report.
+struct KeyMetric {
+  std::vector<std::string> path;
+  bool higher_is_better;
+};
+
+static const std::vector<KeyMetric> kKeyMetrics = {
+    {{"throughput_fps"}, true},
+    {{"end_to_end_latency", "p50_ms"}, false},
+    {{"end_to_end_latency", "p99_ms"}, false},
+    {{"frames_dropped"}, false},
+    {{"cpu", "ms_per_frame"}, false},
+    {{"memory", "peak_rss_kb"}, false}};
+
+static nlohmann::json ToJson(const LatencySummary& summary) {
+  nlohmann::json json;
+  json["count"] = summary.count;
+  json["mean_ms"] = summary.mean_ms;
+  json["p50_ms"] = summary.p50_ms;
+  json["p90_ms"] = summary.p90_ms;
+  json["p99_ms"] = summary.p99_ms;
+  json["p999_ms"] = summary.p999_ms;
+  json["max_ms"] = summary.max_ms;
+  return json;
+}
 
-  auto& model_manager = ModelManager::GetInstance();
-  auto& camera_manager = CameraManager::GetInstance();
+static nlohmann::json ToJson(const CpuStats& cpu) {
+  nlohmann::json json;
+  json["cpu_ms"] = cpu.cpu_micros / 1000.0;
+  json["cycles"] = cpu.cycles;
+  json["instructions"] = cpu.instructions;
+  json["llc_misses"] = cpu.llc_misses;
+  json["branch_misses"] = cpu.branch_misses;
+  json["ipc"] = cpu.GetInstructionsPerCycle();
+  json["llc_mpki"] = cpu.GetLlcMissesPerKiloInstruction();
+  return json;
+}
 
-  auto camera_size = CONFIG.camera_names.size();
+// The user and system CPU time of the whole process, in seconds.
+static void GetProcessCpuSeconds(double& user_s, double& system_s) {
+  rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  user_s = usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6;
+  system_s = usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+}
 
-  // Camera streams
-  std::vector<std::shared_ptr<Camera>> cameras;
-  for (const auto& camera_name : CONFIG.camera_names) {
-    auto camera = camera_manager.GetCamera(camera_name);
-    cameras.push_back(camera);
+// Returns the names of the operators of "ops" whose frames no other operator
+// consumes, in the order of the specification.
+static std::vector<std::string> GetLeafOperators(const nlohmann::json& ops) {
+  std::unordered_set<std::string> consumed;
+  for (const auto& op_spec : ops) {
+    if (op_spec.find("inputs") == op_spec.end()) {
+      continue;
+    }
+    for (const auto& input : op_spec["inputs"]) {
+      std::string stream_id = input.get<std::string>();
+      consumed.insert(stream_id.substr(0, stream_id.find(":")));
+    }
   }
-
-  std::vector<std::shared_ptr<Stream>> camera_streams;
-  for (const auto& camera : cameras) {
-    auto camera_stream = camera->GetStream();
-    camera_streams.push_back(camera_stream);
+  std::vector<std::string> leaves;
+  for (const auto& op_spec : ops) {
+    std::string name = op_spec["operator_name"];
+    if (consumed.count(name) == 0) {
+      leaves.push_back(name);
+    }
   }
+  return leaves;
+}
 
-  // Input shape
-  Shape input_shape(3, 227, 227);
-  std::vector<std::shared_ptr<Stream>> input_streams;
-  std::vector<std::shared_ptr<Operator>> transformers;
-  std::vector<std::shared_ptr<GstVideoEncoder>> encoders;
-
-  // transformers
-  for (const auto& camera_stream : camera_streams) {
-    std::shared_ptr<Operator> transform_op(
-        new ImageTransformer(input_shape, true));
-    transform_op->SetSource("input", camera_stream);
-    transformers.push_back(transform_op);
-    input_streams.push_back(transform_op->GetSink("output"));
+// Creates copy "index" of the pipeline "spec", with every camera replaced by a
+// SyntheticCamera that pushes "images".
+static BenchmarkStream CreateStream(const BenchmarkConfig& config,
+                                    const nlohmann::json& spec, size_t index,
+                                    const std::vector<cv::Mat>& images) {
+  BenchmarkStream stream;
+  nlohmann::json copy = spec;
+  std::string pipeline_name = "benchmark";
+  if (spec.find("pipeline_name") != spec.end()) {
+    pipeline_name = spec["pipeline_name"].get<std::string>();
   }
-
-  // classifier
-  auto model_desc = model_manager.GetModelDesc(CONFIG.net);
-  std::vector<OperatorPtr> classifiers;
-  for (const auto& input_stream : input_streams) {
-    std::shared_ptr<ImageClassifier> classifier(
-        new ImageClassifier(model_desc, input_shape, 1));
-    classifier->SetSource("input", input_stream);
-    classifiers.push_back(classifier);
+  copy["pipeline_name"] = pipeline_name + "-" + std::to_string(index);
+  if (index > 0) {
+    // Only the first copy serves the metrics of the process and takes control
+    // requests, since the others cannot share its ports.
+    copy.erase("metrics_port");
+    copy.erase("control_endpoint");
+  }
+  if (config.cpu_accounting) {
+    copy["cpu_accounting"] = true;
   }
 
-  // encoders, encode each camera stream
-  if (CONFIG.store) {
-    for (decltype(camera_size) i = 0; i < camera_size; ++i) {
-      auto classifier = classifiers.at(i);
-      std::string output_filename = CONFIG.camera_names.at(i) + ".mp4";
-
-      std::shared_ptr<GstVideoEncoder> encoder(
-          new GstVideoEncoder("original_image", output_filename));
-      encoder->SetSource(classifier->GetSink("output" + std::to_string(0)));
-      encoders.push_back(encoder);
+  for (auto& op_spec : copy["operators"]) {
+    std::string type = op_spec["operator_type"];
+    if (GetOperatorTypeByString(type) != OPERATOR_TYPE_CAMERA) {
+      continue;
     }
+    std::string camera_name = op_spec["operator_name"].get<std::string>() +
+                              "-" + std::to_string(index);
+    auto camera = std::make_shared<SyntheticCamera>(
+        camera_name, images, config.num_frames, config.fps);
+    CameraManager::GetInstance().AddCamera(camera);
+    op_spec["parameters"]["camera_name"] = camera_name;
+    stream.cameras.push_back(camera);
   }
-
-  for (const auto& camera : cameras) {
-    camera->Start();
+  if (stream.cameras.empty()) {
+    throw std::runtime_error("Pipeline \"" + config.pipeline_filepath +
+                             "\" has no \"Camera\" operator to feed");
   }
 
-  for (const auto& transformer : transformers) {
-    transformer->Start();
-  }
+  stream.pipeline = Pipeline::ConstructPipeline(copy);
+  return stream;
+}
 
-  for (const auto& classifier : classifiers) {
-    classifier->Start();
+// Returns the number of frames that made it through all of "leaves" of
+// "stream".
+static unsigned long GetNumFramesCompleted(
+    const BenchmarkStream& stream, const std::vector<std::string>& leaves) {
+  unsigned long num_frames = std::numeric_limits<unsigned long>::max();
+  for (const auto& name : leaves) {
+    auto op = stream.pipeline->GetOperator(name);
+    num_frames =
+        std::min(num_frames, op->GetProcessingLatencyHistogram().GetCount());
   }
+  return num_frames;
+}
 
-  for (const auto& encoder : encoders) {
-    encoder->Start();
+static bool HasFinished(const BenchmarkStream& stream,
+                        const std::vector<std::string>& leaves) {
+  for (const auto& name : leaves) {
+    if (!stream.pipeline->GetOperator(name)->HasFinished()) {
+      return false;
+    }
   }
+  return true;
+}
 
-  /////////////// RUN
-  SLEEP(CONFIG.time);
-
-  for (const auto& encoder : encoders) {
-    encoder->Stop();
+static nlohmann::json RunBenchmark(const BenchmarkConfig& config,
+                                   const nlohmann::json& spec) {
+  // Decode or generate the frames once, before anything is measured.
+  std::vector<cv::Mat> images;
+  if (config.input_filepath.empty()) {
+    images = SyntheticCamera::GenerateImages(config.width, config.height,
+                                             kNumGeneratedImages, config.seed);
+  } else {
+    images = SyntheticCamera::LoadImages(config.input_filepath, config.width,
+                                         config.height);
   }
 
-  for (const auto& classifier : classifiers) {
-    classifier->Stop();
+  nlohmann::json ops = spec["operators"];
+  std::vector<std::string> leaves = GetLeafOperators(ops);
+  std::vector<BenchmarkStream> streams;
+  for (size_t i = 0; i < config.num_streams; ++i) {
+    streams.push_back(CreateStream(config, spec, i, images));
   }
 
-  for (const auto& transformer : transformers) {
-    transformer->Stop();
+  nlohmann::json report;
+  nlohmann::json config_json;
+  config_json["pipeline"] = config.pipeline_filepath;
+  config_json["streams"] = config.num_streams;
+  config_json["frames"] = config.num_frames;
+  config_json["fps"] = config.fps;
+  config_json["input"] =
+      config.input_filepath.empty() ? "synthetic" : config.input_filepath;
+  config_json["width"] = images.front().cols;
+  config_json["height"] = images.front().rows;
+  config_json["seed"] = config.seed;
+  config_json["cpu_accounting"] = config.cpu_accounting;
+  report["config"] = config_json;
+  report["pipeline"] = spec;
+  report["host"]["cpus"] = std::thread::hardware_concurrency();
+  report["host"]["hardware_counters"] = HasThreadHardwareCounters();
+
+  double start_user_s;
+  double start_system_s;
+  GetProcessCpuSeconds(start_user_s, start_system_s);
+  auto start = std::chrono::steady_clock::now();
+  for (const auto& stream : streams) {
+    CHECK(stream.pipeline->Start()) << "Unable to start the pipeline";
   }
 
-  for (const auto& camera : cameras) {
-    camera->Stop();
+  // Wait for every copy to finish. The throughput is measured from the first
+  // completed frame on, so that starting up, e.g., loading models, does not
+  // count against it.
+  auto deadline = start + std::chrono::seconds(config.timeout_s);
+  auto first_frame_time = start;
+  unsigned long frames_before_first = 0;
+  bool seen_first_frame = false;
+  bool timed_out = false;
+  while (true) {
+    bool finished = true;
+    unsigned long num_frames = 0;
+    for (const auto& stream : streams) {
+      finished = finished && HasFinished(stream, leaves);
+      num_frames += GetNumFramesCompleted(stream, leaves);
+    }
+    auto now = std::chrono::steady_clock::now();
+    if (!seen_first_frame && num_frames > 0) {
+      seen_first_frame = true;
+      first_frame_time = now;
+      frames_before_first = num_frames;
+    }
+    if (finished) {
+      break;
+    }
+    if (now > deadline) {
+      LOG(ERROR) << "The pipelines did not finish within " << config.timeout_s
+                 << " s";
+      timed_out = true;
+      break;
+    }
+    std::this_thread::sleep_for(kPollInterval);
   }
-
-  /////////////// PRINT STATS
-  for (decltype(cameras.size()) i = 0; i < cameras.size(); ++i) {
-    cout << "-- camera[" << i << "] latency is "
-         << cameras.at(i)->GetAvgProcessingLatencyMs() << endl;
+  auto end = std::chrono::steady_clock::now();
+  double end_user_s;
+  double end_system_s;
+  GetProcessCpuSeconds(end_user_s, end_system_s);
+  // Sampled before the pipelines stop and free their queues and buffers.
+  int rss_kb = GetPhysicalKB();
+
+  // The queues are gone once the pipelines stop, so count the drops first.
+  std::unordered_map<std::string, unsigned long> frames_dropped;
+  unsigned long total_frames_dropped = 0;
+  for (const auto& stream : streams) {
+    for (const auto& pair : stream.pipeline->GetOperators()) {
+      unsigned long num_dropped = pair.second->GetNumFramesDropped();
+      frames_dropped[pair.first] += num_dropped;
+      total_frames_dropped += num_dropped;
+    }
   }
-  for (decltype(transformers.size()) i = 0; i < transformers.size(); ++i) {
-    cout << "-- transformer[" << i << "] latency is "
-         << transformers.at(i)->GetAvgProcessingLatencyMs() << endl;
+  for (const auto& stream : streams) {
+    stream.pipeline->Stop();
+  }
+
+  unsigned long frames_pushed = 0;
+  unsigned long frames_completed = 0;
+  LatencyHistogram end_to_end_latency;
+  for (const auto& stream : streams) {
+    for (const auto& camera : stream.cameras) {
+      frames_pushed += camera->GetNumFramesPushed();
+    }
+    frames_completed += GetNumFramesCompleted(stream, leaves);
+    for (const auto& name : leaves) {
+      end_to_end_latency.Merge(
+          stream.pipeline->GetOperator(name)->GetEndToEndLatencyHistogram());
+    }
   }
 
-  for (decltype(classifiers.size()) i = 0; i < classifiers.size(); ++i) {
-    cout << "-- classifier << " << i << " latency is "
-         << classifiers.at(i)->GetAvgProcessingLatencyMs() << endl;
+  double duration_s = std::chrono::duration<double>(end - start).count();
+  double measured_s =
+      std::chrono::duration<double>(end - first_frame_time).count();
+  double user_s = end_user_s - start_user_s;
+  double system_s = end_system_s - start_system_s;
+  report["timed_out"] = timed_out;
+  report["duration_s"] = duration_s;
+  report["time_to_first_frame_s"] =
+      seen_first_frame
+          ? std::chrono::duration<double>(first_frame_time - start).count()
+          : duration_s;
+  report["frames_pushed"] = frames_pushed;
+  report["frames_completed"] = frames_completed;
+  report["frames_dropped"] = total_frames_dropped;
+  report["throughput_fps"] =
+      measured_s > 0 ? (frames_completed - frames_before_first) / measured_s
+                     : 0.0;
+  // Only measured for the leaves that push their frames to a sink.
+  report["end_to_end_latency"] = ToJson(end_to_end_latency.GetSummary());
+  report["cpu"]["user_s"] = user_s;
+  report["cpu"]["system_s"] = system_s;
+  report["cpu"]["cores"] = duration_s > 0 ? (user_s + system_s) / duration_s
+                                          : 0.0;
+  report["cpu"]["ms_per_frame"] =
+      frames_completed > 0 ? (user_s + system_s) * 1000 / frames_completed
+                           : 0.0;
+  report["memory"]["rss_kb"] = rss_kb;
+  report["memory"]["peak_rss_kb"] = GetPeakPhysicalKB();
+
+  // The operators of all of the copies are combined.
+  nlohmann::json ops_json;
+  for (const auto& op_spec : ops) {
+    std::string name = op_spec["operator_name"];
+    LatencyHistogram processing_latency;
+    LatencyHistogram queue_latency;
+    CpuStats cpu;
+    bool cpu_accounting = false;
+    for (const auto& stream : streams) {
+      auto op = stream.pipeline->GetOperator(name);
+      processing_latency.Merge(op->GetProcessingLatencyHistogram());
+      queue_latency.Merge(op->GetQueueLatencyHistogram());
+      cpu += op->GetCpuStats();
+      cpu_accounting = op->IsCpuAccounting();
+    }
+    nlohmann::json op_json;
+    op_json["type"] = op_spec["operator_type"];
+    op_json["processing_latency"] = ToJson(processing_latency.GetSummary());
+    op_json["queue_latency"] = ToJson(queue_latency.GetSummary());
+    op_json["frames_dropped"] = frames_dropped[name];
+    if (cpu_accounting) {
+      op_json["cpu"] = ToJson(cpu);
+    }
+    ops_json[name] = op_json;
   }
+  report["operators"] = ops_json;
+  return report;
+}
 
-  if (CONFIG.store) {
-    for (decltype(encoders.size()) i = 0; i < encoders.size(); ++i) {
-      cout << "-- encoder[" << i << "] latency is "
-           << encoders.at(i)->GetAvgProcessingLatencyMs() << endl;
+// Returns the value at "path" in "report", or nullptr if there is none.
+static const nlohmann::json* FindMetric(const nlohmann::json& report,
+                                        const std::vector<std::string>& path) {
+  const nlohmann::json* value = &report;
+  for (const auto& key : path) {
+    if (!value->is_object() || value->find(key) == value->end()) {
+      return nullptr;
     }
+    value = &(*value)[key];
   }
+  return value->is_number() ? value : nullptr;
 }
 
-/**
- * @brief Benchmark the time to take the forward pass or a neural network
- */
-void RunNNInferenceExperiment() {
-  LOG(INFO) << "Run NN Inference Experiment";
-
-  auto& model_manager = ModelManager::GetInstance();
-  auto model_desc = model_manager.GetModelDesc(CONFIG.net);
-  Shape input_shape(3, model_desc.GetInputWidth(), model_desc.GetInputHeight());
-
-  std::vector<std::string> output_layers = {model_desc.GetDefaultOutputLayer()};
-  auto model =
-      ModelManager::GetInstance().CreateModel(model_desc, input_shape, 1);
-  model->Load();
-  // Prepare fake input
-  srand((unsigned)(15213));
-  std::vector<decltype(input_shape.channel)> mat_size;
-  mat_size.push_back(input_shape.channel);
-  mat_size.push_back(input_shape.width);
-  mat_size.push_back(input_shape.height);
-  cv::Mat fake_input(mat_size, CV_32F);
-  auto mat_it = fake_input.begin<float>();
-  auto mat_end = fake_input.end<float>();
-  while (mat_it != mat_end) {
-    *mat_it = (float)(rand()) / (float)(RAND_MAX);
-    ++mat_it;
+// Adds a "comparison" of the key metrics of "report" with "baseline" to
+// "report", prints it, and returns whether any of them got worse by more than
+// "max_regression_pct" percent.
+static bool CompareWithBaseline(const nlohmann::json& baseline,
+                                nlohmann::json& report,
+                                double max_regression_pct) {
+  if (baseline.find("config") == baseline.end() ||
+      baseline["config"] != report["config"]) {
+    LOG(WARNING) << "The baseline was measured with a different configuration";
   }
 
-  Timer timer;
-  timer.Start();
-  std::unordered_map<std::string, std::vector<cv::Mat>> input_map(
-      {{model_desc.GetDefaultInputLayer(), {fake_input}}});
-  model->Evaluate(input_map, output_layers);
-  LOG(INFO) << "Inference time: " << timer.ElapsedMSec() << " ms";
+  bool regressed = false;
+  nlohmann::json comparison;
+  std::cerr << std::left << std::setw(28) << "metric" << std::right
+            << std::setw(14) << "baseline" << std::setw(14) << "current"
+            << std::setw(10) << "change" << std::endl;
+  for (const auto& metric : kKeyMetrics) {
+    const nlohmann::json* baseline_value = FindMetric(baseline, metric.path);
+    const nlohmann::json* current_value = FindMetric(report, metric.path);
+    if (baseline_value == nullptr || current_value == nullptr) {
+      continue;
+    }
+    std::string name = metric.path.front();
+    for (size_t i = 1; i < metric.path.size(); ++i) {
+      name += "." + metric.path.at(i);
+    }
+    double before = baseline_value->get<double>();
+    double after = current_value->get<double>();
+
+    nlohmann::json entry;
+    entry["baseline"] = before;
+    entry["current"] = after;
+    bool worse = metric.higher_is_better ? after < before : after > before;
+    bool metric_regressed;
+    std::ostringstream change;
+    if (before != 0) {
+      double change_pct = (after - before) / before * 100;
+      entry["change_pct"] = change_pct;
+      metric_regressed = worse && std::abs(change_pct) > max_regression_pct;
+      change << std::showpos << std::fixed << std::setprecision(1)
+             << change_pct << "%";
+    } else {
+      // Any change from 0, e.g., frames dropped where none were before, is
+      // too much.
+      metric_regressed = worse;
+      change << (after == before ? "+0.0%" : "n/a");
+    }
+    entry["regressed"] = metric_regressed;
+    regressed = regressed || metric_regressed;
+    comparison[name] = entry;
+
+    std::cerr << std::left << std::setw(28) << name << std::right
+              << std::fixed << std::setprecision(2) << std::setw(14) << before
+              << std::setw(14) << after << std::setw(10) << change.str()
+              << (metric_regressed ? "  REGRESSED" : "") << std::endl;
+  }
+  report["comparison"] = comparison;
+  return regressed;
 }
 
 int main(int argc, char* argv[]) {
-  // Set up glog
-  gst_init(&argc, &argv);
-  google::InitGoogleLogging(argv[0]);
-  FLAGS_alsologtostderr = 1;
-  FLAGS_colorlogtostderr = 1;
-
-  po::options_description desc("Benchmark for SAF");
+  po::options_description desc(
+      "Measures a pipeline described by a JSON file against synthetic cameras "
+      "and reports the results as JSON");
   desc.add_options()("help,h", "print the help message");
-  desc.add_options()("net,n",
-                     po::value<std::string>()->value_name("NET")->required(),
-                     "The name of the neural net to run");
-  desc.add_options()("camera,c",
-                     po::value<std::string>()->value_name("CAMERAS"),
-                     "The name of the camera to use, if there are multiple "
-                     "cameras to be used, separate with ,");
-  desc.add_options()("config_dir,C",
-                     po::value<std::string>()->value_name("CONFIG_DIR"),
-                     "The directory to find SAF's configuration");
-  desc.add_options()("experiment,e",
-                     po::value<std::string>()->value_name("EXP")->required(),
-                     "Experiment to run");
-  desc.add_options()("verbose,v", po::value<bool>()->default_value(false),
-                     "Verbose logging or not");
-  desc.add_options()("encoder", po::value<std::string>(), "Encoder to use");
-  desc.add_options()("decoder", po::value<std::string>(), "Decoder to use");
-  desc.add_options()("time,t", po::value<int>()->default_value(10),
-                     "Duration of the experiment");
-  desc.add_options()("device", po::value<int>()->default_value(-1),
-                     "which device to use, -1 for CPU, > 0 for GPU device");
-  desc.add_options()("pipeline,p",
-                     po::value<std::string>()->value_name("pipeline"),
-                     "The operator pipeline to run, separate operator with ,");
-  desc.add_options()("store", po::value<bool>()->default_value(false),
-                     "Write video at the end of the pipeline or not");
-
-  po::variables_map vm;
+  desc.add_options()("config-dir,C", po::value<std::string>(),
+                     "The directory containing SAF's config files.");
+  desc.add_options()("pipeline,p", po::value<std::string>()->required(),
+                     "Path to a JSON file describing a pipeline. Its "
+                     "\"Camera\" operators are fed synthetic frames.");
+  desc.add_options()("streams,n", po::value<size_t>()->default_value(1),
+                     "The number of copies of the pipeline to run at once, "
+                     "each with its own cameras.");
+  desc.add_options()("frames,f",
+                     po::value<unsigned long>()->default_value(1000),
+                     "The number of frames that each camera pushes.");
+  desc.add_options()("fps", po::value<double>()->default_value(0),
+                     "The frame rate of each camera. 0 pushes frames as fast "
+                     "as the pipeline takes them, without dropping any.");
+  desc.add_options()("input,i", po::value<std::string>(),
+                     "An image or H.264 video file to replay instead of "
+                     "generated frames. It is decoded before the run starts.");
+  desc.add_options()("width", po::value<int>(),
+                     "The width of the frames. Defaults to 640 for generated "
+                     "frames and to the width of the input file.");
+  desc.add_options()("height", po::value<int>(),
+                     "The height of the frames. Defaults to 480 for generated "
+                     "frames and to the height of the input file.");
+  desc.add_options()("seed", po::value<unsigned int>()->default_value(0),
+                     "The seed of the generated frames.");
+  desc.add_options()("cpu-accounting",
+                     "Measure the CPU time and hardware events of every "
+                     "operator.");
+  desc.add_options()("timeout", po::value<int>()->default_value(600),
+                     "Give up if the pipelines take longer than this many "
+                     "seconds.");
+  desc.add_options()("output,o", po::value<std::string>(),
+                     "Write the report to this file instead of stdout.");
+  desc.add_options()("baseline,b", po::value<std::string>(),
+                     "Compare the key metrics with this earlier report.");
+  desc.add_options()("max-regression", po::value<double>()->default_value(5),
+                     "With --baseline, exit with status 2 if a key metric got "
+                     "worse by more than this many percent.");
+
+  // Parse the command line arguments.
+  po::variables_map args;
   try {
-    po::store(po::parse_command_line(argc, argv, desc), vm);
-    po::notify(vm);
+    po::store(po::parse_command_line(argc, argv, desc), args);
+    if (args.count("help")) {
+      std::cout << desc << std::endl;
+      return 1;
+    }
+    po::notify(args);
   } catch (const po::error& e) {
-    std::cerr << e.what() << endl;
-    cout << desc << endl;
-    return 1;
-  }
-
-  if (vm.count("help")) {
+    std::cerr << e.what() << std::endl;
     std::cout << desc << std::endl;
     return 1;
   }
 
-  if (vm.count("verbose")) {
-    CONFIG.verbose = true;
-  }
-
-  //// Prase arguments
+  // Set up GStreamer.
+  gst_init(&argc, &argv);
+  // Set up glog. The report goes to stdout, so keep the log on stderr.
+  google::InitGoogleLogging(argv[0]);
+  FLAGS_alsologtostderr = 1;
+  FLAGS_colorlogtostderr = 1;
 
-  if (vm.count("config_dir")) {
-    Context::GetContext().SetConfigDir(vm["config_dir"].as<std::string>());
+  // Extract the command line arguments.
+  if (args.count("config-dir")) {
+    Context::GetContext().SetConfigDir(args["config-dir"].as<std::string>());
   }
-  // Init SAF context, this must be called before using SAF.
+  // Initialize the SAF context. This must be called before using SAF.
   Context::GetContext().Init();
 
-  if (vm.count("pipeline")) {
-    auto pipeline = vm["pipeline"].as<std::string>();
-    CONFIG.op_names = SplitString(pipeline, ",");
+  BenchmarkConfig config;
+  config.pipeline_filepath = args["pipeline"].as<std::string>();
+  config.num_streams = args["streams"].as<size_t>();
+  config.num_frames = args["frames"].as<unsigned long>();
+  config.fps = args["fps"].as<double>();
+  if (args.count("input")) {
+    config.input_filepath = args["input"].as<std::string>();
   }
-
-  if (vm.count("camera")) {
-    auto camera = vm["camera"].as<std::string>();
-    CONFIG.camera_names = SplitString(camera, ",");
-  }
-
-  if (vm.count("experiment")) {
-    CONFIG.experiment = vm["experiment"].as<std::string>();
-  }
-
-  if (vm.count("net")) {
-    CONFIG.net = vm["net"].as<std::string>();
+  bool generated = config.input_filepath.empty();
+  config.width = args.count("width") ? args["width"].as<int>()
+                                     : (generated ? 640 : -1);
+  config.height = args.count("height") ? args["height"].as<int>()
+                                       : (generated ? 480 : -1);
+  config.seed = args["seed"].as<unsigned int>();
+  config.cpu_accounting = args.count("cpu-accounting") != 0;
+  config.timeout_s = args["timeout"].as<int>();
+  if (config.num_streams == 0 || config.fps < 0) {
+    std::cerr << "--streams must be at least 1 and --fps at least 0"
+              << std::endl;
+    return 1;
   }
 
-  if (vm.count("encoder")) {
-    CONFIG.encoder = vm["encoder"].as<std::string>();
-    Context::GetContext().SetString(H264_ENCODER_GST_ELEMENT, CONFIG.encoder);
+  std::ifstream pipeline_file(config.pipeline_filepath);
+  if (!pipeline_file) {
+    std::cerr << "Unable to read \"" << config.pipeline_filepath << "\""
+              << std::endl;
+    return 1;
   }
-
-  if (vm.count("decoder")) {
-    CONFIG.decoder = vm["decoder"].as<std::string>();
-    Context::GetContext().SetString(H264_DECODER_GST_ELEMENT, CONFIG.decoder);
+  nlohmann::json spec;
+  pipeline_file >> spec;
+
+  nlohmann::json report = RunBenchmark(config, spec);
+
+  bool regressed = false;
+  if (args.count("baseline")) {
+    std::ifstream baseline_file(args["baseline"].as<std::string>());
+    if (!baseline_file) {
+      std::cerr << "Unable to read \"" << args["baseline"].as<std::string>()
+                << "\"" << std::endl;
+      return 1;
+    }
+    nlohmann::json baseline;
+    baseline_file >> baseline;
+    regressed = CompareWithBaseline(baseline, report,
+                                    args["max-regression"].as<double>());
   }
 
-  if (vm.count("store")) {
-    CONFIG.store = vm["store"].as<bool>();
+  if (args.count("output")) {
+    std::ofstream output_file(args["output"].as<std::string>());
+    output_file << report.dump(2) << std::endl;
+  } else {
+    std::cout << report.dump(2) << std::endl;
   }
 
-  CONFIG.verbose = vm["verbose"].as<bool>();
-  CONFIG.time = vm["time"].as<int>();
-  CONFIG.device_number = vm["device"].as<int>();
-  Context::GetContext().SetInt(DEVICE_NUMBER, CONFIG.device_number);
-
-  if (CONFIG.experiment == "endtoend") {
-    RunEndToEndExperiment();
-  } else if (CONFIG.experiment == "nninfer") {
-    RunNNInferenceExperiment();
-  } else {
-    LOG(ERROR) << "Unknown experiment: " << CONFIG.experiment;
+  if (report["timed_out"].get<bool>()) {
+    return 1;
   }
+  return regressed ? 2 : 0;
 }
@@ -66,9 +66,8 @@ void GigeFileWriter::Process() {
 
   auto frame = GetFrame("input");
 
-  std::vector<char> raw_pixels =
-      frame->GetValue<std::vector<char>>("original_bytes");
-  current_file_.write((char*)raw_pixels.data(), raw_pixels.size());
+  Frame::ByteView raw_pixels = frame->GetBytes("original_bytes");
+  current_file_.write(raw_pixels.data, raw_pixels.size);
 
   frames_written_ += 1;
 }
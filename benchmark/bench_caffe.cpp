@@ -0,0 +1,63 @@
+// Copyright 2018 The SAF Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Benchmarks of code that is only built with Caffe.
+
+#include <random>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "model/caffe_model.h"
+#include "operator/detectors/caffe_mtcnn_face_detector.h"
+
+// Converts a camera image to the normalized floats that a network takes. Only
+// the preprocessing is measured, so the model is never loaded.
+static void BM_CaffeConvertAndNormalize(benchmark::State& state) {
+  int size = state.range(0);
+  ModelDesc model_desc("bench", MODEL_TYPE_CAFFE, "", "", size, size, "", "");
+  CaffeModel model(model_desc, Shape(3, size, size));
+  cv::Mat image(size, size, CV_8UC3, cv::Scalar(64, 128, 192));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(model.ConvertAndNormalize(image));
+  }
+  state.SetBytesProcessed(state.iterations() * image.total() *
+                          image.elemSize());
+}
+BENCHMARK(BM_CaffeConvertAndNormalize)->Arg(224)->Arg(300);
+
+// Suppresses overlaps among state.range(0) candidate faces, as the first
+// MTCNN stage does with its many candidates.
+static void BM_MtcnnNonMaximumSuppression(benchmark::State& state) {
+  std::mt19937 generator(42);
+  std::uniform_real_distribution<float> position(0, 600);
+  std::uniform_real_distribution<float> extent(12, 120);
+  std::uniform_real_distribution<float> score(0, 1);
+  std::vector<FaceInfo> candidates(state.range(0));
+  for (auto& candidate : candidates) {
+    candidate.bbox.x1 = position(generator);
+    candidate.bbox.y1 = position(generator);
+    candidate.bbox.x2 = candidate.bbox.x1 + extent(generator);
+    candidate.bbox.y2 = candidate.bbox.y1 + extent(generator);
+    candidate.bbox.score = score(generator);
+  }
+  for (auto _ : state) {
+    // NonMaximumSuppression() sorts the candidates, so start from a fresh copy
+    // each time.
+    std::vector<FaceInfo> bboxes = candidates;
+    benchmark::DoNotOptimize(MTCNN::NonMaximumSuppression(bboxes, 0.5, 'u'));
+  }
+  state.SetItemsProcessed(state.iterations() * candidates.size());
+}
+BENCHMARK(BM_MtcnnNonMaximumSuppression)->Arg(64)->Arg(1024);
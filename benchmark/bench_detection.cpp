@@ -0,0 +1,65 @@
+// Copyright 2018 The SAF Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Benchmarks of detector post-processing.
+
+#include <random>
+#include <tuple>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include <glog/logging.h>
+
+#include "utils/yolo_utils.h"
+
+// The YOLOv1-tiny output that yolo_utils.h decodes: 7x7 cells with 20 class
+// probabilities each, then 2 box scores and 2 boxes per cell.
+static const int kYoloClasses = 20;
+static const size_t kYoloOutputSize = 1470;
+
+static std::vector<float> MakeYoloPredictions() {
+  std::mt19937 generator(42);
+  std::uniform_real_distribution<float> distribution(0, 1);
+  std::vector<float> predictions(kYoloOutputSize);
+  for (auto& prediction : predictions) {
+    prediction = distribution(generator);
+  }
+  return predictions;
+}
+
+// Suppresses overlapping boxes of every class.
+static void BM_YoloNms(benchmark::State& state) {
+  std::vector<std::vector<float>> probs;
+  std::vector<cv::Rect_<float>> boxes;
+  get_boxes(probs, boxes, MakeYoloPredictions(), kYoloClasses);
+  for (auto _ : state) {
+    // nms_sort() modifies the probabilities, so start from a fresh copy,
+    // which costs little next to the suppression itself.
+    std::vector<std::vector<float>> probs_copy = probs;
+    nms_sort(probs_copy, boxes, kYoloClasses);
+    benchmark::DoNotOptimize(probs_copy);
+  }
+}
+BENCHMARK(BM_YoloNms)->Unit(benchmark::kMillisecond);
+
+// Decodes the boxes, suppresses overlaps, and thresholds the detections.
+static void BM_YoloGetDetections(benchmark::State& state) {
+  std::vector<float> predictions = MakeYoloPredictions();
+  for (auto _ : state) {
+    std::vector<std::tuple<int, cv::Rect, float>> detections;
+    get_detections(detections, predictions, cv::Size(640, 480), kYoloClasses);
+    benchmark::DoNotOptimize(detections);
+  }
+}
+BENCHMARK(BM_YoloGetDetections)->Unit(benchmark::kMillisecond);
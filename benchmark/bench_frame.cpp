@@ -0,0 +1,179 @@
+// Copyright 2018 The SAF Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Benchmarks of Frame field access and of serializing frames.
+
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include <boost/archive/binary_iarchive.hpp>
+#include <boost/archive/binary_oarchive.hpp>
+
+#include "camera/camera.h"
+#include "stream/frame.h"
+#include "stream/frame_codec.h"
+
+// Returns a frame like one that has been through a detector, with a
+// "width"x"height" image.
+static std::unique_ptr<Frame> MakeFrame(int width, int height) {
+  auto frame = std::make_unique<Frame>();
+  frame->SetValue(Frame::kFrameIdField, 1UL);
+  frame->SetValue("camera_name", std::string("bench"));
+  frame->SetValue(Camera::kCaptureTimeMicrosKey,
+                  boost::posix_time::microsec_clock::local_time());
+  frame->SetValue(Frame::kOriginalImageKey,
+                  cv::Mat(height, width, CV_8UC3, cv::Scalar(64, 128, 192)));
+  frame->SetValue("bounding_boxes", std::vector<Rect>(8, Rect(10, 20, 30, 40)));
+  frame->SetValue("tags", std::vector<std::string>(8, "person"));
+  frame->SetValue("confidences", std::vector<double>(8, 0.9));
+  frame->SetValue("features", std::vector<std::vector<float>>(
+                                  8, std::vector<float>(128, 0.5f)));
+  return frame;
+}
+
+// Copies a frame, which only copies a handle to its fields.
+static void BM_FrameCopy(benchmark::State& state) {
+  auto frame = MakeFrame(640, 480);
+  for (auto _ : state) {
+    Frame copy(*frame);
+    benchmark::DoNotOptimize(copy);
+  }
+}
+BENCHMARK(BM_FrameCopy);
+
+// Copies a frame and sets a field of the copy, which copies the field map.
+static void BM_FrameCopyAndSetValue(benchmark::State& state) {
+  auto frame = MakeFrame(640, 480);
+  for (auto _ : state) {
+    Frame copy(*frame);
+    copy.SetValue(Frame::kFrameIdField, 2UL);
+    benchmark::DoNotOptimize(copy);
+  }
+}
+BENCHMARK(BM_FrameCopyAndSetValue);
+
+static void BM_FrameSetValueByName(benchmark::State& state) {
+  auto frame = MakeFrame(640, 480);
+  unsigned long id = 0;
+  for (auto _ : state) {
+    frame->SetValue("frame_id", id++);
+  }
+}
+BENCHMARK(BM_FrameSetValueByName);
+
+static void BM_FrameSetValueByKey(benchmark::State& state) {
+  auto frame = MakeFrame(640, 480);
+  unsigned long id = 0;
+  for (auto _ : state) {
+    frame->SetValue(Frame::kFrameIdField, id++);
+  }
+}
+BENCHMARK(BM_FrameSetValueByKey);
+
+static void BM_FrameGetValueByName(benchmark::State& state) {
+  auto frame = MakeFrame(640, 480);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(frame->GetValue<unsigned long>("frame_id"));
+  }
+}
+BENCHMARK(BM_FrameGetValueByName);
+
+static void BM_FrameGetValueByKey(benchmark::State& state) {
+  auto frame = MakeFrame(640, 480);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(frame->GetValue(Frame::kFrameIdField));
+  }
+}
+BENCHMARK(BM_FrameGetValueByKey);
+
+// Gets a vector field by value, which copies it, and by reference.
+static void BM_FrameGetVectorValue(benchmark::State& state) {
+  auto frame = MakeFrame(640, 480);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(
+        frame->GetValue<std::vector<std::vector<float>>>("features"));
+  }
+}
+BENCHMARK(BM_FrameGetVectorValue);
+
+static void BM_FrameGetVectorRef(benchmark::State& state) {
+  auto frame = MakeFrame(640, 480);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(
+        frame->GetRef<std::vector<std::vector<float>>>("features"));
+  }
+}
+BENCHMARK(BM_FrameGetVectorRef);
+
+// The serialization benchmarks take the image's width and height, and report
+// the size of the encoded frame as bytes processed.
+
+static void BM_FrameSerializeBoost(benchmark::State& state) {
+  std::unique_ptr<Frame> frame = MakeFrame(state.range(0), state.range(1));
+  size_t size = 0;
+  for (auto _ : state) {
+    std::ostringstream o;
+    boost::archive::binary_oarchive ar(o);
+    ar << frame;
+    size = o.tellp();
+  }
+  state.SetBytesProcessed(state.iterations() * size);
+}
+BENCHMARK(BM_FrameSerializeBoost)->Args({320, 240})->Args({1280, 720});
+
+static void BM_FrameDeserializeBoost(benchmark::State& state) {
+  std::unique_ptr<Frame> frame = MakeFrame(state.range(0), state.range(1));
+  std::ostringstream o;
+  {
+    boost::archive::binary_oarchive ar(o);
+    ar << frame;
+  }
+  const std::string data = o.str();
+  for (auto _ : state) {
+    std::istringstream i(data);
+    boost::archive::binary_iarchive ar(i);
+    std::unique_ptr<Frame> decoded;
+    ar >> decoded;
+    benchmark::DoNotOptimize(decoded);
+  }
+  state.SetBytesProcessed(state.iterations() * data.size());
+}
+BENCHMARK(BM_FrameDeserializeBoost)->Args({320, 240})->Args({1280, 720});
+
+// FrameCodec writes cv::Mat pixels and numeric vectors as raw arrays.
+static void BM_FrameEncodeRaw(benchmark::State& state) {
+  auto frame = MakeFrame(state.range(0), state.range(1));
+  size_t size = 0;
+  for (auto _ : state) {
+    std::string data = FrameCodec::Encode(*frame);
+    size = data.size();
+    benchmark::DoNotOptimize(data);
+  }
+  state.SetBytesProcessed(state.iterations() * size);
+}
+BENCHMARK(BM_FrameEncodeRaw)->Args({320, 240})->Args({1280, 720});
+
+// Decodes without copying the image, as the pubsub operators do.
+static void BM_FrameDecodeRaw(benchmark::State& state) {
+  auto frame = MakeFrame(state.range(0), state.range(1));
+  auto data = std::make_shared<std::string>(FrameCodec::Encode(*frame));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(FrameCodec::Decode(data));
+  }
+  state.SetBytesProcessed(state.iterations() * data->size());
+}
+BENCHMARK(BM_FrameDecodeRaw)->Args({320, 240})->Args({1280, 720});
@@ -0,0 +1,99 @@
+// Copyright 2018 The SAF Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Benchmarks of the feature distances used to match and track objects.
+
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include <boost/filesystem.hpp>
+
+#include "operator/face_tracker.h"
+#include "operator/matchers/euclidean_matcher.h"
+#include "operator/matchers/xqda_matcher.h"
+
+// The feature size that XQDAMatcher expects, and that of its subspace.
+static const int kXqdaFeatureSize = 4096;
+static const int kXqdaSubspaceSize = 138;
+
+template <typename T>
+static std::vector<T> MakeFeature(size_t size, unsigned int seed) {
+  std::mt19937 generator(seed);
+  std::uniform_real_distribution<T> distribution(0, 1);
+  std::vector<T> feature(size);
+  for (auto& value : feature) {
+    value = distribution(generator);
+  }
+  return feature;
+}
+
+// Writes a "rows"x"cols" matrix of random values in the comma-separated format
+// that XQDAMatcher reads.
+static void WriteMatrixFile(const std::string& path, int rows, int cols) {
+  std::ofstream file(path);
+  std::vector<double> values = MakeFeature<double>((size_t)rows * cols, rows);
+  for (int row = 0; row < rows; ++row) {
+    for (int col = 0; col < cols; ++col) {
+      file << (col == 0 ? "" : ",") << values[row * cols + col];
+    }
+    file << "\n";
+  }
+}
+
+static void BM_EuclideanMatcherMatch(benchmark::State& state) {
+  EuclideanMatcher matcher;
+  matcher.Init();
+  std::vector<double> a = MakeFeature<double>(state.range(0), 1);
+  std::vector<double> b = MakeFeature<double>(state.range(0), 2);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(matcher.Match(a, b));
+  }
+}
+BENCHMARK(BM_EuclideanMatcherMatch)->Arg(128)->Arg(4096);
+
+// Uses random projection matrices, since only their shape matters here.
+static void BM_XQDAMatcherMatch(benchmark::State& state) {
+  auto dir = boost::filesystem::temp_directory_path() /
+             boost::filesystem::unique_path("saf-xqda-%%%%-%%%%");
+  boost::filesystem::create_directories(dir);
+  std::string w_path = (dir / "W.txt").string();
+  std::string m_path = (dir / "M_xqda.txt").string();
+  WriteMatrixFile(w_path, kXqdaFeatureSize, kXqdaSubspaceSize);
+  WriteMatrixFile(m_path, kXqdaSubspaceSize, kXqdaSubspaceSize);
+  // XQDAMatcher reads W from the params path and M from the desc path.
+  ModelDesc model_desc("xqda", MODEL_TYPE_XQDA, m_path, w_path, 0, 0, "",
+                       "");
+  XQDAMatcher matcher(model_desc);
+  matcher.Init();
+  boost::filesystem::remove_all(dir);
+
+  std::vector<double> a = MakeFeature<double>(kXqdaFeatureSize, 1);
+  std::vector<double> b = MakeFeature<double>(kXqdaFeatureSize, 2);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(matcher.Match(a, b));
+  }
+}
+BENCHMARK(BM_XQDAMatcherMatch)->Unit(benchmark::kMicrosecond);
+
+static void BM_FaceTrackerGetDistance(benchmark::State& state) {
+  std::vector<float> a = MakeFeature<float>(state.range(0), 1);
+  std::vector<float> b = MakeFeature<float>(state.range(0), 2);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(FaceTracker::GetDistance(a, b));
+  }
+}
+BENCHMARK(BM_FaceTrackerGetDistance)->Arg(128)->Arg(512);
@@ -0,0 +1,121 @@
+// Copyright 2018 The SAF Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Benchmarks of moving frames through Streams and StreamReaders.
+
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "camera/camera.h"
+#include "stream/frame.h"
+#include "stream/stream.h"
+
+// Returns a frame with the fields that cameras set, but no image.
+static std::unique_ptr<Frame> MakeFrame(unsigned long id) {
+  auto frame = std::make_unique<Frame>();
+  frame->SetValue(Frame::kFrameIdField, id);
+  frame->SetValue("camera_name", std::string("bench"));
+  frame->SetValue(Camera::kCaptureTimeMicrosKey,
+                  boost::posix_time::microsec_clock::local_time());
+  return frame;
+}
+
+// Pushes one frame to a Stream with state.range(0) readers, then pops it from
+// every reader, on one thread. Measures the cost of fanning a frame out.
+static void BM_StreamPushPop(benchmark::State& state) {
+  Stream stream;
+  std::vector<StreamReader*> readers;
+  for (int i = 0; i < state.range(0); ++i) {
+    readers.push_back(stream.Subscribe());
+  }
+  unsigned long id = 0;
+  for (auto _ : state) {
+    stream.PushFrame(MakeFrame(id++));
+    for (auto reader : readers) {
+      benchmark::DoNotOptimize(reader->PopFrame());
+    }
+  }
+  for (auto reader : readers) {
+    reader->UnSubscribe();
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_StreamPushPop)->Arg(1)->Arg(2)->Arg(4)->Arg(8);
+
+// Like BM_StreamPushPop, but pushes frames in batches of state.range(1).
+static void BM_StreamPushPopBatch(benchmark::State& state) {
+  Stream stream;
+  std::vector<StreamReader*> readers;
+  size_t batch_size = state.range(1);
+  for (int i = 0; i < state.range(0); ++i) {
+    readers.push_back(stream.Subscribe(batch_size));
+  }
+  unsigned long id = 0;
+  for (auto _ : state) {
+    FrameBatch frames;
+    for (size_t i = 0; i < batch_size; ++i) {
+      frames.push_back(MakeFrame(id++));
+    }
+    stream.PushFrames(std::move(frames));
+    for (auto reader : readers) {
+      benchmark::DoNotOptimize(reader->PopFrames(batch_size));
+    }
+  }
+  for (auto reader : readers) {
+    reader->UnSubscribe();
+  }
+  state.SetItemsProcessed(state.iterations() * batch_size);
+}
+BENCHMARK(BM_StreamPushPopBatch)->Args({1, 16})->Args({4, 16});
+
+// Hands state.range(1) frames to each of state.range(0) reader threads per
+// iteration. The producer blocks while a reader's queue is full, so this
+// measures the wake-ups between threads as well as the queues.
+static void BM_StreamHandoff(benchmark::State& state) {
+  const size_t frames_per_iteration = state.range(1);
+  Stream stream;
+  std::vector<StreamReader*> readers;
+  for (int i = 0; i < state.range(0); ++i) {
+    readers.push_back(stream.Subscribe(64));
+  }
+  unsigned long id = 0;
+  for (auto _ : state) {
+    std::vector<std::thread> consumers;
+    for (auto reader : readers) {
+      consumers.emplace_back([reader, frames_per_iteration] {
+        for (size_t i = 0; i < frames_per_iteration; ++i) {
+          benchmark::DoNotOptimize(reader->PopFrame(1000));
+        }
+      });
+    }
+    for (size_t i = 0; i < frames_per_iteration; ++i) {
+      stream.PushFrame(MakeFrame(id++), true);
+    }
+    for (auto& consumer : consumers) {
+      consumer.join();
+    }
+  }
+  for (auto reader : readers) {
+    reader->UnSubscribe();
+  }
+  state.SetItemsProcessed(state.iterations() * frames_per_iteration);
+}
+BENCHMARK(BM_StreamHandoff)
+    ->Args({1, 4096})
+    ->Args({4, 4096})
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
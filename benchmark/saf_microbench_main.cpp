@@ -0,0 +1,40 @@
+// Copyright 2018 The SAF Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Runs SAF's microbenchmarks. Accepts Google Benchmark's flags, e.g.,
+// "--benchmark_filter=Stream" or "--benchmark_format=json", followed by an
+// optional config directory for the benchmarks that need models.
+
+#include <benchmark/benchmark.h>
+#include <glog/logging.h>
+
+#include "common/context.h"
+#include "utils/file_utils.h"
+
+int main(int argc, char** argv) {
+  benchmark::Initialize(&argc, argv);
+  google::InitGoogleLogging(argv[0]);
+  // Keep the results readable.
+  FLAGS_minloglevel = 1;
+  if (argc >= 2) {
+    Context::GetContext().SetConfigDir(argv[1]);
+  } else if (FileExists("./test/config/models.toml")) {
+    Context::GetContext().SetConfigDir("./test/config");
+  } else if (FileExists("./config/models.toml")) {
+    Context::GetContext().SetConfigDir("./config");
+  }
+  Context::GetContext().Init();
+  benchmark::RunSpecifiedBenchmarks();
+  return 0;
+}
@@ -138,6 +138,7 @@ function(saf_print_configuration_summary)
   saf_status("  Debug CXX flags   :   ${__flags_deb}")
   saf_status("  Build type        :   ${CMAKE_BUILD_TYPE}")
   saf_status("  Build tests       : " ${BUILD_TESTS} THEN "Yes" ELSE "No")
+  saf_status("  Build benchmarks  : " ${BUILD_BENCHMARKS} THEN "Yes" ELSE "No")
   saf_status("")
   saf_status("Options:")
   saf_status("  BACKEND           :   ${BACKEND}")
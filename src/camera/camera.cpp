@@ -118,6 +118,11 @@ void Camera::MoveRight() { ExecuteAndCheck((pan_right_command_ + " &")); }
 
 void Camera::PushFrame(const std::string& sink_name,
                        std::unique_ptr<Frame> frame) {
+  // Stop frames have no image.
+  if (frame->IsStopFrame()) {
+    Operator::PushFrame(sink_name, std::move(frame));
+    return;
+  }
   auto img = frame->GetValue<cv::Mat>("original_image");
   int actual_width = img.cols;
   int actual_height = img.rows;
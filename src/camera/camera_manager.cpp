@@ -146,3 +146,10 @@ std::shared_ptr<Camera> CameraManager::GetCamera(const std::string& name) {
 bool CameraManager::HasCamera(const std::string& name) const {
   return cameras_.count(name) != 0;
 }
+
+void CameraManager::AddCamera(std::shared_ptr<Camera> camera) {
+  CHECK(camera != nullptr);
+  CHECK(cameras_.count(camera->GetName()) == 0)
+      << "Camera with name " << camera->GetName() << " is already present";
+  cameras_.emplace(camera->GetName(), camera);
+}
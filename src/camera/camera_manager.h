@@ -40,6 +40,9 @@ class CameraManager {
   std::unordered_map<std::string, std::shared_ptr<Camera>> GetCameras();
   std::shared_ptr<Camera> GetCamera(const std::string& name);
   bool HasCamera(const std::string& name) const;
+  // Makes "camera" available under its name, e.g., to Pipelines that are
+  // created afterwards, in addition to the cameras in the config file.
+  void AddCamera(std::shared_ptr<Camera> camera);
 
  private:
   std::unordered_map<std::string, std::shared_ptr<Camera>> cameras_;
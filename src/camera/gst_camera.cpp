@@ -73,10 +73,7 @@ void GSTCamera::Process() {
       return;
     }
 
-    frame->SetValue("original_bytes",
-                    std::vector<char>((char*)pixels.data,
-                                      (char*)pixels.data +
-                                          pixels.total() * pixels.elemSize()));
+    // "original_bytes" is served from this image by Frame::GetBytes().
     frame->SetValue("original_image", pixels);
   }
   PushFrame("output", std::move(frame));
@@ -0,0 +1,202 @@
+// Copyright 2018 The SAF Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "camera/synthetic_camera.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <thread>
+
+#include "video/gst_video_capture.h"
+
+// The longest that Process() sleeps at a time while waiting for the next
+// frame to be due, so that Stop() does not wait for a slow frame rate.
+constexpr auto kMaxSleep = std::chrono::milliseconds(100);
+// How many times in a row LoadImages() waits for a frame of a video before it
+// gives up on the rest of the video. Each wait takes up to 100 ms.
+constexpr int kMaxEmptyReads = 50;
+
+SyntheticCamera::SyntheticCamera(const std::string& name,
+                                 const std::vector<cv::Mat>& images,
+                                 unsigned long num_frames, double fps)
+    : Camera(name, "synthetic://", images.empty() ? -1 : images.front().cols,
+             images.empty() ? -1 : images.front().rows),
+      images_(images),
+      num_frames_(num_frames),
+      fps_(fps),
+      num_frames_pushed_(0) {
+  CHECK(!images_.empty()) << "SyntheticCamera \"" << name
+                          << "\" needs at least one image";
+  CHECK(fps_ >= 0) << "SyntheticCamera \"" << name
+                   << "\" needs a frame rate of at least 0";
+}
+
+std::vector<cv::Mat> SyntheticCamera::GenerateImages(int width, int height,
+                                                     size_t num_images,
+                                                     unsigned int seed) {
+  CHECK(width > 0 && height > 0) << "Invalid image size: " << width << "x"
+                                 << height;
+  cv::Mat background(height, width, CV_8UC3);
+  cv::RNG rng(seed);
+  rng.fill(background, cv::RNG::UNIFORM, 0, 256);
+
+  int box_width = std::max(1, width / 8);
+  int box_height = std::max(1, height / 8);
+  std::vector<cv::Mat> images;
+  for (size_t i = 0; i < num_images; ++i) {
+    cv::Mat image = background.clone();
+    int x = (int)((width - box_width) * i / std::max<size_t>(1, num_images));
+    image(cv::Rect(x, (height - box_height) / 2, box_width, box_height))
+        .setTo(cv::Scalar(255, 255, 255));
+    images.push_back(image);
+  }
+  return images;
+}
+
+std::vector<cv::Mat> SyntheticCamera::LoadImages(const std::string& path,
+                                                 int width, int height,
+                                                 size_t max_images) {
+  std::vector<cv::Mat> images;
+  cv::Mat image = cv::imread(path);
+  if (!image.empty()) {
+    images.push_back(image);
+  } else {
+    // Not an image, so try to decode it as a video.
+    GstVideoCapture capture(10, false);
+    if (capture.CreatePipeline("file://" + path)) {
+      int empty_reads = 0;
+      for (unsigned long frame_id = 0; images.size() < max_images &&
+                                       !capture.NextFrameIsLast() &&
+                                       empty_reads < kMaxEmptyReads;
+           ++frame_id) {
+        cv::Mat pixels = capture.GetPixels(frame_id);
+        if (pixels.empty()) {
+          ++empty_reads;
+          continue;
+        }
+        empty_reads = 0;
+        images.push_back(pixels.clone());
+      }
+      capture.DestroyPipeline();
+    }
+  }
+  if (images.empty()) {
+    throw std::runtime_error("Unable to read any frames from \"" + path +
+                             "\"");
+  }
+
+  if (width > 0 && height > 0) {
+    for (auto& image : images) {
+      if (image.cols != width || image.rows != height) {
+        cv::Mat resized;
+        cv::resize(image, resized, cv::Size(width, height));
+        image = resized;
+      }
+    }
+  }
+  return images;
+}
+
+unsigned long SyntheticCamera::GetNumFramesPushed() const {
+  return num_frames_pushed_;
+}
+
+bool SyntheticCamera::Init() {
+  // Without a frame rate, the camera runs at the pace of the pipeline instead
+  // of dropping the frames that it cannot keep up with.
+  SetBlockOnPush(fps_ == 0);
+  num_frames_pushed_ = 0;
+  next_frame_time_ = std::chrono::steady_clock::now();
+  return true;
+}
+
+bool SyntheticCamera::OnStop() { return true; }
+
+void SyntheticCamera::Process() {
+  auto frame = std::make_unique<Frame>();
+  unsigned long frame_index = num_frames_pushed_;
+  if (frame_index >= num_frames_) {
+    MetadataToFrame(frame);
+    frame->SetStopFrame(true);
+    // A full queue would drop the stop frame, and the pipeline would never
+    // finish, so wait for room even when running at a fixed frame rate.
+    SetBlockOnPush(true);
+    PushFrame("output", std::move(frame));
+    return;
+  }
+
+  if (fps_ > 0) {
+    auto now = std::chrono::steady_clock::now();
+    while (now < next_frame_time_) {
+      if (stopped_) {
+        return;
+      }
+      std::this_thread::sleep_for(std::min<std::chrono::steady_clock::duration>(
+          next_frame_time_ - now, kMaxSleep));
+      now = std::chrono::steady_clock::now();
+    }
+    // A camera that falls behind does not catch up with a burst of frames.
+    next_frame_time_ =
+        std::max(next_frame_time_ +
+                     std::chrono::duration_cast<
+                         std::chrono::steady_clock::duration>(
+                         std::chrono::duration<double>(1 / fps_)),
+                 now);
+  }
+
+  MetadataToFrame(frame);
+  // Every frame gets its own pixels, like it would from a real camera, so that
+  // operators that draw on them do not change the images of later frames.
+  frame->SetValue("original_image",
+                  images_.at(frame_index % images_.size()).clone());
+  PushFrame("output", std::move(frame));
+  num_frames_pushed_ = frame_index + 1;
+}
+
+CameraType SyntheticCamera::GetCameraType() const {
+  return CAMERA_TYPE_SYNTHETIC;
+}
+
+// A synthetic camera has no controls.
+float SyntheticCamera::GetExposure() { return 0; }
+void SyntheticCamera::SetExposure(float) {}
+float SyntheticCamera::GetSharpness() { return 0; }
+void SyntheticCamera::SetSharpness(float) {}
+Shape SyntheticCamera::GetImageSize() { return Shape(3, width_, height_); }
+void SyntheticCamera::SetBrightness(float) {}
+float SyntheticCamera::GetBrightness() { return 0; }
+void SyntheticCamera::SetSaturation(float) {}
+float SyntheticCamera::GetSaturation() { return 0; }
+void SyntheticCamera::SetHue(float) {}
+float SyntheticCamera::GetHue() { return 0; }
+void SyntheticCamera::SetGain(float) {}
+float SyntheticCamera::GetGain() { return 0; }
+void SyntheticCamera::SetGamma(float) {}
+float SyntheticCamera::GetGamma() { return 0; }
+void SyntheticCamera::SetWBRed(float) {}
+float SyntheticCamera::GetWBRed() { return 0; }
+void SyntheticCamera::SetWBBlue(float) {}
+float SyntheticCamera::GetWBBlue() { return 0; }
+CameraModeType SyntheticCamera::GetMode() { return CAMERA_MODE_INVALID; }
+void SyntheticCamera::SetImageSizeAndMode(Shape, CameraModeType) {}
+CameraPixelFormatType SyntheticCamera::GetPixelFormat() {
+  return CAMERA_PIXEL_FORMAT_BGR;
+}
+void SyntheticCamera::SetPixelFormat(CameraPixelFormatType) {}
+void SyntheticCamera::SetFrameRate(float) {}
+float SyntheticCamera::GetFrameRate() { return (float)fps_; }
+void SyntheticCamera::SetROI(int, int, int, int) {}
+int SyntheticCamera::GetROIOffsetX() { return 0; }
+int SyntheticCamera::GetROIOffsetY() { return 0; }
+Shape SyntheticCamera::GetROIOffsetShape() { return Shape(); }
@@ -0,0 +1,109 @@
+// Copyright 2018 The SAF Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SAF_CAMERA_SYNTHETIC_CAMERA_H_
+#define SAF_CAMERA_SYNTHETIC_CAMERA_H_
+
+#include <atomic>
+#include <chrono>
+#include <vector>
+
+#include "camera/camera.h"
+
+// A camera that pushes frames from memory, so that a pipeline can be measured
+// without camera hardware, a network or a video decoder in the way. The frames
+// cycle through a fixed set of images, which are either generated (see
+// GenerateImages()) or loaded from a file (see LoadImages()), and every run
+// pushes exactly the same pixels.
+//
+// With a frame rate of 0 the camera pushes as fast as the pipeline takes
+// frames, blocking while its output queue is full, which measures the
+// pipeline's peak throughput. With a positive frame rate it pushes on a fixed
+// schedule like a real camera, and frames that the pipeline cannot keep up
+// with are dropped by the overflow policy of the queues that they reach.
+// After "num_frames" frames it pushes a stop frame, which ends the pipeline.
+class SyntheticCamera : public Camera {
+ public:
+  // Pushes "num_frames" frames of "images", which must not be empty and must
+  // all be the same size, at "fps" frames per second, or as fast as possible
+  // if "fps" is 0.
+  SyntheticCamera(const std::string& name, const std::vector<cv::Mat>& images,
+                  unsigned long num_frames, double fps = 0);
+
+  // Generates "num_images" "width" x "height" BGR images of noise, with a
+  // white box that moves a bit further across each one, so that operators
+  // that look for motion have something to find. The same "seed" always
+  // gives the same images.
+  static std::vector<cv::Mat> GenerateImages(int width, int height,
+                                             size_t num_images = 30,
+                                             unsigned int seed = 0);
+  // Decodes up to "max_images" frames of the image or video file "path",
+  // resized to "width" x "height" unless they are -1. Decoding happens once,
+  // up front, so that it is not part of what is measured. Throws
+  // std::runtime_error if "path" cannot be read.
+  static std::vector<cv::Mat> LoadImages(const std::string& path,
+                                         int width = -1, int height = -1,
+                                         size_t max_images = 300);
+
+  // The number of frames, not counting the stop frame, that have been pushed.
+  unsigned long GetNumFramesPushed() const;
+
+  virtual CameraType GetCameraType() const override;
+
+  virtual float GetExposure() override;
+  virtual void SetExposure(float exposure) override;
+  virtual float GetSharpness() override;
+  virtual void SetSharpness(float sharpness) override;
+  virtual Shape GetImageSize() override;
+  virtual void SetBrightness(float brightness) override;
+  virtual float GetBrightness() override;
+  virtual void SetSaturation(float saturation) override;
+  virtual float GetSaturation() override;
+  virtual void SetHue(float hue) override;
+  virtual float GetHue() override;
+  virtual void SetGain(float gain) override;
+  virtual float GetGain() override;
+  virtual void SetGamma(float gamma) override;
+  virtual float GetGamma() override;
+  virtual void SetWBRed(float wb_red) override;
+  virtual float GetWBRed() override;
+  virtual void SetWBBlue(float wb_blue) override;
+  virtual float GetWBBlue() override;
+  virtual CameraModeType GetMode() override;
+  virtual void SetImageSizeAndMode(Shape shape, CameraModeType mode) override;
+  virtual CameraPixelFormatType GetPixelFormat() override;
+  virtual void SetPixelFormat(CameraPixelFormatType pixel_format) override;
+  virtual void SetFrameRate(float f) override;
+  virtual float GetFrameRate() override;
+  virtual void SetROI(int roi_offset_x, int roi_offset_y, int roi_width,
+                      int roi_height) override;
+  virtual int GetROIOffsetX() override;
+  virtual int GetROIOffsetY() override;
+  virtual Shape GetROIOffsetShape() override;
+
+ protected:
+  virtual bool Init() override;
+  virtual bool OnStop() override;
+  virtual void Process() override;
+
+ private:
+  std::vector<cv::Mat> images_;
+  unsigned long num_frames_;
+  double fps_;
+  std::atomic<unsigned long> num_frames_pushed_;
+  // When the next frame is due, if the frame rate is fixed.
+  std::chrono::steady_clock::time_point next_frame_time_;
+};
+
+#endif  // SAF_CAMERA_SYNTHETIC_CAMERA_H_
@@ -21,7 +21,9 @@
 #include <zmq.hpp>
 
 #include "common/timer.h"
+#include "stream/tracer.h"
 #include "utils/gst_utils.h"
+#include "utils/pooled_mat_allocator.h"
 #include "utils/utils.h"
 
 const std::string H264_ENCODER_GST_ELEMENT = "h264_encoder_gst_element";
@@ -51,6 +53,8 @@ class Context {
   void Init() {
     SetEncoderDecoderInformation();
     SetDefaultDeviceInformation();
+    SetMatAllocatorInformation();
+    SetTracingInformation();
     control_context_ = new zmq::context_t(0);
     timer_.Start();
   }
@@ -178,6 +182,51 @@ class Context {
     SetInt(DEVICE_NUMBER, DEVICE_NUMBER_CPU_ONLY);
   }
 
+  /**
+   * @brief Install the pooled cv::Mat allocator if the config enables it
+   */
+  void SetMatAllocatorInformation() {
+    auto root_value = ParseTomlFromFile(GetConfigFile("config.toml"));
+    auto memory_value = root_value.find("memory");
+    if (memory_value == nullptr || !memory_value->has("pool_mat_buffers") ||
+        !memory_value->get<bool>("pool_mat_buffers")) {
+      return;
+    }
+
+    bool use_huge_pages = false;
+    if (memory_value->has("huge_pages")) {
+      use_huge_pages = memory_value->get<bool>("huge_pages");
+    }
+    size_t max_pooled_bytes = PooledMatAllocator::kDefaultMaxPooledBytes;
+    if (memory_value->has("max_pooled_mb")) {
+      max_pooled_bytes = (size_t)memory_value->get<int>("max_pooled_mb") << 20;
+    }
+    PooledMatAllocator::Install(use_huge_pages, max_pooled_bytes);
+  }
+
+  /**
+   * @brief Configure per-frame tracing if the config enables it
+   */
+  void SetTracingInformation() {
+    auto root_value = ParseTomlFromFile(GetConfigFile("config.toml"));
+    auto tracing_value = root_value.find("tracing");
+    if (tracing_value == nullptr) {
+      return;
+    }
+
+    Tracer& tracer = Tracer::GetInstance();
+    if (tracing_value->has("max_spans")) {
+      tracer.SetMaxSpans((size_t)tracing_value->get<int>("max_spans"));
+    }
+    if (tracing_value->has("sampling_rate")) {
+      tracer.SetSamplingRate(tracing_value->get<double>("sampling_rate"));
+    }
+    if (tracing_value->has("dump_path_prefix")) {
+      tracer.InstallSignalHandler(
+          tracing_value->get<std::string>("dump_path_prefix"));
+    }
+  }
+
  private:
   std::string config_dir_;
 
@@ -169,7 +169,12 @@ enum ModelType {
 };
 
 //// Camera types
-enum CameraType { CAMERA_TYPE_GST = 0, CAMERA_TYPE_PTGRAY, CAMERA_TYPE_VIMBA };
+enum CameraType {
+  CAMERA_TYPE_GST = 0,
+  CAMERA_TYPE_PTGRAY,
+  CAMERA_TYPE_VIMBA,
+  CAMERA_TYPE_SYNTHETIC
+};
 
 enum CameraModeType {
   CAMERA_MODE_0 = 0,
@@ -231,6 +236,7 @@ enum OperatorType {
 #endif  // USE_RPC
   OPERATOR_TYPE_FRAME_PUBLISHER,
   OPERATOR_TYPE_FRAME_SUBSCRIBER,
+  OPERATOR_TYPE_FRAME_SYNCHRONIZER,
   OPERATOR_TYPE_FRAME_WRITER,
   OPERATOR_TYPE_IMAGE_CLASSIFIER,
   OPERATOR_TYPE_IMAGE_SEGMENTER,
@@ -290,6 +296,8 @@ inline OperatorType GetOperatorTypeByString(const std::string& type) {
     return OPERATOR_TYPE_FRAME_PUBLISHER;
   } else if (type == "FrameSubscriber") {
     return OPERATOR_TYPE_FRAME_SUBSCRIBER;
+  } else if (type == "FrameSynchronizer") {
+    return OPERATOR_TYPE_FRAME_SYNCHRONIZER;
   } else if (type == "FrameWriter") {
     return OPERATOR_TYPE_FRAME_WRITER;
   } else if (type == "ImageClassifier") {
@@ -366,6 +374,8 @@ inline std::string GetStringForOperatorType(OperatorType type) {
       return "FramePublisher";
     case OPERATOR_TYPE_FRAME_SUBSCRIBER:
       return "FrameSubscriber";
+    case OPERATOR_TYPE_FRAME_SYNCHRONIZER:
+      return "FrameSynchronizer";
     case OPERATOR_TYPE_FRAME_WRITER:
       return "FrameWriter";
     case OPERATOR_TYPE_IMAGE_CLASSIFIER:
@@ -67,15 +67,9 @@ void BinaryFileWriter::Process() {
     LOG(FATAL) << "Unable to open file \"" << filepath_s << "\".";
   }
 
-  std::vector<char> bytes;
+  Frame::ByteView bytes = frame->GetBytes(field_);
   try {
-    bytes = frame->GetValue<std::vector<char>>(field_);
-  } catch (boost::bad_get& e) {
-    LOG(FATAL) << "Unable to get field \"" << field_
-               << "\" as an std::vector<char>: " << e.what();
-  }
-  try {
-    file.write((char*)bytes.data(), bytes.size());
+    file.write(bytes.data, bytes.size);
     file.close();
     if (!file) {
       LOG(FATAL) << "Unknown error while writing binary file \"" << filepath_s
@@ -85,12 +85,19 @@ void Compressor::Process() {
 }
 
 void Compressor::OutputFrames() {
+  // This thread starts before the thread placement is set, so it is applied
+  // once the first frame arrives.
+  bool placed = false;
   while (true) {
     std::unique_lock<std::mutex> lock(queue_mutex_);
     queue_cond_.wait(lock, [this]() { return stop_ || !queue_.empty(); });
     if (stop_) {
       break;
     }
+    if (!placed) {
+      ApplyThreadPlacement(GetThreadPlacement());
+      placed = true;
+    }
     auto future = std::move(queue_.front());
     queue_.pop();
     auto compressed_frame = future.get();
@@ -99,7 +106,7 @@ void Compressor::OutputFrames() {
 }
 
 std::unique_ptr<Frame> Compressor::CompressFrame(std::unique_ptr<Frame> frame) {
-  auto raw_image = frame->GetValue<std::vector<char>>(FIELD_TO_COMPRESS);
+  Frame::ByteView raw_image = frame->GetBytes(FIELD_TO_COMPRESS);
 
   std::vector<char> compressed_raw;
   boost::iostreams::filtering_ostream compressor;
@@ -109,7 +116,7 @@ std::unique_ptr<Frame> Compressor::CompressFrame(std::unique_ptr<Frame> frame) {
     compressor.push(boost::iostreams::gzip_compressor());
   }
   compressor.push(boost::iostreams::back_inserter(compressed_raw));
-  compressor.write((char*)raw_image.data(), raw_image.size());
+  compressor.write(raw_image.data, raw_image.size);
   boost::iostreams::close(compressor);
 
   // Write compressed data to the frame and notify committer thread
@@ -62,6 +62,12 @@ class MTCNN {
   MTCNN(const std::vector<ModelDesc>& model_descs);
   void Detect(const cv::Mat& img, std::vector<FaceInfo>& faceInfo, int minSize,
               double* threshold, double factor);
+  // Keeps the highest-scoring of each group of boxes in "bboxes" that overlap
+  // by more than "thresh", measured as intersection over union if
+  // "methodType" is 'u', or over the smaller box if it is 'm'. Sorts
+  // "bboxes" by score.
+  static std::vector<FaceInfo> NonMaximumSuppression(
+      std::vector<FaceInfo>& bboxes, float thresh, char methodType);
 
  private:
   bool CvMatToDatumSignalChannel(const cv::Mat& cv_mat, Datum* datum);
@@ -80,8 +86,6 @@ class MTCNN {
                              cv::Mat& sample_single,
                              boost::shared_ptr<Net<float> >& net, double thresh,
                              char netName);
-  std::vector<FaceInfo> NonMaximumSuppression(std::vector<FaceInfo>& bboxes,
-                                              float thresh, char methodType);
   void Bbox2Square(std::vector<FaceInfo>& bboxes);
   void Padding(int img_w, int img_h);
   std::vector<FaceInfo> BoxRegress(std::vector<FaceInfo>& faceInfo_, int stage);
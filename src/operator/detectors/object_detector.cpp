@@ -163,6 +163,24 @@ bool ObjectDetector::Init() {
 
 bool ObjectDetector::OnStop() { return true; }
 
+bool ObjectDetector::OnSetParameter(const std::string& name,
+                                    const std::string& value) {
+  float* parameter;
+  if (name == "confidence_threshold") {
+    parameter = &confidence_threshold_;
+  } else if (name == "idle_duration") {
+    parameter = &idle_duration_;
+  } else {
+    return Operator::OnSetParameter(name, value);
+  }
+  try {
+    *parameter = std::stof(value);
+  } catch (const std::exception&) {
+    return false;
+  }
+  return true;
+}
+
 void ObjectDetector::Process() {
   Timer timer;
   timer.Start();
@@ -57,6 +57,9 @@ class ObjectDetector : public Operator {
   virtual bool Init() override;
   virtual bool OnStop() override;
   virtual void Process() override;
+  // Accepts "confidence_threshold" and "idle_duration".
+  virtual bool OnSetParameter(const std::string& name,
+                              const std::string& value) override;
 
  private:
   std::string type_;
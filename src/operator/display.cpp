@@ -49,6 +49,7 @@ Display::Display(const std::string& key, unsigned int angle, float size_ratio,
         << size_ratio_;
     throw std::invalid_argument(msg.str());
   }
+  DeclareFields({key_});
 }
 
 std::shared_ptr<Display> Display::Create(const FactoryParamsType& params) {
@@ -71,6 +72,8 @@ void Display::SetSource(StreamPtr stream) {
 
 StreamPtr Display::GetSink() { return Operator::GetSink(SINK_NAME); }
 
+bool Display::IsBlocking() const { return true; }
+
 bool Display::Init() { return true; }
 
 bool Display::OnStop() { return true; }
@@ -33,6 +33,8 @@ class Display : public Operator {
           const std::string& window_name);
   static std::shared_ptr<Display> Create(const FactoryParamsType& params);
 
+  virtual bool IsBlocking() const override;
+
   void SetSource(StreamPtr stream);
   using Operator::SetSource;
 
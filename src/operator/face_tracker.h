@@ -27,6 +27,10 @@ class FaceTracker : public Operator {
   FaceTracker(size_t rem_size = 5);
   static std::shared_ptr<FaceTracker> Create(const FactoryParamsType& params);
 
+  // Returns the Euclidean distance between the face features "a" and "b".
+  static float GetDistance(const std::vector<float>& a,
+                           const std::vector<float>& b);
+
  protected:
   virtual bool Init() override;
   virtual bool OnStop() override;
@@ -35,7 +39,6 @@ class FaceTracker : public Operator {
  private:
   void AttachNearest(std::vector<PointFeature>& point_features,
                      float threshold);
-  float GetDistance(const std::vector<float>& a, const std::vector<float>& b);
 
  private:
   std::list<std::list<boost::optional<PointFeature>>> path_list_;
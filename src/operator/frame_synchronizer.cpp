@@ -0,0 +1,233 @@
+// Copyright 2018 The SAF Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "operator/frame_synchronizer.h"
+
+#include <algorithm>
+
+#include "camera/camera.h"
+#include "operator/flow_control/flow_control_entrance.h"
+#include "utils/string_utils.h"
+
+constexpr auto SINK_NAME = "output";
+
+const char* FrameSynchronizer::kFramesKey = "frames";
+const char* FrameSynchronizer::kSourceIndicesKey = "source_indices";
+
+FrameSynchronizer::FrameSynchronizer(size_t num_sources,
+                                     unsigned long max_skew_micros,
+                                     unsigned long max_lateness_micros,
+                                     bool emit_partial)
+    : Operator(OPERATOR_TYPE_FRAME_SYNCHRONIZER, {}, {SINK_NAME}),
+      num_sources_(num_sources),
+      max_skew_(boost::posix_time::microseconds(max_skew_micros)),
+      max_lateness_(boost::posix_time::microseconds(max_lateness_micros)),
+      emit_partial_(emit_partial),
+      buffers_(num_sources),
+      watermarks_(num_sources, boost::posix_time::not_a_date_time),
+      max_watermark_(boost::posix_time::not_a_date_time),
+      last_tuple_time_(boost::posix_time::not_a_date_time),
+      next_frame_id_(0),
+      num_tuples_emitted_(0),
+      num_partial_tuples_(0),
+      num_late_frames_(0) {
+  CHECK(num_sources > 0) << "FrameSynchronizer needs at least one source";
+  for (size_t i = 0; i < num_sources; ++i) {
+    sources_.insert({GetSourceName(i), nullptr});
+  }
+}
+
+std::shared_ptr<FrameSynchronizer> FrameSynchronizer::Create(
+    const FactoryParamsType& params) {
+  auto num_sources = StringToSizet(params.at("num_sources"));
+  unsigned long max_skew_micros = std::stoul(params.at("max_skew_micros"));
+
+  // By default, a source may lag the others by one second before it is
+  // considered missing.
+  unsigned long max_lateness_micros = 1000000;
+  if (params.count("max_lateness_micros") != 0) {
+    max_lateness_micros = std::stoul(params.at("max_lateness_micros"));
+  }
+  bool emit_partial = true;
+  if (params.count("emit_partial") != 0) {
+    emit_partial = params.at("emit_partial") == "true";
+  }
+
+  return std::make_shared<FrameSynchronizer>(num_sources, max_skew_micros,
+                                             max_lateness_micros, emit_partial);
+}
+
+StreamPtr FrameSynchronizer::GetSink() { return Operator::GetSink(SINK_NAME); }
+
+unsigned long FrameSynchronizer::GetNumTuplesEmitted() const {
+  return num_tuples_emitted_;
+}
+
+unsigned long FrameSynchronizer::GetNumPartialTuples() const {
+  return num_partial_tuples_;
+}
+
+unsigned long FrameSynchronizer::GetNumLateFrames() const {
+  return num_late_frames_;
+}
+
+bool FrameSynchronizer::Init() { return true; }
+
+bool FrameSynchronizer::OnStop() {
+  // Frames that are still buffered will never be emitted.
+  for (auto& buffer : buffers_) {
+    for (auto& frame : buffer) {
+      ReleaseToken(*frame);
+    }
+    buffer.clear();
+  }
+  return true;
+}
+
+void FrameSynchronizer::Process() {
+  for (size_t i = 0; i < num_sources_; ++i) {
+    auto frame = GetFrame(GetSourceName(i));
+    if (frame != nullptr) {
+      AddFrame(i, std::move(frame));
+    }
+  }
+  EmitReadyTuples();
+}
+
+void FrameSynchronizer::AddFrame(size_t idx, std::unique_ptr<Frame> frame) {
+  auto capture_time = frame->GetValue<boost::posix_time::ptime>(
+      Camera::kCaptureTimeMicrosKey);
+
+  if (!last_tuple_time_.is_not_a_date_time() &&
+      capture_time < last_tuple_time_) {
+    // The tuple that this frame belongs to has already been emitted.
+    LOG(WARNING) << "Frame " << frame->GetValue<unsigned long>("frame_id")
+                 << " from source " << idx << " arrived too late. Dropping.";
+    ++num_late_frames_;
+    ReleaseToken(*frame);
+    return;
+  }
+
+  if (watermarks_.at(idx).is_not_a_date_time() ||
+      capture_time > watermarks_.at(idx)) {
+    watermarks_.at(idx) = capture_time;
+  }
+  if (max_watermark_.is_not_a_date_time() || capture_time > max_watermark_) {
+    max_watermark_ = capture_time;
+  }
+
+  // Sources normally deliver frames in order, so this is almost always an
+  // append.
+  auto& buffer = buffers_.at(idx);
+  auto it = std::upper_bound(
+      buffer.begin(), buffer.end(), capture_time,
+      [](const boost::posix_time::ptime& t, const std::unique_ptr<Frame>& f) {
+        return t < f->GetValue<boost::posix_time::ptime>(
+                       Camera::kCaptureTimeMicrosKey);
+      });
+  buffer.insert(it, std::move(frame));
+}
+
+boost::posix_time::ptime FrameSynchronizer::GetEffectiveWatermark(
+    size_t idx) const {
+  // A source that lags too far behind the most advanced source is treated as
+  // if it had caught up, so that it cannot stall the join.
+  auto lateness_bound = max_watermark_ - max_lateness_;
+  const auto& watermark = watermarks_.at(idx);
+  if (watermark.is_not_a_date_time() || watermark < lateness_bound) {
+    return lateness_bound;
+  }
+  return watermark;
+}
+
+void FrameSynchronizer::EmitReadyTuples() {
+  while (true) {
+    // The oldest buffered frame anchors the next tuple.
+    boost::posix_time::ptime anchor(boost::posix_time::not_a_date_time);
+    for (const auto& buffer : buffers_) {
+      if (!buffer.empty()) {
+        auto t = buffer.front()->GetValue<boost::posix_time::ptime>(
+            Camera::kCaptureTimeMicrosKey);
+        if (anchor.is_not_a_date_time() || t < anchor) {
+          anchor = t;
+        }
+      }
+    }
+    if (anchor.is_not_a_date_time()) {
+      // Nothing is buffered.
+      return;
+    }
+    auto window_end = anchor + max_skew_;
+
+    // A source contributes its oldest frame if it falls inside the window.
+    // Otherwise, the tuple is only final once the source has moved past the
+    // window.
+    std::vector<int> members;
+    bool is_final = true;
+    for (size_t i = 0; i < num_sources_; ++i) {
+      const auto& buffer = buffers_.at(i);
+      if (!buffer.empty() &&
+          buffer.front()->GetValue<boost::posix_time::ptime>(
+              Camera::kCaptureTimeMicrosKey) <= window_end) {
+        members.push_back((int)i);
+      } else if (GetEffectiveWatermark(i) <= window_end) {
+        is_final = false;
+      }
+    }
+    bool complete = members.size() == num_sources_;
+    if (!complete && !is_final) {
+      // Wait for the missing sources.
+      return;
+    }
+
+    std::vector<Frame> frames;
+    for (const auto& i : members) {
+      auto frame = std::move(buffers_.at(i).front());
+      buffers_.at(i).pop_front();
+      // The output frame has no single flow control entrance, so the
+      // absorbed frames give up their tokens here.
+      ReleaseToken(*frame);
+      frames.push_back(*frame);
+    }
+    last_tuple_time_ = anchor;
+
+    if (!complete) {
+      ++num_partial_tuples_;
+      if (!emit_partial_) {
+        VLOG(1) << "Dropping partial tuple with " << members.size() << " of "
+                << num_sources_ << " frames";
+        continue;
+      }
+    }
+
+    auto tuple = std::make_unique<Frame>();
+    tuple->SetValue("frame_id", next_frame_id_++);
+    tuple->SetValue(Camera::kCaptureTimeMicrosKey, anchor);
+    tuple->SetValue(kFramesKey, frames);
+    tuple->SetValue(kSourceIndicesKey, members);
+    PushFrame(SINK_NAME, std::move(tuple));
+    ++num_tuples_emitted_;
+  }
+}
+
+void FrameSynchronizer::ReleaseToken(Frame& frame) {
+  auto flow_control_entrance = frame.GetFlowControlEntrance();
+  if (flow_control_entrance) {
+    flow_control_entrance->ReturnToken(
+        frame.GetValue<unsigned long>("frame_id"));
+    // Change the frame's FlowControlEntrance to null so that it does not try
+    // to release the token again.
+    frame.SetFlowControlEntrance(nullptr);
+  }
+}
@@ -0,0 +1,108 @@
+// Copyright 2018 The SAF Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SAF_OPERATOR_FRAME_SYNCHRONIZER_H_
+#define SAF_OPERATOR_FRAME_SYNCHRONIZER_H_
+
+#include <deque>
+#include <memory>
+#include <vector>
+
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+#include "common/types.h"
+#include "operator/operator.h"
+
+// The FrameSynchronizer operator joins frames from multiple sources by their
+// capture timestamps. Frames are buffered per source, and a tuple containing
+// at most one frame from each source is emitted once every source either has a
+// frame within "max_skew_micros" of the oldest buffered frame or can no longer
+// deliver one.
+//
+// Each source has a watermark, which is the latest capture time that it has
+// delivered. A source whose watermark is more than "max_lateness_micros"
+// behind the most advanced source is considered missing, so a stalled camera
+// does not hold up the others forever. Frames that arrive after their tuple
+// has already been emitted are dropped.
+//
+// Each output frame has its own "frame_id", the capture time of the oldest
+// frame in the tuple, and two extra fields: "frames" (the joined frames, in
+// source order) and "source_indices" (the source index of each joined frame).
+// Joined frames give up their flow control tokens when they are absorbed
+// into a tuple.
+class FrameSynchronizer : public Operator {
+ public:
+  // "emit_partial" controls whether tuples that are missing frames from some
+  // sources are emitted or dropped.
+  FrameSynchronizer(size_t num_sources, unsigned long max_skew_micros,
+                    unsigned long max_lateness_micros, bool emit_partial);
+  static std::shared_ptr<FrameSynchronizer> Create(
+      const FactoryParamsType& params);
+
+  static std::string GetSourceName(int index) {
+    return "input" + std::to_string(index);
+  }
+
+  StreamPtr GetSink();
+  using Operator::GetSink;
+
+  // The number of tuples that have been pushed to the sink.
+  unsigned long GetNumTuplesEmitted() const;
+  // The number of emitted or dropped tuples that lacked frames from some
+  // sources.
+  unsigned long GetNumPartialTuples() const;
+  // The number of frames that were dropped because they arrived too late.
+  unsigned long GetNumLateFrames() const;
+
+  static const char* kFramesKey;
+  static const char* kSourceIndicesKey;
+
+ protected:
+  virtual bool Init() override;
+  virtual bool OnStop() override;
+  virtual void Process() override;
+
+ private:
+  // Buffers "frame" from source "idx", or drops it if it is too late.
+  void AddFrame(size_t idx, std::unique_ptr<Frame> frame);
+  // Emits (or drops) every tuple that can no longer change.
+  void EmitReadyTuples();
+  // The capture time up to which source "idx" is known to be complete, taking
+  // the lateness bound into account.
+  boost::posix_time::ptime GetEffectiveWatermark(size_t idx) const;
+  // Returns the frame's flow control token, if it has one.
+  void ReleaseToken(Frame& frame);
+
+  size_t num_sources_;
+  boost::posix_time::time_duration max_skew_;
+  boost::posix_time::time_duration max_lateness_;
+  bool emit_partial_;
+
+  // Buffered frames from each source, ordered by capture time.
+  std::vector<std::deque<std::unique_ptr<Frame>>> buffers_;
+  // The latest capture time delivered by each source.
+  std::vector<boost::posix_time::ptime> watermarks_;
+  // The latest capture time delivered by any source.
+  boost::posix_time::ptime max_watermark_;
+  // The capture time of the oldest frame in the most recent tuple. Frames
+  // older than this are late.
+  boost::posix_time::ptime last_tuple_time_;
+
+  unsigned long next_frame_id_;
+  unsigned long num_tuples_emitted_;
+  unsigned long num_partial_tuples_;
+  unsigned long num_late_frames_;
+};
+
+#endif  // SAF_OPERATOR_FRAME_SYNCHRONIZER_H_
@@ -25,6 +25,7 @@
 
 #include "camera/camera.h"
 #include "stream/frame.h"
+#include "stream/frame_codec.h"
 #include "utils/time_utils.h"
 
 constexpr auto SOURCE_NAME = "input";
@@ -56,6 +57,8 @@ std::shared_ptr<FrameWriter> FrameWriter::Create(
     format = JSON;
   } else if (format_s == "text") {
     format = TEXT;
+  } else if (format_s == "saf") {
+    format = SAF;
   } else {
     LOG(FATAL) << "Unknown file format: " << format_s;
   }
@@ -120,6 +123,11 @@ void FrameWriter::Process() {
             ar << value;
             break;
           }
+          case SAF: {
+            std::string encoded = FrameCodec::Encode(*frame, {key});
+            file.write(encoded.data(), encoded.size());
+            break;
+          }
         }
       } catch (const boost::archive::archive_exception& e) {
         LOG(FATAL) << "Boost serialization error: " << e.what();
@@ -157,6 +165,11 @@ void FrameWriter::Process() {
           ar << frame_to_write;
           break;
         }
+        case SAF: {
+          std::string encoded = FrameCodec::Encode(*frame, fields_);
+          file.write(encoded.data(), encoded.size());
+          break;
+        }
       }
     } catch (const boost::archive::archive_exception& e) {
       LOG(FATAL) << "Boost serialization error: " << e.what();
@@ -180,6 +193,8 @@ std::string FrameWriter::GetExtension() {
       return ".json";
     case TEXT:
       return ".txt";
+    case SAF:
+      return ".saf";
   }
 
   LOG(FATAL) << "Unhandled FileFormat: " << format_;
@@ -23,11 +23,13 @@
 #include "operator/operator.h"
 #include "utils/output_tracker.h"
 
-// The FrameWriter writes Frames to disk in either binary, JSON, or text format.
-// The user can specify which frame fields to save (the default is all fields).
+// The FrameWriter writes Frames to disk in either binary, SAF, JSON, or text
+// format. BINARY files are Boost archives, while SAF files use FrameCodec's
+// format, which is much faster to write and can be read without copying. The
+// user can specify which frame fields to save (the default is all fields).
 class FrameWriter : public Operator {
  public:
-  enum FileFormat { BINARY, JSON, TEXT };
+  enum FileFormat { BINARY, JSON, TEXT, SAF };
 
   // "fields" is a set of frame fields to save. If "fields" is an empty set,
   // then all fields will be saved. If "save_fields_separately" is true, then
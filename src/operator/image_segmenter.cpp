@@ -21,7 +21,9 @@
 ImageSegmenter::ImageSegmenter(const ModelDesc& model_desc, Shape input_shape)
     : Operator(OPERATOR_TYPE_IMAGE_SEGMENTER, {"input"}, {"output"}),
       model_desc_(model_desc),
-      input_shape_(input_shape) {}
+      input_shape_(input_shape) {
+  DeclareFields({"image", "original_image"}, {"image"});
+}
 
 std::shared_ptr<ImageSegmenter> ImageSegmenter::Create(
     const FactoryParamsType&) {
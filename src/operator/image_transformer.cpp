@@ -27,7 +27,9 @@ ImageTransformer::ImageTransformer(const Shape& target_shape, bool crop,
     : Operator(OPERATOR_TYPE_IMAGE_TRANSFORMER, {SOURCE_NAME}, {SINK_NAME}),
       target_shape_(target_shape),
       crop_(crop),
-      angle_(angle) {}
+      angle_(angle) {
+  DeclareFields({"original_image"}, {kOutputKey});
+}
 
 std::shared_ptr<ImageTransformer> ImageTransformer::Create(
     const FactoryParamsType& params) {
@@ -54,10 +56,42 @@ void ImageTransformer::SetSource(StreamPtr stream) {
 
 StreamPtr ImageTransformer::GetSink() { return Operator::GetSink(SINK_NAME); }
 
+bool ImageTransformer::IsStateless() const { return true; }
+
 void ImageTransformer::Process() {
   auto frame = GetFrame(SOURCE_NAME);
   const cv::Mat& img = frame->GetValue<cv::Mat>("original_image");
+  frame->SetValue("image", TransformImage(img));
+  PushFrame(SINK_NAME, std::move(frame));
+}
 
+// Transforms the images of a batch of frames in parallel, one frame per task.
+class ImageTransformer::BatchTransformer : public cv::ParallelLoopBody {
+ public:
+  BatchTransformer(const ImageTransformer& transformer, FrameBatch& frames)
+      : transformer_(transformer), frames_(frames) {}
+
+  virtual void operator()(const cv::Range& range) const override {
+    for (int i = range.start; i < range.end; ++i) {
+      auto& frame = frames_.at(i);
+      const cv::Mat& img = frame->GetValue<cv::Mat>("original_image");
+      frame->SetValue("image", transformer_.TransformImage(img));
+    }
+  }
+
+ private:
+  const ImageTransformer& transformer_;
+  FrameBatch& frames_;
+};
+
+void ImageTransformer::ProcessBatch() {
+  auto frames = GetFrames(SOURCE_NAME);
+  cv::parallel_for_(cv::Range(0, (int)frames.size()),
+                    BatchTransformer(*this, frames));
+  PushFrames(SINK_NAME, std::move(frames));
+}
+
+cv::Mat ImageTransformer::TransformImage(const cv::Mat& img) const {
   int num_channel = target_shape_.channel;
   int width = target_shape_.width;
   int height = target_shape_.height;
@@ -108,8 +142,7 @@ void ImageTransformer::Process() {
     RotateImage(sample_resized, angle_);
   }
 
-  frame->SetValue("image", sample_resized);
-  PushFrame(SINK_NAME, std::move(frame));
+  return sample_resized;
 }
 
 bool ImageTransformer::Init() { return true; }
@@ -33,14 +33,22 @@ class ImageTransformer : public Operator {
   StreamPtr GetSink();
   using Operator::GetSink;
 
+  virtual bool IsStateless() const override;
+
   static const char* kOutputKey;
 
  protected:
   virtual bool Init() override;
   virtual bool OnStop() override;
   virtual void Process() override;
+  virtual void ProcessBatch() override;
 
  private:
+  class BatchTransformer;
+
+  // Converts, crops, resizes and rotates "img" to match the target shape.
+  cv::Mat TransformImage(const cv::Mat& img) const;
+
   Shape target_shape_;
   bool crop_;
   unsigned int angle_;
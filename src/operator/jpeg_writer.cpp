@@ -36,7 +36,9 @@ JpegWriter::JpegWriter(const std::string& field, const std::string& output_dir,
                        bool organize_by_time, unsigned long frames_per_dir)
     : Operator(OPERATOR_TYPE_JPEG_WRITER, {SOURCE_NAME}, {SINK_NAME}),
       field_(field),
-      tracker_{output_dir, organize_by_time, frames_per_dir} {}
+      tracker_{output_dir, organize_by_time, frames_per_dir} {
+  DeclareFields({field_}, {kPathKey, kFieldKey});
+}
 
 std::shared_ptr<JpegWriter> JpegWriter::Create(
     const FactoryParamsType& params) {
@@ -54,6 +56,8 @@ void JpegWriter::SetSource(StreamPtr stream) {
 
 StreamPtr JpegWriter::GetSink() { return Operator::GetSink(SINK_NAME); }
 
+bool JpegWriter::IsStateless() const { return true; }
+
 bool JpegWriter::Init() { return true; }
 
 bool JpegWriter::OnStop() { return true; }
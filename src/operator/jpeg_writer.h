@@ -45,6 +45,8 @@ class JpegWriter : public Operator {
   StreamPtr GetSink();
   using Operator::GetSink;
 
+  virtual bool IsStateless() const override;
+
   static const char* kPathKey;
   static const char* kFieldKey;
 
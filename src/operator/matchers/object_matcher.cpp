@@ -91,15 +91,15 @@ void ObjectMatcher::Process() {
     auto frame = GetFrame(GetSourceName(i));
     if (!frame) continue;
 
-    auto camera_name = frame->GetValue<std::string>("camera_name");
-    auto ids = frame->GetValue<std::vector<std::string>>("ids");
+    const auto& camera_name = frame->GetRef<std::string>("camera_name");
+    const auto& ids = frame->GetRef<std::vector<std::string>>("ids");
     auto timestamp =
         GetTimeSinceEpochMicros(frame->GetValue<boost::posix_time::ptime>(
             Camera::kCaptureTimeMicrosKey)) /
         1000;
-    auto tags = frame->GetValue<std::vector<std::string>>("tags");
-    auto features =
-        frame->GetValue<std::vector<std::vector<double>>>("features");
+    const auto& tags = frame->GetRef<std::vector<std::string>>("tags");
+    const auto& features =
+        frame->GetRef<std::vector<std::vector<double>>>("features");
     CHECK(ids.size() == tags.size());
     CHECK(ids.size() == features.size());
 
@@ -164,6 +164,7 @@ void ObjectMatcher::Process() {
 }
 
 void ObjectMatcher::ReIDThread() {
+  ApplyThreadPlacement(GetThreadPlacement());
   while (reid_thread_run_) {
     // Delete TrackInfo which deactived 3600 secs
     auto now = GetTimeSinceEpochMillis();
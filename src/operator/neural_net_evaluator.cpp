@@ -27,6 +27,8 @@ NeuralNetEvaluator::NeuralNetEvaluator(
     : Operator(OPERATOR_TYPE_NEURAL_NET_EVALUATOR, {SOURCE_NAME}, {SINK_NAME}),
       input_shape_(input_shape),
       batch_size_(batch_size) {
+  SetMaxBatchSize(batch_size_);
+
   // Load model.
   auto& manager = ModelManager::GetInstance();
   model_ = manager.CreateModel(model_desc, input_shape_, batch_size_);
@@ -53,6 +55,8 @@ NeuralNetEvaluator::NeuralNetEvaluator(
       PublishLayer(layer);
     }
   }
+  DeclareFields({"image"}, {output_layer_names_.begin(),
+                            output_layer_names_.end()});
 }
 
 NeuralNetEvaluator::~NeuralNetEvaluator() {
@@ -88,14 +92,50 @@ std::shared_ptr<NeuralNetEvaluator> NeuralNetEvaluator::Create(
 
   std::vector<std::string> output_layer_names = {
       params.at("output_layer_names")};
-  return std::make_shared<NeuralNetEvaluator>(model_desc, input_shape, 1,
-                                              output_layer_names);
+  size_t batch_size = 1;
+  if (params.count("batch_size") != 0) {
+    batch_size = StringToSizet(params.at("batch_size"));
+  }
+  auto nne = std::make_shared<NeuralNetEvaluator>(
+      model_desc, input_shape, batch_size, output_layer_names);
+  if (params.count("max_batch_delay_ms") != 0) {
+    nne->SetMaxBatchDelay(
+        (unsigned int)StringToSizet(params.at("max_batch_delay_ms")));
+  }
+  return nne;
 }
 
 bool NeuralNetEvaluator::Init() { return true; }
 
 bool NeuralNetEvaluator::OnStop() { return true; }
 
+bool NeuralNetEvaluator::OnSetParameter(const std::string& name,
+                                        const std::string& value) {
+  if (name != "batch_size" && name != "max_batch_size") {
+    return Operator::OnSetParameter(name, value);
+  }
+  // Partial batches are padded to the model's batch size, so smaller batches
+  // do not require reloading the model.
+  size_t batch_size;
+  try {
+    batch_size = std::stoul(value);
+  } catch (const std::exception&) {
+    return false;
+  }
+  if (batch_size == 0 || batch_size > batch_size_) {
+    LOG(WARNING) << "Batch size must be between 1 and " << batch_size_;
+    return false;
+  }
+  return Operator::OnSetParameter("max_batch_size", value);
+}
+
+void NeuralNetEvaluator::SetMaxBatchSize(size_t max_batch_size) {
+  CHECK(max_batch_size <= batch_size_)
+      << "Maximum batch size of operator " << GetName() << " must not exceed "
+      << "the model's batch size of " << batch_size_;
+  Operator::SetMaxBatchSize(max_batch_size);
+}
+
 void NeuralNetEvaluator::SetSource(const std::string& name, StreamPtr stream,
                                    const std::string& layername) {
   if (layername == "") {
@@ -105,6 +145,10 @@ void NeuralNetEvaluator::SetSource(const std::string& name, StreamPtr stream,
   }
   LOG(INFO) << "Using layer \"" << input_layer_name_
             << "\" as input for source \"" << name << "\"";
+  // The intermediate "<name>.*.normalized" field is not read downstream, so it
+  // is dropped as soon as the frame is pushed.
+  DeclareFields({input_layer_name_, "image"},
+                {output_layer_names_.begin(), output_layer_names_.end()});
   Operator::SetSource(name, stream);
 }
 
@@ -116,48 +160,47 @@ void NeuralNetEvaluator::SetSource(StreamPtr stream,
 StreamPtr NeuralNetEvaluator::GetSink() { return Operator::GetSink(SINK_NAME); }
 
 void NeuralNetEvaluator::Process() {
-  auto input_frame = GetFrame(SOURCE_NAME);
-  cv::Mat input_mat;
-  if (input_frame->Count(input_layer_name_) > 0) {
-    input_mat = input_frame->GetValue<cv::Mat>(input_layer_name_);
-    input_frame->SetValue(GetName() + "." + input_layer_name_ + ".normalized",
-                          input_mat);
-  } else {
-    // Only need to call "ConvertAndNormalize()" if the input is an image (as
-    // opposed to a feature map).
-    input_mat = input_frame->GetValue<cv::Mat>("image");
-    input_frame->SetValue(GetName() + ".image.normalized",
-                          model_->ConvertAndNormalize(input_mat));
-  }
-  cur_batch_frames_.push_back(std::move(input_frame));
-  if (cur_batch_frames_.size() < batch_size_) {
-    return;
-  }
-  std::vector<cv::Mat> cur_batch_;
-  for (auto& frame : cur_batch_frames_) {
-    if (frame->Count(input_layer_name_) > 0) {
-      cur_batch_.push_back(frame->GetValue<cv::Mat>(
-          GetName() + "." + input_layer_name_ + ".normalized"));
+  FrameBatch frames;
+  frames.push_back(GetFrame(SOURCE_NAME));
+  EvaluateBatch(std::move(frames));
+}
+
+void NeuralNetEvaluator::ProcessBatch() {
+  EvaluateBatch(GetFrames(SOURCE_NAME));
+}
+
+void NeuralNetEvaluator::EvaluateBatch(FrameBatch frames) {
+  std::vector<cv::Mat> cur_batch;
+  for (auto& input_frame : frames) {
+    cv::Mat input_mat;
+    if (input_frame->Count(input_layer_name_) > 0) {
+      input_mat = input_frame->GetValue<cv::Mat>(input_layer_name_);
+      input_frame->SetValue(
+          GetName() + "." + input_layer_name_ + ".normalized", input_mat);
     } else {
-      cur_batch_.push_back(
-          frame->GetValue<cv::Mat>(GetName() + ".image" + ".normalized"));
+      // Only need to call "ConvertAndNormalize()" if the input is an image (as
+      // opposed to a feature map).
+      input_mat = model_->ConvertAndNormalize(
+          input_frame->GetValue<cv::Mat>("image"));
+      input_frame->SetValue(GetName() + ".image.normalized", input_mat);
     }
+    cur_batch.push_back(input_mat);
+  }
+  // The model only accepts full batches, so a partial batch is padded with
+  // copies of its last input, whose activations are discarded.
+  while (cur_batch.size() < batch_size_) {
+    cur_batch.push_back(cur_batch.back());
   }
 
   auto layer_outputs =
-      model_->Evaluate({{input_layer_name_, cur_batch_}}, output_layer_names_);
+      model_->Evaluate({{input_layer_name_, cur_batch}}, output_layer_names_);
 
-  // Push the activations for each published layer to their respective sink.
-  for (decltype(cur_batch_frames_.size()) i = 0; i < cur_batch_frames_.size();
-       ++i) {
-    std::unique_ptr<Frame> ret_frame = std::move(cur_batch_frames_.at(i));
+  // Set the activations for each published layer, then push the frames to the
+  // sink together.
+  for (decltype(frames.size()) i = 0; i < frames.size(); ++i) {
     for (const auto& layer_pair : layer_outputs) {
-      auto activation_vector = layer_pair.second;
-      auto layer_name = layer_pair.first;
-      cv::Mat activations = activation_vector.at(i);
-      ret_frame->SetValue(layer_name, activations);
+      frames.at(i)->SetValue(layer_pair.first, layer_pair.second.at(i));
     }
-    PushFrame(SINK_NAME, std::move(ret_frame));
   }
-  cur_batch_frames_.clear();
+  PushFrames(SINK_NAME, std::move(frames));
 }
@@ -28,6 +28,11 @@
 // sink is created for each published layer and is named after the layer.
 // At any time, PublishLayer() can be called to expose a previously unpublished
 // layer.
+//
+// Frames are evaluated in batches of up to "batch_size" frames, as many as have
+// arrived. A partial batch is padded to the model's fixed batch size, so that
+// frames never wait for a batch to fill. Call SetMaxBatchDelay() to let
+// batches wait a bounded time for more frames under load.
 class NeuralNetEvaluator : public Operator {
  public:
   // If output_layer_names is empty, then by default the last layer is
@@ -56,21 +61,29 @@ class NeuralNetEvaluator : public Operator {
   StreamPtr GetSink();
   using Operator::GetSink;
 
+  // The maximum batch size must not exceed the batch size that the model was
+  // loaded with.
+  virtual void SetMaxBatchSize(size_t max_batch_size) override;
+
  protected:
   virtual bool Init() override;
   virtual bool OnStop() override;
   virtual void Process() override;
+  virtual void ProcessBatch() override;
+  // Accepts "batch_size" and its alias "max_batch_size", up to the batch size
+  // that the model was loaded with.
+  virtual bool OnSetParameter(const std::string& name,
+                              const std::string& value) override;
 
  private:
-  // Executes the neural network and returns a mapping from the name of a layer
-  // to that layer's activations.
-  std::unordered_map<std::string, cv::Mat> Evaluate();
+  // Runs the neural network on "frames", which may be fewer than the batch
+  // size, and pushes them with the activations of the published layers.
+  void EvaluateBatch(FrameBatch frames);
 
   Shape input_shape_;
   std::string input_layer_name_;
   std::unique_ptr<Model> model_;
   std::vector<std::string> output_layer_names_;
-  std::vector<std::unique_ptr<Frame>> cur_batch_frames_;
   size_t batch_size_;
 };
 
@@ -21,7 +21,9 @@ OpenCVMotionDetector::OpenCVMotionDetector(float threshold, float max_duration)
       first_frame_(true),
       previous_pixels_(0),
       threshold_(threshold),
-      max_duration_(max_duration) {}
+      max_duration_(max_duration) {
+  DeclareFields({"image"});
+}
 
 std::shared_ptr<OpenCVMotionDetector> OpenCVMotionDetector::Create(
     const FactoryParamsType&) {
@@ -17,7 +17,10 @@
 #include "operator/opencv_optical_flow.h"
 
 OpenCVOpticalFlow::OpenCVOpticalFlow()
-    : Operator(OPERATOR_TYPE_OPENCV_OPTICAL_FLOW, {"input"}, {"output"}) {}
+    : Operator(OPERATOR_TYPE_OPENCV_OPTICAL_FLOW, {"input"}, {"output"}) {
+  // "flow" and "cflow" are not set on the first frame.
+  DeclareFields({"original_image"});
+}
 
 std::shared_ptr<OpenCVOpticalFlow> OpenCVOpticalFlow::Create(
     const FactoryParamsType&) {
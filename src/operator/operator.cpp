@@ -14,14 +14,51 @@
 
 #include "operator/operator.h"
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <future>
+#include <iterator>
 #include <sstream>
 #include <stdexcept>
 
 #include "camera/camera.h"
 #include "common/types.h"
+#include "pipeline/executor.h"
+#include "stream/tracer.h"
 #include "utils/utils.h"
 
 static const size_t SLIDING_WINDOW_SIZE = 25;
+// How many frames each replica may have in flight, counting frames that are
+// queued, being processed, or waiting for an earlier frame to be pushed.
+static const size_t FRAMES_IN_FLIGHT_PER_REPLICA = 2;
+// The weight of the newest sample in the batch statistics' moving averages.
+static const double BATCH_STATS_WEIGHT = 0.125;
+
+static void UpdateMovingAverage(std::atomic<double>& average, double sample) {
+  double old_average = average;
+  average = old_average == 0 ? sample
+                             : old_average + BATCH_STATS_WEIGHT *
+                                                 (sample - old_average);
+}
+
+struct Operator::Replica {
+  std::thread thread;
+  // Takes the place of "source_frame_cache_" for the frame that this replica
+  // is processing.
+  std::unordered_map<std::string, std::unique_ptr<Frame>> source_frame_cache;
+  boost::posix_time::ptime processing_start_micros;
+  // The frames that Process() pushed for the current frame.
+  std::vector<std::pair<std::string, std::unique_ptr<Frame>>> outputs;
+};
+
+struct Operator::ParameterChange {
+  std::string name;
+  std::string value;
+  std::promise<bool> result;
+};
+
+thread_local Operator::Replica* Operator::current_replica_ = nullptr;
 
 Operator::Operator(OperatorType type,
                    const std::vector<std::string>& source_names,
@@ -32,7 +69,25 @@ Operator::Operator(OperatorType type,
       trailing_avg_processing_latency_ms_(0),
       queue_latency_sum_ms_(0),
       type_(type),
-      block_on_push_(false) {
+      block_on_push_(false),
+      overflow_policy_(OverflowPolicy::DROP_NEWEST),
+      max_queue_bytes_(0),
+      has_pending_parameters_(false),
+      processing_(false),
+      cpu_accounting_(false),
+      max_batch_size_(1),
+      max_batch_delay_ms_(0),
+      batch_arrival_interval_micros_(0),
+      batch_latency_micros_(0),
+      fields_declared_(false),
+      num_replicas_(1),
+      tasks_closed_(false),
+      next_sequence_(0),
+      num_frames_in_flight_(0),
+      on_executor_(false),
+      initialized_(false),
+      fused_(false),
+      trace_lane_(-1) {
   found_last_frame_ = false;
   stopped_ = true;
 
@@ -93,6 +148,14 @@ bool Operator::Start(size_t buf_size) {
   CHECK(stopped_) << "Operator " << GetName() << " has already started";
 
   op_timer_.Start();
+  if (trace_lane_ < 0) {
+    trace_lane_ = Tracer::GetInstance().RegisterLane(GetName());
+  }
+  // Resolve the per-frame latency field once rather than building its name for
+  // every pushed frame.
+  total_micros_field_ =
+      std::make_unique<FieldKey<boost::posix_time::time_duration>>(
+          GetName() + ".total_micros");
 
   // Check sources are filled
   for (const auto& source : sources_) {
@@ -100,13 +163,52 @@ bool Operator::Start(size_t buf_size) {
         << "Source \"" << source.first << "\" is not set.";
   }
 
+  if (fused_) {
+    // The operator that feeds this one pushes frames straight to it, so there
+    // is nothing to subscribe to and no thread to start.
+    initialized_ = false;
+    stopped_ = false;
+    RegisterMetrics();
+    return true;
+  }
+
   // Subscribe sources
   for (auto& source : sources_) {
-    readers_.emplace(source.first, source.second->Subscribe(buf_size));
+    CHECK(overflow_policy_ != OverflowPolicy::BLOCK ||
+          !source.second->IsPushedFromExecutor())
+        << "Operator " << GetName() << " would block the operator that "
+        << "feeds source \"" << source.first << "\" on an Executor, so it "
+        << "must be started before that operator";
+    StreamReader* reader = source.second->Subscribe(buf_size, overflow_policy_);
+    reader->SetMaxBufferBytes(max_queue_bytes_);
+    reader->SetExtraQueueLatencyHistogram(&queue_latency_histogram_);
+    readers_.emplace(source.first, reader);
+    source_wait_set_.Add(reader);
+    wait_set_source_names_.push_back(source.first);
   }
 
+  RegisterMetrics();
+
   stopped_ = false;
-  process_thread_ = std::thread(&Operator::OperatorLoop, this);
+  initialized_ = false;
+  {
+    std::lock_guard<std::mutex> guard(parameters_mtx_);
+    processing_ = true;
+  }
+  if (num_replicas_ > 1) {
+    CHECK(readers_.size() == 1)
+        << "Operator " << GetName()
+        << " must have exactly one source to be replicated";
+    process_thread_ = std::thread(&Operator::ReplicatedLoop, this);
+  } else if (executor_ != nullptr && !readers_.empty() && !IsBlocking() &&
+             !block_on_push_ && !HasBlockingSinks() &&
+             thread_placement_.IsDefault()) {
+    on_executor_ = true;
+    SetSinksPushedFromExecutor(true);
+    executor_->Add(this);
+  } else {
+    process_thread_ = std::thread(&Operator::OperatorLoop, this);
+  }
   return true;
 }
 
@@ -126,14 +228,40 @@ bool Operator::Stop() {
     p.second->Stop();
   }
 
-  // Unsubscribe from the source streams, which wakes up any blocking calls to
-  // StreamReader::PopFrame() in the process thread.
+  // Stop the source readers, which wakes up any blocking calls to
+  // StreamReader::PopFrame() and StreamWaitSet::Wait() in the process thread.
   for (const auto& reader : readers_) {
-    reader.second->UnSubscribe();
+    reader.second->Stop();
   }
 
   // Join the process thread, completing the main processing loop.
-  process_thread_.join();
+  if (on_executor_) {
+    executor_->Remove(this);
+    on_executor_ = false;
+    SetSinksPushedFromExecutor(false);
+  } else if (fused_) {
+    // Wait for the operator that feeds this one to finish the current frame.
+    std::lock_guard<std::mutex> guard(fused_mtx_);
+  } else {
+    process_thread_.join();
+  }
+
+  UnregisterMetrics();
+
+  // Make the parameter changes that the process thread did not get to.
+  {
+    std::lock_guard<std::mutex> guard(parameters_mtx_);
+    processing_ = false;
+  }
+  ApplyPendingParameters();
+
+  // Now that the process thread is no longer using them, unsubscribe from the
+  // source streams, which may destroy the readers.
+  source_wait_set_.Clear();
+  wait_set_source_names_.clear();
+  for (const auto& reader : readers_) {
+    reader.second->UnSubscribe();
+  }
 
   // Do any operator-specific cleanup.
   bool result = OnStop();
@@ -146,65 +274,402 @@ bool Operator::Stop() {
 }
 
 void Operator::OperatorLoopDirect() {
+  ApplyThreadPlacement(thread_placement_);
   CHECK(Init()) << "Operator is not able to be initialized";
   while (!stopped_ && !found_last_frame_) {
-    Process();
+    if (has_pending_parameters_) {
+      ApplyPendingParameters();
+    }
+    CallProcess();
     ++num_frames_processed_;
   }
 }
 
 void Operator::OperatorLoop() {
+  ApplyThreadPlacement(thread_placement_);
   CHECK(Init()) << "Operator " << GetStringForOperatorType(type_)
                 << " is not able to be initialized";
-  Timer local_timer;
   while (!stopped_ && !found_last_frame_) {
-    // Cache source frames
-    source_frame_cache_.clear();
-    for (auto& reader : readers_) {
-      auto source_name = reader.first;
-      auto source_stream = reader.second;
-
-      auto frame = source_stream->PopFrame(15);
-      if (frame == nullptr) {
-        // This is for nonblock feature.
-        // Case 1: Stop() was called on the StreamReader.
-        // Case 2: StreamReader timeout.
-        // Therefore, we should continue to read other readers.
-        continue;
-      } else if (frame->IsStopFrame()) {
-        // This frame is signaling the pipeline to stop. We need to forward
-        // it to our sinks, then not process it or any future frames.
-        for (const auto& p : sinks_) {
-          PushFrame(p.first, std::make_unique<Frame>(frame));
-        }
-        return;
-      } else {
-        // Calculate queue latency
-        auto start_micros = frame->GetValue<boost::posix_time::ptime>(
-            Camera::kCaptureTimeMicrosKey);
-        boost::posix_time::ptime end_micros =
-            boost::posix_time::microsec_clock::local_time();
-        queue_latency_sum_ms_ +=
-            (end_micros - start_micros).total_milliseconds();
-        source_frame_cache_[source_name] = std::move(frame);
-      }
+    if (!ProcessNextFrames(true)) {
+      return;
     }
+  }
+}
+
+bool Operator::RunOnce() {
+  if (stopped_ || found_last_frame_) {
+    return false;
+  }
+  if (!initialized_) {
+    CHECK(Init()) << "Operator " << GetStringForOperatorType(type_)
+                  << " is not able to be initialized";
+    initialized_ = true;
+  }
+  return ProcessNextFrames(false) && !stopped_ && !found_last_frame_;
+}
+
+bool Operator::HasReadyInput() const {
+  return !source_wait_set_.Poll().empty();
+}
 
-    // This is for nonblock feature.
-    // Camera operator has no readers, should skip this.
-    if (!readers_.empty() && source_frame_cache_.empty()) {
-      // Other operator should continue the while loop when nothing received.
+bool Operator::ProcessNextFrames(bool wait) {
+  if (has_pending_parameters_) {
+    ApplyPendingParameters();
+  }
+  if (max_batch_size_ > 1 && readers_.size() == 1) {
+    if (!wait && !readers_.begin()->second->HasFrame()) {
+      return true;
+    }
+    return ProcessNextBatch(wait);
+  }
+
+  // Cache source frames
+  source_frame_cache_.clear();
+  // Take one frame from each of the ready sources, first parking until at
+  // least one source has a frame if "wait" is set. An empty set means that the
+  // wait timed out or the readers were stopped.
+  std::vector<size_t> ready;
+  if (!readers_.empty()) {
+    ready = wait ? source_wait_set_.Wait(15) : source_wait_set_.Poll();
+  }
+  for (const auto& idx : ready) {
+    const auto& source_name = wait_set_source_names_.at(idx);
+
+    auto frame = readers_.at(source_name)->TryPopFrame();
+    if (frame == nullptr) {
+      // This is for nonblock feature.
+      // Case 1: Stop() was called on the StreamReader.
+      // Case 2: Another thread popped the frame first.
+      // Therefore, we should continue to read other readers.
       continue;
+    } else if (frame->IsStopFrame()) {
+      // This frame is signaling the pipeline to stop. We need to forward
+      // it to our sinks, then not process it or any future frames.
+      ForwardStopFrame(frame);
+      return false;
+    } else {
+      RecordQueueLatency(*frame);
+      source_frame_cache_[source_name] = std::move(frame);
+    }
+  }
+
+  // This is for nonblock feature.
+  // Camera operator has no readers, should skip this.
+  if (!readers_.empty() && source_frame_cache_.empty()) {
+    // Other operator should try again when nothing received.
+    return true;
+  }
+
+  ProcessSourceFrames();
+  return true;
+}
+
+void Operator::ProcessSourceFrames() {
+  TraceScope trace(trace_lane_);
+  for (const auto& p : source_frame_cache_) {
+    if (p.second != nullptr) {
+      trace.AddInput(*p.second);
+    }
+  }
+  processing_start_micros_ = boost::posix_time::microsec_clock::local_time();
+  CallProcess();
+  double processing_latency_ms =
+      (double)(boost::posix_time::microsec_clock::local_time() -
+               processing_start_micros_)
+          .total_microseconds() /
+      1000;
+  processing_start_micros_ = boost::posix_time::not_a_date_time;
+
+  RecordProcessingLatency(processing_latency_ms, 1);
+}
+
+void Operator::ProcessFusedFrame(std::unique_ptr<Frame> frame) {
+  std::lock_guard<std::mutex> guard(fused_mtx_);
+  if (stopped_ || found_last_frame_) {
+    return;
+  }
+  if (!initialized_) {
+    // Init() runs on the same thread as Process(), like it does otherwise.
+    CHECK(Init()) << "Operator " << GetStringForOperatorType(type_)
+                  << " is not able to be initialized";
+    initialized_ = true;
+  }
+
+  if (frame->IsStopFrame()) {
+    ForwardStopFrame(frame);
+    return;
+  }
+  RecordQueueLatency(*frame);
+  source_frame_cache_.clear();
+  source_frame_cache_[sources_.begin()->first] = std::move(frame);
+  ProcessSourceFrames();
+}
+
+bool Operator::ProcessNextBatch(bool wait) {
+  const auto& source_name = readers_.begin()->first;
+  const auto& reader = readers_.begin()->second;
+  auto frames = reader->PopFrames(max_batch_size_, 15);
+
+  // Give a partial batch until the deadline to grow to the target size. An
+  // operator on an Executor does not wait, since that would hold up a thread
+  // of the pool.
+  unsigned int max_batch_delay_ms = max_batch_delay_ms_;
+  if (wait && max_batch_delay_ms > 0 && !frames.empty()) {
+    size_t target_batch_size = GetTargetBatchSize();
+    auto deadline = std::chrono::steady_clock::now() +
+                    std::chrono::milliseconds(max_batch_delay_ms);
+    while (frames.size() < target_batch_size &&
+           !frames.back()->IsStopFrame()) {
+      auto remaining_ms =
+          std::chrono::duration_cast<std::chrono::milliseconds>(
+              deadline - std::chrono::steady_clock::now())
+              .count();
+      if (remaining_ms <= 0) {
+        break;
+      }
+      auto more_frames = reader->PopFrames(target_batch_size - frames.size(),
+                                           (unsigned int)remaining_ms);
+      if (more_frames.empty()) {
+        break;
+      }
+      std::move(more_frames.begin(), more_frames.end(),
+                std::back_inserter(frames));
+    }
+  }
+
+  // A stop frame ends the batch. The frames in front of it are still
+  // processed.
+  std::unique_ptr<Frame> stop_frame;
+  for (auto it = frames.begin(); it != frames.end(); ++it) {
+    if ((*it)->IsStopFrame()) {
+      stop_frame = std::move(*it);
+      frames.erase(it, frames.end());
+      break;
     }
+  }
+
+  auto num_frames = frames.size();
+  if (num_frames > 0) {
+    auto now = boost::posix_time::microsec_clock::local_time();
+    if (!last_batch_micros_.is_not_a_date_time()) {
+      UpdateMovingAverage(
+          batch_arrival_interval_micros_,
+          (double)(now - last_batch_micros_).total_microseconds() /
+              num_frames);
+    }
+    last_batch_micros_ = now;
+    for (const auto& frame : frames) {
+      RecordQueueLatency(*frame);
+    }
+    TraceScope trace(trace_lane_);
+    for (const auto& frame : frames) {
+      trace.AddInput(*frame);
+    }
+    source_batch_cache_[source_name] = std::move(frames);
 
     processing_start_micros_ = boost::posix_time::microsec_clock::local_time();
-    Process();
+    CallProcess(true);
     double processing_latency_ms =
         (double)(boost::posix_time::microsec_clock::local_time() -
                  processing_start_micros_)
-            .total_microseconds();
+            .total_microseconds() /
+        1000;
     processing_start_micros_ = boost::posix_time::not_a_date_time;
+    source_batch_cache_.clear();
+
+    UpdateMovingAverage(batch_latency_micros_, processing_latency_ms * 1000);
+    RecordProcessingLatency(processing_latency_ms, num_frames);
+  }
+
+  if (stop_frame != nullptr) {
+    // This frame is signaling the pipeline to stop. We need to forward it to
+    // our sinks, then not process it or any future frames.
+    ForwardStopFrame(stop_frame);
+    return false;
+  }
+  return true;
+}
+
+void Operator::ReplicatedLoop() {
+  ApplyThreadPlacement(thread_placement_);
+  CHECK(Init()) << "Operator " << GetStringForOperatorType(type_)
+                << " is not able to be initialized";
+
+  tasks_.clear();
+  tasks_closed_ = false;
+  completed_frames_.clear();
+  next_sequence_ = 0;
+  num_frames_in_flight_ = 0;
+  for (size_t i = 0; i < num_replicas_; ++i) {
+    replicas_.push_back(std::make_unique<Replica>());
+    replicas_.back()->thread =
+        std::thread(&Operator::ReplicaLoop, this, replicas_.back().get());
+  }
+
+  StreamReader* reader = readers_.begin()->second;
+  unsigned long sequence = 0;
+  while (!stopped_ && !found_last_frame_) {
+    if (has_pending_parameters_) {
+      // Parameters are only changed while no replica is processing a frame.
+      std::unique_lock<std::mutex> lock(tasks_mtx_);
+      while (!stopped_ && num_frames_in_flight_ > 0) {
+        tasks_cv_.wait_for(lock, std::chrono::milliseconds(15));
+      }
+      lock.unlock();
+      ApplyPendingParameters();
+    }
+    auto frame = reader->PopFrame(15);
+    if (frame == nullptr) {
+      continue;
+    }
+    bool is_stop_frame = frame->IsStopFrame();
+    if (!is_stop_frame) {
+      RecordQueueLatency(*frame);
+    }
+
+    // Limit the frames in flight so that one slow frame cannot make the
+    // reorder buffer grow without bound.
+    {
+      std::unique_lock<std::mutex> lock(tasks_mtx_);
+      while (!stopped_ && num_frames_in_flight_ >=
+                              num_replicas_ * FRAMES_IN_FLIGHT_PER_REPLICA) {
+        tasks_cv_.wait_for(lock, std::chrono::milliseconds(15));
+      }
+      ++num_frames_in_flight_;
+      tasks_.push_back({sequence++, std::move(frame)});
+    }
+    tasks_cv_.notify_all();
+
+    if (is_stop_frame) {
+      // The replicas forward the stop frame once every frame in front of it
+      // has been pushed.
+      break;
+    }
+  }
+
+  {
+    std::lock_guard<std::mutex> guard(tasks_mtx_);
+    tasks_closed_ = true;
+  }
+  tasks_cv_.notify_all();
+  for (const auto& replica : replicas_) {
+    replica->thread.join();
+  }
+  replicas_.clear();
+}
+
+void Operator::ReplicaLoop(Replica* replica) {
+  ApplyThreadPlacement(thread_placement_);
+  current_replica_ = replica;
+  const std::string& source_name = readers_.begin()->first;
+  while (true) {
+    ReplicaTask task;
+    {
+      std::unique_lock<std::mutex> lock(tasks_mtx_);
+      tasks_cv_.wait(lock, [this] { return tasks_closed_ || !tasks_.empty(); });
+      if (tasks_.empty()) {
+        return;
+      }
+      task = std::move(tasks_.front());
+      tasks_.pop_front();
+    }
+
+    double processing_latency_ms = -1;
+    if (task.frame->IsStopFrame()) {
+      ForwardStopFrame(task.frame);
+    } else if (!stopped_) {
+      TraceScope trace(trace_lane_);
+      trace.AddInput(*task.frame);
+      replica->source_frame_cache.clear();
+      replica->source_frame_cache[source_name] = std::move(task.frame);
+      replica->processing_start_micros =
+          boost::posix_time::microsec_clock::local_time();
+      CallProcess();
+      processing_latency_ms =
+          (double)(boost::posix_time::microsec_clock::local_time() -
+                   replica->processing_start_micros)
+              .total_microseconds() /
+          1000;
+      replica->processing_start_micros = boost::posix_time::not_a_date_time;
+    }
+
+    std::lock_guard<std::mutex> guard(reorder_mtx_);
+    completed_frames_[task.sequence] = std::move(replica->outputs);
+    replica->outputs.clear();
+    if (processing_latency_ms >= 0) {
+      RecordProcessingLatency(processing_latency_ms, 1);
+    }
+    PushCompletedFrames();
+  }
+}
+
+void Operator::PushCompletedFrames() {
+  auto it = completed_frames_.begin();
+  while (it != completed_frames_.end() && it->first == next_sequence_) {
+    for (auto& output : it->second) {
+      sinks_.at(output.first)
+          ->PushFrame(std::move(output.second), block_on_push_);
+    }
+    it = completed_frames_.erase(it);
+    ++next_sequence_;
+    --num_frames_in_flight_;
+  }
+  tasks_cv_.notify_all();
+}
+
+void Operator::CallProcess(bool batch) {
+  // Allocations are charged to the operator whichever thread runs it, be it
+  // its own, a replica, an Executor's or that of the operator it is fused to.
+  MatAllocationScope allocation_scope(&mat_allocation_counters_);
+  std::unique_ptr<CpuAccountingScope> scope;
+  if (cpu_accounting_) {
+    scope = std::make_unique<CpuAccountingScope>();
+  }
+  if (batch) {
+    ProcessBatch();
+  } else {
+    Process();
+  }
+  if (scope != nullptr) {
+    cpu_counters_.Record(scope->Stop());
+  }
+}
+
+void Operator::ProcessBatch() {
+  for (auto& p : source_batch_cache_) {
+    for (auto& frame : p.second) {
+      source_frame_cache_.clear();
+      source_frame_cache_[p.first] = std::move(frame);
+      Process();
+    }
+  }
+}
 
+void Operator::RecordQueueLatency(const Frame& frame) {
+  auto start_micros =
+      frame.GetValue<boost::posix_time::ptime>(Camera::kCaptureTimeMicrosKey);
+  boost::posix_time::ptime end_micros =
+      boost::posix_time::microsec_clock::local_time();
+  queue_latency_sum_ms_ += (end_micros - start_micros).total_milliseconds();
+}
+
+void Operator::RecordEndToEndLatency(const Frame& frame) {
+  static const FieldKey<boost::posix_time::ptime> capture_time_field(
+      Camera::kCaptureTimeMicrosKey);
+  if (frame.Count(capture_time_field.GetId()) == 0) {
+    return;
+  }
+  end_to_end_latency_histogram_.Record(
+      (boost::posix_time::microsec_clock::local_time() -
+       frame.GetValue(capture_time_field))
+          .total_microseconds());
+}
+
+void Operator::RecordProcessingLatency(double latency_ms, size_t num_frames) {
+  // Frames in a batch are accounted for individually, each taking an equal
+  // share of the batch's processing time.
+  double processing_latency_ms = latency_ms / num_frames;
+  for (size_t i = 0; i < num_frames; ++i) {
     ++num_frames_processed_;
 
     // Update average processing latency.
@@ -226,12 +691,17 @@ void Operator::OperatorLoop() {
     processing_latencies_ms_.push(processing_latency_ms);
     processing_latencies_sum_ms_ += processing_latency_ms;
     trailing_avg_processing_latency_ms_ =
-        processing_latencies_sum_ms_ / num_latencies;
+        processing_latencies_sum_ms_ / processing_latencies_ms_.size();
+
+    processing_latency_histogram_.Record(
+        (int64_t)(processing_latency_ms * 1000));
   }
 }
 
 bool Operator::IsStarted() const { return !stopped_; }
 
+bool Operator::HasFinished() const { return found_last_frame_; }
+
 double Operator::GetTrailingAvgProcessingLatencyMs() const {
   return trailing_avg_processing_latency_ms_;
 }
@@ -248,6 +718,60 @@ double Operator::GetAvgQueueLatencyMs() const {
   return queue_latency_sum_ms_ / num_frames_processed_;
 }
 
+LatencySummary Operator::GetProcessingLatencySummary() const {
+  return processing_latency_histogram_.GetSummary();
+}
+
+LatencySummary Operator::GetQueueLatencySummary() const {
+  return queue_latency_histogram_.GetSummary();
+}
+
+LatencySummary Operator::GetEndToEndLatencySummary() const {
+  return end_to_end_latency_histogram_.GetSummary();
+}
+
+const LatencyHistogram& Operator::GetProcessingLatencyHistogram() const {
+  return processing_latency_histogram_;
+}
+
+const LatencyHistogram& Operator::GetQueueLatencyHistogram() const {
+  return queue_latency_histogram_;
+}
+
+const LatencyHistogram& Operator::GetEndToEndLatencyHistogram() const {
+  return end_to_end_latency_histogram_;
+}
+
+unsigned long Operator::GetNumFramesDropped() const {
+  unsigned long num_dropped = 0;
+  for (const auto& pair : readers_) {
+    num_dropped += pair.second->GetNumFramesDroppedNewest() +
+                   pair.second->GetNumFramesDroppedOldest() +
+                   pair.second->GetNumFramesConflated();
+  }
+  return num_dropped;
+}
+
+std::string Operator::DumpLatencies() const {
+  std::ostringstream o;
+  o << GetName() << " processing: " << GetProcessingLatencySummary().ToString()
+    << std::endl
+    << GetName() << " queue: " << GetQueueLatencySummary().ToString()
+    << std::endl
+    << GetName() << " end-to-end: " << GetEndToEndLatencySummary().ToString()
+    << std::endl;
+  if (cpu_accounting_) {
+    o << GetName() << " cpu: " << GetCpuStats().ToString() << std::endl;
+  }
+  return o.str();
+}
+
+MatAllocationStats Operator::GetMatAllocationStats() const {
+  return mat_allocation_counters_.Get();
+}
+
+CpuStats Operator::GetCpuStats() const { return cpu_counters_.Get(); }
+
 OperatorType Operator::GetType() const { return type_; }
 
 std::string Operator::GetName() const {
@@ -258,22 +782,508 @@ zmq::socket_t* Operator::GetControlSocket() { return control_socket_; };
 
 void Operator::SetBlockOnPush(bool block) { block_on_push_ = block; }
 
+bool Operator::IsStateless() const { return false; }
+
+void Operator::SetReplicas(size_t replicas) {
+  CHECK(replicas > 0) << "Number of replicas must be positive";
+  CHECK(replicas == 1 || IsStateless())
+      << "Operator " << GetName() << " is not stateless and cannot be "
+      << "replicated";
+  CHECK(stopped_) << "Replicas of operator " << GetName()
+                  << " must be set before it is started";
+  num_replicas_ = replicas;
+}
+
+size_t Operator::GetReplicas() const { return num_replicas_; }
+
+bool Operator::IsBlocking() const { return false; }
+
+bool Operator::HasBlockingSinks() const {
+  for (const auto& sink : sinks_) {
+    if (sink.second->HasBlockingReaders()) {
+      return true;
+    }
+  }
+  // Fused operators push on this operator's thread.
+  for (const auto& fused : fused_sinks_) {
+    if (fused.second->HasBlockingSinks()) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void Operator::SetSinksPushedFromExecutor(bool pushed_from_executor) {
+  for (const auto& sink : sinks_) {
+    sink.second->SetPushedFromExecutor(pushed_from_executor);
+  }
+  for (const auto& fused : fused_sinks_) {
+    fused.second->SetSinksPushedFromExecutor(pushed_from_executor);
+  }
+}
+
+bool Operator::IsFusable() const { return !IsBlocking(); }
+
+bool Operator::CanFuse(const Operator& consumer) const {
+  return IsFusable() && consumer.IsFusable() && num_replicas_ == 1 &&
+         consumer.num_replicas_ == 1 && consumer.sources_.size() == 1 &&
+         consumer.max_batch_size_ == 1 && !consumer.fused_ &&
+         consumer.thread_placement_ == thread_placement_ &&
+         // A fused consumer has no input queue, so it must not rely on one.
+         consumer.overflow_policy_ == OverflowPolicy::DROP_NEWEST &&
+         consumer.max_queue_bytes_ == 0 && !consumer.block_on_push_;
+}
+
+void Operator::FuseSink(const std::string& sink_name, Operator* consumer) {
+  CHECK(stopped_ && consumer->stopped_)
+      << "Operators " << GetName() << " and " << consumer->GetName()
+      << " must be fused before they are started";
+  CHECK(CanFuse(*consumer)) << "Operator " << consumer->GetName()
+                            << " cannot be fused to " << GetName();
+  CHECK(consumer->sources_.begin()->second == GetSink(sink_name))
+      << "Operator " << consumer->GetName() << " does not read sink \""
+      << sink_name << "\" of " << GetName();
+  fused_sinks_[sink_name] = consumer;
+  consumer->fused_ = true;
+}
+
+bool Operator::IsFused() const { return fused_; }
+
+void Operator::SetExecutor(std::shared_ptr<Executor> executor) {
+  CHECK(stopped_) << "Executor of operator " << GetName()
+                  << " must be set before it is started";
+  executor_ = std::move(executor);
+}
+
+bool Operator::SetParameter(const std::string& name, const std::string& value,
+                            unsigned int timeout_ms) {
+  if (fused_) {
+    // Fused operators process frames on the thread of the operator that feeds
+    // them, while holding "fused_mtx_".
+    std::lock_guard<std::mutex> guard(fused_mtx_);
+    return OnSetParameter(name, value);
+  }
+
+  auto change = std::make_shared<ParameterChange>();
+  change->name = name;
+  change->value = value;
+  auto result = change->result.get_future();
+  {
+    std::lock_guard<std::mutex> guard(parameters_mtx_);
+    if (!processing_) {
+      // Nothing else is running, so make the change right away.
+      return OnSetParameter(name, value);
+    }
+    pending_parameters_.push_back(change);
+    has_pending_parameters_ = true;
+  }
+  // Wake up the processing thread, or have the Executor schedule it, in case
+  // it is waiting for frames.
+  source_wait_set_.Notify();
+
+  if (result.wait_for(std::chrono::milliseconds(timeout_ms)) !=
+      std::future_status::ready) {
+    LOG(WARNING) << "Operator " << GetName() << " did not set \"" << name
+                 << "\" within " << timeout_ms << " ms";
+    return false;
+  }
+  return result.get();
+}
+
+void Operator::ApplyPendingParameters() {
+  std::deque<std::shared_ptr<ParameterChange>> changes;
+  {
+    std::lock_guard<std::mutex> guard(parameters_mtx_);
+    changes.swap(pending_parameters_);
+    has_pending_parameters_ = false;
+  }
+  for (const auto& change : changes) {
+    bool ok = OnSetParameter(change->name, change->value);
+    LOG(INFO) << (ok ? "Set" : "Unable to set") << " parameter \""
+              << change->name << "\" of operator " << GetName() << " to \""
+              << change->value << "\"";
+    change->result.set_value(ok);
+  }
+}
+
+bool Operator::OnSetParameter(const std::string& name,
+                              const std::string& value) {
+  if (fused_ && (name == "overflow_policy" || name == "queue_size" ||
+                 name == "queue_bytes")) {
+    LOG(WARNING) << "Operator " << GetName() << " is fused and has no input "
+                 << "queue, so parameter \"" << name << "\" does not apply";
+    return false;
+  }
+  try {
+    if (name == "max_batch_size") {
+      size_t max_batch_size = std::stoul(value);
+      if (max_batch_size == 0) {
+        return false;
+      }
+      max_batch_size_ = max_batch_size;
+    } else if (name == "max_batch_delay_ms") {
+      max_batch_delay_ms_ = (unsigned int)std::stoul(value);
+    } else if (name == "overflow_policy") {
+      OverflowPolicy policy = GetOverflowPolicyByString(value);
+      if (policy == OverflowPolicy::BLOCK) {
+        // A push that blocks would park one of the Executor's threads, maybe
+        // until this operator runs on that very Executor.
+        for (const auto& source : sources_) {
+          if (source.second->IsPushedFromExecutor()) {
+            LOG(WARNING) << "Source \"" << source.first << "\" of operator "
+                         << GetName() << " is fed from an Executor, so it "
+                         << "cannot block";
+            return false;
+          }
+        }
+      }
+      overflow_policy_ = policy;
+      for (const auto& reader : readers_) {
+        reader.second->SetOverflowPolicy(overflow_policy_);
+      }
+    } else if (name == "queue_size") {
+      size_t queue_size = std::stoul(value);
+      for (const auto& reader : readers_) {
+        if (queue_size == 0 ||
+            queue_size > reader.second->GetBufferCapacity()) {
+          return false;
+        }
+      }
+      for (const auto& reader : readers_) {
+        reader.second->SetMaxBufferSize(queue_size);
+      }
+    } else if (name == "cpu_accounting") {
+      if (value != "true" && value != "false") {
+        return false;
+      }
+      cpu_accounting_ = value == "true";
+    } else if (name == "queue_bytes") {
+      max_queue_bytes_ = std::stoul(value);
+      for (const auto& reader : readers_) {
+        reader.second->SetMaxBufferBytes(max_queue_bytes_);
+      }
+    } else {
+      return false;
+    }
+  } catch (const std::exception& e) {
+    // Unparsable numbers and unknown overflow policies.
+    LOG(WARNING) << "Invalid value \"" << value << "\" for parameter \""
+                 << name << "\": " << e.what();
+    return false;
+  }
+  return true;
+}
+
+void Operator::SetThreadPlacement(const ThreadPlacement& placement) {
+  CHECK(stopped_) << "Thread placement of operator " << GetName()
+                  << " must be set before it is started";
+  thread_placement_ = placement;
+}
+
+const ThreadPlacement& Operator::GetThreadPlacement() const {
+  return thread_placement_;
+}
+
+void Operator::SetMetricLabels(const MetricLabels& labels) {
+  CHECK(stopped_) << "Metric labels of operator " << GetName()
+                  << " must be set before it is started";
+  metric_labels_ = labels;
+}
+
+void Operator::SetCpuAccounting(bool enabled) { cpu_accounting_ = enabled; }
+
+bool Operator::IsCpuAccounting() const { return cpu_accounting_; }
+
+void Operator::RegisterMetrics() {
+  if (metric_labels_.empty()) {
+    return;
+  }
+  MetricsRegistry& registry = MetricsRegistry::GetInstance();
+  registry.AddCallback("saf_operator_frames_processed_total",
+                       "Frames processed by the operator.", METRIC_COUNTER,
+                       metric_labels_,
+                       [this] { return (double)num_frames_processed_; });
+  registry.AddCallback(
+      "saf_operator_fps",
+      "Frames processed per second since the operator started.", METRIC_GAUGE,
+      metric_labels_, [this] {
+        double fps = GetHistoricalProcessFps();
+        return std::isfinite(fps) ? fps : 0;
+      });
+  registry.AddLatencyCallback(
+      "saf_operator_processing_latency_seconds",
+      "Time that the operator takes to process a frame.", metric_labels_,
+      [this] { return GetProcessingLatencySummary(); });
+  registry.AddLatencyCallback(
+      "saf_operator_queue_latency_seconds",
+      "Time that frames wait in the operator's source queues.",
+      metric_labels_, [this] { return GetQueueLatencySummary(); });
+  registry.AddLatencyCallback(
+      "saf_operator_end_to_end_latency_seconds",
+      "Time from frame capture until the operator pushes the frame.",
+      metric_labels_, [this] { return GetEndToEndLatencySummary(); });
+  registry.AddCallback(
+      "saf_operator_queued_bytes",
+      "Bytes of frame data waiting in all of the operator's source queues.",
+      METRIC_GAUGE, metric_labels_, [this] {
+        size_t queued_bytes = 0;
+        for (const auto& reader : readers_) {
+          queued_bytes += reader.second->GetQueuedBytes();
+        }
+        return (double)queued_bytes;
+      });
+  // These stay at 0 unless CPU accounting is enabled, and the hardware events
+  // also where there are no hardware counters.
+  registry.AddCallback(
+      "saf_operator_cpu_seconds_total",
+      "CPU time spent in the operator's Process(), excluding fused operators.",
+      METRIC_COUNTER, metric_labels_,
+      [this] { return cpu_counters_.Get().cpu_micros / 1e6; });
+  registry.AddCallback("saf_operator_cycles_total",
+                       "CPU cycles spent in the operator's Process().",
+                       METRIC_COUNTER, metric_labels_,
+                       [this] { return (double)cpu_counters_.Get().cycles; });
+  registry.AddCallback(
+      "saf_operator_instructions_total",
+      "Instructions retired in the operator's Process().", METRIC_COUNTER,
+      metric_labels_,
+      [this] { return (double)cpu_counters_.Get().instructions; });
+  registry.AddCallback(
+      "saf_operator_llc_misses_total",
+      "Last-level cache misses in the operator's Process().", METRIC_COUNTER,
+      metric_labels_,
+      [this] { return (double)cpu_counters_.Get().llc_misses; });
+  registry.AddCallback(
+      "saf_operator_branch_misses_total",
+      "Mispredicted branches in the operator's Process().", METRIC_COUNTER,
+      metric_labels_,
+      [this] { return (double)cpu_counters_.Get().branch_misses; });
+
+  for (const auto& pair : readers_) {
+    StreamReader* reader = pair.second;
+    MetricLabels labels = metric_labels_;
+    labels["source"] = pair.first;
+    registry.AddCallback(
+        "saf_stream_queued_frames", "Frames waiting in a source queue.",
+        METRIC_GAUGE, labels,
+        [reader] { return (double)reader->GetNumQueuedFrames(); });
+    registry.AddCallback(
+        "saf_stream_queue_size",
+        "Frames that a source queue holds before it is full.", METRIC_GAUGE,
+        labels, [reader] { return (double)reader->GetMaxBufferSize(); });
+    registry.AddCallback(
+        "saf_stream_queued_bytes",
+        "Bytes of frame data waiting in a source queue.", METRIC_GAUGE,
+        labels, [reader] { return (double)reader->GetQueuedBytes(); });
+    registry.AddCallback(
+        "saf_stream_frames_pushed_total",
+        "Frames accepted into a source queue.", METRIC_COUNTER, labels,
+        [reader] { return (double)reader->GetNumFramesPushed(); });
+    registry.AddCallback(
+        "saf_stream_frames_popped_total", "Frames popped from a source queue.",
+        METRIC_COUNTER, labels,
+        [reader] { return (double)reader->GetNumFramesPopped(); });
+    registry.AddCallback(
+        "saf_stream_blocked_pushes_total",
+        "Pushes that waited for room in a full source queue.", METRIC_COUNTER,
+        labels, [reader] { return (double)reader->GetNumBlockedPushes(); });
+
+    // Frames lost to the overflow policy, by how they were lost.
+    const std::string dropped_help =
+        "Frames that a full source queue dropped, by overflow policy.";
+    labels["reason"] = "drop_newest";
+    registry.AddCallback(
+        "saf_stream_frames_dropped_total", dropped_help, METRIC_COUNTER,
+        labels,
+        [reader] { return (double)reader->GetNumFramesDroppedNewest(); });
+    labels["reason"] = "drop_oldest";
+    registry.AddCallback(
+        "saf_stream_frames_dropped_total", dropped_help, METRIC_COUNTER,
+        labels,
+        [reader] { return (double)reader->GetNumFramesDroppedOldest(); });
+    labels["reason"] = "latest_only";
+    registry.AddCallback(
+        "saf_stream_frames_dropped_total", dropped_help, METRIC_COUNTER,
+        labels, [reader] { return (double)reader->GetNumFramesConflated(); });
+    labels.erase("reason");
+
+    // The rates are moving averages, which are infinite before the second
+    // frame.
+    registry.AddCallback("saf_stream_push_fps",
+                         "Recent rate of frames pushed to a source queue.",
+                         METRIC_GAUGE, labels, [reader] {
+                           double fps = reader->GetPushFps();
+                           return std::isfinite(fps) ? fps : 0;
+                         });
+    registry.AddCallback("saf_stream_pop_fps",
+                         "Recent rate of frames popped from a source queue.",
+                         METRIC_GAUGE, labels, [reader] {
+                           double fps = reader->GetPopFps();
+                           return std::isfinite(fps) ? fps : 0;
+                         });
+  }
+}
+
+void Operator::UnregisterMetrics() {
+  if (!metric_labels_.empty()) {
+    MetricsRegistry::GetInstance().RemoveCallbacks(metric_labels_);
+  }
+}
+
+void Operator::SetMaxBatchSize(size_t max_batch_size) {
+  CHECK(max_batch_size > 0) << "Batch size must be positive";
+  max_batch_size_ = max_batch_size;
+}
+
+void Operator::SetMaxBatchDelay(unsigned int max_batch_delay_ms) {
+  max_batch_delay_ms_ = max_batch_delay_ms;
+}
+
+size_t Operator::GetTargetBatchSize() const {
+  // Waiting for the frames that arrive while a batch is processed keeps up
+  // with the arrival rate without holding frames back any longer than that.
+  double arrival_interval_micros = batch_arrival_interval_micros_;
+  double batch_latency_micros = batch_latency_micros_;
+  if (arrival_interval_micros <= 0 || batch_latency_micros <= 0) {
+    return 1;
+  }
+  double target_batch_size =
+      std::ceil(batch_latency_micros / arrival_interval_micros);
+  return (size_t)std::max(
+      1.0, std::min(target_batch_size, (double)max_batch_size_));
+}
+
+void Operator::SetOverflowPolicy(OverflowPolicy policy) {
+  CHECK(stopped_) << "Overflow policy of operator " << GetName()
+                  << " must be set before it is started";
+  overflow_policy_ = policy;
+}
+
+void Operator::SetMaxQueueBytes(size_t max_queue_bytes) {
+  CHECK(stopped_) << "Queue bytes of operator " << GetName()
+                  << " must be set before it is started";
+  max_queue_bytes_ = max_queue_bytes;
+}
+
+bool Operator::HasDeclaredFields() const { return fields_declared_; }
+
+const std::unordered_set<std::string>& Operator::GetReadFields() const {
+  return read_fields_;
+}
+
+const std::unordered_set<std::string>& Operator::GetWrittenFields() const {
+  return written_fields_;
+}
+
+void Operator::DeclareFields(const std::unordered_set<std::string>& reads,
+                             const std::unordered_set<std::string>& writes) {
+  fields_declared_ = true;
+  read_fields_ = reads;
+  written_fields_ = writes;
+}
+
+void Operator::SetLiveFields(const std::string& sink_name,
+                             const std::unordered_set<std::string>& fields) {
+  CHECK(stopped_) << "Live fields of operator " << GetName()
+                  << " must be set before it is started";
+  std::unordered_set<FieldId> ids = {
+      Frame::kFrameIdField.GetId(),
+      FieldRegistry::GetId(Camera::kCaptureTimeMicrosKey),
+      FieldRegistry::GetId(Tracer::kTraceIdKey),
+      FieldRegistry::GetId(Tracer::kTracePushMicrosKey)};
+  for (const auto& field : fields) {
+    ids.insert(FieldRegistry::GetId(field));
+  }
+  live_fields_[sink_name] = std::move(ids);
+}
+
+void Operator::DropDeadFields(const std::string& sink_name,
+                              Frame& frame) const {
+  auto it = live_fields_.find(sink_name);
+  if (it != live_fields_.end() && !frame.IsStopFrame()) {
+    frame.DeleteAllExcept(it->second);
+  }
+}
+
 void Operator::PushFrame(const std::string& sink_name,
                          std::unique_ptr<Frame> frame) {
   CHECK(sinks_.count(sink_name) != 0)
       << GetStringForOperatorType(GetType()) << " does not have a sink named \""
       << sink_name << "\"!";
-  if (!processing_start_micros_.is_not_a_date_time()) {
-    frame->SetValue(GetName() + ".total_micros",
+  const boost::posix_time::ptime& processing_start_micros =
+      current_replica_ == nullptr ? processing_start_micros_
+                                  : current_replica_->processing_start_micros;
+  if (!processing_start_micros.is_not_a_date_time() && total_micros_field_) {
+    frame->SetValue(*total_micros_field_,
                     boost::posix_time::microsec_clock::local_time() -
-                        processing_start_micros_);
+                        processing_start_micros);
   }
   if (frame->IsStopFrame()) {
     found_last_frame_ = true;
+  } else {
+    RecordEndToEndLatency(*frame);
+    if (Tracer::IsEnabled()) {
+      Tracer::GetInstance().OnPush(*frame, trace_lane_, sources_.empty());
+    }
+  }
+  DropDeadFields(sink_name, *frame);
+  if (current_replica_ != nullptr) {
+    // Replicas finish frames out of order, so hold on to the frame until
+    // every frame in front of it has been pushed.
+    current_replica_->outputs.emplace_back(sink_name, std::move(frame));
+    return;
+  }
+  auto fused_it = fused_sinks_.find(sink_name);
+  if (fused_it != fused_sinks_.end()) {
+    const StreamPtr& sink = sinks_.at(sink_name);
+    if (sink->HasReaders()) {
+      sink->PushFrame(std::make_unique<Frame>(frame), block_on_push_);
+    }
+    fused_it->second->ProcessFusedFrame(std::move(frame));
+    return;
   }
   sinks_[sink_name]->PushFrame(std::move(frame), block_on_push_);
 }
 
+void Operator::ForwardStopFrame(const std::unique_ptr<Frame>& frame) {
+  for (const auto& p : sinks_) {
+    PushFrame(p.first, std::make_unique<Frame>(frame));
+  }
+  // Pushing the stop frame marks the operator as finished, unless it has no
+  // sinks to push it to.
+  found_last_frame_ = true;
+}
+
+void Operator::PushFrames(const std::string& sink_name, FrameBatch frames) {
+  CHECK(sinks_.count(sink_name) != 0)
+      << GetStringForOperatorType(GetType()) << " does not have a sink named \""
+      << sink_name << "\"!";
+  if (current_replica_ != nullptr || fused_sinks_.count(sink_name) != 0) {
+    for (auto& frame : frames) {
+      PushFrame(sink_name, std::move(frame));
+    }
+    return;
+  }
+  for (const auto& frame : frames) {
+    if (!processing_start_micros_.is_not_a_date_time() &&
+        total_micros_field_) {
+      frame->SetValue(*total_micros_field_,
+                      boost::posix_time::microsec_clock::local_time() -
+                          processing_start_micros_);
+    }
+    if (frame->IsStopFrame()) {
+      found_last_frame_ = true;
+    } else {
+      RecordEndToEndLatency(*frame);
+      if (Tracer::IsEnabled()) {
+        Tracer::GetInstance().OnPush(*frame, trace_lane_, sources_.empty());
+      }
+    }
+    DropDeadFields(sink_name, *frame);
+  }
+  sinks_[sink_name]->PushFrames(std::move(frames), block_on_push_);
+}
+
 std::unique_ptr<Frame> Operator::GetFrame(const std::string& source_name) {
   if (sources_.find(source_name) == sources_.end()) {
     std::ostringstream msg;
@@ -281,14 +1291,31 @@ std::unique_ptr<Frame> Operator::GetFrame(const std::string& source_name) {
         << GetStringForOperatorType(GetType()) << "\".";
     throw std::out_of_range(msg.str());
   }
-  if (source_frame_cache_.find(source_name) == source_frame_cache_.end()) {
+  auto& source_frame_cache = current_replica_ == nullptr
+                                ? source_frame_cache_
+                                : current_replica_->source_frame_cache;
+  if (source_frame_cache.find(source_name) == source_frame_cache.end()) {
     // This is for the nonblocking feature. Sources of some operators (those
     // with multiple sources) may not receive a frame within a PopFrame
     // duration. In this case, we return a nullptr. The caller should handle
     // this nullptr case.
     return nullptr;
   }
-  return std::move(source_frame_cache_[source_name]);
+  return std::move(source_frame_cache[source_name]);
+}
+
+FrameBatch Operator::GetFrames(const std::string& source_name) {
+  if (sources_.find(source_name) == sources_.end()) {
+    std::ostringstream msg;
+    msg << "\"" << source_name << "\" is not a valid source for operator \""
+        << GetStringForOperatorType(GetType()) << "\".";
+    throw std::out_of_range(msg.str());
+  }
+  auto it = source_batch_cache_.find(source_name);
+  if (it == source_batch_cache_.end()) {
+    return FrameBatch();
+  }
+  return std::move(it->second);
 }
 
 std::unique_ptr<Frame> Operator::GetFrameDirect(
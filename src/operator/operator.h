@@ -16,15 +16,28 @@
 #define SAF_OPERATOR_OPERATOR_H_
 
 #include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <queue>
+#include <string>
 #include <thread>
 #include <unordered_map>
+#include <unordered_set>
 
 #include <boost/date_time/posix_time/posix_time.hpp>
 #include <zmq.hpp>
 
 #include "stream/stream.h"
+#include "utils/cpu_accounting.h"
+#include "utils/latency_histogram.h"
+#include "utils/metrics.h"
+#include "utils/pooled_mat_allocator.h"
+#include "utils/thread_utils.h"
 
+class Executor;
 class Pipeline;
 
 #ifdef USE_VIMBA
@@ -37,6 +50,7 @@ class VimbaCameraFrameObserver;
  * streams.
  */
 class Operator {
+  friend class Executor;
   friend class Pipeline;
 #ifdef USE_VIMBA
   friend class VimbaCameraFrameObserver;
@@ -84,6 +98,12 @@ class Operator {
    */
   bool IsStarted() const;
 
+  /**
+   * @brief Check if the operator has reached the end of its input, i.e., it
+   * has seen a stop frame and will not process any more frames.
+   */
+  bool HasFinished() const;
+
   /**
    * @brief Get trailing (sliding window) average latency of the operator.
    * @return Latency in ms.
@@ -102,12 +122,63 @@ class Operator {
    */
   virtual double GetAvgQueueLatencyMs() const;
 
+  /**
+   * @brief Get the distribution of the time that Process() takes per frame.
+   */
+  LatencySummary GetProcessingLatencySummary() const;
+
+  /**
+   * @brief Get the distribution of the time that frames wait in the queues of
+   * this operator's sources, from being pushed to being popped.
+   */
+  LatencySummary GetQueueLatencySummary() const;
+
+  /**
+   * @brief Get the distribution of the time between when frames were captured
+   * and when this operator pushed them to its sinks.
+   */
+  LatencySummary GetEndToEndLatencySummary() const;
+
+  /**
+   * @brief Get the histograms behind the latency summaries above, e.g., to
+   * merge the distributions of several operators.
+   */
+  const LatencyHistogram& GetProcessingLatencyHistogram() const;
+  const LatencyHistogram& GetQueueLatencyHistogram() const;
+  const LatencyHistogram& GetEndToEndLatencyHistogram() const;
+
+  /**
+   * @brief Get the number of frames that the queues of this operator's sources
+   * dropped because they were full, under any overflow policy. Only known
+   * while the operator is started.
+   */
+  unsigned long GetNumFramesDropped() const;
+
+  /**
+   * @brief Describe all of the operator's latency distributions, one per line.
+   */
+  std::string DumpLatencies() const;
+
   /**
    * @brief Get overall throughput of operator.
    * @return in FPS.
    */
   virtual double GetHistoricalProcessFps();
 
+  /**
+   * @brief Get the cv::Mat buffer allocations made by Process(), summed over
+   * replicas and excluding operators fused to this one. Only tracked while
+   * the PooledMatAllocator is installed.
+   */
+  MatAllocationStats GetMatAllocationStats() const;
+
+  /**
+   * @brief Get the CPU time and hardware events that Process() used, excluding
+   * operators fused to this one. Only tracked while CPU accounting is enabled
+   * (see SetCpuAccounting()).
+   */
+  CpuStats GetCpuStats() const;
+
   /**
    * @brief Get the type of the operator
    */
@@ -124,7 +195,132 @@ class Operator {
   // outputs streams if any of its output streams is full.
   virtual void SetBlockOnPush(bool block);
 
+  // Configure what this operator's input queues do when they are full. Must be
+  // called before Start().
+  void SetOverflowPolicy(OverflowPolicy policy);
+
+  // Configure how many bytes of frame data (see Frame::GetRawSizeBytes()) each
+  // input queue holds before it counts as full, in addition to the number of
+  // frames passed to Start(). 0, the default, means no limit. Must be called
+  // before Start().
+  void SetMaxQueueBytes(size_t max_queue_bytes);
+
+  // Configure the maximum number of frames that this operator pops from its
+  // source at once. Values larger than 1 enable ProcessBatch(). Only applies to
+  // operators with exactly one source. Subclasses that cannot process batches
+  // of any size override this to reject larger ones.
+  virtual void SetMaxBatchSize(size_t max_batch_size);
+
+  // Configure how long, in milliseconds, a batch may wait for more frames
+  // after its first frame is popped. The batch waits for about as many frames
+  // as arrive while one batch is processed, up to the maximum batch size, so
+  // batches grow under load but frames are not held back when traffic is
+  // light. 0, the default, processes whatever frames are queued right away.
+  // Operators that run on an Executor never wait.
+  void SetMaxBatchDelay(unsigned int max_batch_delay_ms);
+  // Returns the batch size that a batch currently waits for, based on the
+  // observed frame arrival rate and batch processing time.
+  size_t GetTargetBatchSize() const;
+
+  // Whether Process() keeps no state between frames, so that several frames
+  // may be processed concurrently. Only stateless operators may be replicated.
+  virtual bool IsStateless() const;
+
+  // Configure the number of threads that process this operator's frames
+  // concurrently. Frames are still pushed to the sinks in the order in which
+  // they arrived. Only applies to stateless operators with exactly one source,
+  // which then process one frame at a time per replica regardless of
+  // SetMaxBatchSize(). Must be called before Start().
+  void SetReplicas(size_t replicas);
+  size_t GetReplicas() const;
+
+  // Whether Process() may block for long, e.g., on a socket or a display,
+  // instead of only waiting for its sources. Blocking operators always get a
+  // thread of their own.
+  virtual bool IsBlocking() const;
+
+  // Run this operator on "executor"'s thread pool instead of a dedicated
+  // thread. Ignored for operators that are blocking, replicated, have no
+  // sources, block on push, have a consumer that blocks pushes (see
+  // OverflowPolicy::BLOCK), or have a thread placement, since those could
+  // stall the pool or need a thread of their own. Consumers must therefore be
+  // started first, as Pipeline does. Must be called before Start().
+  void SetExecutor(std::shared_ptr<Executor> executor);
+
+  // Set the tunable parameter "name" to "value" while the operator runs,
+  // e.g., the "fps" of a Throttler, without restarting the pipeline. The
+  // change is made by the processing thread between frames. Every operator
+  // accepts "max_batch_size", "max_batch_delay_ms", "queue_size",
+  // "queue_bytes", "overflow_policy" and "cpu_accounting". Returns false if the
+  // parameter is unknown, the value is invalid, or the change was not made
+  // within "timeout_ms", in which case it is still made before the next frame
+  // is processed.
+  bool SetParameter(const std::string& name, const std::string& value,
+                    unsigned int timeout_ms = 1000);
+
+  // Configure the CPUs, NUMA node and priority of the threads that process
+  // this operator's frames, including any helper threads that it starts, so
+  // that the operators of one camera can be kept on one NUMA node. Must be
+  // called before Start().
+  void SetThreadPlacement(const ThreadPlacement& placement);
+  const ThreadPlacement& GetThreadPlacement() const;
+
+  // Export this operator's metrics, and those of its source queues, through
+  // MetricsRegistry::GetInstance() while it runs, e.g., for Prometheus.
+  // "labels", e.g., the names of the pipeline, operator and camera, must tell
+  // this operator apart from every other one in the process. Nothing is
+  // exported without labels. Must be called before Start().
+  void SetMetricLabels(const MetricLabels& labels);
+
+  // Configure whether to measure the CPU time, and where available the
+  // hardware events, e.g., cycles and cache misses, of every call to
+  // Process() (see GetCpuStats()). Tells apart operators that are CPU-bound
+  // from ones that are memory-bound or wait. Costs a few microseconds per
+  // call, so it is off by default.
+  void SetCpuAccounting(bool enabled);
+  bool IsCpuAccounting() const;
+
+  // Whether this operator may be fused with its neighbours, i.e., have its
+  // Process() called inline on the thread of the operator that feeds it, or
+  // call the Process() of the operator that it feeds on its own thread.
+  // Blocking operators are not fusable by default.
+  virtual bool IsFusable() const;
+
+  // Returns whether "consumer" can be fused to one of this operator's sinks
+  // (see FuseSink()). Operators with different thread placements are never
+  // fused, and neither are consumers configured with a non-default overflow
+  // policy, queue byte limit, or blocking pushes, since fusing them would
+  // bypass their input queue.
+  bool CanFuse(const Operator& consumer) const;
+
+  // Fuse "consumer", whose only source must be the sink "sink_name", to this
+  // operator. Frames pushed to that sink are then processed by "consumer"
+  // right away on this operator's thread, instead of being queued for a thread
+  // of its own. Frames are still pushed to any other readers of the sink, but
+  // "consumer" itself never drops frames or batches them. Must be called before
+  // either operator is started, and "consumer" must outlive this operator.
+  void FuseSink(const std::string& sink_name, Operator* consumer);
+
+  // Returns whether this operator runs inline on the thread of the operator
+  // that feeds it.
+  bool IsFused() const;
+
+  // Returns whether this operator declared the fields that it reads and
+  // writes (see DeclareFields()).
+  bool HasDeclaredFields() const;
+  const std::unordered_set<std::string>& GetReadFields() const;
+  const std::unordered_set<std::string>& GetWrittenFields() const;
+
  protected:
+  // Declares the fields that this operator reads from its input frames, and
+  // the fields that it sets on every frame that it outputs. The Pipeline uses
+  // these to drop fields from frames after their last reader. Operators that
+  // do not declare their fields are assumed to read every field. May be called
+  // again, e.g., once the operator's configuration is known, but not after
+  // the Pipeline has been constructed.
+  void DeclareFields(const std::unordered_set<std::string>& reads,
+                     const std::unordered_set<std::string>& writes = {});
+
   /**
    * @brief Initialize the operator.
    */
@@ -142,24 +338,49 @@ class Operator {
    * @return A list of output frames.
    */
   virtual void Process() = 0;
+  /**
+   * @brief Process all of the frames returned by GetFrames(). Called instead
+   * of Process() when batching is enabled (see SetMaxBatchSize()). The
+   * default implementation calls Process() once per frame. Operators that
+   * can amortize work across frames should override it.
+   */
+  virtual void ProcessBatch();
 
   std::unique_ptr<Frame> GetFrame(const std::string& source_name);
+  // Sets a tunable parameter (see SetParameter()). Called on the processing
+  // thread, or while the operator is stopped. Overrides handle their own
+  // parameters and pass the rest on to this implementation. Returns false if
+  // "name" is unknown or "value" is invalid.
+  virtual bool OnSetParameter(const std::string& name,
+                              const std::string& value);
+
+  // Returns the batch of frames fetched from "source_name" for ProcessBatch().
+  FrameBatch GetFrames(const std::string& source_name);
   std::unique_ptr<Frame> GetFrameDirect(const std::string& source_name);
   virtual void PushFrame(const std::string& sink_name,
                          std::unique_ptr<Frame> frame);
+  void PushFrames(const std::string& sink_name, FrameBatch frames);
+  // Pushes a copy of the stop frame "frame" to every sink, after which the
+  // operator does not process any more frames.
+  void ForwardStopFrame(const std::unique_ptr<Frame>& frame);
   void OperatorLoop();
   void OperatorLoopDirect();
 
   std::unordered_map<std::string, std::unique_ptr<Frame>> source_frame_cache_;
+  std::unordered_map<std::string, FrameBatch> source_batch_cache_;
   std::unordered_map<std::string, StreamPtr> sources_;
   std::unordered_map<std::string, StreamPtr> sinks_;
   std::unordered_map<std::string, StreamReader*> readers_;
+  // Wakes up the process thread as soon as any of the readers has a frame.
+  StreamWaitSet source_wait_set_;
+  // The source name of each reader in "source_wait_set_", by index.
+  std::vector<std::string> wait_set_source_names_;
 
   std::thread process_thread_;
   std::atomic<bool> stopped_;
   std::atomic<bool> found_last_frame_;
 
-  unsigned int num_frames_processed_;
+  std::atomic<unsigned long> num_frames_processed_;
   double avg_processing_latency_ms_;
   // A queue of recent processing latencies.
   std::queue<double> processing_latencies_ms_;
@@ -170,14 +391,159 @@ class Operator {
   // Processing latency, computed using a sliding window average.
   double trailing_avg_processing_latency_ms_;
   double queue_latency_sum_ms_;
+  LatencyHistogram processing_latency_histogram_;
+  LatencyHistogram queue_latency_histogram_;
+  LatencyHistogram end_to_end_latency_histogram_;
 
  private:
+  struct Replica;
+  struct ReplicaTask {
+    // The position of "frame" in the input order.
+    unsigned long sequence;
+    std::unique_ptr<Frame> frame;
+  };
+
+  struct ParameterChange;
+
+  // Makes the parameter changes that SetParameter() queued.
+  void ApplyPendingParameters();
+  // Adds this operator's metrics to, and removes them from, the
+  // MetricsRegistry. The callbacks read the readers, so they must be removed
+  // before the readers are unsubscribed.
+  void RegisterMetrics();
+  void UnregisterMetrics();
+  // Calls ProcessBatch() if "batch" is true, or Process() otherwise, and adds
+  // what it used to "cpu_counters_" if CPU accounting is enabled.
+  void CallProcess(bool batch = false);
+  // Pops and processes the next frames from the sources. If "wait" is true,
+  // parks for a while if none of the sources have frames. Returns false if a
+  // stop frame was found.
+  bool ProcessNextFrames(bool wait);
+  // Pops and processes one batch from the only source. If "wait" is true, a
+  // partial batch may wait for more frames (see SetMaxBatchDelay()). Returns
+  // false if a stop frame was found.
+  bool ProcessNextBatch(bool wait);
+  // Processes whatever frames the sources have, without waiting. Called by the
+  // Executor instead of OperatorLoop(). Returns false once the operator has
+  // stopped or forwarded the stop frame.
+  bool RunOnce();
+  // Returns whether any of the sources has a frame.
+  bool HasReadyInput() const;
+  // Calls Process() on the frames in "source_frame_cache_" and records how
+  // long it took.
+  void ProcessSourceFrames();
+  // Processes "frame" from the only source on the calling thread. Called by
+  // the operator that this operator is fused to.
+  void ProcessFusedFrame(std::unique_ptr<Frame> frame);
+  // Replaces OperatorLoop() when the operator is replicated. Pops frames from
+  // the only source and hands them to the replicas.
+  void ReplicatedLoop();
+  void ReplicaLoop(Replica* replica);
+  // Pushes the outputs of completed frames to the sinks, stopping at the first
+  // frame that is still being processed. Requires "reorder_mtx_".
+  void PushCompletedFrames();
+  // Accumulates the time that "frame" spent between capture and now.
+  void RecordQueueLatency(const Frame& frame);
+  // Records the time between when "frame" was captured and now, if it has a
+  // capture time.
+  void RecordEndToEndLatency(const Frame& frame);
+  // Updates the processing statistics after "num_frames" frames were processed
+  // in "latency_ms" in total.
+  void RecordProcessingLatency(double latency_ms, size_t num_frames);
+  // Restricts the frames pushed to "sink_name" to "fields", plus the fields
+  // that every operator relies on. Called by Pipeline.
+  void SetLiveFields(const std::string& sink_name,
+                     const std::unordered_set<std::string>& fields);
+  // Deletes the fields of "frame" that no consumer of "sink_name" reads.
+  void DropDeadFields(const std::string& sink_name, Frame& frame) const;
+  // Whether a consumer of any sink, including those of fused operators, blocks
+  // pushes when it is full, which would stall an Executor's thread.
+  bool HasBlockingSinks() const;
+  // Marks the sinks, including those of fused operators, as pushed to from an
+  // Executor's thread, or not.
+  void SetSinksPushedFromExecutor(bool pushed_from_executor);
+
   const OperatorType type_;
   zmq::socket_t* control_socket_;
   Timer op_timer_;
   // Whether to block when pushing frames if any output streams are full.
   std::atomic<bool> block_on_push_;
+  // What the input queues do when they are full.
+  OverflowPolicy overflow_policy_;
+  // The maximum bytes of frame data in each input queue. 0 means no limit.
+  size_t max_queue_bytes_;
+  // Parameter changes waiting for the processing thread.
+  std::mutex parameters_mtx_;
+  std::deque<std::shared_ptr<ParameterChange>> pending_parameters_;
+  std::atomic<bool> has_pending_parameters_;
+  // Whether a processing thread may be running, so that parameter changes
+  // must be left to it. Guarded by "parameters_mtx_".
+  bool processing_;
+  // Where the processing threads run.
+  ThreadPlacement thread_placement_;
+  // The labels of the exported metrics. Empty if none are exported.
+  MetricLabels metric_labels_;
+  // Whether to account for the CPU usage of Process().
+  std::atomic<bool> cpu_accounting_;
+  CpuAccountingCounters cpu_counters_;
+  // The maximum number of frames to pop and process at once.
+  std::atomic<size_t> max_batch_size_;
+  // How long a partial batch waits for more frames.
+  std::atomic<unsigned int> max_batch_delay_ms_;
+  // Moving averages of the time between frames popped by ProcessNextBatch()
+  // and of the time taken to process a batch, which determine the target
+  // batch size.
+  std::atomic<double> batch_arrival_interval_micros_;
+  std::atomic<double> batch_latency_micros_;
+  boost::posix_time::ptime last_batch_micros_;
   boost::posix_time::ptime processing_start_micros_;
+  // The allocations made by Process(), on whichever thread it runs.
+  MatAllocationCounters mat_allocation_counters_;
+  bool fields_declared_;
+  std::unordered_set<std::string> read_fields_;
+  std::unordered_set<std::string> written_fields_;
+  // The fields that are kept in frames pushed to each sink. Sinks that are not
+  // listed keep all fields.
+  std::unordered_map<std::string, std::unordered_set<FieldId>> live_fields_;
+  // The number of threads that call Process().
+  size_t num_replicas_;
+  // The replica that runs on the calling thread, if any.
+  static thread_local Replica* current_replica_;
+  std::vector<std::unique_ptr<Replica>> replicas_;
+  // Frames waiting for a replica.
+  std::mutex tasks_mtx_;
+  std::condition_variable tasks_cv_;
+  std::deque<ReplicaTask> tasks_;
+  bool tasks_closed_;
+  // The outputs of frames that were processed before all of the frames ahead
+  // of them, by sequence number.
+  std::mutex reorder_mtx_;
+  std::map<unsigned long,
+           std::vector<std::pair<std::string, std::unique_ptr<Frame>>>>
+      completed_frames_;
+  // The sequence number of the next frame whose outputs may be pushed.
+  unsigned long next_sequence_;
+  // The number of frames that were handed to replicas but not yet pushed.
+  std::atomic<unsigned long> num_frames_in_flight_;
+  // The pool that runs this operator instead of "process_thread_", if any.
+  std::shared_ptr<Executor> executor_;
+  // Whether this operator was added to "executor_" when it was started.
+  bool on_executor_;
+  // Whether Init() was called since the operator was last started.
+  bool initialized_;
+  // The operators that are fused to each sink, if any.
+  std::unordered_map<std::string, Operator*> fused_sinks_;
+  // Whether another operator calls ProcessFusedFrame() instead of this
+  // operator reading its source.
+  bool fused_;
+  // Held while processing a frame from the operator that this operator is
+  // fused to, so that Stop() can wait for it to finish.
+  std::mutex fused_mtx_;
+  // Where this operator's spans are drawn in traces (see Tracer).
+  int trace_lane_;
+  // The "<name>.total_micros" field that PushFrame() stamps on every frame.
+  std::unique_ptr<FieldKey<boost::posix_time::time_duration>>
+      total_micros_field_;
 };
 
 #endif  // SAF_OPERATOR_OPERATOR_H_
@@ -27,6 +27,7 @@
 #include "operator/face_tracker.h"
 #include "operator/flow_control/flow_control_entrance.h"
 #include "operator/flow_control/flow_control_exit.h"
+#include "operator/frame_synchronizer.h"
 #include "operator/frame_writer.h"
 #include "operator/image_classifier.h"
 #include "operator/image_segmenter.h"
@@ -90,6 +91,8 @@ std::shared_ptr<Operator> OperatorFactory::Create(OperatorType type,
       return FramePublisher::Create(params);
     case OPERATOR_TYPE_FRAME_SUBSCRIBER:
       return FrameSubscriber::Create(params);
+    case OPERATOR_TYPE_FRAME_SYNCHRONIZER:
+      return FrameSynchronizer::Create(params);
     case OPERATOR_TYPE_FRAME_WRITER:
       return FrameWriter::Create(params);
     case OPERATOR_TYPE_IMAGE_CLASSIFIER:
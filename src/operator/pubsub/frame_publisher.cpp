@@ -14,9 +14,13 @@
 
 #include "operator/pubsub/frame_publisher.h"
 
-#include <boost/archive/binary_oarchive.hpp>
+#include <stdexcept>
+
 #include <zguide/examples/C++/zhelpers.hpp>
 
+#include "stream/frame_codec.h"
+#include "stream/tracer.h"
+
 constexpr auto SOURCE = "input";
 
 FramePublisher::FramePublisher(const std::string& url,
@@ -26,6 +30,11 @@ FramePublisher::FramePublisher(const std::string& url,
       zmq_publisher_{zmq_context_, ZMQ_PUB},
       zmq_publisher_addr_("tcp://" + url),
       fields_to_send_(fields_to_send) {
+  if (!fields_to_send_.empty()) {
+    // Keep traces going in the subscribers.
+    fields_to_send_.insert(Tracer::kTraceIdKey);
+    fields_to_send_.insert(Tracer::kTracePushMicrosKey);
+  }
   // Bind the publisher socket
   LOG(INFO) << "Publishing frames on " << zmq_publisher_addr_;
   try {
@@ -58,18 +67,21 @@ bool FramePublisher::OnStop() { return true; }
 
 void FramePublisher::Process() {
   auto frame = this->GetFrame(SOURCE);
+  Tracer::GetInstance().OnSend(*frame);
 
-  // serialize
-  std::stringstream frame_string;
+  // Encode only the fields that we are supposed to send, directly into the
+  // message buffer.
+  zmq::message_t message;
   try {
-    boost::archive::binary_oarchive ar(frame_string);
-    // Make a copy of the frame, keeping only the fields that we are supposed to
-    // send.
-    auto frame_to_send = std::make_unique<Frame>(frame, fields_to_send_);
-    ar << frame_to_send;
-  } catch (const boost::archive::archive_exception& e) {
-    LOG(INFO) << "Boost serialization error: " << e.what();
+    FrameCodec::Encode(*frame,
+                       [&message](size_t size) {
+                         message.rebuild(size);
+                         return static_cast<char*>(message.data());
+                       },
+                       fields_to_send_);
+  } catch (const std::invalid_argument& e) {
+    LOG(INFO) << "Frame encoding error, dropping frame: " << e.what();
+    return;
   }
-
-  s_send(zmq_publisher_, frame_string.str());
+  zmq_publisher_.send(message);
 }
@@ -17,6 +17,8 @@
 #include <boost/archive/binary_iarchive.hpp>
 #include <zguide/examples/C++/zhelpers.hpp>
 
+#include "stream/frame_codec.h"
+
 constexpr auto SINK = "output";
 
 FrameSubscriber::FrameSubscriber(const std::string url)
@@ -56,7 +58,6 @@ bool FrameSubscriber::OnStop() { return true; }
 
 void FrameSubscriber::Process() {
   std::unique_ptr<Frame> frame;
-  std::stringstream frame_string;
 
   // Initialize poll set
   zmq::pollitem_t items[] = {
@@ -64,17 +65,34 @@ void FrameSubscriber::Process() {
 
   // Check to see if there is a message waiting and receive it
   zmq::poll(items, 1, 0);
+  auto message = std::make_shared<zmq::message_t>();
   if (items[0].revents & ZMQ_POLLIN) {
-    frame_string << s_recv(zmq_subscriber_);
+    zmq_subscriber_.recv(message.get());
   } else {
     return;
   }
 
-  try {
-    boost::archive::binary_iarchive ar(frame_string);
-    ar >> frame;
-  } catch (const boost::archive::archive_exception& e) {
-    LOG(INFO) << "Boost serialization error: " << e.what();
+  const char* data = static_cast<const char*>(message->data());
+  if (FrameCodec::IsEncodedFrame(data, message->size())) {
+    // The decoded frame's images point into the message, which stays alive
+    // for as long as they do.
+    try {
+      frame = FrameCodec::Decode(data, message->size(), message);
+    } catch (const std::exception& e) {
+      // Besides std::runtime_error for malformed frames, e.g., std::bad_alloc.
+      LOG(INFO) << "Frame decoding error: " << e.what();
+      return;
+    }
+  } else {
+    // Publishers that predate FrameCodec send Boost archives.
+    std::stringstream frame_string(std::string(data, message->size()));
+    try {
+      boost::archive::binary_iarchive ar(frame_string);
+      ar >> frame;
+    } catch (const boost::archive::archive_exception& e) {
+      LOG(INFO) << "Boost serialization error: " << e.what();
+      return;
+    }
   }
 
   PushFrame(SINK, std::move(frame));
@@ -139,13 +139,8 @@ void Receiver::Process() {
         frame->SetValue(Camera::kCaptureTimeMicrosKey,
                         boost::posix_time::microsec_clock::local_time());
 
-        const cv::Mat& pixels = image;
-        frame->SetValue(
-            "original_bytes",
-            std::vector<char>(
-                (char*)pixels.data,
-                (char*)pixels.data + pixels.total() * pixels.elemSize()));
-        frame->SetValue("original_image", pixels);
+        // "original_bytes" is served from this image by Frame::GetBytes().
+        frame->SetValue("original_image", image);
 
         if (ids.size() > 0) {
           frame->SetValue("ids", ids);
@@ -16,6 +16,8 @@
 
 #include <boost/archive/binary_iarchive.hpp>
 
+#include "stream/frame_codec.h"
+
 constexpr auto SINK = "output";
 
 FrameReceiver::FrameReceiver(const std::string listen_url)
@@ -42,22 +44,36 @@ StreamPtr FrameReceiver::GetSink() { return Operator::GetSink(SINK); }
 grpc::Status FrameReceiver::SendFrame(grpc::ServerContext*,
                                       const SingleFrame* frame_message,
                                       google::protobuf::Empty*) {
-  std::stringstream frame_string;
-  frame_string << frame_message->frame();
-
+  const std::string& frame_string = frame_message->frame();
   std::unique_ptr<Frame> frame;
 
-  // If Boost's serialization fails, it throws an exception.  If we don't
-  // catch the exception, gRPC triggers a core dump with a "double free or
-  // corruption" error. See https://github.com/grpc/grpc/issues/3071
-  try {
-    boost::archive::binary_iarchive ar(frame_string);
-    ar >> frame;
-  } catch (const boost::archive::archive_exception& e) {
-    std::ostringstream error_message;
-    error_message << "Boost serialization error: " << e.what();
-    LOG(INFO) << error_message.str();
-    return grpc::Status(grpc::StatusCode::ABORTED, error_message.str());
+  // If decoding fails, it throws an exception.  If we don't catch the
+  // exception, gRPC triggers a core dump with a "double free or corruption"
+  // error. See https://github.com/grpc/grpc/issues/3071
+  if (FrameCodec::IsEncodedFrame(frame_string.data(), frame_string.size())) {
+    // gRPC owns the message buffer, so the frame's images must be copied out
+    // of it.
+    try {
+      frame = FrameCodec::Decode(frame_string.data(), frame_string.size());
+    } catch (const std::exception& e) {
+      // Besides std::runtime_error for malformed frames, e.g., std::bad_alloc.
+      std::ostringstream error_message;
+      error_message << "Frame decoding error: " << e.what();
+      LOG(INFO) << error_message.str();
+      return grpc::Status(grpc::StatusCode::ABORTED, error_message.str());
+    }
+  } else {
+    // Senders that predate FrameCodec send Boost archives.
+    std::stringstream archive_string(frame_string);
+    try {
+      boost::archive::binary_iarchive ar(archive_string);
+      ar >> frame;
+    } catch (const boost::archive::archive_exception& e) {
+      std::ostringstream error_message;
+      error_message << "Boost serialization error: " << e.what();
+      LOG(INFO) << error_message.str();
+      return grpc::Status(grpc::StatusCode::ABORTED, error_message.str());
+    }
   }
 
   PushFrame(SINK, std::move(frame));
@@ -14,7 +14,10 @@
 
 #include "frame_sender.h"
 
-#include <boost/archive/binary_oarchive.hpp>
+#include <stdexcept>
+
+#include "stream/frame_codec.h"
+#include "stream/tracer.h"
 
 constexpr auto SOURCE = "input";
 
@@ -35,25 +38,29 @@ std::shared_ptr<FrameSender> FrameSender::Create(
   return std::make_shared<FrameSender>(params.at("server_url"));
 }
 
+bool FrameSender::IsBlocking() const { return true; }
+
 bool FrameSender::Init() { return true; }
 
 bool FrameSender::OnStop() { return true; }
 
 void FrameSender::Process() {
   auto frame = this->GetFrame(SOURCE);
+  Tracer::GetInstance().OnSend(*frame);
 
-  // serialize
-  std::stringstream frame_string;
+  // Encode directly into the message's buffer.
+  SingleFrame frame_message;
+  std::string* frame_string = frame_message.mutable_frame();
   try {
-    boost::archive::binary_oarchive ar(frame_string);
-    ar << frame;
-  } catch (const boost::archive::archive_exception& e) {
-    LOG(INFO) << "Boost serialization error: " << e.what();
+    FrameCodec::Encode(*frame, [frame_string](size_t size) {
+      frame_string->resize(size);
+      return &(*frame_string)[0];
+    });
+  } catch (const std::invalid_argument& e) {
+    LOG(INFO) << "Frame encoding error, dropping frame: " << e.what();
+    return;
   }
 
-  SingleFrame frame_message;
-  frame_message.set_frame(frame_string.str());
-
   grpc::ClientContext context;
   google::protobuf::Empty ignored;
   grpc::Status status = stub_->SendFrame(&context, frame_message, &ignored);
@@ -30,6 +30,8 @@ class FrameSender : public Operator {
 
   static std::shared_ptr<FrameSender> Create(const FactoryParamsType& params);
 
+  virtual bool IsBlocking() const override;
+
  protected:
   bool Init() override;
   bool OnStop() override;
@@ -60,6 +60,8 @@ void GstRtspSender::SetSource(StreamPtr stream) {
 
 StreamPtr GstRtspSender::GetSink() { return Operator::GetSink(SINK_NAME); }
 
+bool GstRtspSender::IsBlocking() const { return true; }
+
 bool GstRtspSender::Init() { return true; }
 
 bool GstRtspSender::OnStop() {
@@ -36,6 +36,8 @@ class GstRtspSender : public Operator {
 
   static std::shared_ptr<GstRtspSender> Create(const FactoryParamsType& params);
 
+  virtual bool IsBlocking() const override;
+
   // Set the Gstreamer encoder element direclty. The caller should make sure
   // that the encoder element can work on the current hardware.
   void SetEncoderElement(const std::string& encoder);
@@ -52,6 +52,8 @@ std::shared_ptr<Sender> Sender::Create(const FactoryParamsType& params) {
   return std::make_shared<Sender>(endpoint, package_type, batch_size);
 }
 
+bool Sender::IsBlocking() const { return true; }
+
 bool Sender::Init() {
   bool result = false;
   if (!endpoint_.empty()) {
@@ -97,8 +99,8 @@ void Sender::Process() {
 }
 
 void Sender::Send(std::unique_ptr<Frame> frame) {
-  auto camera_name = frame->GetValue<std::string>("camera_name");
-  auto image = frame->GetValue<cv::Mat>("original_image");
+  const auto& camera_name = frame->GetRef<std::string>("camera_name");
+  const auto& image = frame->GetRef<cv::Mat>("original_image");
   // Convert micros to millis
   auto timestamp =
       GetTimeSinceEpochMicros(frame->GetValue<boost::posix_time::ptime>(
@@ -108,8 +110,8 @@ void Sender::Send(std::unique_ptr<Frame> frame) {
 
   std::stringstream ss;
   if (package_type_ == "thumbnails") {
-    auto tags = frame->GetValue<std::vector<std::string>>("tags");
-    auto bboxes = frame->GetValue<std::vector<Rect>>("bounding_boxes");
+    const auto& tags = frame->GetRef<std::vector<std::string>>("tags");
+    const auto& bboxes = frame->GetRef<std::vector<Rect>>("bounding_boxes");
     DetectionProto info;
     info.set_capture_time_micros(std::to_string(timestamp));
     info.set_stream_id(camera_name);
@@ -126,13 +128,13 @@ void Sender::Send(std::unique_ptr<Frame> frame) {
       th->set_thumbnail(image_bin_str);
       th->set_label(tags[i]);
       if (frame->Count("ids") > 0) {
-        auto ids = frame->GetValue<std::vector<std::string>>("ids");
+        const auto& ids = frame->GetRef<std::vector<std::string>>("ids");
         CHECK(ids.size() == bboxes.size());
         th->set_id(ids[i]);
       }
       if (frame->Count("features") > 0) {
-        auto features =
-            frame->GetValue<std::vector<std::vector<double>>>("features");
+        const auto& features =
+            frame->GetRef<std::vector<std::vector<double>>>("features");
         CHECK(features.size() == bboxes.size());
         auto feature = th->mutable_feature();
         for (const auto& m : features[i]) feature->add_feature(m);
@@ -162,8 +164,8 @@ void Sender::Send(std::unique_ptr<Frame> frame) {
 #endif
 
     if (frame->Count("bounding_boxes") > 0) {
-      auto tags = frame->GetValue<std::vector<std::string>>("tags");
-      auto bboxes = frame->GetValue<std::vector<Rect>>("bounding_boxes");
+      const auto& tags = frame->GetRef<std::vector<std::string>>("tags");
+      const auto& bboxes = frame->GetRef<std::vector<Rect>>("bounding_boxes");
       for (decltype(bboxes.size()) i = 0; i < bboxes.size(); ++i) {
         auto ri = info.add_rect_infos();
         auto bb = ri->mutable_bbox();
@@ -173,13 +175,13 @@ void Sender::Send(std::unique_ptr<Frame> frame) {
         bb->set_h(bboxes[i].height);
         ri->set_label(tags[i]);
         if (frame->Count("ids") > 0) {
-          auto ids = frame->GetValue<std::vector<std::string>>("ids");
+          const auto& ids = frame->GetRef<std::vector<std::string>>("ids");
           CHECK(ids.size() == bboxes.size());
           ri->set_id(ids[i]);
         }
         if (frame->Count("features") > 0) {
-          auto features =
-              frame->GetValue<std::vector<std::vector<double>>>("features");
+          const auto& features =
+              frame->GetRef<std::vector<std::vector<double>>>("features");
           CHECK(features.size() == bboxes.size());
           auto feature = ri->mutable_feature();
           for (const auto& m : features[i]) feature->add_feature(m);
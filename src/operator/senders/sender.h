@@ -33,6 +33,8 @@ class Sender : public Operator {
   Sender(const std::string& endpoint, const std::string& package_type,
          size_t batch_size);
   static std::shared_ptr<Sender> Create(const FactoryParamsType& params);
+
+  virtual bool IsBlocking() const override;
   static std::string GetSourceName(int index) {
     return "input" + std::to_string(index);
   }
@@ -22,7 +22,9 @@ constexpr auto SINK_NAME = "output";
 Strider::Strider(unsigned long stride)
     : Operator(OPERATOR_TYPE_STRIDER, {SOURCE_NAME}, {SINK_NAME}),
       stride_(stride),
-      num_frames_processed_(0) {}
+      num_frames_processed_(0) {
+  DeclareFields({});
+}
 
 std::shared_ptr<Strider> Strider::Create(const FactoryParamsType& params) {
   unsigned long stride = std::stoul(params.at("stride"));
@@ -39,26 +41,65 @@ bool Strider::Init() { return true; }
 
 bool Strider::OnStop() { return true; }
 
+bool Strider::OnSetParameter(const std::string& name,
+                             const std::string& value) {
+  if (name != "stride") {
+    return Operator::OnSetParameter(name, value);
+  }
+  unsigned long stride;
+  try {
+    stride = std::stoul(value);
+  } catch (const std::exception&) {
+    return false;
+  }
+  if (stride == 0) {
+    return false;
+  }
+  // Start counting afresh, so that the next frame is passed.
+  stride_ = stride;
+  num_frames_processed_ = 0;
+  return true;
+}
+
 void Strider::Process() {
   auto frame = GetFrame(SOURCE_NAME);
 
   if (num_frames_processed_ % stride_) {
     // Drop frames whose arrival index is not evenly divisible by the stride.
-    LOG(WARNING) << "Striding by " << stride_ << " frames. Dropping frame: "
-                 << frame->GetValue<unsigned long>("frame_id");
-    auto flow_control_entrance = frame->GetFlowControlEntrance();
-    if (flow_control_entrance) {
-      // If a flow control entrance exists, then we need to inform it that a
-      // frame is being dropped so that the flow control token is returned.
-      flow_control_entrance->ReturnToken(
-          frame->GetValue<unsigned long>("frame_id"));
-      // Change the frame's FlowControlEntrance to null so that it does not try
-      // to release the token again.
-      frame->SetFlowControlEntrance(nullptr);
-    }
+    DropFrame(std::move(frame));
   } else {
     PushFrame(SINK_NAME, std::move(frame));
   }
 
   ++num_frames_processed_;
 }
+
+void Strider::ProcessBatch() {
+  FrameBatch passed;
+  for (auto& frame : GetFrames(SOURCE_NAME)) {
+    if (num_frames_processed_ % stride_) {
+      DropFrame(std::move(frame));
+    } else {
+      passed.push_back(std::move(frame));
+    }
+    ++num_frames_processed_;
+  }
+  if (!passed.empty()) {
+    PushFrames(SINK_NAME, std::move(passed));
+  }
+}
+
+void Strider::DropFrame(std::unique_ptr<Frame> frame) {
+  LOG(WARNING) << "Striding by " << stride_ << " frames. Dropping frame: "
+               << frame->GetValue<unsigned long>("frame_id");
+  auto flow_control_entrance = frame->GetFlowControlEntrance();
+  if (flow_control_entrance) {
+    // If a flow control entrance exists, then we need to inform it that a
+    // frame is being dropped so that the flow control token is returned.
+    flow_control_entrance->ReturnToken(
+        frame->GetValue<unsigned long>("frame_id"));
+    // Change the frame's FlowControlEntrance to null so that it does not try
+    // to release the token again.
+    frame->SetFlowControlEntrance(nullptr);
+  }
+}
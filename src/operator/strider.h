@@ -37,8 +37,15 @@ class Strider : public Operator {
   virtual bool Init() override;
   virtual bool OnStop() override;
   virtual void Process() override;
+  virtual void ProcessBatch() override;
+  // Accepts "stride".
+  virtual bool OnSetParameter(const std::string& name,
+                              const std::string& value) override;
 
  private:
+  // Drops a frame that is not on the stride.
+  void DropFrame(std::unique_ptr<Frame> frame);
+
   unsigned long stride_;
   unsigned long num_frames_processed_;
 };
@@ -24,6 +24,7 @@ Throttler::Throttler(double fps)
     : Operator(OPERATOR_TYPE_THROTTLER, {SOURCE_NAME}, {SINK_NAME}),
       delay_ms_(0) {
   SetFps(fps);
+  DeclareFields({});
 }
 
 std::shared_ptr<Throttler> Throttler::Create(const FactoryParamsType& params) {
@@ -50,30 +51,66 @@ void Throttler::SetFps(double fps) {
 
 bool Throttler::Init() { return true; }
 
+bool Throttler::OnSetParameter(const std::string& name,
+                               const std::string& value) {
+  if (name != "fps") {
+    return Operator::OnSetParameter(name, value);
+  }
+  try {
+    SetFps(std::stod(value));
+  } catch (const std::exception&) {
+    return false;
+  }
+  return true;
+}
+
 bool Throttler::OnStop() { return true; }
 
 void Throttler::Process() {
   std::unique_ptr<Frame> frame = GetFrame(SOURCE_NAME);
 
-  if (timer_.ElapsedMSec() < delay_ms_) {
-    // Drop frame.
-    LOG(INFO) << "Frame rate too high. Dropping frame: "
-              << frame->GetValue<unsigned long>("frame_id");
-
-    FlowControlEntrance* flow_control_entrance =
-        frame->GetFlowControlEntrance();
-    if (flow_control_entrance) {
-      // If a flow control entrance exists, then we need to inform it that a
-      // frame is being dropped so that the flow control token is returned.
-      flow_control_entrance->ReturnToken(
-          frame->GetValue<unsigned long>("frame_id"));
-      // Change the frame's FlowControlEntrance to null so that it does not try
-      // to release the token again.
-      frame->SetFlowControlEntrance(nullptr);
-    }
-  } else {
-    // Restart timer
-    timer_.Start();
+  if (ShouldPass()) {
     PushFrame(SINK_NAME, std::move(frame));
+  } else {
+    DropFrame(std::move(frame));
+  }
+}
+
+void Throttler::ProcessBatch() {
+  FrameBatch passed;
+  for (auto& frame : GetFrames(SOURCE_NAME)) {
+    if (ShouldPass()) {
+      passed.push_back(std::move(frame));
+    } else {
+      DropFrame(std::move(frame));
+    }
+  }
+  if (!passed.empty()) {
+    PushFrames(SINK_NAME, std::move(passed));
+  }
+}
+
+bool Throttler::ShouldPass() {
+  if (timer_.ElapsedMSec() < delay_ms_) {
+    return false;
+  }
+  // Restart timer
+  timer_.Start();
+  return true;
+}
+
+void Throttler::DropFrame(std::unique_ptr<Frame> frame) {
+  LOG(INFO) << "Frame rate too high. Dropping frame: "
+            << frame->GetValue<unsigned long>("frame_id");
+
+  FlowControlEntrance* flow_control_entrance = frame->GetFlowControlEntrance();
+  if (flow_control_entrance) {
+    // If a flow control entrance exists, then we need to inform it that a
+    // frame is being dropped so that the flow control token is returned.
+    flow_control_entrance->ReturnToken(
+        frame->GetValue<unsigned long>("frame_id"));
+    // Change the frame's FlowControlEntrance to null so that it does not try
+    // to release the token again.
+    frame->SetFlowControlEntrance(nullptr);
   }
 }
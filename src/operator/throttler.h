@@ -39,8 +39,18 @@ class Throttler : public Operator {
   virtual bool Init() override;
   virtual bool OnStop() override;
   virtual void Process() override;
+  virtual void ProcessBatch() override;
+  // Accepts "fps".
+  virtual bool OnSetParameter(const std::string& name,
+                              const std::string& value) override;
 
  private:
+  // Whether enough time has passed since the last frame to let a frame
+  // through. Restarts the timer if so.
+  bool ShouldPass();
+  // Drops a frame that exceeds the frame rate.
+  void DropFrame(std::unique_ptr<Frame> frame);
+
   double delay_ms_;
   Timer timer_;
 };
@@ -0,0 +1,189 @@
+// Copyright 2018 The SAF Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "pipeline/control_server.h"
+
+#include <cstring>
+#include <vector>
+
+#include <glog/logging.h>
+
+#include "pipeline/pipeline.h"
+
+// How often the serving thread checks whether it should stop.
+constexpr long kPollTimeoutMs = 100;
+
+static nlohmann::json ToJson(const LatencySummary& summary) {
+  nlohmann::json json;
+  json["count"] = summary.count;
+  json["mean_ms"] = summary.mean_ms;
+  json["p50_ms"] = summary.p50_ms;
+  json["p90_ms"] = summary.p90_ms;
+  json["p99_ms"] = summary.p99_ms;
+  json["p999_ms"] = summary.p999_ms;
+  json["max_ms"] = summary.max_ms;
+  return json;
+}
+
+static nlohmann::json ErrorReply(const std::string& error) {
+  nlohmann::json reply;
+  reply["ok"] = false;
+  reply["error"] = error;
+  return reply;
+}
+
+ControlServer::ControlServer(Pipeline& pipeline, const std::string& endpoint)
+    : pipeline_(pipeline),
+      endpoint_(endpoint),
+      context_{1},
+      socket_{context_, ZMQ_REP},
+      stopped_(true) {
+  int linger = 0;
+  socket_.setsockopt(ZMQ_LINGER, &linger, sizeof(linger));
+}
+
+ControlServer::~ControlServer() { Stop(); }
+
+bool ControlServer::Start() {
+  if (!stopped_) {
+    return true;
+  }
+  try {
+    socket_.bind(endpoint_);
+  } catch (const zmq::error_t& e) {
+    LOG(ERROR) << "Control server unable to bind to " << endpoint_ << ": "
+               << e.what();
+    return false;
+  }
+  stopped_ = false;
+  thread_ = std::thread(&ControlServer::ServeLoop, this);
+  LOG(INFO) << "Serving control requests on " << endpoint_;
+  return true;
+}
+
+void ControlServer::Stop() {
+  if (stopped_) {
+    return;
+  }
+  stopped_ = true;
+  thread_.join();
+  socket_.unbind(endpoint_);
+}
+
+void ControlServer::ServeLoop() {
+  while (!stopped_) {
+    zmq::pollitem_t items[] = {{static_cast<void*>(socket_), 0, ZMQ_POLLIN, 0}};
+    zmq::poll(items, 1, kPollTimeoutMs);
+    if (!(items[0].revents & ZMQ_POLLIN)) {
+      continue;
+    }
+
+    zmq::message_t request_message;
+    socket_.recv(&request_message);
+    std::string request_str(static_cast<char*>(request_message.data()),
+                            request_message.size());
+    nlohmann::json reply;
+    try {
+      reply = HandleRequest(nlohmann::json::parse(request_str));
+    } catch (const std::exception& e) {
+      reply = ErrorReply(std::string("Invalid request: ") + e.what());
+    }
+
+    std::string reply_str = reply.dump();
+    zmq::message_t reply_message(reply_str.size());
+    memcpy(reply_message.data(), reply_str.data(), reply_str.size());
+    socket_.send(reply_message);
+  }
+}
+
+nlohmann::json ControlServer::HandleRequest(const nlohmann::json& request) {
+  if (!request.is_object() || request.find("command") == request.end()) {
+    return ErrorReply("Missing \"command\"");
+  }
+  std::string command = request["command"];
+  auto ops = pipeline_.GetOperators();
+  std::string op_name;
+  if (request.find("operator") != request.end()) {
+    op_name = request["operator"].get<std::string>();
+    if (ops.find(op_name) == ops.end()) {
+      return ErrorReply("Unknown operator \"" + op_name + "\"");
+    }
+  }
+
+  nlohmann::json reply;
+  reply["ok"] = true;
+  if (command == "list") {
+    std::vector<std::string> names;
+    for (const auto& op : ops) {
+      names.push_back(op.first);
+    }
+    reply["operators"] = names;
+  } else if (command == "set") {
+    if (op_name.empty() || request.find("parameter") == request.end() ||
+        request.find("value") == request.end()) {
+      return ErrorReply(
+          "\"set\" requires \"operator\", \"parameter\", and \"value\"");
+    }
+    std::string parameter = request["parameter"];
+    // Accept numbers as well as strings.
+    const auto& value_json = request["value"];
+    std::string value = value_json.is_string() ? value_json.get<std::string>()
+                                               : value_json.dump();
+    if (!ops.at(op_name)->SetParameter(parameter, value)) {
+      return ErrorReply("Unable to set \"" + parameter + "\" of operator \"" +
+                        op_name + "\" to \"" + value + "\"");
+    }
+  } else if (command == "stats") {
+    nlohmann::json stats;
+    if (op_name.empty()) {
+      for (const auto& op : ops) {
+        stats[op.first] = GetOperatorStats(op.first);
+      }
+    } else {
+      stats[op_name] = GetOperatorStats(op_name);
+    }
+    reply["stats"] = stats;
+  } else {
+    return ErrorReply("Unknown command \"" + command + "\"");
+  }
+  return reply;
+}
+
+nlohmann::json ControlServer::GetOperatorStats(const std::string& name) {
+  auto op = pipeline_.GetOperator(name);
+  nlohmann::json stats;
+  stats["type"] = GetStringForOperatorType(op->GetType());
+  stats["started"] = op->IsStarted();
+  stats["fps"] = op->GetHistoricalProcessFps();
+  stats["avg_processing_latency_ms"] = op->GetAvgProcessingLatencyMs();
+  stats["processing_latency"] = ToJson(op->GetProcessingLatencySummary());
+  stats["queue_latency"] = ToJson(op->GetQueueLatencySummary());
+  stats["end_to_end_latency"] = ToJson(op->GetEndToEndLatencySummary());
+  stats["target_batch_size"] = op->GetTargetBatchSize();
+  stats["replicas"] = op->GetReplicas();
+  stats["fused"] = op->IsFused();
+  if (op->IsCpuAccounting()) {
+    CpuStats cpu = op->GetCpuStats();
+    nlohmann::json cpu_stats;
+    cpu_stats["cpu_ms"] = cpu.cpu_micros / 1000.0;
+    cpu_stats["cycles"] = cpu.cycles;
+    cpu_stats["instructions"] = cpu.instructions;
+    cpu_stats["llc_misses"] = cpu.llc_misses;
+    cpu_stats["branch_misses"] = cpu.branch_misses;
+    cpu_stats["ipc"] = cpu.GetInstructionsPerCycle();
+    cpu_stats["llc_mpki"] = cpu.GetLlcMissesPerKiloInstruction();
+    stats["cpu"] = cpu_stats;
+  }
+  return stats;
+}
@@ -0,0 +1,69 @@
+// Copyright 2018 The SAF Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SAF_PIPELINE_CONTROL_SERVER_H_
+#define SAF_PIPELINE_CONTROL_SERVER_H_
+
+#include <atomic>
+#include <string>
+#include <thread>
+
+#include <json/src/json.hpp>
+#include <zmq.hpp>
+
+class Pipeline;
+
+// Lets a running Pipeline be inspected and tuned without restarting it, which
+// would lose the state of trackers and matchers. Requests arrive on a ZMQ REP
+// socket, and requests and replies are JSON objects:
+//
+//   {"command": "list"}
+//     -> {"ok": true, "operators": ["camera", "throttler", ...]}
+//   {"command": "set", "operator": "throttler", "parameter": "fps",
+//    "value": "5"}
+//     -> {"ok": true}
+//   {"command": "stats"} or {"command": "stats", "operator": "throttler"}
+//     -> {"ok": true, "stats": {"throttler": {"fps": 5.0, ...}}}
+//
+// Failed requests get {"ok": false, "error": "<reason>"}. See
+// Operator::SetParameter() for the parameters that can be set.
+class ControlServer {
+ public:
+  // Serves requests for "pipeline", which must outlive the server, on
+  // "endpoint", e.g., "tcp://*:5555".
+  ControlServer(Pipeline& pipeline, const std::string& endpoint);
+  ~ControlServer();
+  ControlServer(const ControlServer&) = delete;
+  ControlServer& operator=(const ControlServer&) = delete;
+
+  // Returns false if "endpoint" could not be bound.
+  bool Start();
+  void Stop();
+
+  // Handles one request and returns the reply.
+  nlohmann::json HandleRequest(const nlohmann::json& request);
+
+ private:
+  void ServeLoop();
+  nlohmann::json GetOperatorStats(const std::string& name);
+
+  Pipeline& pipeline_;
+  const std::string endpoint_;
+  zmq::context_t context_;
+  zmq::socket_t socket_;
+  std::thread thread_;
+  std::atomic<bool> stopped_;
+};
+
+#endif  // SAF_PIPELINE_CONTROL_SERVER_H_
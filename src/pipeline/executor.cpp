@@ -0,0 +1,218 @@
+// Copyright 2018 The SAF Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "pipeline/executor.h"
+
+#include <algorithm>
+#include <chrono>
+
+#include <glog/logging.h>
+
+#include "operator/operator.h"
+
+// How many times a task may run its Operator in a row before going to the back
+// of the queue, so that a busy Operator cannot starve the others.
+static const size_t MAX_RUNS_PER_TURN = 8;
+
+// The Executor and queue of the calling thread, if it is a pool thread.
+static thread_local const Executor* current_executor = nullptr;
+static thread_local size_t current_worker = 0;
+
+struct Executor::Task : public StreamWaitSet::Listener {
+  enum State { IDLE, QUEUED, RUNNING, RUNNING_DIRTY };
+
+  Task(Executor* executor, Operator* op)
+      : executor(executor), op(op), state(IDLE), removed(false), done(false) {}
+
+  virtual void OnNotify() override { executor->Schedule(this); }
+
+  Executor* const executor;
+  Operator* const op;
+  // RUNNING_DIRTY means that the Operator was notified while it was running,
+  // so it must be queued again even if its sources looked empty.
+  std::atomic<int> state;
+  // Set by Remove(). The task is never queued again.
+  std::atomic<bool> removed;
+  // Set once the Operator has stopped or forwarded the stop frame.
+  std::atomic<bool> done;
+};
+
+Executor::Executor(size_t num_threads)
+    : stopped_(false), num_queued_(0), next_queue_(0) {
+  if (num_threads == 0) {
+    num_threads = std::max(1U, std::thread::hardware_concurrency());
+  }
+  for (size_t i = 0; i < num_threads; ++i) {
+    queues_.push_back(std::make_unique<RunQueue>());
+  }
+  for (size_t i = 0; i < num_threads; ++i) {
+    threads_.emplace_back(&Executor::WorkerLoop, this, i);
+  }
+  LOG(INFO) << "Started executor with " << num_threads << " threads";
+}
+
+Executor::~Executor() {
+  stopped_ = true;
+  work_event_.NotifyAll();
+  for (auto& thread : threads_) {
+    thread.join();
+  }
+}
+
+size_t Executor::GetNumThreads() const { return threads_.size(); }
+
+void Executor::Add(Operator* op) {
+  Task* task;
+  {
+    std::lock_guard<std::mutex> guard(tasks_mtx_);
+    tasks_.push_back(std::make_unique<Task>(this, op));
+    task = tasks_.back().get();
+  }
+  op->source_wait_set_.SetListener(task);
+  // Frames may have arrived before the listener was attached.
+  Schedule(task);
+}
+
+void Executor::Remove(Operator* op) {
+  Task* task = nullptr;
+  {
+    std::lock_guard<std::mutex> guard(tasks_mtx_);
+    for (const auto& t : tasks_) {
+      if (t->op == op && !t->removed) {
+        task = t.get();
+        break;
+      }
+    }
+  }
+  CHECK(task != nullptr) << "Operator " << op->GetName()
+                         << " is not running on this executor";
+  op->source_wait_set_.SetListener(nullptr);
+  task->removed = true;
+  // A queued task goes back to IDLE as soon as a thread picks it up, and a
+  // running one once the current call to RunOnce() returns, which is prompt
+  // because the Operator's readers and sinks have already been stopped.
+  while (task->state != Task::IDLE) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+}
+
+void Executor::Schedule(Task* task) {
+  while (!task->removed && !task->done) {
+    int state = task->state;
+    if (state == Task::IDLE) {
+      if (task->state.compare_exchange_weak(state, Task::QUEUED)) {
+        Enqueue(task);
+        return;
+      }
+    } else if (state == Task::RUNNING) {
+      if (task->state.compare_exchange_weak(state, Task::RUNNING_DIRTY)) {
+        return;
+      }
+    } else {
+      // Already queued, or already due to be queued again.
+      return;
+    }
+  }
+}
+
+void Executor::Enqueue(Task* task) {
+  size_t idx;
+  if (current_executor == this) {
+    // Keep the task on the thread that produced its input.
+    idx = current_worker;
+  } else {
+    idx = next_queue_++ % queues_.size();
+  }
+  ++num_queued_;
+  {
+    std::lock_guard<std::mutex> guard(queues_.at(idx)->mtx);
+    queues_.at(idx)->tasks.push_back(task);
+  }
+  work_event_.NotifyOne();
+}
+
+Executor::Task* Executor::Dequeue(size_t idx) {
+  {
+    RunQueue& queue = *queues_.at(idx);
+    std::lock_guard<std::mutex> guard(queue.mtx);
+    if (!queue.tasks.empty()) {
+      Task* task = queue.tasks.front();
+      queue.tasks.pop_front();
+      return task;
+    }
+  }
+  // Steal the task that its owner would run last.
+  for (size_t i = 1; i < queues_.size(); ++i) {
+    RunQueue& queue = *queues_.at((idx + i) % queues_.size());
+    std::lock_guard<std::mutex> guard(queue.mtx);
+    if (!queue.tasks.empty()) {
+      Task* task = queue.tasks.back();
+      queue.tasks.pop_back();
+      return task;
+    }
+  }
+  return nullptr;
+}
+
+void Executor::Run(Task* task) {
+  task->state = Task::RUNNING;
+  Operator* op = task->op;
+  bool more = false;
+  if (!task->removed && !task->done) {
+    for (size_t i = 0; i < MAX_RUNS_PER_TURN; ++i) {
+      if (!op->RunOnce()) {
+        task->done = true;
+        break;
+      }
+      more = op->HasReadyInput();
+      if (!more) {
+        break;
+      }
+    }
+  }
+
+  if (task->removed || task->done) {
+    task->state = Task::IDLE;
+    return;
+  }
+  if (!more) {
+    int state = Task::RUNNING;
+    if (task->state.compare_exchange_strong(state, Task::IDLE)) {
+      return;
+    }
+    // A frame arrived after the sources were last checked.
+  }
+  task->state = Task::QUEUED;
+  Enqueue(task);
+}
+
+void Executor::WorkerLoop(size_t idx) {
+  current_executor = this;
+  current_worker = idx;
+  while (!stopped_) {
+    Task* task = Dequeue(idx);
+    if (task != nullptr) {
+      --num_queued_;
+      Run(task);
+      continue;
+    }
+
+    auto key = work_event_.PrepareWait();
+    if (stopped_ || num_queued_ > 0) {
+      work_event_.CancelWait();
+      continue;
+    }
+    work_event_.Wait(key);
+  }
+}
@@ -0,0 +1,92 @@
+// Copyright 2018 The SAF Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SAF_PIPELINE_EXECUTOR_H_
+#define SAF_PIPELINE_EXECUTOR_H_
+
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "stream/event_count.h"
+
+class Operator;
+
+// An Executor runs many Operators on a fixed pool of threads, instead of
+// giving each Operator a thread of its own that polls its sources. An Operator
+// is queued whenever one of its sources receives a frame, and a pool thread
+// then runs it until its sources are drained.
+//
+// Each thread has its own run queue. An Operator that is woken up by a frame
+// pushed from a pool thread is queued on that thread, so that it usually runs
+// on the same core as its upstream Operator while the frame is still in the
+// cache. Idle threads steal work from the other queues, and park when there is
+// none instead of waking up on a timer.
+//
+// Only Operators that never block for long may share the pool (see
+// Operator::IsBlocking()). The others keep a dedicated thread.
+class Executor {
+ public:
+  // Starts "num_threads" threads, or one per core if it is 0.
+  explicit Executor(size_t num_threads = 0);
+  ~Executor();
+  Executor(const Executor&) = delete;
+  Executor& operator=(const Executor&) = delete;
+
+  size_t GetNumThreads() const;
+
+ private:
+  friend class Operator;
+
+  struct Task;
+  struct RunQueue {
+    std::mutex mtx;
+    std::deque<Task*> tasks;
+  };
+
+  // Starts running "op" whenever its sources have frames. Called by
+  // Operator::Start().
+  void Add(Operator* op);
+  // Returns once "op" is not running and will never be run again. Called by
+  // Operator::Stop().
+  void Remove(Operator* op);
+
+  // Queues "task" unless it is already queued or running. If it is running, it
+  // will be queued again when it finishes.
+  void Schedule(Task* task);
+  void Enqueue(Task* task);
+  // Takes a task from the queue of thread "idx", or else steals one from
+  // another thread. Returns nullptr if all queues are empty.
+  Task* Dequeue(size_t idx);
+  void Run(Task* task);
+  void WorkerLoop(size_t idx);
+
+  std::vector<std::unique_ptr<RunQueue>> queues_;
+  std::vector<std::thread> threads_;
+  std::atomic<bool> stopped_;
+  // The number of tasks in all queues.
+  std::atomic<size_t> num_queued_;
+  // Where tasks that are scheduled from outside the pool are queued next.
+  std::atomic<size_t> next_queue_;
+  EventCount work_event_;
+  // Tasks are only freed with the Executor, since a thread that is pushing
+  // frames may still be about to schedule a task that was just removed.
+  std::mutex tasks_mtx_;
+  std::vector<std::unique_ptr<Task>> tasks_;
+};
+
+#endif  // SAF_PIPELINE_EXECUTOR_H_
@@ -0,0 +1,177 @@
+// Copyright 2018 The SAF Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "pipeline/metrics_server.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <sstream>
+
+#include <glog/logging.h>
+
+#include "utils/metrics.h"
+
+// How often the serving thread checks whether it should stop.
+constexpr int kPollTimeoutMs = 100;
+// How long a client has to send its request.
+constexpr int kRequestTimeoutMs = 1000;
+// Requests are only a request line and a few headers.
+constexpr size_t kMaxRequestBytes = 8192;
+
+// Sends all of "data" to "fd", giving up if the client goes away.
+static void SendAll(int fd, const std::string& data) {
+  size_t sent = 0;
+  while (sent < data.size()) {
+    ssize_t n = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+    if (n <= 0) {
+      return;
+    }
+    sent += n;
+  }
+}
+
+static std::string MakeResponse(const std::string& status,
+                                const std::string& content_type,
+                                const std::string& body) {
+  std::ostringstream o;
+  o << "HTTP/1.1 " << status << "\r\n"
+    << "Content-Type: " << content_type << "\r\n"
+    << "Content-Length: " << body.size() << "\r\n"
+    << "Connection: close\r\n\r\n"
+    << body;
+  return o.str();
+}
+
+MetricsServer::MetricsServer(MetricsRegistry& registry, unsigned short port,
+                             const std::string& address)
+    : registry_(registry),
+      port_(port),
+      address_(address),
+      listen_fd_(-1),
+      stopped_(true) {}
+
+MetricsServer::~MetricsServer() { Stop(); }
+
+bool MetricsServer::Start() {
+  if (!stopped_) {
+    return true;
+  }
+
+  sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port_);
+  if (inet_pton(AF_INET, address_.c_str(), &addr.sin_addr) != 1) {
+    LOG(ERROR) << "Invalid metrics address: " << address_;
+    return false;
+  }
+
+  listen_fd_ = socket(AF_INET, SOCK_STREAM, 0);
+  if (listen_fd_ < 0) {
+    LOG(ERROR) << "Unable to create metrics socket: " << strerror(errno);
+    return false;
+  }
+  int reuse = 1;
+  setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+  if (bind(listen_fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) !=
+          0 ||
+      listen(listen_fd_, 16) != 0) {
+    LOG(ERROR) << "Unable to serve metrics on " << address_ << ":" << port_
+               << ": " << strerror(errno);
+    close(listen_fd_);
+    listen_fd_ = -1;
+    return false;
+  }
+  socklen_t addr_len = sizeof(addr);
+  getsockname(listen_fd_, reinterpret_cast<sockaddr*>(&addr), &addr_len);
+  port_ = ntohs(addr.sin_port);
+
+  stopped_ = false;
+  thread_ = std::thread(&MetricsServer::ServeLoop, this);
+  LOG(INFO) << "Serving metrics on http://" << address_ << ":" << port_
+            << "/metrics";
+  return true;
+}
+
+void MetricsServer::Stop() {
+  if (stopped_) {
+    return;
+  }
+  stopped_ = true;
+  thread_.join();
+  close(listen_fd_);
+  listen_fd_ = -1;
+}
+
+unsigned short MetricsServer::GetPort() const { return port_; }
+
+void MetricsServer::ServeLoop() {
+  while (!stopped_) {
+    pollfd listen_poll = {listen_fd_, POLLIN, 0};
+    if (poll(&listen_poll, 1, kPollTimeoutMs) <= 0) {
+      continue;
+    }
+    int fd = accept(listen_fd_, nullptr, nullptr);
+    if (fd < 0) {
+      continue;
+    }
+    HandleConnection(fd);
+    close(fd);
+  }
+}
+
+void MetricsServer::HandleConnection(int fd) {
+  // Do not let a slow client hold up the next scrape for long.
+  timeval timeout = {kRequestTimeoutMs / 1000,
+                     (kRequestTimeoutMs % 1000) * 1000};
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+  setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+  // Only the request line matters, but read up to the end of the headers so
+  // that the client does not see a reset.
+  std::string request;
+  char buf[1024];
+  while (request.find("\r\n\r\n") == std::string::npos &&
+         request.size() < kMaxRequestBytes) {
+    ssize_t n = recv(fd, buf, sizeof(buf), 0);
+    if (n <= 0) {
+      break;
+    }
+    request.append(buf, n);
+  }
+
+  std::istringstream request_line(request.substr(0, request.find("\r\n")));
+  std::string method;
+  std::string target;
+  request_line >> method >> target;
+  std::string path = target.substr(0, target.find('?'));
+
+  if (method != "GET") {
+    SendAll(fd, MakeResponse("405 Method Not Allowed", "text/plain",
+                             "Only GET is supported\n"));
+  } else if (path == "/metrics") {
+    SendAll(fd, MakeResponse("200 OK", "text/plain; version=0.0.4",
+                             registry_.Serialize()));
+  } else {
+    SendAll(fd, MakeResponse("404 Not Found", "text/plain",
+                             "Metrics are served at /metrics\n"));
+  }
+}
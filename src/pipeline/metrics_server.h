@@ -0,0 +1,57 @@
+// Copyright 2018 The SAF Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SAF_PIPELINE_METRICS_SERVER_H_
+#define SAF_PIPELINE_METRICS_SERVER_H_
+
+#include <atomic>
+#include <string>
+#include <thread>
+
+class MetricsRegistry;
+
+// Serves the metrics of a MetricsRegistry over HTTP, so that Prometheus can
+// scrape them from "http://<host>:<port>/metrics". Requests are answered one
+// at a time on a thread of the server's own, which only formats the metrics
+// when it is asked for them.
+class MetricsServer {
+ public:
+  // Serves "registry", which must outlive the server, on TCP port "port" of
+  // "address". Port 0 picks a free port (see GetPort()).
+  MetricsServer(MetricsRegistry& registry, unsigned short port,
+                const std::string& address = "0.0.0.0");
+  ~MetricsServer();
+  MetricsServer(const MetricsServer&) = delete;
+  MetricsServer& operator=(const MetricsServer&) = delete;
+
+  // Returns false if the port could not be bound.
+  bool Start();
+  void Stop();
+
+  // The port that the server listens on, once started.
+  unsigned short GetPort() const;
+
+ private:
+  void ServeLoop();
+  void HandleConnection(int fd);
+
+  MetricsRegistry& registry_;
+  unsigned short port_;
+  const std::string address_;
+  int listen_fd_;
+  std::thread thread_;
+  std::atomic<bool> stopped_;
+};
+
+#endif  // SAF_PIPELINE_METRICS_SERVER_H_
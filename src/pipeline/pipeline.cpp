@@ -22,15 +22,71 @@
 
 #include "common/types.h"
 #include "operator/operator_factory.h"
+#include "stream/frame_memory_budget.h"
+#include "utils/metrics.h"
+#include "utils/string_utils.h"
 
 constexpr auto DEFAULT_SINK_NAME = "output";
 
-Pipeline::Pipeline() {}
+// The numeric settings of an operator may be given as JSON numbers or, like
+// operator parameters, as strings.
+static size_t JsonToSizet(const nlohmann::json& value) {
+  if (value.is_string()) {
+    return StringToSizet(value.get<std::string>());
+  }
+  CHECK(value.is_number_unsigned()) << "Improperly formed size_t: " << value;
+  return value.get<size_t>();
+}
+
+static int JsonToInt(const nlohmann::json& value) {
+  if (value.is_string()) {
+    return StringToInt(value.get<std::string>());
+  }
+  CHECK(value.is_number_integer()) << "Improperly formed int: " << value;
+  return value.get<int>();
+}
+
+Pipeline::Pipeline() : name_("pipeline") {}
 
 std::shared_ptr<Pipeline> Pipeline::ConstructPipeline(nlohmann::json json) {
   nlohmann::json ops = json["operators"];
 
   auto pipeline = std::make_shared<Pipeline>();
+  if (json.find("executor_threads") != json.end()) {
+    size_t num_threads = json["executor_threads"];
+    pipeline->executor_ = std::make_shared<Executor>(num_threads);
+  }
+  if (json.find("frame_memory_budget_bytes") != json.end()) {
+    size_t budget_bytes = json["frame_memory_budget_bytes"];
+    FrameMemoryBudget::GetInstance().SetLimitBytes(budget_bytes);
+  }
+  if (json.find("pipeline_name") != json.end()) {
+    pipeline->name_ = json["pipeline_name"].get<std::string>();
+  }
+  if (json.find("metrics_port") != json.end()) {
+    unsigned short port = json["metrics_port"];
+    std::string address = "0.0.0.0";
+    if (json.find("metrics_address") != json.end()) {
+      address = json["metrics_address"].get<std::string>();
+    }
+    pipeline->metrics_server_ = std::make_shared<MetricsServer>(
+        MetricsRegistry::GetInstance(), port, address);
+  }
+  if (json.find("control_endpoint") != json.end()) {
+    std::string endpoint = json["control_endpoint"];
+    pipeline->control_server_ =
+        std::make_shared<ControlServer>(*pipeline, endpoint);
+  }
+
+  // Whether to account for the CPU usage of every operator, unless an
+  // operator says otherwise.
+  bool cpu_accounting = false;
+  if (json.find("cpu_accounting") != json.end()) {
+    cpu_accounting = json["cpu_accounting"].get<bool>();
+  }
+
+  // Operators that must not be fused to the operator that feeds them.
+  std::unordered_set<std::string> unfused;
 
   // First pass to create all operators
   for (const auto& op_spec : ops) {
@@ -51,6 +107,55 @@ std::shared_ptr<Pipeline> Pipeline::ConstructPipeline(nlohmann::json json) {
     LOG(INFO) << "Creating operator \"" << op_name << "\" of type \""
               << op_type_str << "\"";
     std::shared_ptr<Operator> op = OperatorFactory::Create(op_type, params);
+    auto policy_it = op_spec.find("overflow_policy");
+    if (policy_it != op_spec.end()) {
+      std::string policy_str = op_spec["overflow_policy"];
+      op->SetOverflowPolicy(GetOverflowPolicyByString(policy_str));
+    }
+    auto batch_it = op_spec.find("max_batch_size");
+    if (batch_it != op_spec.end()) {
+      op->SetMaxBatchSize(JsonToSizet(*batch_it));
+    }
+    auto queue_bytes_it = op_spec.find("max_queue_bytes");
+    if (queue_bytes_it != op_spec.end()) {
+      op->SetMaxQueueBytes(JsonToSizet(*queue_bytes_it));
+    }
+    auto replicas_it = op_spec.find("replicas");
+    if (replicas_it != op_spec.end()) {
+      op->SetReplicas(JsonToSizet(*replicas_it));
+    }
+    ThreadPlacement placement;
+    auto cpu_set_it = op_spec.find("cpu_set");
+    if (cpu_set_it != op_spec.end()) {
+      std::string cpu_set_str = op_spec["cpu_set"];
+      placement.cpus = ParseCpuList(cpu_set_str);
+    }
+    auto numa_node_it = op_spec.find("numa_node");
+    if (numa_node_it != op_spec.end()) {
+      placement.numa_node = JsonToInt(*numa_node_it);
+    }
+    auto priority_it = op_spec.find("priority");
+    if (priority_it != op_spec.end()) {
+      placement.priority = JsonToInt(*priority_it);
+    }
+    if (!placement.IsDefault()) {
+      LOG(INFO) << "Placing operator \"" << op_name
+                << "\": " << placement.ToString();
+      op->SetThreadPlacement(placement);
+    }
+    auto cpu_accounting_it = op_spec.find("cpu_accounting");
+    if (cpu_accounting_it != op_spec.end()) {
+      op->SetCpuAccounting(op_spec["cpu_accounting"].get<bool>());
+    } else {
+      op->SetCpuAccounting(cpu_accounting);
+    }
+    auto fuse_it = op_spec.find("fuse");
+    if (fuse_it != op_spec.end() && !op_spec["fuse"].get<bool>()) {
+      unfused.insert(op_name);
+    }
+    if (pipeline->executor_ != nullptr) {
+      op->SetExecutor(pipeline->executor_);
+    }
     pipeline->ops_.insert({op_name, op});
 
     pipeline->op_names_.push_back(op_name);
@@ -91,6 +196,7 @@ std::shared_ptr<Pipeline> Pipeline::ConstructPipeline(nlohmann::json json) {
                                  pipeline->reverse_dependency_graph_);
         boost::add_edge_by_label(cur_op_id, src_op_id,
                                  pipeline->dependency_graph_);
+        pipeline->consumers_[src_op_id][sink].push_back(cur_op_id);
 
         LOG(INFO) << "Connected source \"" << src << "\" of operator \""
                   << cur_op_id << "\" to the sink \"" << sink
@@ -99,9 +205,149 @@ std::shared_ptr<Pipeline> Pipeline::ConstructPipeline(nlohmann::json json) {
     }
   }
 
+  // Fusing changes which thread runs an Operator, so it is opt-in.
+  bool fuse_operators = false;
+  if (json.find("fuse_operators") != json.end()) {
+    fuse_operators = json["fuse_operators"];
+  }
+  if (fuse_operators) {
+    pipeline->FuseOperators(unfused);
+  }
+
+  // Off by default, since an application that subscribes to an Operator's
+  // sink itself would otherwise get frames without the fields it reads.
+  bool drop_dead_fields = false;
+  if (json.find("drop_dead_fields") != json.end()) {
+    drop_dead_fields = json["drop_dead_fields"];
+  }
+  if (drop_dead_fields) {
+    pipeline->ComputeFieldLiveness();
+  }
+
+  pipeline->SetMetricLabels();
+
   return pipeline;
 }
 
+void Pipeline::ComputeFieldLiveness() {
+  // Visit every Operator after all of the Operators that consume its frames.
+  std::deque<Vertex> deque;
+  boost::topological_sort(dependency_graph_, std::front_inserter(deque));
+
+  // The fields that each Operator needs in its input frames. Operators that
+  // read every field, or that feed one that does, are not listed.
+  std::unordered_map<std::string, std::unordered_set<std::string>> live_in;
+  for (const auto& i : deque) {
+    std::string name = op_names_[i];
+    std::shared_ptr<Operator> op = ops_.at(name);
+    bool reads_all = !op->HasDeclaredFields();
+    std::unordered_set<std::string> needed = op->GetReadFields();
+
+    for (const auto& sink : op->sinks_) {
+      // Sinks that nothing in the pipeline consumes are presumably read by the
+      // application, which may need any field.
+      auto consumers_it = consumers_[name].find(sink.first);
+      if (consumers_it == consumers_[name].end()) {
+        reads_all = true;
+        continue;
+      }
+
+      std::unordered_set<std::string> live;
+      bool sink_reads_all = false;
+      for (const auto& consumer : consumers_it->second) {
+        auto live_it = live_in.find(consumer);
+        if (live_it == live_in.end()) {
+          sink_reads_all = true;
+          break;
+        }
+        live.insert(live_it->second.begin(), live_it->second.end());
+      }
+      if (sink_reads_all) {
+        reads_all = true;
+        continue;
+      }
+
+      std::ostringstream msg;
+      msg << "Operator \"" << name << "\" keeps only these fields in sink \""
+          << sink.first << "\":";
+      for (const auto& field : live) {
+        msg << " " << field;
+        // Fields that this Operator always sets are not needed upstream.
+        if (op->GetWrittenFields().count(field) == 0) {
+          needed.insert(field);
+        }
+      }
+      LOG(INFO) << msg.str();
+      op->SetLiveFields(sink.first, live);
+    }
+
+    if (!reads_all) {
+      live_in.insert({name, needed});
+    }
+  }
+}
+
+void Pipeline::SetMetricLabels() {
+  // Visit every Operator after all of the Operators that feed it.
+  std::deque<Vertex> deque;
+  boost::topological_sort(reverse_dependency_graph_,
+                          std::front_inserter(deque));
+
+  // The cameras upstream of each Operator.
+  std::unordered_map<std::string, std::set<std::string>> cameras;
+  for (const auto& i : deque) {
+    std::string name = op_names_[i];
+    std::shared_ptr<Operator> op = ops_.at(name);
+    std::set<std::string>& op_cameras = cameras[name];
+    if (op->GetType() == OPERATOR_TYPE_CAMERA) {
+      op_cameras.insert(op->GetName());
+    }
+
+    MetricLabels labels = {{"pipeline", name_}, {"operator", name}};
+    // Operators that merge several cameras are not labelled with any.
+    if (op_cameras.size() == 1) {
+      labels["camera"] = *op_cameras.begin();
+    }
+    op->SetMetricLabels(labels);
+
+    for (const auto& sink_consumers : consumers_[name]) {
+      for (const auto& consumer : sink_consumers.second) {
+        cameras[consumer].insert(op_cameras.begin(), op_cameras.end());
+      }
+    }
+  }
+}
+
+void Pipeline::FuseOperators(const std::unordered_set<std::string>& unfused) {
+  for (const auto& op_sinks : consumers_) {
+    std::shared_ptr<Operator> op = ops_.at(op_sinks.first);
+    for (const auto& sink_consumers : op_sinks.second) {
+      // The Stream can only be bypassed if nothing else in the Pipeline reads
+      // it.
+      if (sink_consumers.second.size() != 1) {
+        continue;
+      }
+      const std::string& consumer_name = sink_consumers.second.front();
+      std::shared_ptr<Operator> consumer = ops_.at(consumer_name);
+      if (unfused.count(consumer_name) != 0) {
+        continue;
+      }
+      if (!op->CanFuse(*consumer)) {
+        // E.g., the consumer's queue settings, which fusing would bypass.
+        LOG(INFO) << "Not fusing operator \"" << consumer_name
+                  << "\" to the sink \"" << sink_consumers.first
+                  << "\" of operator \"" << op_sinks.first << "\"";
+        continue;
+      }
+      op->FuseSink(sink_consumers.first, consumer.get());
+      fused_edges_.insert({op_sinks.first, consumer_name});
+      LOG(INFO) << "Fused operator \"" << consumer_name << "\" to the sink \""
+                << sink_consumers.first << "\" of operator \""
+                << op_sinks.first << "\"";
+    }
+  }
+}
+
 std::unordered_map<std::string, std::shared_ptr<Operator>>
 Pipeline::GetOperators() {
   return ops_;
@@ -134,10 +380,29 @@ bool Pipeline::Start() {
   }
   LOG(INFO) << msg.str();
 
+  if (metrics_server_ != nullptr && !metrics_server_->Start()) {
+    // Not being able to export metrics is no reason to stop the pipeline.
+    LOG(ERROR) << "Unable to serve the metrics of pipeline \"" << name_
+               << "\"";
+  }
+  if (control_server_ != nullptr && !control_server_->Start()) {
+    // Nor is not being able to take control requests, e.g., when another
+    // pipeline already uses the endpoint.
+    LOG(ERROR) << "Unable to serve control requests for pipeline \"" << name_
+               << "\"";
+  }
   return true;
 }
 
 bool Pipeline::Stop() {
+  // Stop taking requests before the Operators go away.
+  if (control_server_ != nullptr) {
+    control_server_->Stop();
+  }
+  if (metrics_server_ != nullptr) {
+    metrics_server_->Stop();
+  }
+
   std::deque<Vertex> deque;
   boost::topological_sort(reverse_dependency_graph_,
                           std::front_inserter(deque));
@@ -157,9 +422,29 @@ bool Pipeline::Stop() {
   return true;
 }
 
+std::string Pipeline::DumpLatencies() const {
+  std::ostringstream o;
+  for (const auto& name : op_names_) {
+    o << "Operator \"" << name << "\":" << std::endl
+      << ops_.at(name)->DumpLatencies();
+  }
+  return o.str();
+}
+
 const std::string Pipeline::GetGraph() const {
   std::ostringstream o;
+  const AdjList& graph = reverse_dependency_graph_.graph();
+  // Draw fused edges in bold.
+  auto edge_writer = [this, &graph](std::ostream& out, const auto& edge) {
+    std::pair<std::string, std::string> names = {
+        op_names_.at(boost::source(edge, graph)),
+        op_names_.at(boost::target(edge, graph))};
+    if (fused_edges_.count(names) != 0) {
+      out << "[style=bold, label=\"fused\"]";
+    }
+  };
   boost::write_graphviz(o, reverse_dependency_graph_,
-                        boost::make_label_writer(op_names_.data()));
+                        boost::make_label_writer(op_names_.data()),
+                        edge_writer);
   return o.str();
 }
@@ -16,14 +16,21 @@
 #define SAF_PIPELINE_PIPELINE_H_
 
 #include <memory>
+#include <set>
 #include <string>
 #include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
 
 #include <boost/graph/adjacency_list.hpp>
 #include <boost/graph/labeled_graph.hpp>
 #include <json/src/json.hpp>
 
 #include "operator/operator.h"
+#include "pipeline/control_server.h"
+#include "pipeline/executor.h"
+#include "pipeline/metrics_server.h"
 
 class Pipeline {
   typedef boost::adjacency_list<boost::vecS, boost::vecS, boost::directedS>
@@ -34,7 +41,44 @@ class Pipeline {
  public:
   Pipeline();
 
-  // Creates a Pipeline from a JSON specification.
+  // Creates a Pipeline from a JSON specification. If the specification sets
+  // "drop_dead_fields" to true, fields are dropped from frames once no
+  // downstream Operator reads them (see Operator::DeclareFields()). This
+  // changes what readers outside the Pipeline see on an Operator's sinks, so
+  // it is off by default. If the specification sets "executor_threads", then
+  // the Operators share an Executor with that many threads (0 for one per
+  // core) instead of each getting its own thread.
+  //
+  // If the specification sets "fuse_operators" to true, then Operators are
+  // fused (see Operator::FuseSink()) to the Operator that feeds them when they
+  // are its only consumer and both allow it (see Operator::CanFuse()), unless
+  // the consumer's specification sets "fuse" to false.
+  //
+  // If the specification sets "control_endpoint", e.g., "tcp://*:5555", then
+  // the Pipeline serves requests to inspect and tune its Operators there
+  // while it runs (see ControlServer).
+  //
+  // The metrics of every Operator and of its source queues are exported
+  // through MetricsRegistry::GetInstance(), labelled with the Operator's name,
+  // the camera that feeds it, if there is only one, and the Pipeline's
+  // "pipeline_name", which defaults to "pipeline". If the specification sets
+  // "metrics_port", then they are served over HTTP for Prometheus on that port
+  // (see MetricsServer), on "metrics_address", which defaults to all
+  // interfaces. The registry covers every Pipeline of the process, so only
+  // one of them needs to serve it.
+  //
+  // If the specification sets "frame_memory_budget_bytes", then the frames
+  // queued in all of the streams of the process may hold at most that many
+  // bytes (see FrameMemoryBudget). An Operator's specification may also limit
+  // the bytes in each of its input queues with "max_queue_bytes".
+  //
+  // If the specification sets "cpu_accounting" to true, then every Operator
+  // measures the CPU time and hardware events of its Process() (see
+  // Operator::SetCpuAccounting()), unless the Operator's specification sets
+  // "cpu_accounting" itself.
+  //
+  // The numeric settings of an Operator's specification, e.g., "replicas" or
+  // "max_batch_size", may be JSON numbers or strings.
   static std::shared_ptr<Pipeline> ConstructPipeline(nlohmann::json json);
 
   // Returns the Operator with the specified name.
@@ -51,16 +95,48 @@ class Pipeline {
   // Operator failed to stop.
   bool Stop();
 
-  // Get reverse dependency graph (the pipeline) in GraphViz format.
+  // Describes the latency distributions of every Operator (see
+  // Operator::DumpLatencies()).
+  std::string DumpLatencies() const;
+
+  // Get reverse dependency graph (the pipeline) in GraphViz format. Fused
+  // edges are drawn in bold.
   const std::string GetGraph() const;
 
  private:
+  // Tells each Operator which fields the consumers of each of its sinks, and
+  // everything downstream of them, read.
+  void ComputeFieldLiveness();
+  // Fuses every Operator that is the only consumer of a sink to the Operator
+  // that owns the sink, where possible, except for the Operators in
+  // "unfused".
+  void FuseOperators(const std::unordered_set<std::string>& unfused);
+  // Labels the metrics of every Operator with the name of this Pipeline, of
+  // the Operator, and of the camera that feeds it.
+  void SetMetricLabels();
+
+  // Tells the metrics of this Pipeline apart from those of the others.
+  std::string name_;
   std::unordered_map<std::string, std::shared_ptr<Operator>> ops_;
+  // Runs the Operators, if the specification asked for a shared thread pool.
+  std::shared_ptr<Executor> executor_;
+  // Serves control requests while the Pipeline runs, if the specification
+  // asked for it.
+  std::shared_ptr<ControlServer> control_server_;
+  // Serves the metrics while the Pipeline runs, if the specification asked
+  // for it.
+  std::shared_ptr<MetricsServer> metrics_server_;
   std::vector<std::string> op_names_;
   // Graph that tracks the Operators that each Operator depends on.
   Graph dependency_graph_;
   // Graph that tracks the Operators that depend on each Operator.
   Graph reverse_dependency_graph_;
+  // The names of the Operators that consume each sink of each Operator.
+  std::unordered_map<std::string,
+                     std::unordered_map<std::string, std::vector<std::string>>>
+      consumers_;
+  // The (producer, consumer) pairs of Operators that are fused.
+  std::set<std::pair<std::string, std::string>> fused_edges_;
 };
 
 #endif  // SAF_PIPELINE_PIPELINE_H_
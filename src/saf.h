@@ -18,6 +18,7 @@
 #include "camera/camera.h"
 #include "camera/camera_manager.h"
 #include "camera/gst_camera.h"
+#include "camera/synthetic_camera.h"
 #include "common/context.h"
 #include "common/serialization.h"
 #include "common/timer.h"
@@ -35,6 +36,7 @@
 #include "operator/face_tracker.h"
 #include "operator/flow_control/flow_control_entrance.h"
 #include "operator/flow_control/flow_control_exit.h"
+#include "operator/frame_synchronizer.h"
 #include "operator/frame_writer.h"
 #include "operator/image_classifier.h"
 #include "operator/image_segmenter.h"
@@ -0,0 +1,161 @@
+// Copyright 2018 The SAF Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SAF_STREAM_EVENT_COUNT_H_
+#define SAF_STREAM_EVENT_COUNT_H_
+
+#include <atomic>
+#include <cstdint>
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#include <cerrno>
+#else
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#endif  // __linux__
+
+// An EventCount lets a thread park until some lock-free condition becomes
+// true, without the notifying thread having to take a lock or make a system
+// call when nobody is waiting. Usage on the waiting side:
+//
+//   while (!condition()) {
+//     auto key = event.PrepareWait();
+//     if (condition()) {
+//       event.CancelWait();
+//       break;
+//     }
+//     event.Wait(key, timeout_ms);
+//   }
+//
+// The notifying side makes the condition true and then calls NotifyOne() or
+// NotifyAll(). On Linux waiters park on a futex, elsewhere they fall back to a
+// condition variable.
+class EventCount {
+ public:
+  typedef uint32_t Key;
+
+  EventCount() : state_(0) {}
+  EventCount(const EventCount&) = delete;
+  EventCount& operator=(const EventCount&) = delete;
+
+  // Registers the calling thread as a waiter and returns the current epoch.
+  // The caller must re-check its condition afterwards and then call either
+  // CancelWait() or Wait().
+  Key PrepareWait() {
+    uint64_t prev = state_.fetch_add(kAddWaiter, std::memory_order_acq_rel);
+    return static_cast<Key>(prev >> kEpochShift);
+  }
+
+  // Unregisters a waiter that decided not to wait after all.
+  void CancelWait() {
+    state_.fetch_sub(kAddWaiter, std::memory_order_seq_cst);
+  }
+
+  // Parks until the epoch moves past "key" or "timeout_ms" milliseconds pass
+  // (0 means forever). Returns false on timeout. Spurious wakeups are
+  // possible, so callers must re-check their condition.
+  bool Wait(Key key, unsigned int timeout_ms = 0) {
+    bool notified = true;
+#ifdef __linux__
+    struct timespec ts;
+    struct timespec* ts_ptr = nullptr;
+    if (timeout_ms > 0) {
+      ts.tv_sec = timeout_ms / 1000;
+      ts.tv_nsec = (timeout_ms % 1000) * 1000000L;
+      ts_ptr = &ts;
+    }
+    while (Epoch() == key) {
+      long ret = syscall(SYS_futex, EpochAddress(), FUTEX_WAIT_PRIVATE,
+                         static_cast<int>(key), ts_ptr, nullptr, 0);
+      if (ret != 0 && errno == ETIMEDOUT) {
+        notified = false;
+        break;
+      }
+    }
+#else
+    std::unique_lock<std::mutex> lock(mtx_);
+    auto pred = [this, key] { return Epoch() != key; };
+    if (timeout_ms > 0) {
+      notified =
+          cv_.wait_for(lock, std::chrono::milliseconds(timeout_ms), pred);
+    } else {
+      cv_.wait(lock, pred);
+    }
+#endif  // __linux__
+    state_.fetch_sub(kAddWaiter, std::memory_order_seq_cst);
+    return notified;
+  }
+
+  void NotifyOne() { Notify(1); }
+  void NotifyAll() { Notify(kWakeAll); }
+
+ private:
+  static constexpr uint64_t kAddWaiter = 1;
+  static constexpr uint64_t kWaiterMask = 0xFFFFFFFF;
+  static constexpr int kEpochShift = 32;
+  static constexpr uint64_t kAddEpoch = uint64_t(1) << kEpochShift;
+  static constexpr int kWakeAll = 0x7FFFFFFF;
+
+  Key Epoch() const {
+    return static_cast<Key>(state_.load(std::memory_order_acquire) >>
+                            kEpochShift);
+  }
+
+  void Notify(int num_threads) {
+    uint64_t prev = state_.fetch_add(kAddEpoch, std::memory_order_acq_rel);
+    if ((prev & kWaiterMask) == 0) {
+      // Nobody is parked, so there is no need to enter the kernel.
+      return;
+    }
+#ifdef __linux__
+    syscall(SYS_futex, EpochAddress(), FUTEX_WAKE_PRIVATE, num_threads,
+            nullptr, nullptr, 0);
+#else
+    std::lock_guard<std::mutex> lock(mtx_);
+    if (num_threads == 1) {
+      cv_.notify_one();
+    } else {
+      cv_.notify_all();
+    }
+#endif  // __linux__
+  }
+
+#ifdef __linux__
+  // The futex word is the upper (epoch) half of "state_".
+  int* EpochAddress() {
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    return reinterpret_cast<int*>(&state_) + 1;
+#else
+    return reinterpret_cast<int*>(&state_);
+#endif
+  }
+#endif  // __linux__
+
+  // Upper 32 bits hold the epoch, which is bumped on every notification. Lower
+  // 32 bits hold the number of registered waiters.
+  std::atomic<uint64_t> state_;
+  static_assert(sizeof(std::atomic<uint64_t>) == sizeof(uint64_t),
+                "EventCount requires a lock-free 64-bit atomic");
+#ifndef __linux__
+  std::mutex mtx_;
+  std::condition_variable cv_;
+#endif  // __linux__
+};
+
+#endif  // SAF_STREAM_EVENT_COUNT_H_
@@ -0,0 +1,87 @@
+// Copyright 2018 The SAF Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "stream/field_key.h"
+
+#include <deque>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+// The process-wide table of interned names. Names are never removed, and
+// std::deque never moves its elements, so references returned by GetName()
+// stay valid forever.
+struct FieldTable {
+  std::mutex mtx;
+  std::unordered_map<std::string, FieldId> ids;
+  std::deque<std::string> names;
+};
+
+FieldTable& GetFieldTable() {
+  // Constructed on first use, so that FieldKeys with static storage duration
+  // can safely be initialized from any translation unit.
+  static FieldTable* table = new FieldTable;
+  return *table;
+}
+
+}  // namespace
+
+FieldId FieldRegistry::GetId(const std::string& name) {
+  thread_local std::unordered_map<std::string, FieldId> cache;
+  auto it = cache.find(name);
+  if (it != cache.end()) {
+    return it->second;
+  }
+
+  FieldTable& table = GetFieldTable();
+  FieldId id;
+  {
+    std::lock_guard<std::mutex> guard(table.mtx);
+    auto table_it = table.ids.find(name);
+    if (table_it == table.ids.end()) {
+      id = (FieldId)table.names.size();
+      table.names.push_back(name);
+      table.ids.insert({name, id});
+    } else {
+      id = table_it->second;
+    }
+  }
+  cache.insert({name, id});
+  return id;
+}
+
+const std::string& FieldRegistry::GetName(FieldId id) {
+  // The names never move, so each thread can keep pointers to them, and only
+  // takes the lock to catch up with names interned since.
+  thread_local std::vector<const std::string*> cache;
+  if (id < cache.size()) {
+    return *cache[id];
+  }
+
+  FieldTable& table = GetFieldTable();
+  std::lock_guard<std::mutex> guard(table.mtx);
+  if (id >= table.names.size()) {
+    std::ostringstream msg;
+    msg << "Unknown field id: " << id;
+    throw std::out_of_range(msg.str());
+  }
+  for (size_t i = cache.size(); i < table.names.size(); ++i) {
+    cache.push_back(&table.names[i]);
+  }
+  return *cache[id];
+}
@@ -0,0 +1,60 @@
+// Copyright 2018 The SAF Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SAF_STREAM_FIELD_KEY_H_
+#define SAF_STREAM_FIELD_KEY_H_
+
+#include <cstdint>
+#include <string>
+
+// A small integer that stands for a Frame field name. Every distinct name is
+// interned once per process, so Frames can store and compare fields by id
+// instead of hashing strings.
+typedef uint32_t FieldId;
+
+class FieldRegistry {
+ public:
+  // Returns the id of "name", interning it if this is the first time it is
+  // seen. Lookups are served from a per-thread cache, so only the first
+  // lookup of a name on each thread takes a lock.
+  static FieldId GetId(const std::string& name);
+  // Returns the name that "id" stands for. Throws std::out_of_range if "id"
+  // was never returned by GetId(). Like GetId(), only the first lookup of an
+  // id on each thread takes a lock.
+  static const std::string& GetName(FieldId id);
+};
+
+// A typed handle for a Frame field. Constructing a FieldKey interns its name
+// once, after which every Frame::GetValue() and Frame::SetValue() through it
+// skips the string hashing entirely. Hot fields should have a long-lived
+// FieldKey, e.g.:
+//
+//   static const FieldKey<unsigned long> kFrameIdField("frame_id");
+//   auto id = frame->GetValue(kFrameIdField);
+template <typename T>
+class FieldKey {
+ public:
+  typedef T value_type;
+
+  explicit FieldKey(const std::string& name)
+      : id_(FieldRegistry::GetId(name)) {}
+
+  FieldId GetId() const { return id_; }
+  const std::string& GetName() const { return FieldRegistry::GetName(id_); }
+
+ private:
+  FieldId id_;
+};
+
+#endif  // SAF_STREAM_FIELD_KEY_H_
@@ -23,8 +23,15 @@
 #include "common/types.h"
 
 constexpr auto STOP_FRAME_KEY = "stop_frame";
+static const FieldKey<bool> kStopFrameField(STOP_FRAME_KEY);
 
 const char* Frame::kFrameIdKey = "frame_id";
+const FieldKey<unsigned long> Frame::kFrameIdField(Frame::kFrameIdKey);
+const char* Frame::kOriginalBytesKey = "original_bytes";
+const char* Frame::kOriginalImageKey = "original_image";
+static const FieldKey<std::vector<char>> kOriginalBytesField(
+    Frame::kOriginalBytesKey);
+static const FieldKey<cv::Mat> kOriginalImageField(Frame::kOriginalImageKey);
 
 class FramePrinter : public boost::static_visitor<std::string> {
  public:
@@ -409,7 +416,7 @@ class FrameSize : public boost::static_visitor<unsigned long> {
   }
 
   unsigned long operator()(const cv::Mat& v) const {
-    return v.total() * sizeof(float);
+    return v.total() * v.elemSize();
   }
 
   unsigned long operator()(const std::vector<float>& v) const {
@@ -462,39 +469,108 @@ class FrameSize : public boost::static_visitor<unsigned long> {
   }
 };
 
-Frame::Frame() {}
+Frame::Frame()
+    : frame_data_(std::make_shared<FieldMap>()), owns_fields_(true) {}
 
 Frame::Frame(const std::unique_ptr<Frame>& frame) : Frame(*frame) {}
 
-Frame::Frame(const Frame& frame) : Frame(frame, {}) {}
+Frame::Frame(const Frame& frame)
+    : flow_control_entrance_(frame.flow_control_entrance_),
+      frame_data_(frame.frame_data_),
+      owns_fields_(false) {
+  // Neither Frame may modify the shared map or its values in place anymore.
+  frame.owns_fields_.store(false, std::memory_order_relaxed);
+}
+
+Frame& Frame::operator=(const Frame& frame) {
+  if (this != &frame) {
+    flow_control_entrance_ = frame.flow_control_entrance_;
+    frame_data_ = frame.frame_data_;
+    owns_fields_ = false;
+    frame.owns_fields_.store(false, std::memory_order_relaxed);
+  }
+  return *this;
+}
 
-Frame::Frame(const Frame& frame, std::unordered_set<std::string> fields) {
-  flow_control_entrance_ = frame.flow_control_entrance_;
-  frame_data_ = frame.frame_data_;
+Frame::Frame(const Frame& frame, std::unordered_set<std::string> fields)
+    : Frame(frame) {
+  if (fields.empty()) {
+    // Inherit all fields by sharing the whole field map.
+    return;
+  }
 
-  bool inherit_all_fields = fields.empty();
-  if (!inherit_all_fields) {
-    for (auto it = frame_data_.begin(); it != frame_data_.end();) {
-      if (fields.find(it->first) == fields.end()) {
-        it = frame_data_.erase(it);
-      } else {
-        ++it;
-      }
+  // Only the selected field pointers are copied. The values themselves are
+  // still shared with "frame".
+  auto frame_data = std::make_shared<FieldMap>();
+  for (const auto& field : fields) {
+    FieldId id;
+    const FieldPtr* value =
+        frame.FindFieldOrAlias(FieldRegistry::GetId(field), &id);
+    bool selected =
+        std::any_of(frame_data->begin(), frame_data->end(),
+                    [id](const Field& other) { return other.id == id; });
+    // "original_bytes" and "original_image" may both select the image.
+    if (value != nullptr && !selected) {
+      frame_data->emplace_back(id, *value);
+    }
+  }
+  frame_data_ = frame_data;
+  // The map is new, but the values in it are still shared.
+  owns_fields_ = true;
+}
+
+Frame::FieldMap& Frame::MutableFields() {
+  if (!owns_fields_.load(std::memory_order_relaxed)) {
+    // Another Frame may share our fields, so detach before modifying the map.
+    // The copied values are shared with the other Frame, even if this one
+    // owned them before.
+    auto frame_data = std::make_shared<FieldMap>();
+    frame_data->reserve(frame_data_->size());
+    for (const auto& field : *frame_data_) {
+      frame_data->emplace_back(field.id, field.value);
+    }
+    frame_data_ = frame_data;
+    owns_fields_ = true;
+  }
+  return *frame_data_;
+}
+
+const Frame::FieldPtr* Frame::FindField(FieldId id) const {
+  // A linear scan over a handful of contiguous entries beats hashing.
+  for (const auto& field : *frame_data_) {
+    if (field.id == id) {
+      return &field.value;
     }
   }
+  return nullptr;
+}
+
+const Frame::FieldPtr* Frame::FindFieldOrAlias(FieldId id,
+                                               FieldId* found_id) const {
+  const FieldPtr* value = FindField(id);
+  if (value == nullptr && id == kOriginalBytesField.GetId()) {
+    id = kOriginalImageField.GetId();
+    value = FindField(id);
+  }
+  if (found_id != nullptr) {
+    *found_id = id;
+  }
+  return value;
+}
 
-  // If either we are inheriting all fields or we are explicitly inheriting
-  // "original_bytes", and "original_bytes" is a valid field in "frame", then
-  // we need to inherit the "original_bytes" field. Doing so requires a deep
-  // copy.
-  auto other_it = frame.frame_data_.find("original_bytes");
-  auto field_it = std::find(fields.begin(), fields.end(), "original_bytes");
-  if ((inherit_all_fields || (field_it != fields.end())) &&
-      (other_it != frame.frame_data_.end())) {
-    CHECK(frame_data_.count("original_bytes") >= 1);
-    frame_data_["original_bytes"] =
-        boost::get<std::vector<char>>(other_it->second);
+void Frame::SetField(FieldId id, FieldPtr value) {
+  // Replace the field rather than assigning into it, since the old value may
+  // be shared with other Frames.
+  // "value" is always newly allocated, so this Frame owns it.
+  auto& fields = MutableFields();
+  for (auto& field : fields) {
+    if (field.id == id) {
+      field.value = std::move(value);
+      field.owned = true;
+      return;
+    }
   }
+  fields.emplace_back(id, std::move(value), true);
 }
 
 void Frame::SetFlowControlEntrance(FlowControlEntrance* flow_control_entrance) {
@@ -506,37 +582,169 @@ FlowControlEntrance* Frame::GetFlowControlEntrance() {
 }
 
 template <typename T>
-T Frame::GetValue(const std::string key) const {
-  auto it = frame_data_.find(key);
-  if (it == frame_data_.end()) {
+const T& Frame::GetRefById(FieldId id) const {
+  const FieldPtr* value = FindField(id);
+  if (value == nullptr) {
+    std::ostringstream msg;
+    if (FindFieldOrAlias(id) != nullptr) {
+      // There is no std::vector<char> to refer to, modify, or move out.
+      msg << "Key \"" << kOriginalBytesKey << "\" is served from \""
+          << kOriginalImageKey << "\", so read it with GetBytes() or "
+          << "GetValue()";
+    } else {
+      msg << "Key \"" << FieldRegistry::GetName(id) << "\" not in frame!";
+    }
+    throw std::runtime_error(msg.str());
+  }
+
+  const T* val = boost::get<T>(value->get());
+  if (val == nullptr) {
+    LOG(FATAL) << "Unable to get field \"" << FieldRegistry::GetName(id)
+               << "\" as requested type.";
+  }
+  return *val;
+}
+
+template <typename T>
+T Frame::GetValueById(FieldId id) const {
+  return GetRefById<T>(id);
+}
+
+// Older code reads "original_bytes" as a std::vector<char>, so materialize it
+// from "original_image" when it is not stored separately.
+template <>
+std::vector<char> Frame::GetValueById(FieldId id) const {
+  if (FindField(id) == nullptr && id == kOriginalBytesField.GetId()) {
+    ByteView bytes = GetBytes(kOriginalBytesKey);
+    return std::vector<char>(bytes.data, bytes.data + bytes.size);
+  }
+  return GetRefById<std::vector<char>>(id);
+}
+
+Frame::ByteView Frame::GetBytes(const std::string& key) const {
+  const FieldPtr* value = FindFieldOrAlias(FieldRegistry::GetId(key));
+  if (value == nullptr) {
     std::ostringstream msg;
     msg << "Key \"" << key << "\" not in frame!";
     throw std::runtime_error(msg.str());
   }
 
-  T val;
-  try {
-    val = boost::get<T>(it->second);
-  } catch (boost::bad_get& e) {
-    LOG(FATAL) << "Unable to get field \"" << key << " as requested type. "
-               << e.what();
+  if (const auto* bytes = boost::get<std::vector<char>>(value->get())) {
+    return {bytes->data(), bytes->size()};
+  }
+  const auto* image = boost::get<cv::Mat>(value->get());
+  if (image == nullptr) {
+    LOG(FATAL) << "Field \"" << key << "\" does not hold raw bytes.";
+  }
+  CHECK(image->empty() || image->isContinuous())
+      << "Field \"" << key << "\" is not a continuous cv::Mat.";
+  return {(const char*)image->data, image->total() * image->elemSize()};
+}
+
+Frame::field_types& Frame::MutableField(FieldId id) {
+  if (FindField(id) == nullptr) {
+    std::ostringstream msg;
+    msg << "Key \"" << FieldRegistry::GetName(id) << "\" not in frame!";
+    throw std::runtime_error(msg.str());
+  }
+
+  for (auto& field : MutableFields()) {
+    if (field.id == id) {
+      if (!field.owned) {
+        field.value = std::make_shared<field_types>(*field.value);
+        field.owned = true;
+      }
+      // Values are allocated non-const, and this Frame now holds the only
+      // reference to this one.
+      return const_cast<field_types&>(*field.value);
+    }
   }
+  LOG(FATAL) << "Field \"" << FieldRegistry::GetName(id)
+             << "\" disappeared from frame!";
+  throw std::logic_error("Unreachable");
+}
+
+template <typename T>
+const T& Frame::GetRef(const std::string& key) const {
+  return GetRefById<T>(FieldRegistry::GetId(key));
+}
+
+template <typename T>
+const T& Frame::GetRef(const FieldKey<T>& key) const {
+  return GetRefById<T>(key.GetId());
+}
+
+template <typename T>
+T& Frame::GetMutable(const std::string& key) {
+  // Check the type before possibly copying the value.
+  FieldId id = FieldRegistry::GetId(key);
+  GetRefById<T>(id);
+  return boost::get<T>(MutableField(id));
+}
+
+template <typename T>
+T Frame::TakeValue(const std::string& key) {
+  FieldId id = FieldRegistry::GetId(key);
+  GetRefById<T>(id);
+  T val = std::move(boost::get<T>(MutableField(id)));
+  Delete(id);
   return val;
 }
 
+template <typename T>
+T Frame::GetValue(const std::string key) const {
+  return GetValueById<T>(FieldRegistry::GetId(key));
+}
+
+template <typename T>
+T Frame::GetValue(const FieldKey<T>& key) const {
+  return GetValueById<T>(key.GetId());
+}
+
 template <typename T>
 void Frame::SetValue(std::string key, const T& val) {
-  frame_data_[key] = val;
+  SetField(FieldRegistry::GetId(key), std::make_shared<field_types>(val));
+}
+
+template <typename T>
+void Frame::SetValue(const FieldKey<T>& key,
+                     const typename FieldKey<T>::value_type& val) {
+  SetField(key.GetId(), std::make_shared<field_types>(val));
+}
+
+void Frame::Delete(std::string key) { Delete(FieldRegistry::GetId(key)); }
+
+void Frame::Delete(FieldId id) {
+  if (FindField(id) == nullptr) {
+    return;
+  }
+  auto& fields = MutableFields();
+  fields.erase(std::remove_if(fields.begin(), fields.end(),
+                              [id](const Field& field) {
+                                return field.id == id;
+                              }),
+               fields.end());
 }
 
-void Frame::Delete(std::string key) { frame_data_.erase(key); }
+void Frame::DeleteAllExcept(const std::unordered_set<FieldId>& ids) {
+  auto is_dead = [&ids](const Field& field) {
+    return ids.find(field.id) == ids.end();
+  };
+  // Avoid detaching a shared map when there is nothing to delete.
+  if (std::none_of(frame_data_->begin(), frame_data_->end(), is_dead)) {
+    return;
+  }
+  auto& fields = MutableFields();
+  fields.erase(std::remove_if(fields.begin(), fields.end(), is_dead),
+               fields.end());
+}
 
 std::string Frame::ToString() const {
   FramePrinter visitor;
   std::ostringstream output;
-  for (auto iter = frame_data_.begin(); iter != frame_data_.end(); iter++) {
-    auto res = boost::apply_visitor(visitor, iter->second);
-    output << iter->first << ": " << res << std::endl;
+  for (auto iter = frame_data_->begin(); iter != frame_data_->end(); iter++) {
+    auto res = boost::apply_visitor(visitor, *iter->value);
+    output << FieldRegistry::GetName(iter->id) << ": " << res << std::endl;
   }
   return output.str();
 }
@@ -544,48 +752,66 @@ std::string Frame::ToString() const {
 nlohmann::json Frame::ToJson() const {
   FrameJsonPrinter visitor;
   nlohmann::json j;
-  for (const auto& e : frame_data_) {
-    j[e.first] = boost::apply_visitor(visitor, e.second);
+  for (const auto& field : *frame_data_) {
+    j[FieldRegistry::GetName(field.id)] =
+        boost::apply_visitor(visitor, *field.value);
   }
   return j;
 }
 
-size_t Frame::Count(std::string key) const { return frame_data_.count(key); }
+size_t Frame::Count(std::string key) const {
+  return Count(FieldRegistry::GetId(key));
+}
+
+size_t Frame::Count(FieldId id) const {
+  return FindFieldOrAlias(id) == nullptr ? 0 : 1;
+}
 
 nlohmann::json Frame::GetFieldJson(const std::string& field) const {
+  const FieldPtr* value = FindField(FieldRegistry::GetId(field));
+  if (value == nullptr) {
+    throw std::out_of_range("Unknown field: " + field);
+  }
   nlohmann::json j;
-  j[field] = boost::apply_visitor(FrameJsonPrinter{}, frame_data_.at(field));
+  j[field] = boost::apply_visitor(FrameJsonPrinter{}, **value);
   return j;
 }
 
 std::unordered_map<std::string, Frame::field_types> Frame::GetFields() {
-  return frame_data_;
+  std::unordered_map<std::string, field_types> fields;
+  for (const auto& field : *frame_data_) {
+    fields.insert({FieldRegistry::GetName(field.id), *field.value});
+  }
+  return fields;
 }
 
 void Frame::SetStopFrame(bool stop_frame) {
-  SetValue<bool>(STOP_FRAME_KEY, stop_frame);
+  SetValue(kStopFrameField, stop_frame);
 }
 
 bool Frame::IsStopFrame() const {
-  return Count(STOP_FRAME_KEY) && GetValue<bool>(STOP_FRAME_KEY);
+  // Checked for every frame by every operator, so avoid the name lookup.
+  const FieldPtr* value = FindField(kStopFrameField.GetId());
+  return value != nullptr && boost::get<bool>(**value);
 }
 
 unsigned long Frame::GetRawSizeBytes(
     std::unordered_set<std::string> fields) const {
-  for (const auto& field : fields) {
-    if (frame_data_.find(field) == frame_data_.end()) {
-      throw std::invalid_argument("Unknown field: " + field);
+  FrameSize visitor;
+  unsigned long size_bytes = 0;
+  if (fields.empty()) {
+    for (const auto& field : *frame_data_) {
+      size_bytes += boost::apply_visitor(visitor, *field.value);
     }
+    return size_bytes;
   }
 
-  bool use_all_fields = fields.empty();
-  FrameSize visitor;
-  unsigned long size_bytes = 0;
-  for (auto it = frame_data_.begin(); it != frame_data_.end(); ++it) {
-    std::string field = it->first;
-    if (use_all_fields || fields.find(field) != fields.end()) {
-      size_bytes += boost::apply_visitor(visitor, frame_data_.at(field));
+  for (const auto& field : fields) {
+    const FieldPtr* value = FindFieldOrAlias(FieldRegistry::GetId(field));
+    if (value == nullptr) {
+      throw std::invalid_argument("Unknown field: " + field);
     }
+    size_bytes += boost::apply_visitor(visitor, **value);
   }
   return size_bytes;
 }
@@ -645,3 +871,210 @@ template std::unordered_map<int, float> Frame::GetValue(std::string) const;
 template std::unordered_map<int, bool> Frame::GetValue(std::string) const;
 template std::unordered_map<unsigned long, int> Frame::GetValue(
     std::string) const;
+
+// Typed key accessors for the same types
+template void Frame::SetValue(const FieldKey<double>&, const double&);
+template void Frame::SetValue(const FieldKey<float>&, const float&);
+template void Frame::SetValue(const FieldKey<int>&, const int&);
+template void Frame::SetValue(const FieldKey<long>&, const long&);
+template void Frame::SetValue(const FieldKey<unsigned long>&,
+                              const unsigned long&);
+template void Frame::SetValue(const FieldKey<bool>&, const bool&);
+template void Frame::SetValue(const FieldKey<boost::posix_time::ptime>&,
+                              const boost::posix_time::ptime&);
+template void Frame::SetValue(const FieldKey<boost::posix_time::time_duration>&,
+                              const boost::posix_time::time_duration&);
+template void Frame::SetValue(const FieldKey<std::string>&, const std::string&);
+template void Frame::SetValue(const FieldKey<std::vector<std::string>>&,
+                              const std::vector<std::string>&);
+template void Frame::SetValue(const FieldKey<std::vector<double>>&,
+                              const std::vector<double>&);
+template void Frame::SetValue(const FieldKey<std::vector<Rect>>&,
+                              const std::vector<Rect>&);
+template void Frame::SetValue(const FieldKey<std::vector<char>>&,
+                              const std::vector<char>&);
+template void Frame::SetValue(const FieldKey<cv::Mat>&, const cv::Mat&);
+template void Frame::SetValue(const FieldKey<std::vector<FaceLandmark>>&,
+                              const std::vector<FaceLandmark>&);
+template void Frame::SetValue(const FieldKey<std::vector<std::vector<float>>>&,
+                              const std::vector<std::vector<float>>&);
+template void Frame::SetValue(const FieldKey<std::vector<float>>&,
+                              const std::vector<float>&);
+template void Frame::SetValue(const FieldKey<std::vector<std::vector<double>>>&,
+                              const std::vector<std::vector<double>>&);
+template void Frame::SetValue(const FieldKey<std::vector<Frame>>&,
+                              const std::vector<Frame>&);
+template void Frame::SetValue(const FieldKey<std::vector<int>>&,
+                              const std::vector<int>&);
+template void Frame::SetValue(const FieldKey<std::unordered_map<int, float>>&,
+                              const std::unordered_map<int, float>&);
+template void Frame::SetValue(const FieldKey<std::unordered_map<int, bool>>&,
+                              const std::unordered_map<int, bool>&);
+template void Frame::SetValue(
+    const FieldKey<std::unordered_map<unsigned long, int>>&,
+    const std::unordered_map<unsigned long, int>&);
+
+template double Frame::GetValue(const FieldKey<double>&) const;
+template float Frame::GetValue(const FieldKey<float>&) const;
+template int Frame::GetValue(const FieldKey<int>&) const;
+template long Frame::GetValue(const FieldKey<long>&) const;
+template unsigned long Frame::GetValue(const FieldKey<unsigned long>&) const;
+template bool Frame::GetValue(const FieldKey<bool>&) const;
+template boost::posix_time::ptime Frame::GetValue(
+    const FieldKey<boost::posix_time::ptime>&) const;
+template boost::posix_time::time_duration Frame::GetValue(
+    const FieldKey<boost::posix_time::time_duration>&) const;
+template std::string Frame::GetValue(const FieldKey<std::string>&) const;
+template std::vector<std::string> Frame::GetValue(
+    const FieldKey<std::vector<std::string>>&) const;
+template std::vector<double> Frame::GetValue(
+    const FieldKey<std::vector<double>>&) const;
+template std::vector<Rect> Frame::GetValue(
+    const FieldKey<std::vector<Rect>>&) const;
+template std::vector<char> Frame::GetValue(
+    const FieldKey<std::vector<char>>&) const;
+template cv::Mat Frame::GetValue(const FieldKey<cv::Mat>&) const;
+template std::vector<FaceLandmark> Frame::GetValue(
+    const FieldKey<std::vector<FaceLandmark>>&) const;
+template std::vector<std::vector<float>> Frame::GetValue(
+    const FieldKey<std::vector<std::vector<float>>>&) const;
+template std::vector<float> Frame::GetValue(
+    const FieldKey<std::vector<float>>&) const;
+template std::vector<std::vector<double>> Frame::GetValue(
+    const FieldKey<std::vector<std::vector<double>>>&) const;
+template std::vector<Frame> Frame::GetValue(
+    const FieldKey<std::vector<Frame>>&) const;
+template std::vector<int> Frame::GetValue(
+    const FieldKey<std::vector<int>>&) const;
+template std::unordered_map<int, float> Frame::GetValue(
+    const FieldKey<std::unordered_map<int, float>>&) const;
+template std::unordered_map<int, bool> Frame::GetValue(
+    const FieldKey<std::unordered_map<int, bool>>&) const;
+template std::unordered_map<unsigned long, int> Frame::GetValue(
+    const FieldKey<std::unordered_map<unsigned long, int>>&) const;
+
+// Reference and move-out accessors for the same types
+template const double& Frame::GetRef(const std::string&) const;
+template const float& Frame::GetRef(const std::string&) const;
+template const int& Frame::GetRef(const std::string&) const;
+template const long& Frame::GetRef(const std::string&) const;
+template const unsigned long& Frame::GetRef(const std::string&) const;
+template const bool& Frame::GetRef(const std::string&) const;
+template const boost::posix_time::ptime& Frame::GetRef(
+    const std::string&) const;
+template const boost::posix_time::time_duration& Frame::GetRef(
+    const std::string&) const;
+template const std::string& Frame::GetRef(const std::string&) const;
+template const std::vector<std::string>& Frame::GetRef(
+    const std::string&) const;
+template const std::vector<double>& Frame::GetRef(const std::string&) const;
+template const std::vector<Rect>& Frame::GetRef(const std::string&) const;
+template const std::vector<char>& Frame::GetRef(const std::string&) const;
+template const cv::Mat& Frame::GetRef(const std::string&) const;
+template const std::vector<FaceLandmark>& Frame::GetRef(
+    const std::string&) const;
+template const std::vector<std::vector<float>>& Frame::GetRef(
+    const std::string&) const;
+template const std::vector<float>& Frame::GetRef(const std::string&) const;
+template const std::vector<std::vector<double>>& Frame::GetRef(
+    const std::string&) const;
+template const std::vector<Frame>& Frame::GetRef(const std::string&) const;
+template const std::vector<int>& Frame::GetRef(const std::string&) const;
+template const std::unordered_map<int, float>& Frame::GetRef(
+    const std::string&) const;
+template const std::unordered_map<int, bool>& Frame::GetRef(
+    const std::string&) const;
+template const std::unordered_map<unsigned long, int>& Frame::GetRef(
+    const std::string&) const;
+
+template const double& Frame::GetRef(const FieldKey<double>&) const;
+template const float& Frame::GetRef(const FieldKey<float>&) const;
+template const int& Frame::GetRef(const FieldKey<int>&) const;
+template const long& Frame::GetRef(const FieldKey<long>&) const;
+template const unsigned long& Frame::GetRef(
+    const FieldKey<unsigned long>&) const;
+template const bool& Frame::GetRef(const FieldKey<bool>&) const;
+template const boost::posix_time::ptime& Frame::GetRef(
+    const FieldKey<boost::posix_time::ptime>&) const;
+template const boost::posix_time::time_duration& Frame::GetRef(
+    const FieldKey<boost::posix_time::time_duration>&) const;
+template const std::string& Frame::GetRef(const FieldKey<std::string>&) const;
+template const std::vector<std::string>& Frame::GetRef(
+    const FieldKey<std::vector<std::string>>&) const;
+template const std::vector<double>& Frame::GetRef(
+    const FieldKey<std::vector<double>>&) const;
+template const std::vector<Rect>& Frame::GetRef(
+    const FieldKey<std::vector<Rect>>&) const;
+template const std::vector<char>& Frame::GetRef(
+    const FieldKey<std::vector<char>>&) const;
+template const cv::Mat& Frame::GetRef(const FieldKey<cv::Mat>&) const;
+template const std::vector<FaceLandmark>& Frame::GetRef(
+    const FieldKey<std::vector<FaceLandmark>>&) const;
+template const std::vector<std::vector<float>>& Frame::GetRef(
+    const FieldKey<std::vector<std::vector<float>>>&) const;
+template const std::vector<float>& Frame::GetRef(
+    const FieldKey<std::vector<float>>&) const;
+template const std::vector<std::vector<double>>& Frame::GetRef(
+    const FieldKey<std::vector<std::vector<double>>>&) const;
+template const std::vector<Frame>& Frame::GetRef(
+    const FieldKey<std::vector<Frame>>&) const;
+template const std::vector<int>& Frame::GetRef(
+    const FieldKey<std::vector<int>>&) const;
+template const std::unordered_map<int, float>& Frame::GetRef(
+    const FieldKey<std::unordered_map<int, float>>&) const;
+template const std::unordered_map<int, bool>& Frame::GetRef(
+    const FieldKey<std::unordered_map<int, bool>>&) const;
+template const std::unordered_map<unsigned long, int>& Frame::GetRef(
+    const FieldKey<std::unordered_map<unsigned long, int>>&) const;
+
+template double& Frame::GetMutable(const std::string&);
+template float& Frame::GetMutable(const std::string&);
+template int& Frame::GetMutable(const std::string&);
+template long& Frame::GetMutable(const std::string&);
+template unsigned long& Frame::GetMutable(const std::string&);
+template bool& Frame::GetMutable(const std::string&);
+template boost::posix_time::ptime& Frame::GetMutable(const std::string&);
+template boost::posix_time::time_duration& Frame::GetMutable(
+    const std::string&);
+template std::string& Frame::GetMutable(const std::string&);
+template std::vector<std::string>& Frame::GetMutable(const std::string&);
+template std::vector<double>& Frame::GetMutable(const std::string&);
+template std::vector<Rect>& Frame::GetMutable(const std::string&);
+template std::vector<char>& Frame::GetMutable(const std::string&);
+template cv::Mat& Frame::GetMutable(const std::string&);
+template std::vector<FaceLandmark>& Frame::GetMutable(const std::string&);
+template std::vector<std::vector<float>>& Frame::GetMutable(const std::string&);
+template std::vector<float>& Frame::GetMutable(const std::string&);
+template std::vector<std::vector<double>>& Frame::GetMutable(
+    const std::string&);
+template std::vector<Frame>& Frame::GetMutable(const std::string&);
+template std::vector<int>& Frame::GetMutable(const std::string&);
+template std::unordered_map<int, float>& Frame::GetMutable(const std::string&);
+template std::unordered_map<int, bool>& Frame::GetMutable(const std::string&);
+template std::unordered_map<unsigned long, int>& Frame::GetMutable(
+    const std::string&);
+
+template double Frame::TakeValue(const std::string&);
+template float Frame::TakeValue(const std::string&);
+template int Frame::TakeValue(const std::string&);
+template long Frame::TakeValue(const std::string&);
+template unsigned long Frame::TakeValue(const std::string&);
+template bool Frame::TakeValue(const std::string&);
+template boost::posix_time::ptime Frame::TakeValue(const std::string&);
+template boost::posix_time::time_duration Frame::TakeValue(const std::string&);
+template std::string Frame::TakeValue(const std::string&);
+template std::vector<std::string> Frame::TakeValue(const std::string&);
+template std::vector<double> Frame::TakeValue(const std::string&);
+template std::vector<Rect> Frame::TakeValue(const std::string&);
+template std::vector<char> Frame::TakeValue(const std::string&);
+template cv::Mat Frame::TakeValue(const std::string&);
+template std::vector<FaceLandmark> Frame::TakeValue(const std::string&);
+template std::vector<std::vector<float>> Frame::TakeValue(const std::string&);
+template std::vector<float> Frame::TakeValue(const std::string&);
+template std::vector<std::vector<double>> Frame::TakeValue(const std::string&);
+template std::vector<Frame> Frame::TakeValue(const std::string&);
+template std::vector<int> Frame::TakeValue(const std::string&);
+template std::unordered_map<int, float> Frame::TakeValue(const std::string&);
+template std::unordered_map<int, bool> Frame::TakeValue(const std::string&);
+template std::unordered_map<unsigned long, int> Frame::TakeValue(
+    const std::string&);
@@ -17,11 +17,14 @@
 
 #include "common/types.h"
 
+#include <atomic>
 #include <unordered_map>
 #include <unordered_set>
 
 #include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/container/small_vector.hpp>
 #include <boost/serialization/access.hpp>
+#include <boost/serialization/split_member.hpp>
 #include <boost/serialization/unique_ptr.hpp>
 #include <boost/serialization/unordered_map.hpp>
 #include <boost/serialization/variant.hpp>
@@ -31,20 +34,38 @@
 #include <json/src/json.hpp>
 
 #include "common/context.h"
+#include "stream/field_key.h"
 
 // Forward declaration to break the cycle:
 //   frame.h -> flow_control_entrance.h -> operator.h -> stream.h -> frame.h
 class FlowControlEntrance;
 
+// A Frame is a set of named fields. Field values are immutable and shared
+// between copies of a Frame, so copying a Frame (e.g., when a Stream fans a
+// frame out to multiple readers) only copies a handle. A copy is made lazily,
+// one field at a time, when a Frame that shares its fields is modified.
+//
+// Fields are identified by interned FieldIds and stored in a small flat array,
+// which suits the 10-20 fields that a Frame usually carries better than a hash
+// map. Fields can be accessed by name or, faster, through a FieldKey.
+//
+// A Frame is not thread-safe, but copies of a Frame may be used and modified
+// by different threads at the same time. Whether a Frame may modify its field
+// map or a field value in place is decided by ownership flags that only the
+// Frame itself reads, never by reference counts, which another thread may be
+// about to decrement. Copying a Frame gives up the ownership of both the copy
+// and the original, so each of them detaches on its next modification.
 class Frame {
  public:
   Frame();
   Frame(const std::unique_ptr<Frame>& frame);
-  // Creates a new Frame object that is a copy of "frame".
+  // Creates a new Frame object that is a copy of "frame". The new Frame shares
+  // all of its field values with "frame".
   Frame(const Frame& frame);
   // Creates a new Frame object that contains the fields in "fields" copied from
   // "frame". If "fields" is empty, then all fields will be copied.
   Frame(const Frame& frame, std::unordered_set<std::string> fields);
+  Frame& operator=(const Frame& frame);
 
   void SetFlowControlEntrance(FlowControlEntrance* flow_control_entrance);
   FlowControlEntrance* GetFlowControlEntrance();
@@ -53,9 +74,49 @@ class Frame {
   void SetValue(std::string key, const T& val);
   template <typename T>
   T GetValue(std::string key) const;
+  // Same as above, but without looking up the field name.
+  template <typename T>
+  void SetValue(const FieldKey<T>& key,
+                const typename FieldKey<T>::value_type& val);
+  template <typename T>
+  T GetValue(const FieldKey<T>& key) const;
+  // Returns a reference to a field's value without copying it. The reference
+  // is valid until the field is set, deleted, or modified through this Frame.
+  template <typename T>
+  const T& GetRef(const std::string& key) const;
+  template <typename T>
+  const T& GetRef(const FieldKey<T>& key) const;
+  // Returns a reference through which a field's value can be modified in
+  // place. The value is copied first only if another Frame shares it.
+  template <typename T>
+  T& GetMutable(const std::string& key);
+  // Removes a field from the frame and returns its value. The value is moved
+  // out, rather than copied, if no other Frame shares it.
+  template <typename T>
+  T TakeValue(const std::string& key);
+  // A read-only view of raw bytes that are owned by a Frame field. It stays
+  // valid for as long as that field does.
+  struct ByteView {
+    const char* data;
+    size_t size;
+  };
+  // Returns the raw bytes of a std::vector<char> or continuous cv::Mat field
+  // without copying them. Cameras no longer store a second copy of the decoded
+  // image in "original_bytes", so if that field is not set this returns the
+  // pixel buffer of "original_image" instead. The same goes for Count(),
+  // GetValue<std::vector<char>>(), which copies the pixels, GetRawSizeBytes()
+  // and selecting fields when copying a Frame. GetRef(), GetMutable() and
+  // TakeValue() throw std::runtime_error for such an "original_bytes", since
+  // there is no std::vector<char> to refer to.
+  ByteView GetBytes(const std::string& key) const;
   // Deletes the specified key from the frame, if it exists, otherwise does
-  // nothing if the key does not exist.
+  // nothing if the key does not exist. Deleting "original_bytes" when it is
+  // served from "original_image" (see GetBytes()) does nothing either, so
+  // delete "original_image" to drop both.
   void Delete(std::string key);
+  void Delete(FieldId id);
+  // Deletes every field that is not in "ids".
+  void DeleteAllExcept(const std::unordered_set<FieldId>& ids);
   std::string ToString() const;
   nlohmann::json ToJson() const;
   nlohmann::json GetFieldJson(const std::string& field) const;
@@ -69,6 +130,7 @@ class Frame {
       std::unordered_map<int, float>, std::unordered_map<int, bool>,
       std::unordered_map<unsigned long, int>>;
   size_t Count(std::string key) const;
+  size_t Count(FieldId id) const;
   std::unordered_map<std::string, field_types> GetFields();
   void SetStopFrame(bool stop_frame);
   bool IsStopFrame() const;
@@ -78,21 +140,94 @@ class Frame {
       std::unordered_set<std::string> fields = {}) const;
 
   static const char* kFrameIdKey;
+  static const char* kOriginalBytesKey;
+  static const char* kOriginalImageKey;
+  static const FieldKey<unsigned long> kFrameIdField;
 
  private:
   friend class boost::serialization::access;
+  friend class FrameCodec;
 
   // If this is not null, then this frame owns a flow control token from the
   // specified FlowControlEntrance. The token should be released when this frame
   // leaves the pipeline or encounters a FlowControlExit operator.
   FlowControlEntrance* flow_control_entrance_ = nullptr;
 
+  // Field values are never modified in place while they are shared. Setting a
+  // field replaces its pointer instead. Values are always allocated non-const
+  // so that an unshared one may be modified or moved from.
+  typedef std::shared_ptr<const field_types> FieldPtr;
+  struct Field {
+    Field(FieldId id, FieldPtr value, bool owned = false)
+        : id(id), value(std::move(value)), owned(owned) {}
+
+    FieldId id;
+    FieldPtr value;
+    // Whether "value" was allocated by this Frame and has never been handed to
+    // another Frame, so that it may be modified in place. Only meaningful in a
+    // field map that the Frame owns.
+    bool owned;
+  };
+  // Frames rarely have more fields than this, so the map normally needs only
+  // a single allocation.
+  static constexpr size_t kInlineFields = 16;
+  typedef boost::container::small_vector<Field, kInlineFields> FieldMap;
+
+  // Returns the field map for modification, first making a private copy of it
+  // unless this Frame owns it. Only the map is copied, not the field values,
+  // which the copy does not own.
+  FieldMap& MutableFields();
+  // Returns the value of field "id", or nullptr if it is not set.
+  const FieldPtr* FindField(FieldId id) const;
+  // Same as above, but returns "original_image" for "original_bytes" if the
+  // latter is not set. Stores the id of the returned field in "found_id", if
+  // it is not null.
+  const FieldPtr* FindFieldOrAlias(FieldId id,
+                                   FieldId* found_id = nullptr) const;
+  void SetField(FieldId id, FieldPtr value);
+  template <typename T>
+  T GetValueById(FieldId id) const;
+  template <typename T>
+  const T& GetRefById(FieldId id) const;
+  // Returns the value of field "id" for modification, first making a private
+  // copy of it if it is shared with another Frame.
+  field_types& MutableField(FieldId id);
+
+  // The on-disk and on-wire format is the same plain map that older versions
+  // of Frame serialized, so archives remain compatible.
   template <class Archive>
-  void serialize(Archive& ar, const unsigned int) {
-    ar& frame_data_;
+  void save(Archive& ar, const unsigned int) const {
+    std::unordered_map<std::string, field_types> frame_data;
+    for (const auto& field : *frame_data_) {
+      frame_data.insert({FieldRegistry::GetName(field.id), *field.value});
+    }
+    ar& frame_data;
   }
 
-  std::unordered_map<std::string, field_types> frame_data_;
+  template <class Archive>
+  void load(Archive& ar, const unsigned int) {
+    std::unordered_map<std::string, field_types> frame_data;
+    ar& frame_data;
+    auto fields = std::make_shared<FieldMap>();
+    for (auto& p : frame_data) {
+      fields->emplace_back(FieldRegistry::GetId(p.first),
+                           std::make_shared<field_types>(std::move(p.second)),
+                           true);
+    }
+    frame_data_ = fields;
+    owns_fields_ = true;
+  }
+
+  BOOST_SERIALIZATION_SPLIT_MEMBER()
+
+  // Shared between copies of this Frame until one of them is modified. Must
+  // only be modified through MutableFields().
+  std::shared_ptr<FieldMap> frame_data_;
+  // Whether "frame_data_" was created by this Frame and has never been shared
+  // with another Frame. Copying clears it on the original as well, which is
+  // why it is mutable, and atomic so that a Frame may be copied by several
+  // threads at once.
+  mutable std::atomic<bool> owns_fields_;
 };
 
 #endif  // SAF_STREAM_FRAME_H_
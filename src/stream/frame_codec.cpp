@@ -0,0 +1,801 @@
+// Copyright 2018 The SAF Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "stream/frame_codec.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+#include <boost/iostreams/copy.hpp>
+#include <boost/iostreams/device/array.hpp>
+#include <boost/iostreams/device/back_inserter.hpp>
+#include <boost/iostreams/filter/gzip.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+#include <boost/mpl/for_each.hpp>
+#include <boost/type_traits/add_pointer.hpp>
+#include <opencv2/core/core.hpp>
+
+constexpr uint16_t FrameCodec::kVersion;
+constexpr size_t FrameCodec::kPayloadAlignment;
+
+constexpr char kMagic[4] = {'S', 'A', 'F', 'F'};
+// The most dimensions that an encoded cv::Mat may have.
+constexpr int kMaxMatDims = 8;
+// Deflate expands data by at most about 1032:1, so a compressed field that
+// claims to be larger than that, or than the hard limit, is corrupt. This
+// bounds what a single frame from the network can make the decoder allocate.
+constexpr uint64_t kMaxCompressionRatio = 1032;
+constexpr uint64_t kMaxDecompressedSize = 1ULL << 31;
+// The most levels of frames nested in frame fields that are decoded.
+constexpr int kMaxFrameNesting = 16;
+
+// The nesting level of the frame being decoded by this thread.
+static thread_local int decode_depth = 0;
+
+struct Header {
+  char magic[4];
+  uint16_t version;
+  uint16_t num_fields;
+  // Where the first payload may start.
+  uint32_t header_size;
+  uint32_t reserved;
+  uint64_t total_size;
+};
+static_assert(sizeof(Header) == 24, "Header must not contain padding");
+
+struct FieldEntry {
+  uint32_t name_offset;
+  uint16_t name_size;
+  // The index of the field's type in Frame::field_types.
+  uint8_t type;
+  uint8_t codec;
+  uint64_t offset;
+  uint64_t size;
+  // The size of the payload before the codec was applied.
+  uint64_t raw_size;
+};
+static_assert(sizeof(FieldEntry) == 32, "FieldEntry must not contain padding");
+
+struct MatHeader {
+  int32_t type;
+  int32_t dims;
+  int32_t sizes[kMaxMatDims];
+};
+
+static size_t Align(size_t offset, size_t alignment) {
+  return (offset + alignment - 1) / alignment * alignment;
+}
+
+// Times are stored as microseconds since the epoch, with the extremes of the
+// range reserved for Boost's special values.
+constexpr int64_t kNotATime = std::numeric_limits<int64_t>::min();
+constexpr int64_t kNegInfinity = std::numeric_limits<int64_t>::min() + 1;
+constexpr int64_t kPosInfinity = std::numeric_limits<int64_t>::max();
+
+static const boost::posix_time::ptime& Epoch() {
+  static const boost::posix_time::ptime epoch(
+      boost::gregorian::date(1970, 1, 1));
+  return epoch;
+}
+
+static int64_t EncodeDuration(const boost::posix_time::time_duration& d) {
+  if (d.is_not_a_date_time()) {
+    return kNotATime;
+  } else if (d.is_neg_infinity()) {
+    return kNegInfinity;
+  } else if (d.is_pos_infinity()) {
+    return kPosInfinity;
+  }
+  return d.total_microseconds();
+}
+
+static boost::posix_time::time_duration DecodeDuration(int64_t micros) {
+  if (micros == kNotATime) {
+    return boost::posix_time::time_duration(boost::date_time::not_a_date_time);
+  } else if (micros == kNegInfinity) {
+    return boost::posix_time::time_duration(boost::date_time::neg_infin);
+  } else if (micros == kPosInfinity) {
+    return boost::posix_time::time_duration(boost::date_time::pos_infin);
+  }
+  return boost::posix_time::microseconds(micros);
+}
+
+static int64_t EncodeTime(const boost::posix_time::ptime& t) {
+  if (t.is_not_a_date_time()) {
+    return kNotATime;
+  } else if (t.is_neg_infinity()) {
+    return kNegInfinity;
+  } else if (t.is_pos_infinity()) {
+    return kPosInfinity;
+  }
+  return EncodeDuration(t - Epoch());
+}
+
+static boost::posix_time::ptime DecodeTime(int64_t micros) {
+  if (micros == kNotATime) {
+    return boost::posix_time::ptime(boost::date_time::not_a_date_time);
+  } else if (micros == kNegInfinity) {
+    return boost::posix_time::ptime(boost::date_time::neg_infin);
+  } else if (micros == kPosInfinity) {
+    return boost::posix_time::ptime(boost::date_time::pos_infin);
+  }
+  return Epoch() + boost::posix_time::microseconds(micros);
+}
+
+// Lets a cv::Mat point into an encoded buffer while keeping that buffer alive,
+// in the same way that OpenCV's Python bindings wrap NumPy arrays.
+class BufferMatAllocator : public cv::MatAllocator {
+ public:
+  static const BufferMatAllocator& GetInstance() {
+    static BufferMatAllocator* allocator = new BufferMatAllocator();
+    return *allocator;
+  }
+
+  cv::Mat Wrap(int dims, const int* sizes, int type, const char* data,
+               const std::shared_ptr<const void>& owner) const {
+    cv::Mat mat(dims, sizes, type, (void*)data);
+    cv::UMatData* u = new cv::UMatData(this);
+    u->data = u->origdata = (uchar*)data;
+    u->size = mat.total() * mat.elemSize();
+    u->flags |= cv::UMatData::USER_ALLOCATED;
+    u->userdata = new std::shared_ptr<const void>(owner);
+    u->refcount = 1;
+    mat.u = u;
+    mat.allocator = const_cast<BufferMatAllocator*>(this);
+    return mat;
+  }
+
+  cv::UMatData* allocate(int, const int*, int, void*, size_t*, int,
+                         cv::UMatUsageFlags) const override {
+    // Mats that were wrapped by this allocator are never reallocated through
+    // it, since Mat::create() switches to the default allocator.
+    return nullptr;
+  }
+
+  bool allocate(cv::UMatData*, int, cv::UMatUsageFlags) const override {
+    return false;
+  }
+
+  void deallocate(cv::UMatData* u) const override {
+    if (u == nullptr) {
+      return;
+    }
+    delete static_cast<std::shared_ptr<const void>*>(u->userdata);
+    delete u;
+  }
+};
+
+// Payloads are produced by running the same code over one of two sinks: the
+// first only measures how large the payload will be, the second writes it.
+class SizeCounter {
+ public:
+  SizeCounter() : size_(0) {}
+  void Put(const void*, size_t size) { size_ += size; }
+  void Pad(size_t alignment) { size_ = Align(size_, alignment); }
+  size_t GetSize() const { return size_; }
+
+ private:
+  size_t size_;
+};
+
+class BufferWriter {
+ public:
+  explicit BufferWriter(char* data) : start_(data), pos_(data) {}
+  void Put(const void* data, size_t size) {
+    std::memcpy(pos_, data, size);
+    pos_ += size;
+  }
+  void Pad(size_t alignment) {
+    size_t padding = Align(GetSize(), alignment) - GetSize();
+    std::memset(pos_, 0, padding);
+    pos_ += padding;
+  }
+  size_t GetSize() const { return pos_ - start_; }
+  // Returns the next "size" bytes so that they can be filled in directly.
+  char* Reserve(size_t size) {
+    char* data = pos_;
+    pos_ += size;
+    return data;
+  }
+
+ private:
+  char* start_;
+  char* pos_;
+};
+
+class BufferReader {
+ public:
+  BufferReader(const char* data, size_t size,
+               const std::shared_ptr<const void>& owner)
+      : start_(data), pos_(data), end_(data + size), owner_(owner) {}
+  void Get(void* data, size_t size) {
+    std::memcpy(data, Skip(size), size);
+  }
+  void Pad(size_t alignment) {
+    Skip(Align(pos_ - start_, alignment) - (pos_ - start_));
+  }
+  // Returns the next "size" bytes and moves past them.
+  const char* Skip(size_t size) {
+    if (size > (size_t)(end_ - pos_)) {
+      throw std::runtime_error("Truncated frame payload");
+    }
+    const char* data = pos_;
+    pos_ += size;
+    return data;
+  }
+  uint64_t GetCount(size_t element_size) {
+    uint64_t count;
+    Get(&count, sizeof(count));
+    if (element_size > 0 && count > (size_t)(end_ - pos_) / element_size) {
+      throw std::runtime_error("Truncated frame payload");
+    }
+    return count;
+  }
+  const std::shared_ptr<const void>& GetOwner() const { return owner_; }
+
+ private:
+  const char* start_;
+  const char* pos_;
+  const char* end_;
+  const std::shared_ptr<const void>& owner_;
+};
+
+struct FieldLayout {
+  FieldId id;
+  const Frame::field_types* value;
+  FrameCodec::Codec codec;
+  // The compressed payload, if a codec is used.
+  std::string encoded;
+  size_t raw_size;
+  size_t size;
+  size_t offset;
+};
+
+struct FrameLayout {
+  std::vector<FieldLayout> fields;
+  size_t header_size;
+  size_t total_size;
+};
+
+static FrameLayout ComputeLayout(
+    const Frame& frame, const std::unordered_set<std::string>& fields,
+    const std::unordered_map<std::string, FrameCodec::Codec>& codecs);
+static void EncodeLayout(const FrameLayout& layout, char* data);
+
+// Writers for each field type. Numbers are written as is, containers as an
+// element count followed by their elements.
+
+template <typename Sink, typename T>
+static typename std::enable_if<std::is_arithmetic<T>::value>::type WriteValue(
+    Sink& sink, const T& value) {
+  sink.Put(&value, sizeof(value));
+}
+
+template <typename Sink>
+static void WriteCount(Sink& sink, size_t count) {
+  uint64_t count_64 = count;
+  sink.Put(&count_64, sizeof(count_64));
+}
+
+template <typename Sink>
+static void WriteValue(Sink& sink, const std::string& value) {
+  WriteCount(sink, value.size());
+  sink.Put(value.data(), value.size());
+}
+
+template <typename Sink>
+static void WriteValue(Sink& sink, const boost::posix_time::ptime& value) {
+  WriteValue(sink, EncodeTime(value));
+}
+
+template <typename Sink>
+static void WriteValue(Sink& sink,
+                       const boost::posix_time::time_duration& value) {
+  WriteValue(sink, EncodeDuration(value));
+}
+
+template <typename Sink>
+static void WriteValue(Sink& sink, const Rect& value) {
+  int32_t coords[] = {value.px, value.py, value.width, value.height};
+  sink.Put(coords, sizeof(coords));
+}
+
+template <typename Sink, typename T>
+static void WriteValue(Sink& sink, const std::vector<T>& value);
+
+template <typename Sink>
+static void WriteValue(Sink& sink, const FaceLandmark& value) {
+  WriteValue(sink, value.x);
+  WriteValue(sink, value.y);
+}
+
+template <typename Sink, typename K, typename V>
+static void WriteValue(Sink& sink, const std::unordered_map<K, V>& value) {
+  WriteCount(sink, value.size());
+  for (const auto& p : value) {
+    WriteValue(sink, p.first);
+    WriteValue(sink, p.second);
+  }
+}
+
+// The pixels follow a MatHeader at the next aligned offset, so that decoded
+// Mats can point straight at them.
+template <typename Sink>
+static void WriteValue(Sink& sink, const cv::Mat& value) {
+  MatHeader header;
+  std::memset(&header, 0, sizeof(header));
+  header.type = value.type();
+  header.dims = value.empty() ? 0 : value.dims;
+  if (header.dims > kMaxMatDims) {
+    std::ostringstream msg;
+    msg << "Cannot encode a cv::Mat with " << header.dims << " dimensions";
+    throw std::invalid_argument(msg.str());
+  }
+  for (int i = 0; i < header.dims; ++i) {
+    header.sizes[i] = value.size[i];
+  }
+  sink.Put(&header, sizeof(header));
+  sink.Pad(FrameCodec::kPayloadAlignment);
+  if (header.dims == 0) {
+    return;
+  }
+
+  if (value.isContinuous()) {
+    sink.Put(value.data, value.total() * value.elemSize());
+  } else if (value.dims == 2) {
+    for (int row = 0; row < value.rows; ++row) {
+      sink.Put(value.ptr(row), value.cols * value.elemSize());
+    }
+  } else {
+    cv::Mat continuous = value.clone();
+    sink.Put(continuous.data, continuous.total() * continuous.elemSize());
+  }
+}
+
+// Nested frames are encoded in full at the next aligned offset.
+static void WriteValue(SizeCounter& sink, const Frame& value) {
+  FrameLayout layout = ComputeLayout(value, {}, {});
+  WriteCount(sink, layout.total_size);
+  sink.Pad(FrameCodec::kPayloadAlignment);
+  sink.Put(nullptr, layout.total_size);
+}
+
+static void WriteValue(BufferWriter& sink, const Frame& value) {
+  FrameLayout layout = ComputeLayout(value, {}, {});
+  WriteCount(sink, layout.total_size);
+  sink.Pad(FrameCodec::kPayloadAlignment);
+  EncodeLayout(layout, sink.Reserve(layout.total_size));
+}
+
+template <typename Sink, typename T>
+static void WriteValue(Sink& sink, const std::vector<T>& value) {
+  WriteCount(sink, value.size());
+  // Plain numbers are copied as one block.
+  if (std::is_arithmetic<T>::value && !std::is_same<T, bool>::value) {
+    sink.Put(value.data(), value.size() * sizeof(T));
+  } else {
+    for (const auto& element : value) {
+      WriteValue(sink, element);
+    }
+  }
+}
+
+template <typename Sink>
+class PayloadWriter : public boost::static_visitor<> {
+ public:
+  explicit PayloadWriter(Sink& sink) : sink_(sink) {}
+  template <typename T>
+  void operator()(const T& value) const {
+    WriteValue(sink_, value);
+  }
+
+ private:
+  Sink& sink_;
+};
+
+// Readers for each field type, mirroring the writers above.
+
+template <typename T>
+static typename std::enable_if<std::is_arithmetic<T>::value>::type ReadValue(
+    BufferReader& reader, T* value) {
+  reader.Get(value, sizeof(*value));
+}
+
+static void ReadValue(BufferReader& reader, std::string* value) {
+  uint64_t size = reader.GetCount(1);
+  const char* data = reader.Skip(size);
+  value->assign(data, size);
+}
+
+static void ReadValue(BufferReader& reader, boost::posix_time::ptime* value) {
+  int64_t micros;
+  ReadValue(reader, &micros);
+  *value = DecodeTime(micros);
+}
+
+static void ReadValue(BufferReader& reader,
+                      boost::posix_time::time_duration* value) {
+  int64_t micros;
+  ReadValue(reader, &micros);
+  *value = DecodeDuration(micros);
+}
+
+static void ReadValue(BufferReader& reader, Rect* value) {
+  int32_t coords[4];
+  reader.Get(coords, sizeof(coords));
+  *value = Rect(coords[0], coords[1], coords[2], coords[3]);
+}
+
+template <typename T>
+static void ReadValue(BufferReader& reader, std::vector<T>* value);
+
+static void ReadValue(BufferReader& reader, FaceLandmark* value) {
+  ReadValue(reader, &value->x);
+  ReadValue(reader, &value->y);
+}
+
+template <typename K, typename V>
+static void ReadValue(BufferReader& reader, std::unordered_map<K, V>* value) {
+  uint64_t count = reader.GetCount(1);
+  value->clear();
+  value->reserve(count);
+  for (uint64_t i = 0; i < count; ++i) {
+    K key;
+    V mapped;
+    ReadValue(reader, &key);
+    ReadValue(reader, &mapped);
+    value->emplace(key, mapped);
+  }
+}
+
+static void ReadValue(BufferReader& reader, cv::Mat* value) {
+  MatHeader header;
+  reader.Get(&header, sizeof(header));
+  reader.Pad(FrameCodec::kPayloadAlignment);
+  if (header.dims == 0) {
+    *value = cv::Mat();
+    return;
+  }
+  if (header.dims < 0 || header.dims > kMaxMatDims) {
+    throw std::runtime_error("Invalid cv::Mat dimensions");
+  }
+
+  size_t size = CV_ELEM_SIZE(header.type);
+  for (int i = 0; i < header.dims; ++i) {
+    // A size that overflows would pass the bounds check in Skip() below, while
+    // the Mat would still be wrapped with the real dimensions.
+    if (header.sizes[i] < 0 ||
+        (header.sizes[i] > 0 &&
+         size > std::numeric_limits<size_t>::max() / header.sizes[i])) {
+      throw std::runtime_error("Invalid cv::Mat size");
+    }
+    size *= header.sizes[i];
+  }
+  const char* data = reader.Skip(size);
+  if (reader.GetOwner() != nullptr) {
+    *value = BufferMatAllocator::GetInstance().Wrap(
+        header.dims, header.sizes, header.type, data, reader.GetOwner());
+  } else {
+    *value =
+        cv::Mat(header.dims, header.sizes, header.type, (void*)data).clone();
+  }
+}
+
+static void ReadValue(BufferReader& reader, Frame* value) {
+  uint64_t size = reader.GetCount(1);
+  reader.Pad(FrameCodec::kPayloadAlignment);
+  const char* data = reader.Skip(size);
+  *value = *FrameCodec::Decode(data, size, reader.GetOwner());
+}
+
+template <typename T>
+static void ReadValue(BufferReader& reader, std::vector<T>* value) {
+  if (std::is_arithmetic<T>::value && !std::is_same<T, bool>::value) {
+    uint64_t count = reader.GetCount(sizeof(T));
+    value->resize(count);
+    reader.Get(value->data(), count * sizeof(T));
+  } else {
+    uint64_t count = reader.GetCount(1);
+    value->clear();
+    value->reserve(count);
+    for (uint64_t i = 0; i < count; ++i) {
+      T element;
+      ReadValue(reader, &element);
+      value->push_back(std::move(element));
+    }
+  }
+}
+
+// Decodes the payload of the field type with index "type" in
+// Frame::field_types.
+class PayloadReader {
+ public:
+  PayloadReader(int type, BufferReader& reader, Frame::field_types* value,
+                bool* found)
+      : type_(type), index_(0), reader_(reader), value_(value), found_(found) {}
+
+  template <typename T>
+  void operator()(T*) {
+    if (index_++ == type_) {
+      T value;
+      ReadValue(reader_, &value);
+      *value_ = std::move(value);
+      *found_ = true;
+    }
+  }
+
+ private:
+  int type_;
+  int index_;
+  BufferReader& reader_;
+  Frame::field_types* value_;
+  bool* found_;
+};
+
+static std::string Compress(const std::string& raw) {
+  std::string compressed;
+  boost::iostreams::filtering_ostream compressor;
+  compressor.push(boost::iostreams::gzip_compressor());
+  compressor.push(boost::iostreams::back_inserter(compressed));
+  compressor.write(raw.data(), raw.size());
+  boost::iostreams::close(compressor);
+  return compressed;
+}
+
+static std::shared_ptr<std::string> Decompress(const char* data, size_t size,
+                                               uint64_t raw_size) {
+  if (raw_size > kMaxDecompressedSize ||
+      raw_size > (uint64_t)size * kMaxCompressionRatio) {
+    throw std::runtime_error("Corrupt compressed field size");
+  }
+  auto raw = std::make_shared<std::string>(raw_size, '\0');
+  boost::iostreams::filtering_istream decompressor;
+  decompressor.push(boost::iostreams::gzip_decompressor());
+  decompressor.push(boost::iostreams::array_source(data, size));
+  // Inflate no more than "raw_size" bytes, so that a payload that expands to
+  // more is rejected without being decompressed in full.
+  decompressor.read(&(*raw)[0], raw_size);
+  if ((uint64_t)decompressor.gcount() != raw_size ||
+      decompressor.peek() != std::char_traits<char>::eof()) {
+    throw std::runtime_error("Corrupt compressed field");
+  }
+  return raw;
+}
+
+static FrameLayout ComputeLayout(
+    const Frame& frame, const std::unordered_set<std::string>& fields,
+    const std::unordered_map<std::string, FrameCodec::Codec>& codecs) {
+  FrameLayout layout;
+  size_t names_size = 0;
+  FrameCodec::FieldList frame_fields = FrameCodec::GetFields(frame);
+  // Selecting "original_bytes" selects "original_image" if the bytes are not
+  // stored separately, since they are served from the image (see
+  // Frame::GetBytes()). The image then gets the codec of the bytes.
+  FieldId bytes_id = FieldRegistry::GetId(Frame::kOriginalBytesKey);
+  bool image_as_bytes =
+      fields.find(Frame::kOriginalBytesKey) != fields.end() &&
+      std::none_of(frame_fields.begin(), frame_fields.end(),
+                   [bytes_id](const FrameCodec::FieldList::value_type& entry) {
+                     return entry.first == bytes_id;
+                   });
+  for (const auto& entry : frame_fields) {
+    const std::string& name = FieldRegistry::GetName(entry.first);
+    bool is_image_as_bytes = image_as_bytes && name == Frame::kOriginalImageKey;
+    if (!fields.empty() && fields.find(name) == fields.end() &&
+        !is_image_as_bytes) {
+      continue;
+    }
+
+    FieldLayout field;
+    field.id = entry.first;
+    field.value = entry.second;
+    auto codec_it = codecs.find(name);
+    if (codec_it == codecs.end() && is_image_as_bytes) {
+      codec_it = codecs.find(Frame::kOriginalBytesKey);
+    }
+    field.codec = codec_it == codecs.end() ? FrameCodec::Codec::NONE
+                                           : codec_it->second;
+    SizeCounter counter;
+    boost::apply_visitor(PayloadWriter<SizeCounter>(counter), *field.value);
+    field.raw_size = counter.GetSize();
+    field.size = field.raw_size;
+    if (field.codec == FrameCodec::Codec::GZIP) {
+      std::string raw(field.raw_size, '\0');
+      BufferWriter writer(&raw[0]);
+      boost::apply_visitor(PayloadWriter<BufferWriter>(writer), *field.value);
+      field.encoded = Compress(raw);
+      field.size = field.encoded.size();
+    }
+    names_size += name.size();
+    layout.fields.push_back(std::move(field));
+  }
+  if (layout.fields.size() > std::numeric_limits<uint16_t>::max()) {
+    throw std::invalid_argument("Too many fields to encode");
+  }
+
+  layout.header_size =
+      Align(sizeof(Header) + layout.fields.size() * sizeof(FieldEntry) +
+                names_size,
+            FrameCodec::kPayloadAlignment);
+  size_t offset = layout.header_size;
+  for (auto& field : layout.fields) {
+    field.offset = offset;
+    offset = Align(offset + field.size, FrameCodec::kPayloadAlignment);
+  }
+  layout.total_size = offset;
+  return layout;
+}
+
+static void EncodeLayout(const FrameLayout& layout, char* data) {
+  Header header;
+  std::memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version = FrameCodec::kVersion;
+  header.num_fields = (uint16_t)layout.fields.size();
+  header.header_size = (uint32_t)layout.header_size;
+  header.reserved = 0;
+  header.total_size = layout.total_size;
+  std::memcpy(data, &header, sizeof(header));
+
+  size_t entry_offset = sizeof(Header);
+  size_t name_offset =
+      sizeof(Header) + layout.fields.size() * sizeof(FieldEntry);
+  for (const auto& field : layout.fields) {
+    const std::string& name = FieldRegistry::GetName(field.id);
+    FieldEntry entry;
+    entry.name_offset = (uint32_t)name_offset;
+    entry.name_size = (uint16_t)name.size();
+    entry.type = (uint8_t)field.value->which();
+    entry.codec = (uint8_t)field.codec;
+    entry.offset = field.offset;
+    entry.size = field.size;
+    entry.raw_size = field.raw_size;
+    std::memcpy(data + entry_offset, &entry, sizeof(entry));
+    std::memcpy(data + name_offset, name.data(), name.size());
+    entry_offset += sizeof(entry);
+    name_offset += name.size();
+  }
+
+  size_t end = name_offset;
+  for (const auto& field : layout.fields) {
+    std::memset(data + end, 0, field.offset - end);
+    if (field.codec == FrameCodec::Codec::NONE) {
+      BufferWriter writer(data + field.offset);
+      boost::apply_visitor(PayloadWriter<BufferWriter>(writer), *field.value);
+    } else {
+      std::memcpy(data + field.offset, field.encoded.data(), field.size);
+    }
+    end = field.offset + field.size;
+  }
+  std::memset(data + end, 0, layout.total_size - end);
+}
+
+size_t FrameCodec::Encode(
+    const Frame& frame, const BufferAllocator& allocate,
+    const std::unordered_set<std::string>& fields,
+    const std::unordered_map<std::string, Codec>& codecs) {
+  FrameLayout layout = ComputeLayout(frame, fields, codecs);
+  EncodeLayout(layout, allocate(layout.total_size));
+  return layout.total_size;
+}
+
+std::string FrameCodec::Encode(
+    const Frame& frame, const std::unordered_set<std::string>& fields,
+    const std::unordered_map<std::string, Codec>& codecs) {
+  std::string encoded;
+  Encode(frame,
+         [&encoded](size_t size) {
+           encoded.resize(size);
+           return &encoded[0];
+         },
+         fields, codecs);
+  return encoded;
+}
+
+bool FrameCodec::IsEncodedFrame(const char* data, size_t size) {
+  return size >= sizeof(Header) &&
+         std::memcmp(data, kMagic, sizeof(kMagic)) == 0;
+}
+
+std::unique_ptr<Frame> FrameCodec::Decode(const char* data, size_t size,
+                                          std::shared_ptr<const void> owner) {
+  if (!IsEncodedFrame(data, size)) {
+    throw std::runtime_error("Not an encoded frame");
+  }
+  Header header;
+  std::memcpy(&header, data, sizeof(header));
+  if (header.version > kVersion) {
+    std::ostringstream msg;
+    msg << "Unsupported frame format version: " << header.version;
+    throw std::runtime_error(msg.str());
+  }
+  if (header.total_size > size || header.header_size > header.total_size ||
+      sizeof(Header) + header.num_fields * sizeof(FieldEntry) >
+          header.header_size) {
+    throw std::runtime_error("Truncated frame");
+  }
+  // Frames nested in frame fields are decoded recursively.
+  if (decode_depth >= kMaxFrameNesting) {
+    throw std::runtime_error("Frames nested too deeply");
+  }
+  ++decode_depth;
+  struct DepthGuard {
+    ~DepthGuard() { --decode_depth; }
+  } depth_guard;
+
+  auto frame = std::make_unique<Frame>();
+  auto& frame_data = frame->MutableFields();
+  frame_data.reserve(header.num_fields);
+  for (size_t i = 0; i < header.num_fields; ++i) {
+    FieldEntry entry;
+    std::memcpy(&entry, data + sizeof(Header) + i * sizeof(FieldEntry),
+                sizeof(entry));
+    // Frames come from the network, so check the bounds without overflowing.
+    if ((uint64_t)entry.name_offset + entry.name_size > header.header_size ||
+        entry.offset < header.header_size ||
+        entry.offset > header.total_size ||
+        entry.size > header.total_size - entry.offset) {
+      throw std::runtime_error("Corrupt frame field table");
+    }
+    std::string name(data + entry.name_offset, entry.name_size);
+
+    const char* payload = data + entry.offset;
+    size_t payload_size = entry.size;
+    std::shared_ptr<const void> payload_owner = owner;
+    if (entry.codec == (uint8_t)Codec::GZIP) {
+      auto raw = Decompress(payload, payload_size, entry.raw_size);
+      payload = raw->data();
+      payload_size = raw->size();
+      payload_owner = raw;
+    } else if (entry.codec != (uint8_t)Codec::NONE) {
+      std::ostringstream msg;
+      msg << "Unknown codec " << (int)entry.codec << " for field \"" << name
+          << "\"";
+      throw std::runtime_error(msg.str());
+    }
+
+    BufferReader reader(payload, payload_size, payload_owner);
+    auto value = std::make_shared<Frame::field_types>();
+    bool found = false;
+    boost::mpl::for_each<Frame::field_types::types,
+                         boost::add_pointer<boost::mpl::_1>>(
+        PayloadReader(entry.type, reader, value.get(), &found));
+    if (!found) {
+      std::ostringstream msg;
+      msg << "Unknown type " << (int)entry.type << " for field \"" << name
+          << "\"";
+      throw std::runtime_error(msg.str());
+    }
+    frame_data.emplace_back(FieldRegistry::GetId(name), std::move(value),
+                            true);
+  }
+  return frame;
+}
+
+std::unique_ptr<Frame> FrameCodec::Decode(std::shared_ptr<std::string> buffer) {
+  return Decode(buffer->data(), buffer->size(), buffer);
+}
+
+FrameCodec::FieldList FrameCodec::GetFields(const Frame& frame) {
+  FieldList fields;
+  fields.reserve(frame.frame_data_->size());
+  for (const auto& field : *frame.frame_data_) {
+    fields.emplace_back(field.id, field.value.get());
+  }
+  return fields;
+}
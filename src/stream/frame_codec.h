@@ -0,0 +1,90 @@
+// Copyright 2018 The SAF Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SAF_STREAM_FRAME_CODEC_H_
+#define SAF_STREAM_FRAME_CODEC_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "stream/frame.h"
+
+// FrameCodec converts Frames to and from SAF's native binary format, which
+// replaces Boost archives wherever frames leave the process.
+//
+// An encoded frame is a fixed header, a table with one entry per field (name,
+// type, codec, and payload location), the field names, and then one payload
+// per field. Each payload starts on a kPayloadAlignment-byte boundary. cv::Mat
+// pixels and vectors of plain numbers are stored as raw arrays, so encoding is
+// little more than a memcpy of each field, and decoding can make cv::Mats that
+// point straight into the encoded buffer. Individual fields can optionally be
+// compressed. All integers are stored in host byte order.
+//
+// Field types are identified by their index in Frame::field_types, so new
+// types must only ever be appended to that variant.
+class FrameCodec {
+ public:
+  enum class Codec : uint8_t { NONE = 0, GZIP = 1 };
+
+  // Returns a buffer of at least "size" bytes for the encoded frame.
+  typedef std::function<char*(size_t size)> BufferAllocator;
+
+  static constexpr uint16_t kVersion = 1;
+  static constexpr size_t kPayloadAlignment = 64;
+
+  // Encodes "frame" into a buffer obtained from "allocate", which is called
+  // exactly once, and returns the encoded size. Only the fields in "fields"
+  // are encoded, or all fields if it is empty. Fields named in "codecs" are
+  // compressed with the given codec. Throws std::invalid_argument if the frame
+  // cannot be encoded, e.g., because a cv::Mat has too many dimensions.
+  static size_t Encode(
+      const Frame& frame, const BufferAllocator& allocate,
+      const std::unordered_set<std::string>& fields = {},
+      const std::unordered_map<std::string, Codec>& codecs = {});
+  static std::string Encode(
+      const Frame& frame, const std::unordered_set<std::string>& fields = {},
+      const std::unordered_map<std::string, Codec>& codecs = {});
+
+  // Returns whether the "size" bytes at "data" start with a frame in this
+  // format, as opposed to, e.g., a Boost archive.
+  static bool IsEncodedFrame(const char* data, size_t size);
+
+  // Decodes the frame in the "size" bytes at "data". If "owner" is set, then
+  // it must keep "data" alive, and uncompressed cv::Mat fields will point into
+  // "data" instead of being copied. Such Mats may be modified in place by
+  // downstream operators, so the buffer must not be used for anything else.
+  // Throws std::runtime_error if the data is not a valid encoded frame, e.g.,
+  // if a compressed field expands past its recorded size or frames are nested
+  // too deeply.
+  static std::unique_ptr<Frame> Decode(
+      const char* data, size_t size,
+      std::shared_ptr<const void> owner = nullptr);
+  // Decodes "buffer" without copying its cv::Mat fields.
+  static std::unique_ptr<Frame> Decode(std::shared_ptr<std::string> buffer);
+
+  typedef std::vector<std::pair<FieldId, const Frame::field_types*>> FieldList;
+
+  // Returns the fields of "frame" in the order in which they were added,
+  // without copying their values.
+  static FieldList GetFields(const Frame& frame);
+};
+
+#endif  // SAF_STREAM_FRAME_CODEC_H_
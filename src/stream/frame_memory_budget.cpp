@@ -0,0 +1,72 @@
+// Copyright 2018 The SAF Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "stream/frame_memory_budget.h"
+
+#include "utils/metrics.h"
+
+FrameMemoryBudget& FrameMemoryBudget::GetInstance() {
+  static FrameMemoryBudget* budget = [] {
+    auto budget = new FrameMemoryBudget();
+    MetricsRegistry& registry = MetricsRegistry::GetInstance();
+    registry.AddCallback(
+        "saf_frame_memory_used_bytes",
+        "Bytes of queued frame data charged to the frame memory budget.",
+        METRIC_GAUGE, {}, [budget] { return (double)budget->GetUsedBytes(); });
+    registry.AddCallback(
+        "saf_frame_memory_limit_bytes",
+        "Limit of the frame memory budget, 0 if there is none.", METRIC_GAUGE,
+        {}, [budget] { return (double)budget->GetLimitBytes(); });
+    return budget;
+  }();
+  return *budget;
+}
+
+FrameMemoryBudget::FrameMemoryBudget() : limit_bytes_(0), used_bytes_(0) {}
+
+void FrameMemoryBudget::SetLimitBytes(size_t limit_bytes) {
+  limit_bytes_ = limit_bytes;
+}
+
+size_t FrameMemoryBudget::GetLimitBytes() const { return limit_bytes_; }
+
+bool FrameMemoryBudget::IsLimited() const {
+  return limit_bytes_.load(std::memory_order_relaxed) > 0;
+}
+
+size_t FrameMemoryBudget::GetUsedBytes() const { return used_bytes_; }
+
+bool FrameMemoryBudget::HasRoom(size_t num_bytes) const {
+  size_t limit_bytes = limit_bytes_.load(std::memory_order_relaxed);
+  return limit_bytes == 0 ||
+         used_bytes_.load(std::memory_order_relaxed) + num_bytes <=
+             limit_bytes;
+}
+
+bool FrameMemoryBudget::TryCharge(size_t num_bytes, bool force) {
+  size_t limit_bytes = limit_bytes_.load(std::memory_order_relaxed);
+  size_t used_bytes = used_bytes_.load(std::memory_order_relaxed);
+  do {
+    if (!force && limit_bytes > 0 && used_bytes + num_bytes > limit_bytes) {
+      return false;
+    }
+  } while (!used_bytes_.compare_exchange_weak(used_bytes,
+                                              used_bytes + num_bytes,
+                                              std::memory_order_relaxed));
+  return true;
+}
+
+void FrameMemoryBudget::Release(size_t num_bytes) {
+  used_bytes_.fetch_sub(num_bytes, std::memory_order_relaxed);
+}
@@ -0,0 +1,63 @@
+// Copyright 2018 The SAF Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SAF_STREAM_FRAME_MEMORY_BUDGET_H_
+#define SAF_STREAM_FRAME_MEMORY_BUDGET_H_
+
+#include <atomic>
+#include <cstddef>
+
+// FrameMemoryBudget caps the bytes of frame data (see Frame::GetRawSizeBytes())
+// that wait in the queues of all of the StreamReaders of the process, so that
+// a burst of large frames cannot exhaust memory. A StreamReader charges a
+// frame to the budget when the frame is queued and returns the charge when the
+// frame is popped or dropped. A frame that does not fit is handled like one
+// that arrives at a full queue, i.e., according to the reader's
+// OverflowPolicy. To keep the pipeline moving, a frame always fits into an
+// empty queue, so usage may exceed the limit by up to one frame per queue.
+//
+// Frames that several readers share are charged to each of them, so the
+// budget errs on the side of caution.
+class FrameMemoryBudget {
+ public:
+  // Returns the process-wide budget. It is never destroyed.
+  static FrameMemoryBudget& GetInstance();
+
+  FrameMemoryBudget();
+  FrameMemoryBudget(const FrameMemoryBudget&) = delete;
+  FrameMemoryBudget& operator=(const FrameMemoryBudget&) = delete;
+
+  // Sets the limit, in bytes. 0, the default, means no limit, in which case
+  // nothing is charged. May be called while frames flow. Frames that are
+  // already queued when the limit is set are not charged.
+  void SetLimitBytes(size_t limit_bytes);
+  size_t GetLimitBytes() const;
+  bool IsLimited() const;
+  // The bytes that are currently charged.
+  size_t GetUsedBytes() const;
+
+  // Returns whether "num_bytes" more would fit within the limit.
+  bool HasRoom(size_t num_bytes) const;
+  // Charges "num_bytes" if they fit within the limit, or regardless if
+  // "force" is true. Returns whether they were charged.
+  bool TryCharge(size_t num_bytes, bool force = false);
+  // Returns a charge that TryCharge() made.
+  void Release(size_t num_bytes);
+
+ private:
+  std::atomic<size_t> limit_bytes_;
+  std::atomic<size_t> used_bytes_;
+};
+
+#endif  // SAF_STREAM_FRAME_MEMORY_BUDGET_H_
@@ -0,0 +1,130 @@
+// Copyright 2018 The SAF Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SAF_STREAM_RING_BUFFER_H_
+#define SAF_STREAM_RING_BUFFER_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+
+// A bounded, lock-free FIFO queue based on Dmitry Vyukov's bounded MPMC queue.
+// Each cell carries a sequence number that tells producers and consumers
+// whether the cell is free or full for their current position, so neither side
+// ever takes a lock. With a single producer and a single consumer (the common
+// case for a StreamReader) every operation is one uncontended CAS plus one
+// release store.
+//
+// The queue never blocks. Callers that want to wait for space or data should
+// pair it with an EventCount.
+template <typename T>
+class RingBuffer {
+ public:
+  explicit RingBuffer(size_t capacity)
+      : capacity_(capacity),
+        cells_(new Cell[capacity]),
+        enqueue_pos_(0),
+        dequeue_pos_(0) {
+    if (capacity == 0) {
+      throw std::invalid_argument("RingBuffer capacity must be positive!");
+    }
+    for (size_t i = 0; i < capacity_; ++i) {
+      cells_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+  RingBuffer(const RingBuffer&) = delete;
+  RingBuffer& operator=(const RingBuffer&) = delete;
+
+  // Moves "item" into the queue. Returns false, leaving "item" untouched, if
+  // the queue is full.
+  bool TryPush(T& item) {
+    Cell* cell;
+    size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+    while (true) {
+      cell = &cells_[pos % capacity_];
+      size_t seq = cell->sequence.load(std::memory_order_acquire);
+      intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+      if (diff == 0) {
+        if (enqueue_pos_.compare_exchange_weak(pos, pos + 1,
+                                               std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (diff < 0) {
+        // The cell still holds an item from the previous lap.
+        return false;
+      } else {
+        pos = enqueue_pos_.load(std::memory_order_relaxed);
+      }
+    }
+    cell->data = std::move(item);
+    cell->sequence.store(pos + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Moves the oldest item into "item". Returns false if the queue is empty.
+  bool TryPop(T& item) {
+    Cell* cell;
+    size_t pos = dequeue_pos_.load(std::memory_order_relaxed);
+    while (true) {
+      cell = &cells_[pos % capacity_];
+      size_t seq = cell->sequence.load(std::memory_order_acquire);
+      intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+      if (diff == 0) {
+        if (dequeue_pos_.compare_exchange_weak(pos, pos + 1,
+                                               std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (diff < 0) {
+        // The producer has not filled this cell yet.
+        return false;
+      } else {
+        pos = dequeue_pos_.load(std::memory_order_relaxed);
+      }
+    }
+    item = std::move(cell->data);
+    cell->sequence.store(pos + capacity_, std::memory_order_release);
+    return true;
+  }
+
+  // Returns the number of queued items. This is only a snapshot when other
+  // threads are pushing or popping concurrently.
+  size_t Size() const {
+    size_t dequeue_pos = dequeue_pos_.load(std::memory_order_acquire);
+    size_t enqueue_pos = enqueue_pos_.load(std::memory_order_acquire);
+    return enqueue_pos > dequeue_pos ? enqueue_pos - dequeue_pos : 0;
+  }
+
+  bool Empty() const { return Size() == 0; }
+
+  size_t Capacity() const { return capacity_; }
+
+ private:
+  struct Cell {
+    std::atomic<size_t> sequence;
+    T data;
+  };
+
+  // Keeps the producer and consumer indices on separate cache lines.
+  static constexpr size_t kCacheLineSize = 64;
+
+  const size_t capacity_;
+  std::unique_ptr<Cell[]> cells_;
+  alignas(kCacheLineSize) std::atomic<size_t> enqueue_pos_;
+  alignas(kCacheLineSize) std::atomic<size_t> dequeue_pos_;
+};
+
+#endif  // SAF_STREAM_RING_BUFFER_H_
@@ -14,164 +14,526 @@
 
 #include "stream/stream.h"
 
+#include <algorithm>
 #include <chrono>
+#include <sstream>
+#include <stdexcept>
 
 #include "operator/flow_control/flow_control_entrance.h"
 
+OverflowPolicy GetOverflowPolicyByString(const std::string& str) {
+  if (str == "block") {
+    return OverflowPolicy::BLOCK;
+  } else if (str == "drop_newest") {
+    return OverflowPolicy::DROP_NEWEST;
+  } else if (str == "drop_oldest") {
+    return OverflowPolicy::DROP_OLDEST;
+  } else if (str == "latest_only") {
+    return OverflowPolicy::LATEST_ONLY;
+  } else {
+    std::ostringstream msg;
+    msg << "Unknown overflow policy: \"" << str << "\"";
+    throw std::invalid_argument(msg.str());
+  }
+}
+
+std::string GetStringForOverflowPolicy(OverflowPolicy policy) {
+  switch (policy) {
+    case OverflowPolicy::BLOCK:
+      return "block";
+    case OverflowPolicy::DROP_NEWEST:
+      return "drop_newest";
+    case OverflowPolicy::DROP_OLDEST:
+      return "drop_oldest";
+    case OverflowPolicy::LATEST_ONLY:
+      return "latest_only";
+  }
+
+  return "";
+}
+
 /////// Stream
 
-Stream::Stream(std::string name) : name_(name) {}
+Stream::Stream(std::string name)
+    : name_(name),
+      readers_(std::make_shared<const ReaderList>()),
+      pushed_from_executor_(false) {}
 
 constexpr unsigned int ms_per_sec = 1000;
 
-StreamReader* Stream::Subscribe(size_t max_buffer_size) {
+StreamReader* Stream::Subscribe(size_t max_buffer_size,
+                                OverflowPolicy policy) {
   std::lock_guard<std::mutex> guard(stream_lock_);
-  auto reader = std::make_shared<StreamReader>(this, max_buffer_size);
-  readers_.push_back(reader);
+  auto reader = std::make_shared<StreamReader>(this, max_buffer_size, policy);
+  auto readers = std::make_shared<ReaderList>(*std::atomic_load(&readers_));
+  readers->push_back(reader);
+  std::atomic_store(&readers_, std::shared_ptr<const ReaderList>(readers));
   return reader.get();
 }
 
 void Stream::UnSubscribe(StreamReader* reader) {
   std::lock_guard<std::mutex> guard(stream_lock_);
-  readers_.erase(std::remove_if(readers_.begin(), readers_.end(),
+  auto readers = std::make_shared<ReaderList>(*std::atomic_load(&readers_));
+  readers->erase(std::remove_if(readers->begin(), readers->end(),
                                 [reader](std::shared_ptr<StreamReader> sr) {
                                   return sr.get() == reader;
-                                }));
+                                }),
+                 readers->end());
+  std::atomic_store(&readers_, std::shared_ptr<const ReaderList>(readers));
 }
 
-void Stream::PushFrame(std::unique_ptr<Frame> frame, bool block) {
-  // Make a copy of readers_ so that we can block without holding stream_lock_.
-  std::vector<std::shared_ptr<StreamReader>> readers;
-  {
-    std::lock_guard<std::mutex> guard(stream_lock_);
-    readers = readers_;
+bool Stream::HasReaders() const {
+  return !std::atomic_load(&readers_)->empty();
+}
+
+bool Stream::HasBlockingReaders() const {
+  for (const auto& reader : *std::atomic_load(&readers_)) {
+    if (reader->GetOverflowPolicy() == OverflowPolicy::BLOCK) {
+      return true;
+    }
   }
+  return false;
+}
+
+void Stream::SetPushedFromExecutor(bool pushed_from_executor) {
+  pushed_from_executor_ = pushed_from_executor;
+}
 
-  decltype(readers.size()) num_readers = readers.size();
+bool Stream::IsPushedFromExecutor() const { return pushed_from_executor_; }
+
+void Stream::PushFrame(std::unique_ptr<Frame> frame, bool block) {
+  // Grab the current snapshot of readers_. The snapshot keeps the readers alive
+  // even if they unsubscribe while we are blocked pushing to them.
+  std::shared_ptr<const ReaderList> readers = std::atomic_load(&readers_);
+
+  decltype(readers->size()) num_readers = readers->size();
   if (num_readers == 0) {
     VLOG(1) << "No readers. Dropping frame: "
-            << frame->GetValue<unsigned long>("frame_id");
-  } else if (num_readers == 1) {
-    readers.at(0)->PushFrame(std::move(frame), block);
+            << frame->GetValue(Frame::kFrameIdField);
+    return;
+  }
+
+  // Size the frame once, since the copies below share its data.
+  size_t size_bytes = frame->GetRawSizeBytes();
+  if (num_readers == 1) {
+    readers->at(0)->PushFrame(std::move(frame), block, size_bytes);
   } else {
-    // If there is more than one reader, then we need to copy the frame.
-    for (const auto& reader : readers) {
-      reader->PushFrame(std::make_unique<Frame>(frame), block);
+    // If there is more than one reader, then each one gets its own Frame. The
+    // copies share their field values copy-on-write, so this does not copy any
+    // image data. The last reader gets the original.
+    for (decltype(num_readers) i = 0; i < num_readers - 1; ++i) {
+      readers->at(i)->PushFrame(std::make_unique<Frame>(frame), block,
+                                size_bytes);
+    }
+    readers->back()->PushFrame(std::move(frame), block, size_bytes);
+  }
+}
+
+void Stream::PushFrames(FrameBatch frames, bool block) {
+  if (frames.empty()) {
+    return;
+  }
+
+  std::shared_ptr<const ReaderList> readers = std::atomic_load(&readers_);
+  decltype(readers->size()) num_readers = readers->size();
+  if (num_readers == 0) {
+    VLOG(1) << "No readers. Dropping " << frames.size() << " frames";
+    return;
+  }
+
+  std::vector<size_t> sizes_bytes;
+  sizes_bytes.reserve(frames.size());
+  for (const auto& frame : frames) {
+    sizes_bytes.push_back(frame->GetRawSizeBytes());
+  }
+
+  // As in PushFrame(), every reader but the last gets copy-on-write copies.
+  for (decltype(num_readers) i = 0; i < num_readers - 1; ++i) {
+    FrameBatch copies;
+    copies.reserve(frames.size());
+    for (const auto& frame : frames) {
+      copies.push_back(std::make_unique<Frame>(frame));
     }
+    readers->at(i)->PushFrames(std::move(copies), block, sizes_bytes);
   }
+  readers->back()->PushFrames(std::move(frames), block, sizes_bytes);
 }
 
 void Stream::Stop() {
-  std::lock_guard<std::mutex> lock(stream_lock_);
-  for (auto reader : readers_) {
+  for (const auto& reader : *std::atomic_load(&readers_)) {
     reader->Stop();
   }
 }
 
 /////// StreamReader
-StreamReader::StreamReader(Stream* stream, size_t max_buffer_size)
+StreamReader::StreamReader(Stream* stream, size_t max_buffer_size,
+                           OverflowPolicy policy)
     : stream_(stream),
       max_buffer_size_(max_buffer_size),
+      max_buffer_bytes_(0),
+      queued_bytes_(0),
+      policy_(policy),
+      frame_buffer_(max_buffer_size),
       num_frames_popped_(0),
+      num_frames_pushed_(0),
+      num_frames_dropped_newest_(0),
+      num_frames_dropped_oldest_(0),
+      num_frames_conflated_(0),
+      num_blocked_pushes_(0),
       first_frame_pop_ms_(-1),
       alpha_(0.25),
       running_push_ms_(0),
       running_pop_ms_(0),
       last_push_ms_(0),
-      last_pop_ms_(0) {
+      last_pop_ms_(0),
+      extra_queue_latency_histogram_(nullptr) {
   stopped_ = false;
+  wait_set_ = nullptr;
   timer_.Start();
 }
 
+StreamReader::~StreamReader() {
+  // Return the charges of the frames that were never popped.
+  QueuedFrame queued;
+  while (PopQueued(queued)) {
+  }
+}
+
 std::unique_ptr<Frame> StreamReader::PopFrame(unsigned int timeout_ms) {
   bool have_timeout = timeout_ms > 0;
-  auto pred_func = [this] { return stopped_ || (frame_buffer_.size() > 0); };
+  auto deadline = std::chrono::steady_clock::now() +
+                  std::chrono::milliseconds(timeout_ms);
 
-  std::unique_lock<std::mutex> lock(mtx_);
+  std::unique_ptr<Frame> frame;
   while (true) {
-    bool pred;
-    if (have_timeout) {
-      // Wait for the specified time.
-      pred = pop_cv_.wait_for(lock, std::chrono::milliseconds(timeout_ms),
-                              pred_func);
-    } else {
-      // Wait forever.
-      pop_cv_.wait(lock, pred_func);
-      pred = true;
-    }
-
     if (stopped_) {
       // We stopped, so return early.
       return nullptr;
-    } else if (pred) {
-      // We either timed out or were notified. Either way, there is a frame
-      // available so we break out of the loop and pop it.
+    } else if (TryPopQueued(frame)) {
       break;
-    } else if (have_timeout) {
-      // We must have woken up because of a timeout, so we return immediately.
-      return nullptr;
     }
+
+    // The queue is empty, so park until a producer notifies us. Re-check the
+    // queue after registering as a waiter so that we cannot miss a push that
+    // raced with the failed pop above.
+    auto key = pop_event_.PrepareWait();
+    if (stopped_ || !frame_buffer_.Empty()) {
+      pop_event_.CancelWait();
+      continue;
+    }
+
+    unsigned int wait_ms = 0;
+    if (have_timeout) {
+      auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+          deadline - std::chrono::steady_clock::now());
+      if (remaining.count() <= 0) {
+        pop_event_.CancelWait();
+        // We timed out, so we return immediately.
+        return nullptr;
+      }
+      wait_ms = (unsigned int)remaining.count();
+    }
+    pop_event_.Wait(key, wait_ms);
+  }
+
+  OnFramesPopped(1);
+  return frame;
+}
+
+FrameBatch StreamReader::PopFrames(size_t max_frames,
+                                   unsigned int timeout_ms) {
+  FrameBatch frames;
+  if (max_frames == 0) {
+    return frames;
   }
 
-  // Clear to pop frame.
-  auto frame = std::move(frame_buffer_.front());
-  frame_buffer_.pop();
-  ++num_frames_popped_;
+  // Wait for the first frame, then take whatever else is already queued.
+  auto frame = PopFrame(timeout_ms);
+  if (frame == nullptr) {
+    return frames;
+  }
+  frames.reserve(std::min(max_frames, frame_buffer_.Size() + 1));
+  frames.push_back(std::move(frame));
+
+  size_t num_popped = 0;
+  while (frames.size() < max_frames && !stopped_ && TryPopQueued(frame)) {
+    frames.push_back(std::move(frame));
+    ++num_popped;
+  }
+  if (num_popped > 0) {
+    OnFramesPopped(num_popped);
+  }
+  return frames;
+}
 
+std::unique_ptr<Frame> StreamReader::TryPopFrame() {
+  std::unique_ptr<Frame> frame;
+  if (stopped_ || !TryPopQueued(frame)) {
+    return nullptr;
+  }
+  OnFramesPopped(1);
+  return frame;
+}
+
+bool StreamReader::PopQueued(QueuedFrame& queued) {
+  if (!frame_buffer_.TryPop(queued)) {
+    return false;
+  }
+  queued_bytes_.fetch_sub(queued.size_bytes, std::memory_order_relaxed);
+  if (queued.charged_bytes > 0) {
+    FrameMemoryBudget::GetInstance().Release(queued.charged_bytes);
+  }
+  return true;
+}
+
+bool StreamReader::TryPopQueued(std::unique_ptr<Frame>& frame) {
+  QueuedFrame queued;
+  if (!PopQueued(queued)) {
+    return false;
+  }
+  int64_t latency_micros =
+      (int64_t)timer_.ElapsedMicroSec() - queued.push_micros;
+  queue_latency_histogram_.Record(latency_micros);
+  if (extra_queue_latency_histogram_ != nullptr) {
+    extra_queue_latency_histogram_->Record(latency_micros);
+  }
+  frame = std::move(queued.frame);
+  return true;
+}
+
+bool StreamReader::HasFrame() const {
+  return !stopped_ && !frame_buffer_.Empty();
+}
+
+void StreamReader::SetWaitSet(StreamWaitSet* wait_set) {
+  wait_set_ = wait_set;
+}
+
+void StreamReader::OnFramesPopped(size_t num_frames) {
+  // We freed space in the queue, so notify anyone waiting to push.
+  if (num_frames == 1) {
+    push_event_.NotifyOne();
+  } else {
+    push_event_.NotifyAll();
+  }
+
+  num_frames_popped_ += num_frames;
+
+  // The pop rate is tracked per frame, so a batch counts as "num_frames"
+  // evenly spaced pops.
   double current_ms = timer_.ElapsedMSec();
-  double delta_ms = current_ms - last_pop_ms_;
-  running_pop_ms_ = running_pop_ms_ * (1 - alpha_) + delta_ms * alpha_;
+  double delta_ms = (current_ms - last_pop_ms_) / num_frames;
+  double running_pop_ms = running_pop_ms_;
+  for (size_t i = 0; i < num_frames; ++i) {
+    running_pop_ms = running_pop_ms * (1 - alpha_) + delta_ms * alpha_;
+  }
+  running_pop_ms_ = running_pop_ms;
   last_pop_ms_ = current_ms;
 
   if (first_frame_pop_ms_ == -1) {
     first_frame_pop_ms_ = current_ms;
   }
+}
 
-  // We freed a space in the queue, so notify anyone waiting to push.
-  push_cv_.notify_one();
-
-  return frame;
+void StreamReader::NotifyWaitSet() {
+  StreamWaitSet* wait_set = wait_set_;
+  if (wait_set != nullptr) {
+    wait_set->Notify();
+  }
 }
 
-void StreamReader::PushFrame(std::unique_ptr<Frame> frame, bool block) {
-  std::unique_lock<std::mutex> lock(mtx_);
+void StreamReader::PushFrame(std::unique_ptr<Frame> frame, bool block,
+                             size_t size_bytes) {
+  if (!Enqueue(frame, block ? OverflowPolicy::BLOCK : policy_.load(),
+               size_bytes)) {
+    return;
+  }
+
+  // We pushed a frame, so notify any threads that are waiting to receive
+  // frames. This is free if nobody is waiting.
+  pop_event_.NotifyOne();
+  NotifyWaitSet();
+  OnFramesPushed(1);
+}
 
-  if (block) {
-    push_cv_.wait(lock, [this] {
-      return stopped_ || (frame_buffer_.size() < max_buffer_size_);
-    });
-    if (stopped_) {
-      // We stopped, so return early.
+void StreamReader::PushFrames(FrameBatch frames, bool block,
+                              const std::vector<size_t>& sizes_bytes) {
+  OverflowPolicy policy = block ? OverflowPolicy::BLOCK : policy_.load();
+  size_t num_pushed = 0;
+  for (size_t i = 0; i < frames.size(); ++i) {
+    size_t size_bytes = i < sizes_bytes.size() ? sizes_bytes.at(i) : 0;
+    if (Enqueue(frames.at(i), policy, size_bytes)) {
+      ++num_pushed;
+    } else if (stopped_) {
       return;
     }
-  } else if (frame_buffer_.size() >= max_buffer_size_) {
-    // There is not enough space in the queue, and we're not supposed to block,
-    // so we have no choice but to drop the frame.
-    unsigned long id = frame->GetValue<unsigned long>("frame_id");
-    LOG(WARNING) << "Stream queue full. Dropping frame: " << id;
-    if (frame->GetFlowControlEntrance()) {
-      // This scenario should not happen. If we're using end-to-end flow
-      // control, then we should not be using so many tokens such that we are
-      // dropping frames.
-      LOG(ERROR) << "Dropped frame " << id << " while using end-to-end flow "
-                 << "control. This should not have happened. Either increase "
-                 << "the size of this stream's queue or decrease the number of "
-                 << "flow control tokens.";
-    }
+  }
+  if (num_pushed == 0) {
     return;
   }
 
-  // Clear to push frame.
-  frame_buffer_.push(std::move(frame));
+  // Wake up the consumer once for the whole batch.
+  pop_event_.NotifyOne();
+  NotifyWaitSet();
+  OnFramesPushed(num_pushed);
+}
+
+bool StreamReader::Enqueue(std::unique_ptr<Frame>& frame,
+                           OverflowPolicy policy, size_t size_bytes) {
+  if (policy == OverflowPolicy::LATEST_ONLY) {
+    // Everything that is still queued is now stale, so throw it away. The
+    // consumer may race with us and pop one of these frames first, which is
+    // fine.
+    QueuedFrame stale;
+    while (PopQueued(stale)) {
+      ++num_frames_conflated_;
+      DiscardFrame(std::move(stale.frame));
+    }
+  }
 
+  bool waited = false;
+  QueuedFrame queued = {std::move(frame), 0, size_bytes, 0};
+  while (true) {
+    // Stamp the frame on every attempt, so that time spent blocked does not
+    // count as time in the queue.
+    queued.push_micros = (int64_t)timer_.ElapsedMicroSec();
+    if (TryPushQueued(queued)) {
+      break;
+    }
+    if (policy == OverflowPolicy::BLOCK) {
+      // The queue is full and we are supposed to block, so park until the
+      // consumer pops a frame. When pushing a batch, the consumer has not
+      // been told about the frames that we already queued, so wake it up
+      // first.
+      waited = true;
+      pop_event_.NotifyOne();
+      NotifyWaitSet();
+      if (!WaitForSpace(size_bytes)) {
+        // We stopped, so return early.
+        return false;
+      }
+    } else if (policy == OverflowPolicy::DROP_NEWEST) {
+      // There is not enough space in the queue, and we're not supposed to
+      // block, so we have no choice but to drop the frame.
+      unsigned long id = queued.frame->GetValue(Frame::kFrameIdField);
+      LOG(WARNING) << "Stream queue full. Dropping frame: " << id;
+      ++num_frames_dropped_newest_;
+      DiscardFrame(std::move(queued.frame));
+      return false;
+    } else {
+      // Make room by evicting the oldest frame. If the consumer popped it
+      // first, then there is room already and we simply retry.
+      QueuedFrame oldest;
+      if (PopQueued(oldest)) {
+        if (policy == OverflowPolicy::LATEST_ONLY) {
+          ++num_frames_conflated_;
+        } else {
+          ++num_frames_dropped_oldest_;
+        }
+        DiscardFrame(std::move(oldest.frame));
+      }
+    }
+  }
+  if (waited) {
+    ++num_blocked_pushes_;
+  }
+  ++num_frames_pushed_;
+  return true;
+}
+
+void StreamReader::OnFramesPushed(size_t num_frames) {
+  // The push rate is tracked per frame, so a batch counts as "num_frames"
+  // evenly spaced pushes.
   double current_ms = timer_.ElapsedMSec();
-  double delta_ms = current_ms - last_push_ms_;
-  running_push_ms_ = running_push_ms_ * (1 - alpha_) + delta_ms * alpha_;
+  double delta_ms = (current_ms - last_push_ms_) / num_frames;
+  double running_push_ms = running_push_ms_;
+  for (size_t i = 0; i < num_frames; ++i) {
+    running_push_ms = running_push_ms * (1 - alpha_) + delta_ms * alpha_;
+  }
+  running_push_ms_ = running_push_ms;
   last_push_ms_ = current_ms;
+}
 
-  // We pushed a frame, so notify any threads that are waiting to receive
-  // frames.
-  pop_cv_.notify_one();
+bool StreamReader::TryPushQueued(QueuedFrame& queued) {
+  // The ring buffer is only checked against a lowered size, which is rare, so
+  // that the common case does not pay for Size().
+  size_t max_buffer_size = max_buffer_size_.load(std::memory_order_relaxed);
+  if (max_buffer_size < frame_buffer_.Capacity() &&
+      frame_buffer_.Size() >= max_buffer_size) {
+    return false;
+  }
+
+  queued.charged_bytes = 0;
+  size_t max_buffer_bytes = max_buffer_bytes_.load(std::memory_order_relaxed);
+  FrameMemoryBudget& budget = FrameMemoryBudget::GetInstance();
+  if (max_buffer_bytes > 0 || budget.IsLimited()) {
+    // A frame always fits into an empty queue, so that frames larger than the
+    // limits still get through and no queue is starved by the others.
+    bool empty = frame_buffer_.Empty();
+    if (!empty && max_buffer_bytes > 0 &&
+        queued_bytes_.load(std::memory_order_relaxed) + queued.size_bytes >
+            max_buffer_bytes) {
+      return false;
+    }
+    if (budget.IsLimited()) {
+      if (!budget.TryCharge(queued.size_bytes, empty)) {
+        return false;
+      }
+      queued.charged_bytes = queued.size_bytes;
+    }
+  }
+
+  size_t size_bytes = queued.size_bytes;
+  size_t charged_bytes = queued.charged_bytes;
+  queued_bytes_.fetch_add(size_bytes, std::memory_order_relaxed);
+  if (!frame_buffer_.TryPush(queued)) {
+    queued_bytes_.fetch_sub(size_bytes, std::memory_order_relaxed);
+    if (charged_bytes > 0) {
+      budget.Release(charged_bytes);
+    }
+    return false;
+  }
+  return true;
+}
+
+bool StreamReader::HasSpace(size_t size_bytes) const {
+  if (frame_buffer_.Size() >= max_buffer_size_) {
+    return false;
+  }
+  if (frame_buffer_.Empty()) {
+    return true;
+  }
+  size_t max_buffer_bytes = max_buffer_bytes_.load(std::memory_order_relaxed);
+  return (max_buffer_bytes == 0 ||
+          queued_bytes_.load(std::memory_order_relaxed) + size_bytes <=
+              max_buffer_bytes) &&
+         FrameMemoryBudget::GetInstance().HasRoom(size_bytes);
+}
+
+bool StreamReader::WaitForSpace(size_t size_bytes) {
+  // Pops from other readers make room in the FrameMemoryBudget without
+  // notifying this one, so check the budget again every so often.
+  constexpr unsigned int kBudgetPollMs = 5;
+  while (!stopped_ && !HasSpace(size_bytes)) {
+    auto key = push_event_.PrepareWait();
+    if (stopped_ || HasSpace(size_bytes)) {
+      push_event_.CancelWait();
+      break;
+    }
+    push_event_.Wait(
+        key, FrameMemoryBudget::GetInstance().IsLimited() ? kBudgetPollMs : 0);
+  }
+  return !stopped_;
+}
+
+void StreamReader::DiscardFrame(std::unique_ptr<Frame> frame) {
+  FlowControlEntrance* entrance = frame->GetFlowControlEntrance();
+  if (entrance != nullptr) {
+    // Give the token back, otherwise the entrance would eventually run out of
+    // tokens and stall the pipeline.
+    entrance->ReturnToken(frame->GetValue(Frame::kFrameIdField));
+    frame->SetFlowControlEntrance(nullptr);
+  }
 }
 
 void StreamReader::UnSubscribe() {
@@ -188,10 +550,76 @@ double StreamReader::GetHistoricalFps() {
          ((timer_.ElapsedMSec() - first_frame_pop_ms_) / ms_per_sec);
 }
 
+OverflowPolicy StreamReader::GetOverflowPolicy() const { return policy_; }
+
+void StreamReader::SetOverflowPolicy(OverflowPolicy policy) {
+  policy_ = policy;
+}
+
+size_t StreamReader::GetMaxBufferSize() const { return max_buffer_size_; }
+
+void StreamReader::SetMaxBufferSize(size_t max_buffer_size) {
+  CHECK(max_buffer_size > 0 && max_buffer_size <= frame_buffer_.Capacity())
+      << "Queue size must be between 1 and " << frame_buffer_.Capacity();
+  max_buffer_size_ = max_buffer_size;
+  // Producers that are blocked on a full queue may have room now.
+  push_event_.NotifyAll();
+}
+
+size_t StreamReader::GetBufferCapacity() const {
+  return frame_buffer_.Capacity();
+}
+
+size_t StreamReader::GetMaxBufferBytes() const { return max_buffer_bytes_; }
+
+void StreamReader::SetMaxBufferBytes(size_t max_buffer_bytes) {
+  max_buffer_bytes_ = max_buffer_bytes;
+  // Producers that are blocked on a full queue may have room now.
+  push_event_.NotifyAll();
+}
+
+size_t StreamReader::GetQueuedBytes() const { return queued_bytes_; }
+
+size_t StreamReader::GetNumQueuedFrames() const {
+  return frame_buffer_.Size();
+}
+
+unsigned long StreamReader::GetNumFramesPopped() const {
+  return num_frames_popped_;
+}
+
+const LatencyHistogram& StreamReader::GetQueueLatencyHistogram() const {
+  return queue_latency_histogram_;
+}
+
+void StreamReader::SetExtraQueueLatencyHistogram(LatencyHistogram* histogram) {
+  extra_queue_latency_histogram_ = histogram;
+}
+
+unsigned long StreamReader::GetNumFramesPushed() const {
+  return num_frames_pushed_;
+}
+
+unsigned long StreamReader::GetNumFramesDroppedNewest() const {
+  return num_frames_dropped_newest_;
+}
+
+unsigned long StreamReader::GetNumFramesDroppedOldest() const {
+  return num_frames_dropped_oldest_;
+}
+
+unsigned long StreamReader::GetNumFramesConflated() const {
+  return num_frames_conflated_;
+}
+
+unsigned long StreamReader::GetNumBlockedPushes() const {
+  return num_blocked_pushes_;
+}
+
 void StreamReader::Stop() {
   stopped_ = true;
-  std::unique_lock<std::mutex> lock(mtx_);
   // Wake up any threads that are waiting to push or pop frames.
-  push_cv_.notify_all();
-  pop_cv_.notify_all();
+  push_event_.NotifyAll();
+  pop_event_.NotifyAll();
+  NotifyWaitSet();
 }
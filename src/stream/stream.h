@@ -16,23 +16,60 @@
 #define SAF_STREAM_STREAM_H_
 
 #include <atomic>
-#include <condition_variable>
+#include <cstdint>
+#include <memory>
 #include <mutex>
-#include <queue>
+#include <string>
 #include <unordered_set>
+#include <vector>
 
 #include "common/timer.h"
 #include "frame.h"
+#include "stream/event_count.h"
+#include "stream/frame_memory_budget.h"
+#include "stream/ring_buffer.h"
+#include "stream/stream_wait_set.h"
+#include "utils/latency_histogram.h"
+
+/**
+ * @brief What a StreamReader does with a new frame when its queue is full.
+ */
+enum class OverflowPolicy {
+  // Wait until the reader pops a frame and frees up space.
+  BLOCK,
+  // Drop the incoming frame. This is the default.
+  DROP_NEWEST,
+  // Evict the oldest queued frame to make room for the incoming one, so the
+  // queue always holds the newest "max_buffer_size" frames.
+  DROP_OLDEST,
+  // Discard every queued frame whenever a new one arrives, so the reader
+  // always gets the most recent frame (conflation).
+  LATEST_ONLY
+};
+
+// A group of frames that travels through a Stream together. Batching spreads
+// the fixed per-hop costs (queue synchronization, wakeups, statistics and
+// Operator::Process() dispatch) across all of the frames in the batch.
+typedef std::vector<std::unique_ptr<Frame>> FrameBatch;
+
+OverflowPolicy GetOverflowPolicyByString(const std::string& str);
+std::string GetStringForOverflowPolicy(OverflowPolicy policy);
 
 /**
  * @brief A reader that reads from a stream. There could be multiple readers
  * reading from the same stream.
+ *
+ * Frames are handed over through a bounded lock-free ring buffer. Producers
+ * and consumers only park (on an EventCount) when the queue is full or empty,
+ * so steady-state traffic never takes a lock or makes a system call.
  */
 class StreamReader {
   friend class Stream;
 
  public:
-  StreamReader(Stream* stream, size_t max_buffer_size = 16);
+  StreamReader(Stream* stream, size_t max_buffer_size = 16,
+               OverflowPolicy policy = OverflowPolicy::DROP_NEWEST);
+  ~StreamReader();
 
   /**
    * @brief Pop a frame, and timeout if no frame available for a given time
@@ -41,10 +78,82 @@ class StreamReader {
    */
   std::unique_ptr<Frame> PopFrame(unsigned int timeout_ms = 0);
 
+  /**
+   * @brief Pop up to "max_frames" frames. Waits for the first frame like
+   * PopFrame(), then takes only frames that are already queued.
+   * @param max_frames The maximum number of frames to return.
+   * @param timeout_ms Time out threshold, 0 for forever
+   * @return The frames, in order. Empty if stopped or timed out.
+   */
+  FrameBatch PopFrames(size_t max_frames, unsigned int timeout_ms = 0);
+
+  /**
+   * @brief Pop a frame if one is available, without waiting.
+   * @return The frame, or nullptr if the queue is empty
+   */
+  std::unique_ptr<Frame> TryPopFrame();
+
+  /**
+   * @brief Whether a frame is ready to be popped. Always false once the reader
+   * has been stopped. This is only a snapshot.
+   */
+  bool HasFrame() const;
+
+  /**
+   * @brief Notify "wait_set" whenever a frame is pushed or this reader is
+   * stopped. Pass nullptr to detach. Normally called by StreamWaitSet::Add().
+   */
+  void SetWaitSet(StreamWaitSet* wait_set);
+
   void UnSubscribe();
   double GetPushFps();
   double GetPopFps();
   double GetHistoricalFps();
+  OverflowPolicy GetOverflowPolicy() const;
+  // Change what happens to frames pushed while the queue is full. May be
+  // called while frames are being pushed.
+  void SetOverflowPolicy(OverflowPolicy policy);
+  // The number of frames that the queue holds before it counts as full.
+  size_t GetMaxBufferSize() const;
+  // Change the number of frames that the queue holds, up to the size that the
+  // reader was created with. Frames that are already queued beyond a lowered
+  // size stay queued. May be called while frames are being pushed.
+  void SetMaxBufferSize(size_t max_buffer_size);
+  // The largest size that SetMaxBufferSize() accepts.
+  size_t GetBufferCapacity() const;
+  // The number of bytes of frame data (see Frame::GetRawSizeBytes()) that the
+  // queue holds before it counts as full, in addition to the limit on the
+  // number of frames. 0, the default, means no limit. A frame always fits
+  // into an empty queue, however large it is. May be called while frames are
+  // being pushed.
+  size_t GetMaxBufferBytes() const;
+  void SetMaxBufferBytes(size_t max_buffer_bytes);
+  // The number of bytes of frame data in the queue. This is only a snapshot.
+  size_t GetQueuedBytes() const;
+  // The number of frames in the queue. This is only a snapshot.
+  size_t GetNumQueuedFrames() const;
+  // The number of frames that have been popped from the queue.
+  unsigned long GetNumFramesPopped() const;
+  // The number of frames that have been accepted into this reader's queue.
+  unsigned long GetNumFramesPushed() const;
+  // The number of incoming frames that were dropped because the queue was full
+  // (DROP_NEWEST).
+  unsigned long GetNumFramesDroppedNewest() const;
+  // The number of queued frames that were evicted to make room for newer ones
+  // (DROP_OLDEST).
+  unsigned long GetNumFramesDroppedOldest() const;
+  // The number of queued frames that were superseded by a newer frame
+  // (LATEST_ONLY).
+  unsigned long GetNumFramesConflated() const;
+  // The number of pushes that had to wait for space in the queue (BLOCK).
+  unsigned long GetNumBlockedPushes() const;
+  // The distribution of the time that frames spent in this reader's queue,
+  // from being pushed to being popped.
+  const LatencyHistogram& GetQueueLatencyHistogram() const;
+  // Also record the queue latency of every popped frame in "histogram", e.g.,
+  // to aggregate the latency over all of an operator's sources. Pass nullptr
+  // to detach. Must not be called while frames are being popped.
+  void SetExtraQueueLatencyHistogram(LatencyHistogram* histogram);
   // Signals that this StreamReader should stop any currently-waiting attempts
   // to push or pop frames. This is required because Operator::Stop() joins the
   // processing threads, and the processing threads may call
@@ -57,33 +166,94 @@ class StreamReader {
    * @brief Push a frame into the stream.
    * @param frame The frame to be pushed into the stream.
    */
-  void PushFrame(std::unique_ptr<Frame> frame, bool block = false);
+  void PushFrame(std::unique_ptr<Frame> frame, bool block = false,
+                 size_t size_bytes = 0);
+  /**
+   * @brief Push several frames into the stream, waking up the consumer once.
+   * "sizes_bytes" holds the size of each frame, if known.
+   */
+  void PushFrames(FrameBatch frames, bool block = false,
+                  const std::vector<size_t>& sizes_bytes = {});
+  // A frame in the queue, along with when it was pushed.
+  struct QueuedFrame {
+    std::unique_ptr<Frame> frame;
+    // Microseconds since "timer_" was started.
+    int64_t push_micros;
+    // The size of the frame's data.
+    size_t size_bytes;
+    // The bytes charged to the FrameMemoryBudget, 0 if none.
+    size_t charged_bytes;
+  };
+
+  // Pops the oldest frame into "frame", recording how long it was queued.
+  // Returns false if the queue is empty.
+  bool TryPopQueued(std::unique_ptr<Frame>& frame);
+  // Pops the oldest frame into "queued" and returns its bytes to the budgets.
+  // Returns false if the queue is empty.
+  bool PopQueued(QueuedFrame& queued);
+  // Pushes "queued" if it fits within the frame and byte limits, charging its
+  // bytes. Returns false if it does not fit.
+  bool TryPushQueued(QueuedFrame& queued);
+  // Returns whether a frame of "size_bytes" bytes fits within the limits.
+  bool HasSpace(size_t size_bytes) const;
+  // Applies "policy" to push "frame" into the queue, without notifying the
+  // consumer. Returns false if the frame was dropped or the reader stopped.
+  bool Enqueue(std::unique_ptr<Frame>& frame, OverflowPolicy policy,
+               size_t size_bytes);
+  // Waits until a frame of "size_bytes" bytes fits into the queue. Returns
+  // false if the reader was stopped while waiting.
+  bool WaitForSpace(size_t size_bytes);
+  // Discards a frame that will never be popped, returning its flow control
+  // token (if any) so that the token is not leaked.
+  void DiscardFrame(std::unique_ptr<Frame> frame);
+  // Wakes up producers and updates statistics after frames have been popped.
+  void OnFramesPopped(size_t num_frames);
+  // Updates statistics after frames have been pushed.
+  void OnFramesPushed(size_t num_frames);
+  // Wakes up the wait set, if there is one.
+  void NotifyWaitSet();
+
   Stream* stream_;
   // Max size of the buffer to hold frames in the stream
-  size_t max_buffer_size_;
+  std::atomic<size_t> max_buffer_size_;
+  // Max bytes of frame data in the buffer. 0 means no limit.
+  std::atomic<size_t> max_buffer_bytes_;
+  // The bytes of frame data in the buffer.
+  std::atomic<size_t> queued_bytes_;
+  // What to do when the buffer is full.
+  std::atomic<OverflowPolicy> policy_;
   // The frame buffer
-  std::queue<std::unique_ptr<Frame>> frame_buffer_;
-  std::mutex mtx_;
+  RingBuffer<QueuedFrame> frame_buffer_;
   // Used to wait if the queue is full when trying to push.
-  std::condition_variable push_cv_;
+  EventCount push_event_;
   // Used to wait if the queue is empty when trying to pop.
-  std::condition_variable pop_cv_;
+  EventCount pop_event_;
+  // Notified whenever a frame is pushed, if set.
+  std::atomic<StreamWaitSet*> wait_set_;
   // Used to signal PushFrame() and PopFrame() that they should return
   // immediately.
   std::atomic<bool> stopped_;
 
   // The total number of frames that have popped from this StreamReader.
-  unsigned long num_frames_popped_;
+  std::atomic<unsigned long> num_frames_popped_;
+  // Per-policy counters. These are updated by the producer and may be read
+  // from any thread.
+  std::atomic<unsigned long> num_frames_pushed_;
+  std::atomic<unsigned long> num_frames_dropped_newest_;
+  std::atomic<unsigned long> num_frames_dropped_oldest_;
+  std::atomic<unsigned long> num_frames_conflated_;
+  std::atomic<unsigned long> num_blocked_pushes_;
   // Milliseconds between when this StreamReader was constructed and when the
   // first frame was popped. -1 means that this has not been set yet.
   double first_frame_pop_ms_;
   // Alpha parameter for the exponentially weighted moving average (EWMA)
   // formula.
   double alpha_;
-  // The EWMA of the milliseconds between frame pushes.
-  double running_push_ms_;
+  // The EWMA of the milliseconds between frame pushes. Atomic so that the
+  // rates can be read, e.g., by MetricsRegistry, while frames flow.
+  std::atomic<double> running_push_ms_;
   // The EWMA of the milliseconds between frame pops.
-  double running_pop_ms_;
+  std::atomic<double> running_pop_ms_;
   // Milliseconds between when this StreamReader was constructed and the last
   // frame push.
   double last_push_ms_;
@@ -92,6 +262,9 @@ class StreamReader {
   double last_pop_ms_;
   // Started when this StreamReader is constructed.
   Timer timer_;
+  // The time between pushing and popping each frame.
+  LatencyHistogram queue_latency_histogram_;
+  LatencyHistogram* extra_queue_latency_histogram_;
 };
 
 /**
@@ -104,10 +277,19 @@ class Stream {
   /**
    * @brief Push a frame into the stream.
    * @param frame The frame to be pushed into the stream.
-   * @param block Whether to block if any of the StreamReaders are full.
+   * @param block Whether to block if any of the StreamReaders are full. If
+   * true, this overrides the overflow policy of every reader.
    */
   void PushFrame(std::unique_ptr<Frame> frame, bool block = false);
 
+  /**
+   * @brief Push a batch of frames into the stream. Each reader receives the
+   * frames in order, and is woken up once per batch instead of once per frame.
+   * @param frames The frames to be pushed into the stream.
+   * @param block Whether to block if any of the StreamReaders are full.
+   */
+  void PushFrames(FrameBatch frames, bool block = false);
+
   /**
    * @brief Get the name of the stream.
    */
@@ -116,26 +298,50 @@ class Stream {
   /**
    * @brief Get a reader from the stream.
    * @param max_buffer_size The buffer size limit of the reader.
+   * @param policy What to do when the reader's buffer is full.
    */
-  StreamReader* Subscribe(size_t max_buffer_size = 16);
+  StreamReader* Subscribe(size_t max_buffer_size = 16,
+                          OverflowPolicy policy = OverflowPolicy::DROP_NEWEST);
 
   /**
    * @brief Unsubscribe from the stream
    */
   void UnSubscribe(StreamReader* reader);
 
+  /**
+   * @brief Check whether any StreamReaders are subscribed to the stream.
+   */
+  bool HasReaders() const;
+
+  /**
+   * @brief Check whether any of the StreamReaders block pushes when they are
+   * full, which must not happen on an Executor's thread.
+   */
+  bool HasBlockingReaders() const;
+
+  // Whether frames are pushed into this Stream from an Executor's threads, in
+  // which case its readers must not switch to blocking pushes.
+  void SetPushedFromExecutor(bool pushed_from_executor);
+  bool IsPushedFromExecutor() const;
+
   // Stops all of the StreamReaders attached to this Stream, waking up any
   // threads that are trying to push or pop frames from this Stream. See the
   // documentation for StreamReader::Stop().
   void Stop();
 
  private:
+  typedef std::vector<std::shared_ptr<StreamReader>> ReaderList;
+
   // Stream name for profiling and debugging
   std::string name_;
-  // The readers of the stream
-  std::vector<std::shared_ptr<StreamReader>> readers_;
-  // Stream lock
+  // The readers of the stream. This is an immutable snapshot that is replaced
+  // wholesale (using std::atomic_load() and std::atomic_store()) whenever a
+  // reader subscribes or unsubscribes, so PushFrame() can read it without
+  // taking "stream_lock_" or copying the list.
+  std::shared_ptr<const ReaderList> readers_;
+  // Serializes updates to "readers_".
   std::mutex stream_lock_;
+  std::atomic<bool> pushed_from_executor_;
 };
 
 #endif  // SAF_STREAM_STREAM_H_
@@ -0,0 +1,80 @@
+// Copyright 2018 The SAF Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "stream/stream_wait_set.h"
+
+#include "stream/stream.h"
+
+StreamWaitSet::StreamWaitSet() : listener_(nullptr) {}
+
+StreamWaitSet::~StreamWaitSet() { Clear(); }
+
+size_t StreamWaitSet::Add(StreamReader* reader) {
+  reader->SetWaitSet(this);
+  readers_.push_back(reader);
+  return readers_.size() - 1;
+}
+
+void StreamWaitSet::Clear() {
+  for (const auto& reader : readers_) {
+    reader->SetWaitSet(nullptr);
+  }
+  readers_.clear();
+}
+
+std::vector<size_t> StreamWaitSet::Wait(unsigned int timeout_ms) {
+  std::vector<size_t> ready;
+  CollectReady(ready);
+  if (!ready.empty()) {
+    return ready;
+  }
+
+  // Nothing is ready, so park until a reader notifies us. Re-check after
+  // registering as a waiter so that we cannot miss a push that raced with the
+  // check above.
+  auto key = event_.PrepareWait();
+  CollectReady(ready);
+  if (!ready.empty()) {
+    event_.CancelWait();
+    return ready;
+  }
+  event_.Wait(key, timeout_ms);
+
+  CollectReady(ready);
+  return ready;
+}
+
+std::vector<size_t> StreamWaitSet::Poll() const {
+  std::vector<size_t> ready;
+  CollectReady(ready);
+  return ready;
+}
+
+void StreamWaitSet::SetListener(Listener* listener) { listener_ = listener; }
+
+void StreamWaitSet::Notify() {
+  event_.NotifyAll();
+  Listener* listener = listener_;
+  if (listener != nullptr) {
+    listener->OnNotify();
+  }
+}
+
+void StreamWaitSet::CollectReady(std::vector<size_t>& ready) const {
+  for (decltype(readers_.size()) i = 0; i < readers_.size(); ++i) {
+    if (readers_.at(i)->HasFrame()) {
+      ready.push_back(i);
+    }
+  }
+}
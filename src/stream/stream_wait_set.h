@@ -0,0 +1,94 @@
+// Copyright 2018 The SAF Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SAF_STREAM_STREAM_WAIT_SET_H_
+#define SAF_STREAM_STREAM_WAIT_SET_H_
+
+#include <atomic>
+#include <vector>
+
+#include "stream/event_count.h"
+
+class StreamReader;
+
+/**
+ * @brief Waits on several StreamReaders at once, similar to epoll. Readers
+ * notify the set whenever they receive a frame, so a thread blocked in Wait()
+ * wakes up as soon as any of its inputs has data, instead of polling each
+ * reader in turn.
+ */
+class StreamWaitSet {
+ public:
+  // Gets called, on the pushing thread, whenever the set is notified. Lets a
+  // scheduler react to new frames without dedicating a thread to Wait().
+  class Listener {
+   public:
+    virtual ~Listener() {}
+    virtual void OnNotify() = 0;
+  };
+
+  StreamWaitSet();
+  ~StreamWaitSet();
+  StreamWaitSet(const StreamWaitSet&) = delete;
+  StreamWaitSet& operator=(const StreamWaitSet&) = delete;
+
+  /**
+   * @brief Add a reader to the set. A reader can only belong to one set.
+   * @return The index of the reader, as reported by Wait().
+   */
+  size_t Add(StreamReader* reader);
+
+  /**
+   * @brief Detach all readers from the set.
+   */
+  void Clear();
+
+  /**
+   * @brief Block until at least one reader has a frame, Notify() is called,
+   * or the timeout expires.
+   * @param timeout_ms Time out threshold, 0 for forever
+   * @return The indices of the readers that have frames. May be empty if the
+   * wait timed out or was interrupted by Notify().
+   */
+  std::vector<size_t> Wait(unsigned int timeout_ms = 0);
+
+  /**
+   * @brief Like Wait(), but returns immediately.
+   * @return The indices of the readers that have frames.
+   */
+  std::vector<size_t> Poll() const;
+
+  /**
+   * @brief Call "listener" whenever the set is notified, in addition to waking
+   * up Wait(). Pass nullptr to detach. "listener" must outlive the set or be
+   * detached before it is destroyed.
+   */
+  void SetListener(Listener* listener);
+
+  /**
+   * @brief Wake up any thread that is blocked in Wait(). Called by the readers
+   * whenever they receive a frame or are stopped.
+   */
+  void Notify();
+
+ private:
+  // Appends the indices of the readers that have frames to "ready".
+  void CollectReady(std::vector<size_t>& ready) const;
+
+  std::vector<StreamReader*> readers_;
+  EventCount event_;
+  std::atomic<Listener*> listener_;
+};
+
+#endif  // SAF_STREAM_STREAM_WAIT_SET_H_
@@ -0,0 +1,343 @@
+// Copyright 2018 The SAF Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "stream/tracer.h"
+
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <thread>
+
+#include <glog/logging.h>
+
+#include "stream/frame.h"
+
+const char* Tracer::kTraceIdKey = "trace_id";
+const char* Tracer::kTracePushMicrosKey = "trace_push_micros";
+constexpr size_t Tracer::kDefaultMaxSpans;
+
+std::atomic<bool> Tracer::enabled_(false);
+
+// The write end of the pipe that wakes up the dump thread. Written to by the
+// SIGUSR1 handler. It is non-blocking, so that once the pipe is full, further
+// signals are coalesced into the dumps that are already pending instead of
+// blocking the handler.
+static int signal_pipe_fd = -1;
+
+static void HandleDumpSignal(int) {
+  int saved_errno = errno;
+  char byte = 0;
+  if (write(signal_pipe_fd, &byte, 1) < 0) {
+    // Nothing can be done about it in a signal handler.
+  }
+  errno = saved_errno;
+}
+
+static const FieldKey<unsigned long>& TraceIdField() {
+  static const FieldKey<unsigned long> field(Tracer::kTraceIdKey);
+  return field;
+}
+
+static const FieldKey<unsigned long>& TracePushMicrosField() {
+  static const FieldKey<unsigned long> field(Tracer::kTracePushMicrosKey);
+  return field;
+}
+
+static unsigned long GetFrameId(const Frame& frame) {
+  if (frame.Count(Frame::kFrameIdField.GetId()) == 0) {
+    return 0;
+  }
+  return frame.GetValue(Frame::kFrameIdField);
+}
+
+static const char* GetSpanName(Tracer::SpanType type) {
+  switch (type) {
+    case Tracer::SpanType::QUEUE:
+      return "queue";
+    case Tracer::SpanType::PROCESS:
+      return "process";
+    case Tracer::SpanType::TRANSFER:
+      return "transfer";
+  }
+  return "unknown";
+}
+
+// Escapes "value" for use inside a JSON string, i.e., backslashes, double
+// quotes and control characters.
+static std::string EscapeJsonString(const std::string& value) {
+  std::string escaped;
+  escaped.reserve(value.size());
+  for (char c : value) {
+    if (c == '\\') {
+      escaped += "\\\\";
+    } else if (c == '"') {
+      escaped += "\\\"";
+    } else if (c == '\n') {
+      escaped += "\\n";
+    } else if ((unsigned char)c < 0x20) {
+      char code[7];
+      snprintf(code, sizeof(code), "\\u%04x", (unsigned char)c);
+      escaped += code;
+    } else {
+      escaped += c;
+    }
+  }
+  return escaped;
+}
+
+Tracer::Tracer()
+    : sample_period_(0),
+      num_candidates_(0),
+      max_spans_(kDefaultMaxSpans),
+      next_span_(0),
+      wrapped_(false),
+      random_(std::random_device()()),
+      signal_handler_installed_(false) {
+  spans_.resize(max_spans_);
+}
+
+Tracer& Tracer::GetInstance() {
+  static Tracer* tracer = new Tracer();
+  return *tracer;
+}
+
+bool Tracer::IsTraced(const Frame& frame) {
+  return frame.Count(TraceIdField().GetId()) != 0;
+}
+
+int64_t Tracer::NowMicros() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::system_clock::now().time_since_epoch())
+      .count();
+}
+
+void Tracer::SetSamplingRate(double rate) {
+  CHECK(rate >= 0 && rate <= 1) << "Sampling rate must be between 0 and 1";
+  if (rate == 0) {
+    enabled_ = false;
+    sample_period_ = 0;
+    return;
+  }
+  sample_period_ = std::max((uint64_t)1, (uint64_t)std::llround(1 / rate));
+  enabled_ = true;
+  LOG(INFO) << "Tracing 1 in " << sample_period_ << " frames";
+}
+
+void Tracer::SetMaxSpans(size_t max_spans) {
+  CHECK(max_spans > 0) << "The flight recorder must hold at least one span";
+  std::lock_guard<std::mutex> guard(mtx_);
+  max_spans_ = max_spans;
+  spans_.assign(max_spans_, Span());
+  next_span_ = 0;
+  wrapped_ = false;
+}
+
+int Tracer::RegisterLane(const std::string& name) {
+  std::lock_guard<std::mutex> guard(mtx_);
+  lane_names_.push_back(name);
+  return (int)lane_names_.size() - 1;
+}
+
+bool Tracer::ShouldSample() {
+  uint64_t period = sample_period_;
+  return period != 0 && num_candidates_++ % period == 0;
+}
+
+uint64_t Tracer::NewTraceId() {
+  std::lock_guard<std::mutex> guard(mtx_);
+  uint64_t id;
+  do {
+    id = random_();
+  } while (id == 0);
+  return id;
+}
+
+void Tracer::OnPush(Frame& frame, int lane, bool is_origin) {
+  int64_t now = NowMicros();
+  if (!IsTraced(frame)) {
+    if (!is_origin || !ShouldSample()) {
+      return;
+    }
+    frame.SetValue(TraceIdField(), NewTraceId());
+  } else if (is_origin && frame.Count(TracePushMicrosField().GetId()) != 0) {
+    // The frame was sent by another process, which stamped it on the way out.
+    RecordSpan(frame.GetValue(TraceIdField()), GetFrameId(frame), lane,
+               SpanType::TRANSFER, frame.GetValue(TracePushMicrosField()),
+               now);
+  }
+  frame.SetValue(TracePushMicrosField(), (unsigned long)now);
+}
+
+void Tracer::OnSend(Frame& frame) {
+  if (IsTraced(frame)) {
+    frame.SetValue(TracePushMicrosField(), (unsigned long)NowMicros());
+  }
+}
+
+void Tracer::RecordSpan(uint64_t trace_id, unsigned long frame_id, int lane,
+                        SpanType type, int64_t start_micros,
+                        int64_t end_micros) {
+  Span span;
+  span.trace_id = trace_id;
+  span.frame_id = frame_id;
+  span.lane = lane;
+  span.type = type;
+  span.start_micros = start_micros;
+  span.duration_micros = std::max(end_micros - start_micros, (int64_t)0);
+
+  std::lock_guard<std::mutex> guard(mtx_);
+  spans_[next_span_] = span;
+  if (++next_span_ == max_spans_) {
+    next_span_ = 0;
+    wrapped_ = true;
+  }
+}
+
+std::vector<Tracer::Span> Tracer::GetSpans() const {
+  std::lock_guard<std::mutex> guard(mtx_);
+  std::vector<Span> spans;
+  if (wrapped_) {
+    spans.insert(spans.end(), spans_.begin() + next_span_, spans_.end());
+  }
+  spans.insert(spans.end(), spans_.begin(), spans_.begin() + next_span_);
+  return spans;
+}
+
+void Tracer::Clear() {
+  std::lock_guard<std::mutex> guard(mtx_);
+  next_span_ = 0;
+  wrapped_ = false;
+}
+
+void Tracer::WriteChromeTrace(std::ostream& out) const {
+  std::vector<Span> spans = GetSpans();
+  std::vector<std::string> lane_names;
+  {
+    std::lock_guard<std::mutex> guard(mtx_);
+    lane_names = lane_names_;
+  }
+
+  // Every operator gets a row of its own, labeled with its name. Trace IDs are
+  // written as strings, since JSON numbers cannot hold 64 bits.
+  int pid = getpid();
+  out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+  out << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":" << pid
+      << ",\"args\":{\"name\":\"saf\"}}";
+  for (size_t lane = 0; lane < lane_names.size(); ++lane) {
+    out << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" << pid
+        << ",\"tid\":" << lane << ",\"args\":{\"name\":\""
+        << EscapeJsonString(lane_names[lane]) << "\"}}";
+  }
+  for (const auto& span : spans) {
+    out << ",\n{\"name\":\"" << GetSpanName(span.type)
+        << "\",\"cat\":\"saf\",\"ph\":\"X\",\"pid\":" << pid
+        << ",\"tid\":" << span.lane << ",\"ts\":" << span.start_micros
+        << ",\"dur\":" << span.duration_micros << ",\"args\":{\"trace_id\":\""
+        << std::hex << span.trace_id << std::dec
+        << "\",\"frame_id\":" << span.frame_id << "}}";
+  }
+  out << "]}" << std::endl;
+}
+
+bool Tracer::DumpChromeTrace(const std::string& path) const {
+  std::ofstream out(path);
+  if (!out) {
+    LOG(ERROR) << "Unable to write trace to " << path;
+    return false;
+  }
+  WriteChromeTrace(out);
+  return out.good();
+}
+
+void Tracer::InstallSignalHandler(const std::string& path_prefix) {
+  std::lock_guard<std::mutex> guard(mtx_);
+  if (signal_handler_installed_) {
+    LOG(WARNING) << "The trace dump signal handler is already installed";
+    return;
+  }
+  int fds[2];
+  CHECK(pipe2(fds, O_CLOEXEC) == 0) << "Unable to create the trace dump pipe";
+  CHECK(fcntl(fds[1], F_SETFL, O_NONBLOCK) == 0)
+      << "Unable to make the trace dump pipe non-blocking";
+  signal_pipe_fd = fds[1];
+  std::thread(&Tracer::DumpOnSignal, this, fds[0], path_prefix).detach();
+
+  struct sigaction action;
+  action.sa_handler = HandleDumpSignal;
+  sigemptyset(&action.sa_mask);
+  action.sa_flags = SA_RESTART;
+  CHECK(sigaction(SIGUSR1, &action, nullptr) == 0)
+      << "Unable to install the SIGUSR1 handler";
+  signal_handler_installed_ = true;
+  LOG(INFO) << "Send SIGUSR1 to dump the trace to " << path_prefix
+            << ".<pid>.<n>.json";
+}
+
+void Tracer::DumpOnSignal(int fd, std::string path_prefix) {
+  int pid = getpid();
+  for (int num_dumps = 0;; ++num_dumps) {
+    char byte;
+    ssize_t ret = read(fd, &byte, 1);
+    if (ret < 0 && errno == EINTR) {
+      --num_dumps;
+      continue;
+    } else if (ret <= 0) {
+      return;
+    }
+    std::string path = path_prefix + "." + std::to_string(pid) + "." +
+                       std::to_string(num_dumps) + ".json";
+    if (DumpChromeTrace(path)) {
+      LOG(INFO) << "Dumped trace to " << path;
+    }
+  }
+}
+
+TraceScope::TraceScope(int lane)
+    : lane_(lane),
+      enabled_(Tracer::IsEnabled()),
+      start_micros_(enabled_ ? Tracer::NowMicros() : 0) {}
+
+TraceScope::~TraceScope() {
+  if (inputs_.empty()) {
+    return;
+  }
+  int64_t end_micros = Tracer::NowMicros();
+  Tracer& tracer = Tracer::GetInstance();
+  for (const auto& input : inputs_) {
+    tracer.RecordSpan(input.first, input.second, lane_,
+                      Tracer::SpanType::PROCESS, start_micros_, end_micros);
+  }
+}
+
+void TraceScope::AddInput(const Frame& frame) {
+  if (!enabled_ || !Tracer::IsTraced(frame)) {
+    return;
+  }
+  uint64_t trace_id = frame.GetValue(TraceIdField());
+  unsigned long frame_id = GetFrameId(frame);
+  if (frame.Count(TracePushMicrosField().GetId()) != 0) {
+    Tracer::GetInstance().RecordSpan(trace_id, frame_id, lane_,
+                                     Tracer::SpanType::QUEUE,
+                                     frame.GetValue(TracePushMicrosField()),
+                                     start_micros_);
+  }
+  inputs_.emplace_back(trace_id, frame_id);
+}
@@ -0,0 +1,147 @@
+// Copyright 2018 The SAF Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SAF_STREAM_TRACER_H_
+#define SAF_STREAM_TRACER_H_
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+class Frame;
+
+// Tracer follows a sample of frames through the pipeline and records, for
+// every operator that they pass through, how long they waited in its queue and
+// how long it took to process them. Spans are kept in a fixed-size flight
+// recorder, so tracing can be left on in production, and can be dumped in the
+// Chrome trace format (viewable in chrome://tracing or Perfetto) at any time.
+//
+// A frame is sampled when it enters the pipeline, i.e., when it is first
+// pushed by an operator without sources, and then carries its trace ID and
+// the time at which it was last pushed in the "trace_id" and
+// "trace_push_micros" fields. Since those are ordinary fields, traces continue
+// across FrameSender and FramePublisher process boundaries, where the time in
+// transit is recorded as a span of the receiving operator.
+class Tracer {
+ public:
+  enum class SpanType : uint8_t { QUEUE, PROCESS, TRANSFER };
+
+  struct Span {
+    uint64_t trace_id;
+    unsigned long frame_id;
+    // Identifies the operator that recorded the span (see RegisterLane()).
+    int lane;
+    SpanType type;
+    // Microseconds since the epoch.
+    int64_t start_micros;
+    int64_t duration_micros;
+  };
+
+  static const char* kTraceIdKey;
+  static const char* kTracePushMicrosKey;
+  static constexpr size_t kDefaultMaxSpans = 1 << 16;
+
+  // Returns the process-wide tracer. It is never destroyed.
+  static Tracer& GetInstance();
+  // Whether any frames are being sampled. Cheap enough to check for every
+  // frame.
+  static bool IsEnabled() { return enabled_.load(std::memory_order_relaxed); }
+  static bool IsTraced(const Frame& frame);
+  static int64_t NowMicros();
+
+  // Traces about a fraction "rate" (between 0 and 1) of the frames that enter
+  // the pipeline. 0, the default, turns tracing off.
+  void SetSamplingRate(double rate);
+  // Keep the most recent "max_spans" spans. Drops all current spans.
+  void SetMaxSpans(size_t max_spans);
+  // Returns a lane for spans recorded by operator "name". Every call returns
+  // a new lane.
+  int RegisterLane(const std::string& name);
+
+  // Called for every frame that an operator pushes. Samples frames that enter
+  // the pipeline at "is_origin" operators, and stamps traced frames with the
+  // current time.
+  void OnPush(Frame& frame, int lane, bool is_origin);
+  // Stamps a traced frame with the current time just before it is sent to
+  // another process.
+  void OnSend(Frame& frame);
+  void RecordSpan(uint64_t trace_id, unsigned long frame_id, int lane,
+                  SpanType type, int64_t start_micros, int64_t end_micros);
+
+  // Returns the recorded spans, oldest first.
+  std::vector<Span> GetSpans() const;
+  // Drops all recorded spans.
+  void Clear();
+  void WriteChromeTrace(std::ostream& out) const;
+  // Returns false if "path" cannot be written.
+  bool DumpChromeTrace(const std::string& path) const;
+  // Dump the spans to "<path_prefix>.<pid>.<n>.json" whenever the process
+  // receives SIGUSR1. The dump happens on a background thread, since a signal
+  // handler cannot safely take locks or allocate memory.
+  void InstallSignalHandler(const std::string& path_prefix);
+
+ private:
+  Tracer();
+  bool ShouldSample();
+  uint64_t NewTraceId();
+  void DumpOnSignal(int fd, std::string path_prefix);
+
+  static std::atomic<bool> enabled_;
+  // Every "sample_period_"th frame that enters the pipeline is traced.
+  std::atomic<uint64_t> sample_period_;
+  std::atomic<uint64_t> num_candidates_;
+
+  mutable std::mutex mtx_;
+  // The flight recorder, a ring buffer of spans. "next_span_" is where the
+  // next span goes.
+  std::vector<Span> spans_;
+  size_t max_spans_;
+  size_t next_span_;
+  bool wrapped_;
+  std::vector<std::string> lane_names_;
+  std::mt19937_64 random_;
+  bool signal_handler_installed_;
+};
+
+// Traces the processing of a group of input frames, from when the scope is
+// created until it is destroyed. Usage:
+//
+//   TraceScope trace(lane);
+//   trace.AddInput(*frame);  // For every input frame.
+//   Process();
+class TraceScope {
+ public:
+  explicit TraceScope(int lane);
+  ~TraceScope();
+  TraceScope(const TraceScope&) = delete;
+  TraceScope& operator=(const TraceScope&) = delete;
+
+  // Records the time that "frame" waited since it was last pushed, if it is
+  // traced, and traces its processing when the scope ends.
+  void AddInput(const Frame& frame);
+
+ private:
+  const int lane_;
+  const bool enabled_;
+  int64_t start_micros_;
+  // The trace and frame IDs of the traced inputs.
+  std::vector<std::pair<uint64_t, unsigned long>> inputs_;
+};
+
+#endif  // SAF_STREAM_TRACER_H_
@@ -0,0 +1,253 @@
+// Copyright 2018 The SAF Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "utils/cpu_accounting.h"
+
+#include <time.h>
+
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif  // __linux__
+
+#include <glog/logging.h>
+
+namespace {
+
+// The hardware counters of one thread, read together as a group so that they
+// cover the same instructions.
+class ThreadPerfCounters {
+ public:
+  ThreadPerfCounters();
+  ~ThreadPerfCounters();
+  ThreadPerfCounters(const ThreadPerfCounters&) = delete;
+  ThreadPerfCounters& operator=(const ThreadPerfCounters&) = delete;
+
+  bool IsOpen() const { return !fds_.empty(); }
+  // Adds the counts so far to "stats".
+  void Read(CpuStats& stats) const;
+
+ private:
+  // The CpuStats member that each counter is added to, in group order.
+  std::vector<uint64_t CpuStats::*> members_;
+  std::vector<int> fds_;
+};
+
+ThreadPerfCounters::ThreadPerfCounters() {
+#ifdef __linux__
+  struct Event {
+    uint64_t config;
+    uint64_t CpuStats::*member;
+  };
+  // The first event leads the group, so without it there are no counters.
+  const Event events[] = {
+      {PERF_COUNT_HW_CPU_CYCLES, &CpuStats::cycles},
+      {PERF_COUNT_HW_INSTRUCTIONS, &CpuStats::instructions},
+      {PERF_COUNT_HW_CACHE_MISSES, &CpuStats::llc_misses},
+      {PERF_COUNT_HW_BRANCH_MISSES, &CpuStats::branch_misses}};
+  for (const auto& event : events) {
+    perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = event.config;
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED |
+                       PERF_FORMAT_TOTAL_TIME_RUNNING;
+    // Counting user space only is allowed with the default
+    // perf_event_paranoid setting.
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    int group_fd = fds_.empty() ? -1 : fds_.front();
+    int fd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, group_fd,
+                          PERF_FLAG_FD_CLOEXEC);
+    if (fd < 0) {
+      if (fds_.empty()) {
+        // Every thread would fail the same way, so only say so once.
+        static std::atomic<bool> warned(false);
+        if (!warned.exchange(true)) {
+          LOG(WARNING) << "Hardware performance counters are unavailable, "
+                       << "only CPU time is accounted for: " << strerror(errno);
+        }
+        return;
+      }
+      // Keep the other counters of the group.
+      continue;
+    }
+    fds_.push_back(fd);
+    members_.push_back(event.member);
+  }
+#endif  // __linux__
+}
+
+ThreadPerfCounters::~ThreadPerfCounters() {
+#ifdef __linux__
+  for (int fd : fds_) {
+    close(fd);
+  }
+#endif  // __linux__
+}
+
+void ThreadPerfCounters::Read(CpuStats& stats) const {
+#ifdef __linux__
+  if (fds_.empty()) {
+    return;
+  }
+  // nr, time_enabled, time_running, then one value per counter.
+  uint64_t buf[3 + 4];
+  ssize_t expected = (3 + members_.size()) * sizeof(uint64_t);
+  if (read(fds_.front(), buf, sizeof(buf)) != expected) {
+    return;
+  }
+  uint64_t time_enabled = buf[1];
+  uint64_t time_running = buf[2];
+  for (size_t i = 0; i < members_.size(); ++i) {
+    uint64_t value = buf[3 + i];
+    // When there are more counters than the PMU can hold, the kernel takes
+    // turns, so scale up to the whole time.
+    if (time_running > 0 && time_running < time_enabled) {
+      value = (uint64_t)((double)value * time_enabled / time_running);
+    }
+    stats.*members_.at(i) += value;
+  }
+#else
+  (void)stats;
+#endif  // __linux__
+}
+
+ThreadPerfCounters& GetThreadPerfCounters() {
+  thread_local ThreadPerfCounters counters;
+  return counters;
+}
+
+thread_local CpuAccountingScope* current_scope = nullptr;
+
+// Formats "value" with a K, M or G suffix.
+std::string FormatCount(uint64_t value) {
+  std::ostringstream o;
+  o << std::fixed << std::setprecision(1);
+  if (value >= 1000000000) {
+    o << value / 1e9 << "G";
+  } else if (value >= 1000000) {
+    o << value / 1e6 << "M";
+  } else if (value >= 1000) {
+    o << value / 1e3 << "K";
+  } else {
+    o << value;
+  }
+  return o.str();
+}
+
+}  // namespace
+
+CpuStats& CpuStats::operator+=(const CpuStats& other) {
+  cpu_micros += other.cpu_micros;
+  cycles += other.cycles;
+  instructions += other.instructions;
+  llc_misses += other.llc_misses;
+  branch_misses += other.branch_misses;
+  return *this;
+}
+
+CpuStats CpuStats::operator-(const CpuStats& other) const {
+  // Counts can appear to go backwards when the kernel scales multiplexed
+  // counters, so clamp at 0.
+  auto minus = [](uint64_t a, uint64_t b) { return a > b ? a - b : 0; };
+  CpuStats diff;
+  diff.cpu_micros = minus(cpu_micros, other.cpu_micros);
+  diff.cycles = minus(cycles, other.cycles);
+  diff.instructions = minus(instructions, other.instructions);
+  diff.llc_misses = minus(llc_misses, other.llc_misses);
+  diff.branch_misses = minus(branch_misses, other.branch_misses);
+  return diff;
+}
+
+double CpuStats::GetInstructionsPerCycle() const {
+  return cycles == 0 ? 0 : (double)instructions / cycles;
+}
+
+double CpuStats::GetLlcMissesPerKiloInstruction() const {
+  return instructions == 0 ? 0 : 1000.0 * llc_misses / instructions;
+}
+
+std::string CpuStats::ToString() const {
+  std::ostringstream o;
+  o << std::fixed << std::setprecision(1) << "cpu=" << cpu_micros / 1000.0
+    << "ms";
+  if (cycles > 0) {
+    o << " cycles=" << FormatCount(cycles) << std::setprecision(2)
+      << " ipc=" << GetInstructionsPerCycle()
+      << " llc_mpki=" << GetLlcMissesPerKiloInstruction()
+      << " branch_misses=" << FormatCount(branch_misses);
+  }
+  return o.str();
+}
+
+CpuStats ReadThreadCpuStats() {
+  CpuStats stats;
+  timespec ts;
+  if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) == 0) {
+    stats.cpu_micros = (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+  }
+  GetThreadPerfCounters().Read(stats);
+  return stats;
+}
+
+bool HasThreadHardwareCounters() { return GetThreadPerfCounters().IsOpen(); }
+
+CpuAccountingScope::CpuAccountingScope()
+    : start_(ReadThreadCpuStats()), parent_(current_scope), stopped_(false) {
+  current_scope = this;
+}
+
+CpuAccountingScope::~CpuAccountingScope() { Stop(); }
+
+CpuStats CpuAccountingScope::Stop() {
+  if (stopped_) {
+    return CpuStats();
+  }
+  stopped_ = true;
+  CpuStats total = ReadThreadCpuStats() - start_;
+  current_scope = parent_;
+  if (parent_ != nullptr) {
+    // The parent does not count what this scope measured.
+    parent_->nested_ += total;
+  }
+  return total - nested_;
+}
+
+CpuStats CpuAccountingCounters::Get() const {
+  CpuStats stats;
+  stats.cpu_micros = cpu_micros_;
+  stats.cycles = cycles_;
+  stats.instructions = instructions_;
+  stats.llc_misses = llc_misses_;
+  stats.branch_misses = branch_misses_;
+  return stats;
+}
+
+void CpuAccountingCounters::Record(const CpuStats& stats) {
+  cpu_micros_.fetch_add(stats.cpu_micros, std::memory_order_relaxed);
+  cycles_.fetch_add(stats.cycles, std::memory_order_relaxed);
+  instructions_.fetch_add(stats.instructions, std::memory_order_relaxed);
+  llc_misses_.fetch_add(stats.llc_misses, std::memory_order_relaxed);
+  branch_misses_.fetch_add(stats.branch_misses, std::memory_order_relaxed);
+}
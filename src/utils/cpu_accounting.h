@@ -0,0 +1,96 @@
+// Copyright 2018 The SAF Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Per-thread CPU time and hardware performance counters, for telling apart
+// code that computes from code that waits on locks, is preempted, or stalls on
+// memory.
+
+#ifndef SAF_UTILS_CPU_ACCOUNTING_H_
+#define SAF_UTILS_CPU_ACCOUNTING_H_
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// A snapshot of the resources that a thread used.
+struct CpuStats {
+  // CPU time, as reported by CLOCK_THREAD_CPUTIME_ID.
+  uint64_t cpu_micros = 0;
+  // Hardware events, counted in user space only. These stay 0 where
+  // perf_event_open() is unavailable, e.g., in most VMs and containers, or
+  // when /proc/sys/kernel/perf_event_paranoid forbids it.
+  uint64_t cycles = 0;
+  uint64_t instructions = 0;
+  uint64_t llc_misses = 0;
+  uint64_t branch_misses = 0;
+
+  CpuStats& operator+=(const CpuStats& other);
+  CpuStats operator-(const CpuStats& other) const;
+
+  // Instructions per cycle. Low values (well below 1) point to stalls, e.g.,
+  // on memory, rather than to too much computation.
+  double GetInstructionsPerCycle() const;
+  // Last-level cache misses per thousand instructions. High values (above 10
+  // or so) mean that the code is memory-bound.
+  double GetLlcMissesPerKiloInstruction() const;
+  // E.g., "cpu=12.3ms cycles=45.6M ipc=1.42 llc_mpki=3.10 branch_misses=12.0K".
+  std::string ToString() const;
+};
+
+// Returns what the calling thread has used since it started. Hardware counters
+// are opened for the thread on its first call.
+CpuStats ReadThreadCpuStats();
+
+// Returns whether the calling thread has hardware counters, i.e., whether
+// ReadThreadCpuStats() counts hardware events.
+bool HasThreadHardwareCounters();
+
+// Measures what the calling thread uses from construction until Stop(),
+// excluding what nested scopes on the same thread measure themselves, e.g., a
+// fused operator that runs inside the Process() of the operator that feeds it.
+class CpuAccountingScope {
+ public:
+  CpuAccountingScope();
+  ~CpuAccountingScope();
+  CpuAccountingScope(const CpuAccountingScope&) = delete;
+  CpuAccountingScope& operator=(const CpuAccountingScope&) = delete;
+
+  // Ends the scope and returns what it used, minus its nested scopes. Must be
+  // called on the thread that created the scope, at most once.
+  CpuStats Stop();
+
+ private:
+  CpuStats start_;
+  // What the nested scopes used.
+  CpuStats nested_;
+  CpuAccountingScope* parent_;
+  bool stopped_;
+};
+
+// Totals that are updated by one or more threads and may be read from any
+// thread.
+class CpuAccountingCounters {
+ public:
+  CpuStats Get() const;
+  void Record(const CpuStats& stats);
+
+ private:
+  std::atomic<uint64_t> cpu_micros_{0};
+  std::atomic<uint64_t> cycles_{0};
+  std::atomic<uint64_t> instructions_{0};
+  std::atomic<uint64_t> llc_misses_{0};
+  std::atomic<uint64_t> branch_misses_{0};
+};
+
+#endif  // SAF_UTILS_CPU_ACCOUNTING_H_
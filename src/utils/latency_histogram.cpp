@@ -0,0 +1,148 @@
+// Copyright 2018 The SAF Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "utils/latency_histogram.h"
+
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+
+constexpr int LatencyHistogram::kSubBucketBits;
+constexpr int64_t LatencyHistogram::kSubBuckets;
+constexpr int LatencyHistogram::kMaxValueBits;
+constexpr size_t LatencyHistogram::kNumBuckets;
+
+static constexpr int64_t kHalfSubBuckets = LatencyHistogram::kSubBuckets / 2;
+static constexpr int64_t kMaxMicros =
+    (int64_t(1) << LatencyHistogram::kMaxValueBits) - 1;
+
+std::string LatencySummary::ToString() const {
+  std::ostringstream o;
+  o << "n=" << count << " mean=" << mean_ms << " p50=" << p50_ms
+    << " p90=" << p90_ms << " p99=" << p99_ms << " p99.9=" << p999_ms
+    << " max=" << max_ms << " (ms)";
+  return o.str();
+}
+
+LatencyHistogram::LatencyHistogram() { Reset(); }
+
+size_t LatencyHistogram::GetBucket(int64_t micros) {
+  if (micros < kSubBuckets) {
+    return micros;
+  }
+  // Keep the kSubBucketBits most significant bits of the value. The bucket is
+  // their value, offset by half a power of two per bit that was dropped.
+  int shift = (63 - __builtin_clzll(micros)) - (kSubBucketBits - 1);
+  return shift * kHalfSubBuckets + (micros >> shift);
+}
+
+int64_t LatencyHistogram::GetBucketMaxMicros(size_t bucket) {
+  if (bucket < (size_t)kSubBuckets) {
+    return bucket;
+  }
+  int shift = bucket / kHalfSubBuckets - 1;
+  int64_t sub_bucket = bucket % kHalfSubBuckets + kHalfSubBuckets;
+  return ((sub_bucket + 1) << shift) - 1;
+}
+
+void LatencyHistogram::Record(int64_t micros) {
+  micros = std::min(std::max(micros, int64_t(0)), kMaxMicros);
+  counts_[GetBucket(micros)].fetch_add(1, std::memory_order_relaxed);
+  count_.fetch_add(1, std::memory_order_relaxed);
+  sum_micros_.fetch_add(micros, std::memory_order_relaxed);
+  int64_t max_micros = max_micros_.load(std::memory_order_relaxed);
+  while (micros > max_micros &&
+         !max_micros_.compare_exchange_weak(max_micros, micros,
+                                            std::memory_order_relaxed)) {
+  }
+}
+
+void LatencyHistogram::Merge(const LatencyHistogram& other) {
+  for (size_t i = 0; i < kNumBuckets; ++i) {
+    uint64_t count = other.counts_[i].load(std::memory_order_relaxed);
+    if (count > 0) {
+      counts_[i].fetch_add(count, std::memory_order_relaxed);
+    }
+  }
+  count_.fetch_add(other.count_.load(std::memory_order_relaxed),
+                   std::memory_order_relaxed);
+  sum_micros_.fetch_add(other.sum_micros_.load(std::memory_order_relaxed),
+                        std::memory_order_relaxed);
+  int64_t other_max = other.max_micros_.load(std::memory_order_relaxed);
+  int64_t max_micros = max_micros_.load(std::memory_order_relaxed);
+  while (other_max > max_micros &&
+         !max_micros_.compare_exchange_weak(max_micros, other_max,
+                                            std::memory_order_relaxed)) {
+  }
+}
+
+void LatencyHistogram::Reset() {
+  for (auto& count : counts_) {
+    count.store(0, std::memory_order_relaxed);
+  }
+  count_ = 0;
+  sum_micros_ = 0;
+  max_micros_ = 0;
+}
+
+unsigned long LatencyHistogram::GetCount() const { return count_; }
+
+double LatencyHistogram::GetMeanMs() const {
+  uint64_t count = count_;
+  if (count == 0) {
+    return 0;
+  }
+  return (double)sum_micros_ / count / 1000;
+}
+
+double LatencyHistogram::GetMaxMs() const { return max_micros_ / 1000.0; }
+
+double LatencyHistogram::GetPercentileMs(double percentile) const {
+  // Sum the buckets instead of using "count_", which may be out of step with
+  // them while values are being recorded.
+  uint64_t total = 0;
+  for (const auto& count : counts_) {
+    total += count.load(std::memory_order_relaxed);
+  }
+  if (total == 0) {
+    return 0;
+  }
+
+  percentile = std::min(std::max(percentile, 0.0), 100.0);
+  uint64_t rank = std::max(
+      (uint64_t)1, (uint64_t)std::ceil(percentile / 100 * total));
+  uint64_t seen = 0;
+  for (size_t i = 0; i < kNumBuckets; ++i) {
+    seen += counts_[i].load(std::memory_order_relaxed);
+    if (seen >= rank) {
+      // Report the top of the bucket, but never more than the largest value
+      // that was actually recorded.
+      int64_t micros = std::min(GetBucketMaxMicros(i), max_micros_.load());
+      return micros / 1000.0;
+    }
+  }
+  return GetMaxMs();
+}
+
+LatencySummary LatencyHistogram::GetSummary() const {
+  LatencySummary summary;
+  summary.count = GetCount();
+  summary.mean_ms = GetMeanMs();
+  summary.p50_ms = GetPercentileMs(50);
+  summary.p90_ms = GetPercentileMs(90);
+  summary.p99_ms = GetPercentileMs(99);
+  summary.p999_ms = GetPercentileMs(99.9);
+  summary.max_ms = GetMaxMs();
+  return summary;
+}
@@ -0,0 +1,85 @@
+// Copyright 2018 The SAF Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SAF_UTILS_LATENCY_HISTOGRAM_H_
+#define SAF_UTILS_LATENCY_HISTOGRAM_H_
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// A snapshot of the distribution of a latency.
+struct LatencySummary {
+  unsigned long count = 0;
+  double mean_ms = 0;
+  double p50_ms = 0;
+  double p90_ms = 0;
+  double p99_ms = 0;
+  double p999_ms = 0;
+  double max_ms = 0;
+
+  // E.g., "n=100 mean=1.2 p50=1.1 p90=1.9 p99=3.2 p99.9=4.0 max=4.0 (ms)".
+  std::string ToString() const;
+};
+
+// A histogram of latencies in the style of HdrHistogram. Values are counted in
+// log-linear buckets: every power of two is split into kSubBuckets / 2 linear
+// buckets, so every recorded value is known to within 1/64 of itself (and
+// exactly below 128 us) while the whole range from 1 us to 19 hours fits in
+// about 2000 counters.
+//
+// Record() is lock-free and wait-free, so it is cheap enough to call for every
+// frame, and may be called from any number of threads at once. Readers see a
+// snapshot that may miss values recorded concurrently.
+class LatencyHistogram {
+ public:
+  static constexpr int kSubBucketBits = 7;
+  static constexpr int64_t kSubBuckets = int64_t(1) << kSubBucketBits;
+  // Values at or above 2^kMaxValueBits microseconds are counted as the
+  // largest value that fits.
+  static constexpr int kMaxValueBits = 36;
+  static constexpr size_t kNumBuckets =
+      (kMaxValueBits - kSubBucketBits + 2) * (kSubBuckets / 2);
+
+  LatencyHistogram();
+  LatencyHistogram(const LatencyHistogram&) = delete;
+  LatencyHistogram& operator=(const LatencyHistogram&) = delete;
+
+  // Counts a latency of "micros" microseconds. Negative values count as 0.
+  void Record(int64_t micros);
+  // Adds all of the values recorded by "other".
+  void Merge(const LatencyHistogram& other);
+  void Reset();
+
+  unsigned long GetCount() const;
+  double GetMeanMs() const;
+  double GetMaxMs() const;
+  // Returns the latency that "percentile" percent of the values are at or
+  // below, e.g., GetPercentileMs(99.9). Returns 0 if nothing was recorded.
+  double GetPercentileMs(double percentile) const;
+  LatencySummary GetSummary() const;
+
+ private:
+  static size_t GetBucket(int64_t micros);
+  // The largest value that is counted in bucket "bucket".
+  static int64_t GetBucketMaxMicros(size_t bucket);
+
+  std::array<std::atomic<uint64_t>, kNumBuckets> counts_;
+  std::atomic<uint64_t> count_;
+  std::atomic<uint64_t> sum_micros_;
+  std::atomic<int64_t> max_micros_;
+};
+
+#endif  // SAF_UTILS_LATENCY_HISTOGRAM_H_
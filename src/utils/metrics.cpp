@@ -0,0 +1,264 @@
+// Copyright 2018 The SAF Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "utils/metrics.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+
+#include <glog/logging.h>
+
+#include "utils/perf_utils.h"
+
+static const char* GetStringForMetricType(MetricType type) {
+  switch (type) {
+    case METRIC_COUNTER:
+      return "counter";
+    case METRIC_GAUGE:
+      return "gauge";
+    case METRIC_SUMMARY:
+      return "summary";
+  }
+  return "untyped";
+}
+
+// Writes "value" the way Prometheus expects it. Whole numbers, such as
+// counts, are written without an exponent so that they stay exact.
+static void WriteValue(std::ostream& o, double value) {
+  if (std::isnan(value)) {
+    o << "NaN";
+  } else if (std::isinf(value)) {
+    o << (value > 0 ? "+Inf" : "-Inf");
+  } else if (value == std::floor(value) && std::fabs(value) < 1e15) {
+    o << static_cast<int64_t>(value);
+  } else {
+    o << std::setprecision(10) << value;
+  }
+}
+
+// Writes one sample, e.g., 'name{a="1",b="2"} 3'. "extra_label" is appended
+// to "labels" if it is not empty.
+static void WriteSample(std::ostream& o, const std::string& name,
+                        const MetricLabels& labels,
+                        const std::string& extra_label, double value) {
+  o << name;
+  if (!labels.empty() || !extra_label.empty()) {
+    o << "{";
+    bool first = true;
+    for (const auto& label : labels) {
+      o << (first ? "" : ",") << label.first << "=\""
+        << EscapeMetricLabelValue(label.second) << "\"";
+      first = false;
+    }
+    if (!extra_label.empty()) {
+      o << (first ? "" : ",") << extra_label;
+    }
+    o << "}";
+  }
+  o << " ";
+  WriteValue(o, value);
+  o << "\n";
+}
+
+std::string EscapeMetricLabelValue(const std::string& value) {
+  std::string escaped;
+  escaped.reserve(value.size());
+  for (char c : value) {
+    if (c == '\\') {
+      escaped += "\\\\";
+    } else if (c == '"') {
+      escaped += "\\\"";
+    } else if (c == '\n') {
+      escaped += "\\n";
+    } else {
+      escaped += c;
+    }
+  }
+  return escaped;
+}
+
+MetricsRegistry& MetricsRegistry::GetInstance() {
+  static MetricsRegistry* registry = [] {
+    auto registry = new MetricsRegistry();
+    registry->AddCallback("saf_process_resident_memory_bytes",
+                          "Physical memory used by the process.",
+                          METRIC_GAUGE, {},
+                          [] { return GetPhysicalKB() * 1024.0; });
+    return registry;
+  }();
+  return *registry;
+}
+
+MetricsRegistry::MetricsRegistry() {}
+
+MetricsRegistry::Family& MetricsRegistry::GetFamily(const std::string& name,
+                                                    const std::string& help,
+                                                    MetricType type) {
+  auto it = families_.find(name);
+  if (it == families_.end()) {
+    Family& family = families_[name];
+    family.help = help;
+    family.type = type;
+    return family;
+  }
+  CHECK(it->second.type == type)
+      << "Metric \"" << name << "\" is already a "
+      << GetStringForMetricType(it->second.type);
+  return it->second;
+}
+
+MetricsRegistry::Series* MetricsRegistry::FindSeries(
+    Family& family, const MetricLabels& labels) {
+  for (const auto& series : family.series) {
+    if (series->labels == labels) {
+      return series.get();
+    }
+  }
+  return nullptr;
+}
+
+Counter& MetricsRegistry::GetCounter(const std::string& name,
+                                     const std::string& help,
+                                     const MetricLabels& labels) {
+  std::lock_guard<std::mutex> guard(mtx_);
+  Family& family = GetFamily(name, help, METRIC_COUNTER);
+  Series* series = FindSeries(family, labels);
+  if (series == nullptr) {
+    family.series.emplace_back(new Series());
+    series = family.series.back().get();
+    series->labels = labels;
+  }
+  CHECK(!series->callback) << "Metric \"" << name
+                           << "\" is already exported by a callback";
+  if (series->counter == nullptr) {
+    series->counter = std::make_unique<Counter>();
+  }
+  return *series->counter;
+}
+
+Gauge& MetricsRegistry::GetGauge(const std::string& name,
+                                 const std::string& help,
+                                 const MetricLabels& labels) {
+  std::lock_guard<std::mutex> guard(mtx_);
+  Family& family = GetFamily(name, help, METRIC_GAUGE);
+  Series* series = FindSeries(family, labels);
+  if (series == nullptr) {
+    family.series.emplace_back(new Series());
+    series = family.series.back().get();
+    series->labels = labels;
+  }
+  CHECK(!series->callback) << "Metric \"" << name
+                           << "\" is already exported by a callback";
+  if (series->gauge == nullptr) {
+    series->gauge = std::make_unique<Gauge>();
+  }
+  return *series->gauge;
+}
+
+void MetricsRegistry::AddCallback(const std::string& name,
+                                  const std::string& help, MetricType type,
+                                  const MetricLabels& labels,
+                                  std::function<double()> callback) {
+  CHECK(type != METRIC_SUMMARY) << "Use AddLatencyCallback() for summaries";
+  std::lock_guard<std::mutex> guard(mtx_);
+  Family& family = GetFamily(name, help, type);
+  Series* series = FindSeries(family, labels);
+  if (series == nullptr) {
+    family.series.emplace_back(new Series());
+    series = family.series.back().get();
+    series->labels = labels;
+  }
+  CHECK(series->counter == nullptr && series->gauge == nullptr)
+      << "Metric \"" << name << "\" is already updated directly";
+  series->callback = std::move(callback);
+}
+
+void MetricsRegistry::AddLatencyCallback(
+    const std::string& name, const std::string& help,
+    const MetricLabels& labels, std::function<LatencySummary()> callback) {
+  std::lock_guard<std::mutex> guard(mtx_);
+  Family& family = GetFamily(name, help, METRIC_SUMMARY);
+  Series* series = FindSeries(family, labels);
+  if (series == nullptr) {
+    family.series.emplace_back(new Series());
+    series = family.series.back().get();
+    series->labels = labels;
+  }
+  series->latency_callback = std::move(callback);
+}
+
+void MetricsRegistry::RemoveCallbacks(const MetricLabels& labels) {
+  std::lock_guard<std::mutex> guard(mtx_);
+  for (auto it = families_.begin(); it != families_.end();) {
+    auto& series = it->second.series;
+    series.erase(
+        std::remove_if(series.begin(), series.end(),
+                       [&labels](const std::unique_ptr<Series>& s) {
+                         if (!s->callback && !s->latency_callback) {
+                           return false;
+                         }
+                         for (const auto& label : labels) {
+                           auto match = s->labels.find(label.first);
+                           if (match == s->labels.end() ||
+                               match->second != label.second) {
+                             return false;
+                           }
+                         }
+                         return true;
+                       }),
+        series.end());
+    if (series.empty()) {
+      it = families_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+std::string MetricsRegistry::Serialize() const {
+  std::ostringstream o;
+  std::lock_guard<std::mutex> guard(mtx_);
+  for (const auto& pair : families_) {
+    const std::string& name = pair.first;
+    const Family& family = pair.second;
+    o << "# HELP " << name << " " << family.help << "\n"
+      << "# TYPE " << name << " " << GetStringForMetricType(family.type)
+      << "\n";
+    for (const auto& series : family.series) {
+      if (series->counter != nullptr) {
+        WriteSample(o, name, series->labels, "", series->counter->Get());
+      } else if (series->gauge != nullptr) {
+        WriteSample(o, name, series->labels, "", series->gauge->Get());
+      } else if (series->callback) {
+        WriteSample(o, name, series->labels, "", series->callback());
+      } else if (series->latency_callback) {
+        LatencySummary summary = series->latency_callback();
+        WriteSample(o, name, series->labels, "quantile=\"0.5\"",
+                    summary.p50_ms / 1000);
+        WriteSample(o, name, series->labels, "quantile=\"0.9\"",
+                    summary.p90_ms / 1000);
+        WriteSample(o, name, series->labels, "quantile=\"0.99\"",
+                    summary.p99_ms / 1000);
+        WriteSample(o, name, series->labels, "quantile=\"0.999\"",
+                    summary.p999_ms / 1000);
+        WriteSample(o, name + "_sum", series->labels, "",
+                    summary.mean_ms * summary.count / 1000);
+        WriteSample(o, name + "_count", series->labels, "", summary.count);
+      }
+    }
+  }
+  return o.str();
+}
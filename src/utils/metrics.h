@@ -0,0 +1,139 @@
+// Copyright 2018 The SAF Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// A process-wide registry of metrics that can be scraped by Prometheus.
+
+#ifndef SAF_UTILS_METRICS_H_
+#define SAF_UTILS_METRICS_H_
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "utils/latency_histogram.h"
+
+// Label names and values that identify one series of a metric, e.g.,
+// {{"pipeline", "lobby"}, {"operator", "detector"}}.
+typedef std::map<std::string, std::string> MetricLabels;
+
+// A value that only goes up, e.g., the number of frames processed. Updating it
+// is a single atomic add.
+class Counter {
+ public:
+  Counter() : value_(0) {}
+  void Increment(uint64_t n = 1) {
+    value_.fetch_add(n, std::memory_order_relaxed);
+  }
+  uint64_t Get() const { return value_.load(std::memory_order_relaxed); }
+
+ private:
+  std::atomic<uint64_t> value_;
+};
+
+// A value that goes up and down, e.g., the number of queued frames.
+class Gauge {
+ public:
+  Gauge() : value_(0) {}
+  void Set(double value) { value_.store(value, std::memory_order_relaxed); }
+  void Add(double delta) {
+    double value = value_.load(std::memory_order_relaxed);
+    while (!value_.compare_exchange_weak(value, value + delta,
+                                         std::memory_order_relaxed)) {
+    }
+  }
+  double Get() const { return value_.load(std::memory_order_relaxed); }
+
+ private:
+  std::atomic<double> value_;
+};
+
+enum MetricType { METRIC_COUNTER, METRIC_GAUGE, METRIC_SUMMARY };
+
+// Holds every metric of the process and formats them in the Prometheus text
+// exposition format. Counters and gauges are updated without taking a lock.
+// Values that are already tracked elsewhere, e.g., by an Operator, are
+// exported through callbacks that are only called when the metrics are
+// scraped, so they cost nothing in between.
+class MetricsRegistry {
+ public:
+  static MetricsRegistry& GetInstance();
+
+  MetricsRegistry();
+  MetricsRegistry(const MetricsRegistry&) = delete;
+  MetricsRegistry& operator=(const MetricsRegistry&) = delete;
+
+  // Returns the series "labels" of the counter or gauge "name", creating it
+  // if needed. The returned metric lives as long as the registry, so it can be
+  // kept and updated from any thread. A name may only be used for one type of
+  // metric.
+  Counter& GetCounter(const std::string& name, const std::string& help,
+                      const MetricLabels& labels = {});
+  Gauge& GetGauge(const std::string& name, const std::string& help,
+                  const MetricLabels& labels = {});
+
+  // Exports the series "labels" of the counter or gauge "name", whose value is
+  // returned by "callback" at every scrape. "callback" is called with the
+  // registry's lock held, so it must not call back into the registry.
+  void AddCallback(const std::string& name, const std::string& help,
+                   MetricType type, const MetricLabels& labels,
+                   std::function<double()> callback);
+  // Exports "callback"'s latency distribution as the series "labels" of the
+  // summary "name", in seconds.
+  void AddLatencyCallback(const std::string& name, const std::string& help,
+                          const MetricLabels& labels,
+                          std::function<LatencySummary()> callback);
+  // Removes every callback whose labels include all of "labels". Once this
+  // returns, none of those callbacks are running or will be called again.
+  void RemoveCallbacks(const MetricLabels& labels);
+
+  // Formats every metric in the Prometheus text exposition format, version
+  // 0.0.4.
+  std::string Serialize() const;
+
+ private:
+  struct Series {
+    MetricLabels labels;
+    std::unique_ptr<Counter> counter;
+    std::unique_ptr<Gauge> gauge;
+    std::function<double()> callback;
+    std::function<LatencySummary()> latency_callback;
+  };
+  struct Family {
+    std::string help;
+    MetricType type;
+    std::vector<std::unique_ptr<Series>> series;
+  };
+
+  // Returns the family "name", creating it if needed. Must be called with
+  // "mtx_" held.
+  Family& GetFamily(const std::string& name, const std::string& help,
+                    MetricType type);
+  // Returns the series "labels" of "family", or nullptr if there is none.
+  static Series* FindSeries(Family& family, const MetricLabels& labels);
+
+  mutable std::mutex mtx_;
+  // Sorted by name, so that scrapes list metrics in a stable order.
+  std::map<std::string, Family> families_;
+};
+
+// Escapes "value" for use as a label value, i.e., backslashes, double quotes
+// and newlines.
+std::string EscapeMetricLabelValue(const std::string& value);
+
+#endif  // SAF_UTILS_METRICS_H_
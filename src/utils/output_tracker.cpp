@@ -46,6 +46,7 @@ std::string OutputTracker::GetAndCreateOutputDir(
   if (organize_by_time_) {
     return GetAndCreateDateTimeDir(root_dir_, micros);
   } else {
+    std::lock_guard<std::mutex> guard(mtx_);
     std::string dir = current_dirpath_;
     ++frames_in_current_dir_;
     if (frames_in_current_dir_ == frames_per_dir_) {
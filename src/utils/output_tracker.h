@@ -15,10 +15,12 @@
 #ifndef SAF_UTILS_OUTPUT_TRACKER_H_
 #define SAF_UTILS_OUTPUT_TRACKER_H_
 
+#include <mutex>
 #include <string>
 
 #include <boost/date_time/posix_time/posix_time.hpp>
 
+// Tracks the output directory of each frame. Safe to use from several threads.
 class OutputTracker {
  public:
   OutputTracker(const std::string& root_dir, bool organize_by_time,
@@ -36,6 +38,7 @@ class OutputTracker {
   unsigned long frames_in_current_dir_;
   unsigned long current_dir_idx_;
   std::string current_dirpath_;
+  std::mutex mtx_;
 };
 
 #endif  // SAF_UTILS_OUTPUT_TRACKER_H_
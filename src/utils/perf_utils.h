@@ -52,6 +52,9 @@ inline int GetMemoryInfoKB(std::string key) {
 // Returns the physical memory usage (in KB) of the current process.
 inline int GetPhysicalKB() { return GetMemoryInfoKB("VmRSS"); }
 
+// Returns the peak physical memory usage (in KB) of the current process.
+inline int GetPeakPhysicalKB() { return GetMemoryInfoKB("VmHWM"); }
+
 // Returns the virtual memory usage (in KB) of the current process.
 inline int GetVirtualKB() { return GetMemoryInfoKB("VmSize"); }
 
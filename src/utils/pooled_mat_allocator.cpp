@@ -0,0 +1,346 @@
+// Copyright 2018 The SAF Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "utils/pooled_mat_allocator.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iterator>
+#include <new>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif  // __linux__
+
+#include <glog/logging.h>
+
+#include "utils/thread_utils.h"
+
+// Smaller buffers are cheap enough to get from the system allocator.
+constexpr size_t kMinPooledSize = 4 << 10;
+// Larger buffers are rare and would tie up too much memory while idle.
+constexpr size_t kMaxPooledSize = 64 << 20;
+// The number of idle buffers that each thread keeps per small size class.
+constexpr size_t kThreadCacheBlocks = 4;
+
+constexpr size_t PooledMatAllocator::kHugePageSize;
+constexpr size_t PooledMatAllocator::kDefaultMaxPooledBytes;
+
+MatAllocationStats MatAllocationCounters::Get() const {
+  MatAllocationStats stats;
+  stats.num_allocations = num_allocations_.load(std::memory_order_relaxed);
+  stats.num_pool_hits = num_pool_hits_.load(std::memory_order_relaxed);
+  stats.bytes_allocated = bytes_allocated_.load(std::memory_order_relaxed);
+  return stats;
+}
+
+void MatAllocationCounters::Record(size_t bytes, bool pool_hit) {
+  num_allocations_.fetch_add(1, std::memory_order_relaxed);
+  if (pool_hit) {
+    num_pool_hits_.fetch_add(1, std::memory_order_relaxed);
+  }
+  bytes_allocated_.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+struct PooledMatAllocator::ThreadCache {
+  ThreadCache()
+      : blocks(PooledMatAllocator::GetInstance().class_sizes_.size()),
+        counters(std::make_shared<MatAllocationCounters>()) {}
+  ~ThreadCache();
+
+  // Idle buffers of each small size class.
+  std::vector<std::vector<void*>> blocks;
+  std::shared_ptr<MatAllocationCounters> counters;
+};
+
+// Set once the calling thread's cache has been destroyed, after which any
+// buffers that it frees go straight to the shared pool.
+static thread_local bool thread_cache_destroyed = false;
+// The NUMA node that the calling thread places large buffers on.
+static thread_local int thread_numa_node = -1;
+// The counters of the innermost MatAllocationScope on the calling thread.
+static thread_local MatAllocationCounters* scope_counters = nullptr;
+
+MatAllocationScope::MatAllocationScope(MatAllocationCounters* counters)
+    : parent_(scope_counters) {
+  scope_counters = counters;
+}
+
+MatAllocationScope::~MatAllocationScope() { scope_counters = parent_; }
+
+PooledMatAllocator::ThreadCache::~ThreadCache() {
+  thread_cache_destroyed = true;
+  PooledMatAllocator::GetInstance().Flush(this);
+}
+
+PooledMatAllocator::ThreadCache* PooledMatAllocator::GetThreadCache() {
+  if (thread_cache_destroyed) {
+    return nullptr;
+  }
+  static thread_local ThreadCache cache;
+  return &cache;
+}
+
+PooledMatAllocator& PooledMatAllocator::GetInstance() {
+  static PooledMatAllocator* allocator = new PooledMatAllocator();
+  return *allocator;
+}
+
+void PooledMatAllocator::Install(bool use_huge_pages,
+                                 size_t max_pooled_bytes) {
+  PooledMatAllocator& allocator = GetInstance();
+  allocator.use_huge_pages_ = use_huge_pages;
+  allocator.max_pooled_bytes_ = max_pooled_bytes;
+  cv::Mat::setDefaultAllocator(&allocator);
+  LOG(INFO) << "Pooling cv::Mat buffers (huge pages: "
+            << (use_huge_pages ? "on" : "off")
+            << ", max pooled bytes: " << max_pooled_bytes << ")";
+}
+
+bool PooledMatAllocator::IsInstalled() {
+  return cv::Mat::getDefaultAllocator() == &GetInstance();
+}
+
+std::shared_ptr<const MatAllocationCounters>
+PooledMatAllocator::GetThreadCounters() {
+  ThreadCache* cache = GetThreadCache();
+  if (cache == nullptr) {
+    return std::make_shared<MatAllocationCounters>();
+  }
+  return cache->counters;
+}
+
+void PooledMatAllocator::SetThreadNumaNode(int node) {
+  thread_numa_node = node;
+}
+
+PooledMatAllocator::PooledMatAllocator()
+    : use_huge_pages_(false),
+      max_pooled_bytes_(kDefaultMaxPooledBytes),
+      pooled_bytes_(0) {
+  // Below kHugePageSize there are four size classes per power of two, which
+  // wastes at most 25% of a buffer. Above it, buffers are mapped in whole huge
+  // pages anyway, so the size classes are multiples of kHugePageSize.
+  for (size_t base = kMinPooledSize; base < kHugePageSize; base *= 2) {
+    for (size_t i = 0; i < 4; ++i) {
+      class_sizes_.push_back(base + i * base / 4);
+    }
+  }
+  for (size_t size = kHugePageSize; size <= kMaxPooledSize;
+       size += kHugePageSize) {
+    class_sizes_.push_back(size);
+  }
+  pool_.resize(class_sizes_.size());
+}
+
+MatAllocationStats PooledMatAllocator::GetStats() const {
+  return counters_.Get();
+}
+
+size_t PooledMatAllocator::GetPooledBytes() const { return pooled_bytes_; }
+
+cv::UMatData* PooledMatAllocator::allocate(int dims, const int* sizes,
+                                           int type, void* data,
+                                           size_t* step, int,
+                                           cv::UMatUsageFlags) const {
+  // Computes the buffer size and steps in the same way as OpenCV's standard
+  // allocator.
+  size_t total = CV_ELEM_SIZE(type);
+  for (int i = dims - 1; i >= 0; --i) {
+    if (step != nullptr) {
+      if (data != nullptr && step[i] != CV_AUTOSTEP) {
+        CV_Assert(total <= step[i]);
+        total = step[i];
+      } else {
+        step[i] = total;
+      }
+    }
+    total *= sizes[i];
+  }
+
+  cv::UMatData* u = new cv::UMatData(this);
+  if (data != nullptr) {
+    u->data = u->origdata = (uchar*)data;
+    u->size = total;
+    u->flags |= cv::UMatData::USER_ALLOCATED;
+  } else {
+    u->data = u->origdata = (uchar*)Allocate(total, &u->size);
+  }
+  return u;
+}
+
+bool PooledMatAllocator::allocate(cv::UMatData* data, int,
+                                  cv::UMatUsageFlags) const {
+  return data != nullptr;
+}
+
+void PooledMatAllocator::deallocate(cv::UMatData* data) const {
+  if (data == nullptr) {
+    return;
+  }
+  CV_Assert(data->urefcount == 0);
+  CV_Assert(data->refcount == 0);
+  if (!(data->flags & cv::UMatData::USER_ALLOCATED)) {
+    Release(data->origdata, data->size);
+    data->origdata = nullptr;
+  }
+  delete data;
+}
+
+void* PooledMatAllocator::Allocate(size_t size, size_t* capacity) const {
+  ThreadCache* cache = GetThreadCache();
+  int size_class = GetSizeClass(size);
+  void* buffer = nullptr;
+  if (size_class < 0) {
+    *capacity = size;
+    if (size >= kHugePageSize) {
+      // Huge page mappings can only be unmapped in whole pages.
+      *capacity = (size + kHugePageSize - 1) / kHugePageSize * kHugePageSize;
+    }
+  } else {
+    *capacity = class_sizes_.at(size_class);
+    if (cache != nullptr && !cache->blocks.at(size_class).empty()) {
+      buffer = cache->blocks.at(size_class).back();
+      cache->blocks.at(size_class).pop_back();
+    } else {
+      // A thread on a NUMA node only reuses large buffers from that node.
+      int node = thread_numa_node;
+      bool any_node = node < 0 || *capacity < kHugePageSize;
+      std::lock_guard<std::mutex> guard(pool_mtx_);
+      auto& blocks = pool_.at(size_class);
+      for (auto it = blocks.rbegin(); it != blocks.rend(); ++it) {
+        if (any_node || it->numa_node == node) {
+          buffer = it->buffer;
+          blocks.erase(std::next(it).base());
+          pooled_bytes_ -= *capacity;
+          break;
+        }
+      }
+    }
+  }
+
+  bool pool_hit = buffer != nullptr;
+  if (!pool_hit) {
+    buffer = AllocateFromSystem(*capacity);
+  }
+  counters_.Record(size, pool_hit);
+  if (cache != nullptr) {
+    cache->counters->Record(size, pool_hit);
+  }
+  if (scope_counters != nullptr) {
+    scope_counters->Record(size, pool_hit);
+  }
+  return buffer;
+}
+
+void PooledMatAllocator::Release(void* buffer, size_t capacity) const {
+  int size_class = GetSizeClass(capacity);
+  if (size_class < 0) {
+    FreeToSystem(buffer, capacity);
+    return;
+  }
+
+  if (capacity < kHugePageSize) {
+    ThreadCache* cache = GetThreadCache();
+    if (cache != nullptr &&
+        cache->blocks.at(size_class).size() < kThreadCacheBlocks) {
+      cache->blocks.at(size_class).push_back(buffer);
+      return;
+    }
+  }
+
+  {
+    std::lock_guard<std::mutex> guard(pool_mtx_);
+    if (pooled_bytes_ + capacity <= max_pooled_bytes_) {
+      int node = -1;
+      if (!numa_nodes_.empty()) {
+        auto it = numa_nodes_.find(buffer);
+        if (it != numa_nodes_.end()) {
+          node = it->second;
+        }
+      }
+      pool_.at(size_class).push_back({buffer, node});
+      pooled_bytes_ += capacity;
+      return;
+    }
+  }
+  FreeToSystem(buffer, capacity);
+}
+
+int PooledMatAllocator::GetSizeClass(size_t size) const {
+  if (size < kMinPooledSize || size > kMaxPooledSize) {
+    return -1;
+  }
+  auto it = std::lower_bound(class_sizes_.begin(), class_sizes_.end(), size);
+  return (int)(it - class_sizes_.begin());
+}
+
+void* PooledMatAllocator::AllocateFromSystem(size_t capacity) const {
+#ifdef __linux__
+  if (capacity >= kHugePageSize) {
+    void* buffer = MAP_FAILED;
+    if (use_huge_pages_) {
+      // Prefer reserved huge pages, then fall back to transparent ones.
+      buffer = mmap(nullptr, capacity, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    }
+    if (buffer == MAP_FAILED) {
+      buffer = mmap(nullptr, capacity, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+      if (buffer == MAP_FAILED) {
+        throw std::bad_alloc();
+      }
+      if (use_huge_pages_) {
+        madvise(buffer, capacity, MADV_HUGEPAGE);
+      }
+    }
+    // Nothing has touched the pages yet, so they can still be placed.
+    int node = thread_numa_node;
+    if (node >= 0 && BindMemoryToNumaNode(buffer, capacity, node)) {
+      std::lock_guard<std::mutex> guard(pool_mtx_);
+      numa_nodes_[buffer] = node;
+    }
+    return buffer;
+  }
+#endif  // __linux__
+  return cv::fastMalloc(capacity);
+}
+
+void PooledMatAllocator::FreeToSystem(void* buffer, size_t capacity) const {
+#ifdef __linux__
+  if (capacity >= kHugePageSize) {
+    {
+      std::lock_guard<std::mutex> guard(pool_mtx_);
+      numa_nodes_.erase(buffer);
+    }
+    if (munmap(buffer, capacity) != 0) {
+      LOG(ERROR) << "Unable to unmap a buffer of " << capacity
+                 << " bytes: " << strerror(errno);
+    }
+    return;
+  }
+#endif  // __linux__
+  cv::fastFree(buffer);
+}
+
+void PooledMatAllocator::Flush(ThreadCache* cache) const {
+  for (size_t size_class = 0; size_class < cache->blocks.size();
+       ++size_class) {
+    for (void* buffer : cache->blocks.at(size_class)) {
+      Release(buffer, class_sizes_.at(size_class));
+    }
+    cache->blocks.at(size_class).clear();
+  }
+}
@@ -0,0 +1,154 @@
+// Copyright 2018 The SAF Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SAF_UTILS_POOLED_MAT_ALLOCATOR_H_
+#define SAF_UTILS_POOLED_MAT_ALLOCATOR_H_
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+// A snapshot of cv::Mat buffer allocation counts.
+struct MatAllocationStats {
+  // The number of buffers that were allocated.
+  unsigned long num_allocations = 0;
+  // How many of those were recycled from the pool instead of coming from the
+  // system.
+  unsigned long num_pool_hits = 0;
+  // The total number of bytes that were requested.
+  unsigned long bytes_allocated = 0;
+};
+
+// Allocation counters that are updated by one or more allocating threads and
+// may be read from any thread.
+class MatAllocationCounters {
+ public:
+  MatAllocationStats Get() const;
+
+ private:
+  friend class PooledMatAllocator;
+
+  void Record(size_t bytes, bool pool_hit);
+
+  std::atomic<unsigned long> num_allocations_{0};
+  std::atomic<unsigned long> num_pool_hits_{0};
+  std::atomic<unsigned long> bytes_allocated_{0};
+};
+
+// Charges the cv::Mat buffers that the calling thread allocates while it exists
+// to "counters", in addition to the thread's own counters. This attributes
+// allocations to whatever runs on the thread at the time, e.g., an operator's
+// Process(), no matter which thread that is. Scopes may be nested, in which
+// case only the innermost one is charged.
+class MatAllocationScope {
+ public:
+  explicit MatAllocationScope(MatAllocationCounters* counters);
+  ~MatAllocationScope();
+  MatAllocationScope(const MatAllocationScope&) = delete;
+  MatAllocationScope& operator=(const MatAllocationScope&) = delete;
+
+ private:
+  MatAllocationCounters* parent_;
+};
+
+// A cv::MatAllocator that recycles the buffers of destroyed Mats instead of
+// returning them to the system. Video frames are allocated at a steady rate in
+// a handful of sizes, so after warm-up almost every allocation is served from
+// the pool without touching the system allocator or taking page faults.
+//
+// Buffers are grouped into size classes. Small classes are cached per thread
+// first, since temporaries such as resized images are usually allocated and
+// freed by the same operator. Buffers of at least kHugePageSize bytes, which is
+// where decoded frames land, are kept in a shared pool because they are
+// normally freed by a different thread than the one that allocated them. Those
+// buffers are mapped directly and, if requested, backed by huge pages. They are
+// placed on the NUMA node of the allocating thread, if it has one (see
+// SetThreadNumaNode()), and are only reused by threads on the same node.
+class PooledMatAllocator : public cv::MatAllocator {
+ public:
+  static constexpr size_t kHugePageSize = 2 << 20;
+  static constexpr size_t kDefaultMaxPooledBytes = 512 << 20;
+
+  // Returns the process-wide allocator. It is never destroyed, since Mats that
+  // use it may outlive any other object.
+  static PooledMatAllocator& GetInstance();
+  // Makes the pool the default allocator of every cv::Mat that is created
+  // afterwards. "max_pooled_bytes" bounds the memory held by idle buffers.
+  static void Install(bool use_huge_pages = false,
+                      size_t max_pooled_bytes = kDefaultMaxPooledBytes);
+  static bool IsInstalled();
+  // Returns the counters of the calling thread. They stay valid after the
+  // thread exits.
+  static std::shared_ptr<const MatAllocationCounters> GetThreadCounters();
+  // Places the large buffers that the calling thread allocates on NUMA node
+  // "node". -1, the default, leaves placement to the kernel.
+  static void SetThreadNumaNode(int node);
+
+  // Returns the counters for all threads.
+  MatAllocationStats GetStats() const;
+  // Returns the number of bytes held by idle buffers in the shared pool.
+  size_t GetPooledBytes() const;
+
+  cv::UMatData* allocate(int dims, const int* sizes, int type, void* data,
+                         size_t* step, int flags,
+                         cv::UMatUsageFlags usage_flags) const override;
+  bool allocate(cv::UMatData* data, int access_flags,
+                cv::UMatUsageFlags usage_flags) const override;
+  void deallocate(cv::UMatData* data) const override;
+
+ private:
+  struct ThreadCache;
+  struct PooledBuffer {
+    void* buffer;
+    // The NUMA node that the buffer was placed on, or -1.
+    int numa_node;
+  };
+
+  PooledMatAllocator();
+
+  // Returns the calling thread's cache, or nullptr if it was already destroyed
+  // because the thread is exiting.
+  static ThreadCache* GetThreadCache();
+
+  // Returns a buffer of at least "size" bytes and stores its actual size in
+  // "capacity".
+  void* Allocate(size_t size, size_t* capacity) const;
+  void Release(void* buffer, size_t capacity) const;
+  // Returns the index of the smallest size class that fits "size", or -1 if
+  // buffers of that size are not pooled.
+  int GetSizeClass(size_t size) const;
+  void* AllocateFromSystem(size_t capacity) const;
+  void FreeToSystem(void* buffer, size_t capacity) const;
+  // Moves the buffers in a thread's cache to the shared pool.
+  void Flush(ThreadCache* cache) const;
+
+  // The capacity of each size class, in ascending order.
+  std::vector<size_t> class_sizes_;
+  std::atomic<bool> use_huge_pages_;
+  std::atomic<size_t> max_pooled_bytes_;
+  mutable std::atomic<size_t> pooled_bytes_;
+  // Idle buffers of each size class that any thread may reuse.
+  mutable std::mutex pool_mtx_;
+  mutable std::vector<std::vector<PooledBuffer>> pool_;
+  // The NUMA nodes of the large buffers that were placed on one.
+  mutable std::unordered_map<void*, int> numa_nodes_;
+  mutable MatAllocationCounters counters_;
+};
+
+#endif  // SAF_UTILS_POOLED_MAT_ALLOCATOR_H_
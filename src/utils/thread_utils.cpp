@@ -0,0 +1,252 @@
+// Copyright 2018 The SAF Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "utils/thread_utils.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <stdexcept>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif  // __linux__
+
+#include <glog/logging.h>
+
+#include "utils/pooled_mat_allocator.h"
+#include "utils/string_utils.h"
+
+// From <numaif.h>, which would otherwise pull in libnuma.
+constexpr int kMpolPreferred = 1;
+constexpr int kMaxNumaNodes = 1024;
+constexpr size_t kBitsPerLong = 8 * sizeof(unsigned long);
+
+static std::string ReadFirstLine(const std::string& path) {
+  std::ifstream in(path);
+  std::string line;
+  std::getline(in, line);
+  return line;
+}
+
+// Returns a node mask with only "node" set, for the NUMA syscalls.
+static std::vector<unsigned long> GetNodeMask(int node) {
+  std::vector<unsigned long> mask(kMaxNumaNodes / kBitsPerLong, 0);
+  mask.at(node / kBitsPerLong) |= 1UL << (node % kBitsPerLong);
+  return mask;
+}
+
+bool ThreadPlacement::IsDefault() const {
+  return cpus.empty() && numa_node < 0 && priority == 0;
+}
+
+bool ThreadPlacement::operator==(const ThreadPlacement& other) const {
+  return cpus == other.cpus && numa_node == other.numa_node &&
+         priority == other.priority;
+}
+
+bool ThreadPlacement::operator!=(const ThreadPlacement& other) const {
+  return !(*this == other);
+}
+
+std::string ThreadPlacement::ToString() const {
+  std::ostringstream o;
+  o << "cpus=" << (cpus.empty() ? "any" : CpuListToString(cpus))
+    << " numa_node=";
+  if (numa_node < 0) {
+    o << "any";
+  } else {
+    o << numa_node;
+  }
+  o << " priority=" << priority;
+  return o.str();
+}
+
+std::vector<int> ParseCpuList(const std::string& cpu_list) {
+  std::vector<int> cpus;
+  for (auto range : SplitString(cpu_list, ",")) {
+    range.erase(std::remove_if(range.begin(), range.end(), ::isspace),
+                range.end());
+    if (range.empty()) {
+      continue;
+    }
+    auto bounds = SplitString(range, "-");
+    int first = -1;
+    int last = -1;
+    try {
+      first = std::stoi(bounds.at(0));
+      last = bounds.size() == 2 ? std::stoi(bounds.at(1)) : first;
+    } catch (const std::exception&) {
+      first = -1;
+    }
+    if (bounds.size() > 2 || first < 0 || last < first) {
+      std::ostringstream msg;
+      msg << "Invalid CPU list: \"" << cpu_list << "\"";
+      throw std::invalid_argument(msg.str());
+    }
+    for (int cpu = first; cpu <= last; ++cpu) {
+      cpus.push_back(cpu);
+    }
+  }
+  std::sort(cpus.begin(), cpus.end());
+  cpus.erase(std::unique(cpus.begin(), cpus.end()), cpus.end());
+  return cpus;
+}
+
+std::string CpuListToString(std::vector<int> cpus) {
+  std::sort(cpus.begin(), cpus.end());
+  cpus.erase(std::unique(cpus.begin(), cpus.end()), cpus.end());
+  std::ostringstream o;
+  for (size_t i = 0; i < cpus.size();) {
+    size_t j = i;
+    while (j + 1 < cpus.size() && cpus.at(j + 1) == cpus.at(j) + 1) {
+      ++j;
+    }
+    if (i > 0) {
+      o << ",";
+    }
+    o << cpus.at(i);
+    if (j > i) {
+      o << "-" << cpus.at(j);
+    }
+    i = j + 1;
+  }
+  return o.str();
+}
+
+int GetNumNumaNodes() {
+  std::string online = ReadFirstLine("/sys/devices/system/node/online");
+  if (online.empty()) {
+    return 1;
+  }
+  try {
+    auto nodes = ParseCpuList(online);
+    return nodes.empty() ? 1 : nodes.back() + 1;
+  } catch (const std::invalid_argument&) {
+    return 1;
+  }
+}
+
+std::vector<int> GetNumaNodeCpus(int node) {
+  if (node < 0) {
+    return {};
+  }
+  std::string cpu_list = ReadFirstLine("/sys/devices/system/node/node" +
+                                       std::to_string(node) + "/cpulist");
+  try {
+    return ParseCpuList(cpu_list);
+  } catch (const std::invalid_argument&) {
+    return {};
+  }
+}
+
+bool ApplyThreadPlacement(const ThreadPlacement& placement) {
+  if (placement.IsDefault()) {
+    return true;
+  }
+  bool ok = true;
+#ifdef __linux__
+  // A NUMA node narrows the CPUs down to those of the node.
+  std::vector<int> cpus = placement.cpus;
+  if (placement.numa_node >= 0) {
+    auto node_cpus = GetNumaNodeCpus(placement.numa_node);
+    if (node_cpus.empty()) {
+      LOG(WARNING) << "NUMA node " << placement.numa_node
+                   << " does not exist";
+      ok = false;
+    } else if (cpus.empty()) {
+      cpus = node_cpus;
+    } else {
+      std::vector<int> both;
+      std::set_intersection(cpus.begin(), cpus.end(), node_cpus.begin(),
+                            node_cpus.end(), std::back_inserter(both));
+      if (both.empty()) {
+        LOG(WARNING) << "None of CPUs " << CpuListToString(cpus)
+                     << " are on NUMA node " << placement.numa_node;
+        ok = false;
+      } else {
+        cpus = both;
+      }
+    }
+  }
+
+  if (!cpus.empty()) {
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    for (int cpu : cpus) {
+      if (cpu < CPU_SETSIZE) {
+        CPU_SET(cpu, &cpu_set);
+      }
+    }
+    int err = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set),
+                                     &cpu_set);
+    if (err != 0) {
+      LOG(WARNING) << "Unable to run on CPUs " << CpuListToString(cpus)
+                   << ": " << strerror(err);
+      ok = false;
+    }
+  }
+
+  if (placement.numa_node >= 0 && placement.numa_node < kMaxNumaNodes) {
+    // Prefer, rather than require, the node, so that allocations still
+    // succeed when it is out of memory.
+    auto mask = GetNodeMask(placement.numa_node);
+    if (syscall(SYS_set_mempolicy, kMpolPreferred, mask.data(),
+                (unsigned long)kMaxNumaNodes) != 0) {
+      LOG(WARNING) << "Unable to allocate memory on NUMA node "
+                   << placement.numa_node << ": " << strerror(errno);
+      ok = false;
+    }
+    PooledMatAllocator::SetThreadNumaNode(placement.numa_node);
+  }
+
+  if (placement.priority != 0) {
+    // On Linux, the nice value of a thread ID only applies to that thread.
+    if (setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid),
+                    placement.priority) != 0) {
+      LOG(WARNING) << "Unable to set thread priority to "
+                   << placement.priority << ": " << strerror(errno);
+      ok = false;
+    }
+  }
+#else
+  LOG(WARNING) << "Thread placement is only supported on Linux";
+  ok = false;
+#endif  // __linux__
+  return ok;
+}
+
+bool BindMemoryToNumaNode(void* addr, size_t length, int node) {
+#ifdef __linux__
+  if (node < 0 || node >= kMaxNumaNodes) {
+    return false;
+  }
+  auto mask = GetNodeMask(node);
+  return syscall(SYS_mbind, addr, length, kMpolPreferred, mask.data(),
+                 (unsigned long)kMaxNumaNodes, 0) == 0;
+#else
+  (void)addr;
+  (void)length;
+  (void)node;
+  return false;
+#endif  // __linux__
+}
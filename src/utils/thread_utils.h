@@ -0,0 +1,61 @@
+// Copyright 2018 The SAF Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SAF_UTILS_THREAD_UTILS_H_
+#define SAF_UTILS_THREAD_UTILS_H_
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Where a thread runs and how it is scheduled. The default placement leaves
+// the thread to the OS scheduler.
+struct ThreadPlacement {
+  // The CPUs that the thread may run on. Empty means any CPU.
+  std::vector<int> cpus;
+  // The NUMA node that the thread runs on and allocates memory from. -1 means
+  // any node.
+  int numa_node = -1;
+  // The thread's nice value, from -20 (scheduled first) to 19 (scheduled
+  // last). Values below 0 require CAP_SYS_NICE.
+  int priority = 0;
+
+  bool IsDefault() const;
+  bool operator==(const ThreadPlacement& other) const;
+  bool operator!=(const ThreadPlacement& other) const;
+  // E.g., "cpus=0-3,8 numa_node=0 priority=-5".
+  std::string ToString() const;
+};
+
+// Parses a CPU list in the format of taskset and /sys, e.g., "0-3,8,10-11".
+std::vector<int> ParseCpuList(const std::string& cpu_list);
+// Formats "cpus" as a CPU list, e.g., "0-3,8,10-11".
+std::string CpuListToString(std::vector<int> cpus);
+
+// Returns the number of NUMA nodes, which is 1 on machines without NUMA.
+int GetNumNumaNodes();
+// Returns the CPUs of NUMA node "node", or an empty list if it does not exist.
+std::vector<int> GetNumaNodeCpus(int node);
+
+// Moves the calling thread to the CPUs, NUMA node and priority of "placement".
+// Memory that the thread touches first, including buffers from
+// PooledMatAllocator, is then allocated on that node. Settings that cannot be
+// applied are logged and skipped. Returns whether all of them were applied.
+bool ApplyThreadPlacement(const ThreadPlacement& placement);
+
+// Asks the kernel to back "length" bytes at "addr", which must be page
+// aligned, with memory from NUMA node "node". Returns false on failure.
+bool BindMemoryToNumaNode(void* addr, size_t length, int node);
+
+#endif  // SAF_UTILS_THREAD_UTILS_H_
@@ -368,6 +368,9 @@ bool GstVideoCapture::CreatePipeline(std::string video_uri,
     return false;
   }
 
+  // Like GStreamer's own streaming threads, the bus thread inherits the CPU
+  // affinity, NUMA memory policy and priority of the calling thread, i.e., of
+  // the camera operator's thread.
   check_bus_thread_ = std::thread(&GstVideoCapture::CheckBus, this);
 
   LOG(INFO) << "Pipeline connected, video size: " << width << "x" << height;
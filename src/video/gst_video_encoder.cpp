@@ -85,6 +85,8 @@ void GstVideoEncoder::SetSource(StreamPtr stream) {
 
 StreamPtr GstVideoEncoder::GetSink() { return Operator::GetSink(SINK_NAME); }
 
+bool GstVideoEncoder::IsBlocking() const { return true; }
+
 bool GstVideoEncoder::Init() { return true; }
 
 bool GstVideoEncoder::OnStop() {
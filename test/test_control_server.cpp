@@ -0,0 +1,121 @@
+// Copyright 2018 The SAF Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "pipeline/control_server.h"
+#include "pipeline/pipeline.h"
+
+// A throttler that feeds a strider, neither of which needs to be started for
+// its parameters to be set.
+static std::shared_ptr<Pipeline> MakePipeline() {
+  return Pipeline::ConstructPipeline(nlohmann::json::parse(R"({
+    "operators": [
+      {"operator_name": "throttler", "operator_type": "Throttler",
+       "parameters": {"fps": "30"}},
+      {"operator_name": "strider", "operator_type": "Strider",
+       "parameters": {"stride": "2"}, "inputs": {"input": "throttler"}}
+    ]
+  })"));
+}
+
+TEST(CONTROL_SERVER_TEST, HANDLE_REQUEST_TEST) {
+  auto pipeline = MakePipeline();
+  ControlServer server(*pipeline, "tcp://127.0.0.1:0");
+
+  auto reply = server.HandleRequest({{"command", "list"}});
+  EXPECT_TRUE(reply["ok"].get<bool>());
+  EXPECT_EQ(reply["operators"].get<std::set<std::string>>(),
+            std::set<std::string>({"throttler", "strider"}));
+
+  // Values may be strings or numbers.
+  reply = server.HandleRequest({{"command", "set"},
+                                {"operator", "strider"},
+                                {"parameter", "stride"},
+                                {"value", "3"}});
+  EXPECT_TRUE(reply["ok"].get<bool>());
+  reply = server.HandleRequest({{"command", "set"},
+                                {"operator", "throttler"},
+                                {"parameter", "fps"},
+                                {"value", 5}});
+  EXPECT_TRUE(reply["ok"].get<bool>());
+
+  reply = server.HandleRequest({{"command", "stats"}});
+  EXPECT_TRUE(reply["ok"].get<bool>());
+  EXPECT_EQ(reply["stats"].size(), 2);
+  EXPECT_EQ(reply["stats"]["strider"]["type"], "Strider");
+  EXPECT_FALSE(reply["stats"]["strider"]["started"].get<bool>());
+  reply = server.HandleRequest({{"command", "stats"}, {"operator", "strider"}});
+  EXPECT_TRUE(reply["ok"].get<bool>());
+  EXPECT_EQ(reply["stats"].size(), 1);
+  EXPECT_EQ(reply["stats"]["strider"]["replicas"], 1);
+}
+
+TEST(CONTROL_SERVER_TEST, ERROR_REPLY_TEST) {
+  auto pipeline = MakePipeline();
+  ControlServer server(*pipeline, "tcp://127.0.0.1:0");
+
+  for (const auto& request : std::vector<nlohmann::json>{
+           // Not a command.
+           nlohmann::json::array(),
+           {{"operator", "strider"}},
+           {{"command", "restart"}},
+           {{"command", "stats"}, {"operator", "camera"}},
+           // Incomplete, unknown, or invalid parameters.
+           {{"command", "set"}, {"operator", "strider"}, {"value", "3"}},
+           {{"command", "set"},
+            {"operator", "strider"},
+            {"parameter", "fps"},
+            {"value", "3"}},
+           {{"command", "set"},
+            {"operator", "strider"},
+            {"parameter", "stride"},
+            {"value", "0"}}}) {
+    auto reply = server.HandleRequest(request);
+    EXPECT_FALSE(reply["ok"].get<bool>()) << request;
+    EXPECT_TRUE(reply["error"].is_string()) << request;
+  }
+}
+
+TEST(CONTROL_SERVER_TEST, BUSY_ENDPOINT_TEST) {
+  // Take a port, so that the server cannot bind to it.
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  ASSERT_GE(fd, 0);
+  sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  ASSERT_EQ(bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)), 0);
+  ASSERT_EQ(listen(fd, 1), 0);
+  socklen_t addr_len = sizeof(addr);
+  ASSERT_EQ(getsockname(fd, reinterpret_cast<sockaddr*>(&addr), &addr_len),
+            0);
+
+  auto pipeline = MakePipeline();
+  std::string endpoint =
+      "tcp://127.0.0.1:" + std::to_string(ntohs(addr.sin_port));
+  ControlServer server(*pipeline, endpoint);
+  EXPECT_FALSE(server.Start());
+  close(fd);
+}
@@ -0,0 +1,96 @@
+// Copyright 2018 The SAF Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <chrono>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include "utils/cpu_accounting.h"
+
+// Spins until the calling thread has used "micros" of CPU time.
+static void BusyWait(uint64_t micros) {
+  uint64_t end_micros = ReadThreadCpuStats().cpu_micros + micros;
+  while (ReadThreadCpuStats().cpu_micros < end_micros) {
+  }
+}
+
+TEST(CPU_ACCOUNTING_TEST, SCOPE_TEST) {
+  CpuAccountingScope scope;
+  BusyWait(20000);
+  CpuStats stats = scope.Stop();
+  EXPECT_GE(stats.cpu_micros, 20000);
+  // Sleeping takes no CPU time.
+  CpuAccountingScope sleep_scope;
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  EXPECT_LT(sleep_scope.Stop().cpu_micros, 20000);
+}
+
+TEST(CPU_ACCOUNTING_TEST, NESTED_SCOPE_TEST) {
+  CpuAccountingScope outer;
+  BusyWait(10000);
+  CpuStats inner_stats;
+  {
+    CpuAccountingScope inner;
+    BusyWait(40000);
+    inner_stats = inner.Stop();
+  }
+  CpuStats outer_stats = outer.Stop();
+  EXPECT_GE(inner_stats.cpu_micros, 40000);
+  // The outer scope does not count the inner one.
+  EXPECT_GE(outer_stats.cpu_micros, 10000);
+  EXPECT_LT(outer_stats.cpu_micros, 40000);
+}
+
+TEST(CPU_ACCOUNTING_TEST, HARDWARE_COUNTERS_TEST) {
+  if (!HasThreadHardwareCounters()) {
+    // E.g., in a VM or a container, or when perf_event_paranoid forbids it.
+    CpuAccountingScope scope;
+    BusyWait(1000);
+    EXPECT_EQ(scope.Stop().cycles, 0);
+    return;
+  }
+  CpuAccountingScope scope;
+  BusyWait(10000);
+  CpuStats stats = scope.Stop();
+  EXPECT_GT(stats.cycles, 0);
+  EXPECT_GT(stats.instructions, 0);
+  EXPECT_GT(stats.GetInstructionsPerCycle(), 0);
+}
+
+TEST(CPU_ACCOUNTING_TEST, STATS_TEST) {
+  CpuStats a;
+  a.cpu_micros = 1500;
+  a.cycles = 2000000;
+  a.instructions = 3000000;
+  a.llc_misses = 6000;
+  a.branch_misses = 1200;
+  EXPECT_DOUBLE_EQ(a.GetInstructionsPerCycle(), 1.5);
+  EXPECT_DOUBLE_EQ(a.GetLlcMissesPerKiloInstruction(), 2);
+  EXPECT_EQ(a.ToString(),
+            "cpu=1.5ms cycles=2.0M ipc=1.50 llc_mpki=2.00 branch_misses=1.2K");
+
+  CpuStats b = a;
+  b += a;
+  EXPECT_EQ(b.instructions, 6000000);
+  EXPECT_EQ((b - a).instructions, 3000000);
+  // Differences never go below 0.
+  EXPECT_EQ((a - b).cycles, 0);
+  EXPECT_EQ(CpuStats().ToString(), "cpu=0.0ms");
+
+  CpuAccountingCounters counters;
+  counters.Record(a);
+  counters.Record(a);
+  EXPECT_EQ(counters.Get().branch_misses, 2400);
+}
@@ -0,0 +1,230 @@
+// Copyright 2018 The SAF Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <cstring>
+#include <stdexcept>
+
+#include <gtest/gtest.h>
+#include "stream/frame_codec.h"
+
+TEST(FRAME_CODEC_TEST, ROUND_TRIP_TEST) {
+  boost::posix_time::ptime now =
+      boost::posix_time::microsec_clock::local_time();
+  Frame frame;
+  frame.SetValue("frame_id", 42UL);
+  frame.SetValue("camera_name", std::string("cam"));
+  frame.SetValue("score", 0.5);
+  frame.SetValue("capture_time_micros", now);
+  frame.SetValue("latency",
+                 boost::posix_time::time_duration(
+                     boost::posix_time::microseconds(1234)));
+  frame.SetValue("bboxes", std::vector<Rect>{Rect(1, 2, 3, 4)});
+  frame.SetValue("tags", std::vector<std::string>{"a", "bc"});
+  frame.SetValue("features", std::vector<std::vector<float>>{{1, 2}, {3}});
+  frame.SetValue("ids", std::unordered_map<int, float>{{1, 0.25f}});
+
+  auto decoded = FrameCodec::Decode(
+      std::make_shared<std::string>(FrameCodec::Encode(frame)));
+  EXPECT_EQ(decoded->GetValue<unsigned long>("frame_id"), 42UL);
+  EXPECT_EQ(decoded->GetValue<std::string>("camera_name"), "cam");
+  EXPECT_EQ(decoded->GetValue<double>("score"), 0.5);
+  EXPECT_EQ(decoded->GetValue<boost::posix_time::ptime>("capture_time_micros"),
+            now);
+  EXPECT_EQ(decoded->GetValue<boost::posix_time::time_duration>("latency"),
+            boost::posix_time::microseconds(1234));
+  const auto& bboxes = decoded->GetRef<std::vector<Rect>>("bboxes");
+  ASSERT_EQ(bboxes.size(), 1);
+  EXPECT_EQ(bboxes.at(0), Rect(1, 2, 3, 4));
+  EXPECT_EQ(decoded->GetValue<std::vector<std::string>>("tags"),
+            (std::vector<std::string>{"a", "bc"}));
+  EXPECT_EQ(decoded->GetValue<std::vector<std::vector<float>>>("features"),
+            (std::vector<std::vector<float>>{{1, 2}, {3}}));
+  auto ids = decoded->GetValue<std::unordered_map<int, float>>("ids");
+  EXPECT_EQ(ids.at(1), 0.25f);
+}
+
+TEST(FRAME_CODEC_TEST, ZERO_COPY_MAT_TEST) {
+  Frame frame;
+  cv::Mat image(48, 64, CV_8UC3);
+  for (size_t i = 0; i < image.total() * image.elemSize(); ++i) {
+    image.data[i] = (uchar)i;
+  }
+  frame.SetValue("original_image", image);
+
+  auto buffer = std::make_shared<std::string>(FrameCodec::Encode(frame));
+  cv::Mat decoded;
+  {
+    auto decoded_frame = FrameCodec::Decode(buffer);
+    decoded = decoded_frame->GetValue<cv::Mat>("original_image");
+  }
+  // The pixels are not copied, and the buffer outlives the frame.
+  const char* begin = buffer->data();
+  EXPECT_GE((const char*)decoded.data, begin);
+  EXPECT_LT((const char*)decoded.data, begin + buffer->size());
+  EXPECT_EQ((size_t)decoded.data % FrameCodec::kPayloadAlignment,
+            (size_t)begin % FrameCodec::kPayloadAlignment);
+  ASSERT_EQ(decoded.rows, 48);
+  ASSERT_EQ(decoded.cols, 64);
+  EXPECT_EQ(decoded.type(), CV_8UC3);
+  EXPECT_EQ(std::memcmp(decoded.data, image.data,
+                        image.total() * image.elemSize()),
+            0);
+
+  // Without an owner, the pixels are copied.
+  auto copied = FrameCodec::Decode(buffer->data(), buffer->size());
+  cv::Mat copy = copied->GetValue<cv::Mat>("original_image");
+  EXPECT_TRUE((const char*)copy.data < begin ||
+              (const char*)copy.data >= begin + buffer->size());
+}
+
+TEST(FRAME_CODEC_TEST, FIELD_SELECTION_TEST) {
+  Frame nested;
+  nested.SetValue("label", std::string("car"));
+  Frame frame;
+  frame.SetValue("frame_id", 7UL);
+  frame.SetValue("objects", std::vector<Frame>{nested, nested});
+  frame.SetValue("original_bytes", std::vector<char>(10000, 'x'));
+  frame.SetValue("dropped", 1);
+
+  std::string encoded = FrameCodec::Encode(
+      frame, {"frame_id", "objects", "original_bytes"},
+      {{"original_bytes", FrameCodec::Codec::GZIP}});
+  EXPECT_LT(encoded.size(), 10000);
+
+  auto decoded = FrameCodec::Decode(encoded.data(), encoded.size());
+  EXPECT_EQ(decoded->Count("dropped"), 0);
+  EXPECT_EQ(decoded->GetValue<unsigned long>("frame_id"), 7UL);
+  EXPECT_EQ(decoded->GetValue<std::vector<char>>("original_bytes"),
+            std::vector<char>(10000, 'x'));
+  auto objects = decoded->GetValue<std::vector<Frame>>("objects");
+  ASSERT_EQ(objects.size(), 2);
+  EXPECT_EQ(objects.at(1).GetValue<std::string>("label"), "car");
+}
+
+TEST(FRAME_CODEC_TEST, ORIGINAL_BYTES_TEST) {
+  // Cameras store only the image and serve "original_bytes" from it.
+  Frame frame;
+  frame.SetValue("frame_id", 7UL);
+  cv::Mat image(48, 64, CV_8UC3, cv::Scalar(1, 2, 3));
+  frame.SetValue("original_image", image);
+
+  // What FramePublisher sends when asked for {"original_bytes"}.
+  std::string encoded = FrameCodec::Encode(
+      frame, {"original_bytes"}, {{"original_bytes", FrameCodec::Codec::GZIP}});
+  EXPECT_LT(encoded.size(), image.total() * image.elemSize());
+
+  auto decoded = FrameCodec::Decode(encoded.data(), encoded.size());
+  EXPECT_EQ(decoded->Count("frame_id"), 0);
+  ASSERT_EQ(decoded->Count("original_bytes"), 1);
+  Frame::ByteView bytes = decoded->GetBytes("original_bytes");
+  ASSERT_EQ(bytes.size, image.total() * image.elemSize());
+  EXPECT_EQ(std::memcmp(bytes.data, image.data, bytes.size), 0);
+}
+
+TEST(FRAME_CODEC_TEST, INVALID_INPUT_TEST) {
+  Frame frame;
+  frame.SetValue("camera_name", std::string("cam"));
+  std::string encoded = FrameCodec::Encode(frame);
+  EXPECT_TRUE(FrameCodec::IsEncodedFrame(encoded.data(), encoded.size()));
+
+  std::string garbage(encoded.size(), 'x');
+  EXPECT_FALSE(FrameCodec::IsEncodedFrame(garbage.data(), garbage.size()));
+  EXPECT_THROW(FrameCodec::Decode(garbage.data(), garbage.size()),
+               std::runtime_error);
+  EXPECT_THROW(FrameCodec::Decode(encoded.data(), encoded.size() / 2),
+               std::runtime_error);
+}
+
+// Returns "encoded" with the "T" at byte "offset" replaced by "value".
+template <typename T>
+static std::string Patch(std::string encoded, size_t offset, T value) {
+  std::memcpy(&encoded[offset], &value, sizeof(value));
+  return encoded;
+}
+
+TEST(FRAME_CODEC_TEST, MALFORMED_INPUT_TEST) {
+  // Offsets into the format: a 24-byte header, followed by the field table,
+  // whose entries start with a uint32_t name offset, a uint16_t name size, the
+  // type and codec bytes, and the uint64_t payload offset and size.
+  constexpr size_t kNameOffset = 24;
+  constexpr size_t kNameSize = 28;
+  constexpr size_t kPayloadOffset = 32;
+  constexpr size_t kPayloadSize = 40;
+
+  Frame frame;
+  frame.SetValue("image", cv::Mat(2, 2, CV_8UC1, cv::Scalar(1)));
+  std::string encoded = FrameCodec::Encode(frame);
+  ASSERT_NO_THROW(FrameCodec::Decode(encoded.data(), encoded.size()));
+  uint64_t payload_offset;
+  std::memcpy(&payload_offset, &encoded[kPayloadOffset],
+              sizeof(payload_offset));
+
+  // A name that wraps around in 32 bits.
+  std::string bad =
+      Patch(Patch(encoded, kNameOffset, (uint32_t)0xFFFFFFFF), kNameSize,
+            (uint16_t)2);
+  EXPECT_THROW(FrameCodec::Decode(bad.data(), bad.size()), std::runtime_error);
+
+  // A payload that starts past the end of the frame.
+  bad = Patch(Patch(encoded, kPayloadOffset, (uint64_t)encoded.size() + 64),
+              kPayloadSize, (uint64_t)8);
+  EXPECT_THROW(FrameCodec::Decode(bad.data(), bad.size()), std::runtime_error);
+
+  // A cv::Mat whose size overflows to 0. The Mat header holds the type, the
+  // number of dimensions and the size of each dimension, as int32_t's.
+  bad = Patch(encoded, payload_offset + 4, (int32_t)4);
+  for (size_t i = 0; i < 4; ++i) {
+    bad = Patch(bad, payload_offset + 8 + i * 4, (int32_t)65536);
+  }
+  EXPECT_THROW(FrameCodec::Decode(bad.data(), bad.size()), std::runtime_error);
+  auto buffer = std::make_shared<std::string>(bad);
+  EXPECT_THROW(FrameCodec::Decode(buffer), std::runtime_error);
+}
+
+TEST(FRAME_CODEC_TEST, DECOMPRESSION_LIMIT_TEST) {
+  // The uint64_t size of the first field's payload before compression.
+  constexpr size_t kRawSize = 48;
+
+  Frame frame;
+  frame.SetValue("data", std::string(1 << 20, 'a'));
+  std::string encoded =
+      FrameCodec::Encode(frame, {}, {{"data", FrameCodec::Codec::GZIP}});
+  ASSERT_NO_THROW(FrameCodec::Decode(encoded.data(), encoded.size()));
+
+  // A size that cannot be allocated.
+  std::string bad = Patch(encoded, kRawSize, (uint64_t)1 << 62);
+  EXPECT_THROW(FrameCodec::Decode(bad.data(), bad.size()), std::runtime_error);
+
+  // A payload that expands past its recorded size is not inflated in full.
+  bad = Patch(encoded, kRawSize, (uint64_t)16);
+  EXPECT_THROW(FrameCodec::Decode(bad.data(), bad.size()), std::runtime_error);
+}
+
+TEST(FRAME_CODEC_TEST, NESTING_LIMIT_TEST) {
+  Frame frame;
+  for (int i = 0; i < 64; ++i) {
+    Frame outer;
+    outer.SetValue("objects", std::vector<Frame>{frame});
+    frame = outer;
+  }
+  std::string encoded = FrameCodec::Encode(frame);
+  EXPECT_THROW(FrameCodec::Decode(encoded.data(), encoded.size()),
+               std::runtime_error);
+
+  // The depth is reset after a failed decode.
+  Frame shallow;
+  shallow.SetValue("objects", std::vector<Frame>{Frame()});
+  encoded = FrameCodec::Encode(shallow);
+  EXPECT_NO_THROW(FrameCodec::Decode(encoded.data(), encoded.size()));
+}
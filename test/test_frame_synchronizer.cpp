@@ -0,0 +1,103 @@
+// Copyright 2018 The SAF Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <memory>
+
+#include <gtest/gtest.h>
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+#include "camera/camera.h"
+#include "operator/frame_synchronizer.h"
+#include "stream/frame.h"
+#include "stream/stream.h"
+
+namespace {
+
+std::unique_ptr<Frame> MakeFrame(unsigned long id,
+                                 const boost::posix_time::ptime& base,
+                                 long offset_micros) {
+  auto frame = std::make_unique<Frame>();
+  frame->SetValue(Frame::kFrameIdKey, id);
+  frame->SetValue(Camera::kCaptureTimeMicrosKey,
+                  base + boost::posix_time::microseconds(offset_micros));
+  return frame;
+}
+
+}  // namespace
+
+TEST(TestFrameSynchronizer, TestAlignedTuples) {
+  unsigned long num_tuples = 5;
+  // Frames are 33 ms apart, and the sources are up to 2 ms apart.
+  auto synchronizer =
+      std::make_shared<FrameSynchronizer>(2, 5000, 1000000, true);
+  auto stream0 = std::make_shared<Stream>();
+  auto stream1 = std::make_shared<Stream>();
+  synchronizer->SetSource(FrameSynchronizer::GetSourceName(0), stream0);
+  synchronizer->SetSource(FrameSynchronizer::GetSourceName(1), stream1);
+
+  auto reader = synchronizer->GetSink()->Subscribe(num_tuples);
+  synchronizer->Start(num_tuples + 1);
+
+  auto base = boost::posix_time::microsec_clock::local_time();
+  // One extra frame per source moves the watermarks past the last tuple.
+  for (unsigned long i = 0; i <= num_tuples; ++i) {
+    stream0->PushFrame(MakeFrame(i, base, i * 33000), true);
+    stream1->PushFrame(MakeFrame(i, base, i * 33000 + 2000), true);
+  }
+
+  for (unsigned long i = 0; i < num_tuples; ++i) {
+    auto tuple = reader->PopFrame();
+    ASSERT_NE(tuple, nullptr);
+    auto frames = tuple->GetValue<std::vector<Frame>>(
+        FrameSynchronizer::kFramesKey);
+    auto indices = tuple->GetValue<std::vector<int>>(
+        FrameSynchronizer::kSourceIndicesKey);
+    ASSERT_EQ(frames.size(), 2);
+    EXPECT_EQ(indices, std::vector<int>({0, 1}));
+    EXPECT_EQ(frames.at(0).GetValue<unsigned long>("frame_id"), i);
+    EXPECT_EQ(frames.at(1).GetValue<unsigned long>("frame_id"), i);
+  }
+
+  reader->UnSubscribe();
+  synchronizer->Stop();
+  EXPECT_EQ(synchronizer->GetNumPartialTuples(), 0);
+}
+
+TEST(TestFrameSynchronizer, TestMissingSource) {
+  // Source 1 never delivers anything, so tuples are emitted without it once
+  // source 0 is more than 100 ms ahead.
+  auto synchronizer =
+      std::make_shared<FrameSynchronizer>(2, 5000, 100000, true);
+  auto stream0 = std::make_shared<Stream>();
+  auto stream1 = std::make_shared<Stream>();
+  synchronizer->SetSource(FrameSynchronizer::GetSourceName(0), stream0);
+  synchronizer->SetSource(FrameSynchronizer::GetSourceName(1), stream1);
+
+  auto reader = synchronizer->GetSink()->Subscribe();
+  synchronizer->Start();
+
+  auto base = boost::posix_time::microsec_clock::local_time();
+  stream0->PushFrame(MakeFrame(0, base, 0), true);
+  stream0->PushFrame(MakeFrame(1, base, 200000), true);
+
+  auto tuple = reader->PopFrame();
+  ASSERT_NE(tuple, nullptr);
+  auto indices =
+      tuple->GetValue<std::vector<int>>(FrameSynchronizer::kSourceIndicesKey);
+  EXPECT_EQ(indices, std::vector<int>({0}));
+
+  reader->UnSubscribe();
+  synchronizer->Stop();
+  EXPECT_EQ(synchronizer->GetNumPartialTuples(), 1);
+}
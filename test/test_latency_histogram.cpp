@@ -0,0 +1,97 @@
+// Copyright 2018 The SAF Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "utils/latency_histogram.h"
+
+TEST(LATENCY_HISTOGRAM_TEST, EMPTY_TEST) {
+  LatencyHistogram histogram;
+  auto summary = histogram.GetSummary();
+  EXPECT_EQ(summary.count, 0);
+  EXPECT_EQ(summary.mean_ms, 0);
+  EXPECT_EQ(summary.p99_ms, 0);
+  EXPECT_EQ(summary.max_ms, 0);
+}
+
+TEST(LATENCY_HISTOGRAM_TEST, PERCENTILE_TEST) {
+  LatencyHistogram histogram;
+  // 1 ms to 1 s in steps of 1 ms.
+  for (int64_t i = 1; i <= 1000; ++i) {
+    histogram.Record(i * 1000);
+  }
+  auto summary = histogram.GetSummary();
+  EXPECT_EQ(summary.count, 1000);
+  EXPECT_DOUBLE_EQ(summary.mean_ms, 500.5);
+  EXPECT_DOUBLE_EQ(summary.max_ms, 1000);
+  // Percentiles are accurate to within 1/64 of the value.
+  EXPECT_NEAR(summary.p50_ms, 500, 500.0 / 64);
+  EXPECT_NEAR(summary.p90_ms, 900, 900.0 / 64);
+  EXPECT_NEAR(summary.p99_ms, 990, 990.0 / 64);
+  EXPECT_NEAR(summary.p999_ms, 999, 999.0 / 64);
+  EXPECT_GE(summary.p99_ms, 990);
+
+  // Small values are exact.
+  LatencyHistogram small;
+  small.Record(5);
+  small.Record(7);
+  EXPECT_DOUBLE_EQ(small.GetPercentileMs(50), 0.005);
+  EXPECT_DOUBLE_EQ(small.GetPercentileMs(100), 0.007);
+}
+
+TEST(LATENCY_HISTOGRAM_TEST, OUT_OF_RANGE_TEST) {
+  LatencyHistogram histogram;
+  histogram.Record(-5);
+  EXPECT_EQ(histogram.GetPercentileMs(100), 0);
+  histogram.Record(int64_t(1) << 40);
+  EXPECT_EQ(histogram.GetCount(), 2);
+  EXPECT_NEAR(histogram.GetMaxMs(),
+              (double)(int64_t(1) << LatencyHistogram::kMaxValueBits) / 1000,
+              1);
+}
+
+TEST(LATENCY_HISTOGRAM_TEST, MERGE_AND_RESET_TEST) {
+  LatencyHistogram a;
+  LatencyHistogram b;
+  a.Record(1000);
+  b.Record(3000);
+  a.Merge(b);
+  EXPECT_EQ(a.GetCount(), 2);
+  EXPECT_DOUBLE_EQ(a.GetMeanMs(), 2);
+  EXPECT_DOUBLE_EQ(a.GetMaxMs(), 3);
+
+  a.Reset();
+  EXPECT_EQ(a.GetCount(), 0);
+  EXPECT_EQ(a.GetPercentileMs(50), 0);
+}
+
+TEST(LATENCY_HISTOGRAM_TEST, CONCURRENT_RECORD_TEST) {
+  LatencyHistogram histogram;
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back([&histogram, t] {
+      for (int i = 0; i < 10000; ++i) {
+        histogram.Record(t * 1000 + i % 100);
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(histogram.GetCount(), 40000);
+  EXPECT_DOUBLE_EQ(histogram.GetMaxMs(), 3.099);
+}
@@ -0,0 +1,119 @@
+// Copyright 2018 The SAF Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "pipeline/metrics_server.h"
+#include "utils/metrics.h"
+
+// Returns whether "text" has the line "line".
+static bool HasLine(const std::string& text, const std::string& line) {
+  return ("\n" + text).find("\n" + line + "\n") != std::string::npos;
+}
+
+TEST(METRICS_TEST, REGISTRY_TEST) {
+  MetricsRegistry registry;
+  Counter& frames =
+      registry.GetCounter("frames_total", "Frames.", {{"camera", "lobby"}});
+  frames.Increment();
+  frames.Increment(2);
+  // The same series is returned again.
+  EXPECT_EQ(&registry.GetCounter("frames_total", "Frames.",
+                                 {{"camera", "lobby"}}),
+            &frames);
+  registry.GetGauge("depth", "Depth.").Set(2.5);
+
+  double value = 7;
+  registry.AddCallback("value", "Value.", METRIC_GAUGE,
+                       {{"operator", "op"}, {"name", "a \"b\"\n"}},
+                       [&value] { return value; });
+  LatencySummary summary;
+  summary.count = 4;
+  summary.mean_ms = 500;
+  summary.p50_ms = 250;
+  registry.AddLatencyCallback("latency_seconds", "Latency.",
+                              {{"operator", "op"}},
+                              [&summary] { return summary; });
+
+  std::string text = registry.Serialize();
+  EXPECT_TRUE(HasLine(text, "# HELP frames_total Frames."));
+  EXPECT_TRUE(HasLine(text, "# TYPE frames_total counter"));
+  EXPECT_TRUE(HasLine(text, "frames_total{camera=\"lobby\"} 3"));
+  EXPECT_TRUE(HasLine(text, "# TYPE depth gauge"));
+  EXPECT_TRUE(HasLine(text, "depth 2.5"));
+  EXPECT_TRUE(
+      HasLine(text, "value{name=\"a \\\"b\\\"\\n\",operator=\"op\"} 7"));
+  EXPECT_TRUE(HasLine(text, "# TYPE latency_seconds summary"));
+  EXPECT_TRUE(
+      HasLine(text, "latency_seconds{operator=\"op\",quantile=\"0.5\"} 0.25"));
+  EXPECT_TRUE(HasLine(text, "latency_seconds_sum{operator=\"op\"} 2"));
+  EXPECT_TRUE(HasLine(text, "latency_seconds_count{operator=\"op\"} 4"));
+
+  // Callbacks are called at every scrape.
+  value = 8;
+  EXPECT_TRUE(HasLine(registry.Serialize(),
+                      "value{name=\"a \\\"b\\\"\\n\",operator=\"op\"} 8"));
+
+  // Removing by a subset of the labels removes every matching callback, but
+  // not counters and gauges.
+  registry.RemoveCallbacks({{"operator", "op"}});
+  text = registry.Serialize();
+  EXPECT_EQ(text.find("value"), std::string::npos);
+  EXPECT_EQ(text.find("latency_seconds"), std::string::npos);
+  EXPECT_TRUE(HasLine(text, "frames_total{camera=\"lobby\"} 3"));
+}
+
+TEST(METRICS_TEST, SERVER_TEST) {
+  MetricsRegistry registry;
+  registry.GetCounter("requests_total", "Requests.").Increment(5);
+  MetricsServer server(registry, 0, "127.0.0.1");
+  ASSERT_TRUE(server.Start());
+  ASSERT_NE(server.GetPort(), 0);
+
+  auto get = [&server](const std::string& path) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(server.GetPort());
+    inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+    std::string response;
+    if (connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0) {
+      std::string request = "GET " + path + " HTTP/1.1\r\nHost: x\r\n\r\n";
+      send(fd, request.data(), request.size(), 0);
+      char buf[1024];
+      ssize_t n;
+      while ((n = recv(fd, buf, sizeof(buf), 0)) > 0) {
+        response.append(buf, n);
+      }
+    }
+    close(fd);
+    return response;
+  };
+
+  std::string response = get("/metrics");
+  EXPECT_EQ(response.find("HTTP/1.1 200 OK\r\n"), 0);
+  EXPECT_NE(response.find("\nrequests_total 5\n"), std::string::npos);
+  EXPECT_EQ(get("/").find("HTTP/1.1 404"), 0);
+
+  server.Stop();
+}
@@ -174,3 +174,20 @@ TEST(TestNneCaffe, TestExtractIntermediateActivationsCaffe) {
   }
   nne.Stop();
 }
+
+TEST(TestNneCaffe, TestSetBatchSize) {
+  ASSERT_TRUE(std::ifstream(WEIGHTS_FILEPATH).good())
+      << "The Caffe model file \"" << WEIGHTS_FILEPATH << "\" was not found";
+  Shape input_shape(CHANNELS, WIDTH, HEIGHT);
+  ModelDesc desc("TestSetBatchSize", MODEL_TYPE_CAFFE, NETWORK_FILEPATH,
+                 WEIGHTS_FILEPATH, WIDTH, HEIGHT, "", "prob");
+  NeuralNetEvaluator nne(desc, input_shape, 2);
+
+  // Batches may shrink, but not grow past the batch size that the model was
+  // loaded with.
+  EXPECT_TRUE(nne.SetParameter("batch_size", "1"));
+  EXPECT_TRUE(nne.SetParameter("max_batch_size", "2"));
+  EXPECT_FALSE(nne.SetParameter("batch_size", "3"));
+  EXPECT_FALSE(nne.SetParameter("max_batch_size", "3"));
+  EXPECT_FALSE(nne.SetParameter("batch_size", "0"));
+}
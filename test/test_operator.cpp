@@ -0,0 +1,579 @@
+// Copyright 2018 The SAF Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <chrono>
+#include <future>
+#include <memory>
+#include <thread>
+
+#include <gtest/gtest.h>
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+#include "camera/camera.h"
+#include "operator/detectors/object_detector.h"
+#include "operator/operator.h"
+#include "operator/throttler.h"
+#include "pipeline/executor.h"
+#include "stream/frame.h"
+#include "stream/stream.h"
+
+// Takes longer for frames with lower ids, so that replicas finish frames out
+// of order.
+class SlowOperator : public Operator {
+ public:
+  SlowOperator() : Operator(OPERATOR_TYPE_CUSTOM, {"input"}, {"output"}) {}
+
+  virtual bool IsStateless() const override { return true; }
+
+ protected:
+  virtual bool Init() override { return true; }
+  virtual bool OnStop() override { return true; }
+  virtual void Process() override {
+    auto frame = GetFrame("input");
+    auto id = frame->GetValue<unsigned long>(Frame::kFrameIdKey);
+    std::this_thread::sleep_for(std::chrono::milliseconds(2 * (id % 4)));
+    PushFrame("output", std::move(frame));
+  }
+};
+
+class PassThroughOperator : public Operator {
+ public:
+  PassThroughOperator()
+      : Operator(OPERATOR_TYPE_CUSTOM, {"input"}, {"output"}) {}
+
+ protected:
+  virtual bool Init() override { return true; }
+  virtual bool OnStop() override { return true; }
+  virtual void Process() override {
+    PushFrame("output", GetFrame("input"));
+  }
+};
+
+// Records the thread that processed the last frame.
+class ThreadRecordingOperator : public Operator {
+ public:
+  ThreadRecordingOperator()
+      : Operator(OPERATOR_TYPE_CUSTOM, {"input"}, {"output"}) {}
+
+  std::thread::id GetProcessThreadId() const { return process_thread_id_; }
+
+ protected:
+  virtual bool Init() override { return true; }
+  virtual bool OnStop() override { return true; }
+  virtual void Process() override {
+    process_thread_id_ = std::this_thread::get_id();
+    PushFrame("output", GetFrame("input"));
+  }
+
+ private:
+  std::thread::id process_thread_id_;
+};
+
+// Uses about 2 ms of CPU time per frame.
+class BusyOperator : public Operator {
+ public:
+  BusyOperator() : Operator(OPERATOR_TYPE_CUSTOM, {"input"}, {"output"}) {}
+
+ protected:
+  virtual bool Init() override { return true; }
+  virtual bool OnStop() override { return true; }
+  virtual void Process() override {
+    uint64_t end_micros = ReadThreadCpuStats().cpu_micros + 2000;
+    while (ReadThreadCpuStats().cpu_micros < end_micros) {
+    }
+    PushFrame("output", GetFrame("input"));
+  }
+};
+
+// Records the size of the largest batch, which takes 5 ms to process.
+class SlowBatchOperator : public Operator {
+ public:
+  SlowBatchOperator()
+      : Operator(OPERATOR_TYPE_CUSTOM, {"input"}, {"output"}),
+        max_batch_size_seen_(0) {}
+
+  size_t GetMaxBatchSizeSeen() const { return max_batch_size_seen_; }
+
+ protected:
+  virtual bool Init() override { return true; }
+  virtual bool OnStop() override { return true; }
+  virtual void Process() override { SAF_NOT_IMPLEMENTED; }
+  virtual void ProcessBatch() override {
+    auto frames = GetFrames("input");
+    max_batch_size_seen_ = std::max(max_batch_size_seen_, frames.size());
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    PushFrames("output", std::move(frames));
+  }
+
+ private:
+  size_t max_batch_size_seen_;
+};
+
+// Holds the first frame until Release() is called, so that later frames queue
+// up.
+class GatedOperator : public Operator {
+ public:
+  GatedOperator()
+      : Operator(OPERATOR_TYPE_CUSTOM, {"input"}, {"output"}),
+        gate_(released_.get_future().share()) {}
+
+  void Release() { released_.set_value(); }
+
+ protected:
+  virtual bool Init() override { return true; }
+  virtual bool OnStop() override { return true; }
+  virtual void Process() override {
+    auto frame = GetFrame("input");
+    gate_.wait();
+    PushFrame("output", std::move(frame));
+  }
+
+ private:
+  std::promise<void> released_;
+  std::shared_future<void> gate_;
+};
+
+// Returns a frame with id "id" that operators can process.
+static std::unique_ptr<Frame> MakeFrame(unsigned long id) {
+  auto frame = std::make_unique<Frame>();
+  frame->SetValue(Frame::kFrameIdKey, id);
+  frame->SetValue(Camera::kCaptureTimeMicrosKey,
+                  boost::posix_time::microsec_clock::local_time());
+  return frame;
+}
+
+TEST(OPERATOR_TEST, REPLICA_ORDER_TEST) {
+  unsigned long num_frames = 40;
+
+  auto op = std::make_shared<SlowOperator>();
+  auto stream = std::make_shared<Stream>();
+  op->SetSource("input", stream);
+  op->SetReplicas(4);
+  EXPECT_EQ(op->GetReplicas(), 4);
+
+  auto reader = op->GetSink("output")->Subscribe(num_frames + 1);
+  op->Start(num_frames + 1);
+
+  for (decltype(num_frames) i = 0; i < num_frames; ++i) {
+    auto frame = std::make_unique<Frame>();
+    frame->SetValue(Frame::kFrameIdKey, i);
+    frame->SetValue(Camera::kCaptureTimeMicrosKey,
+                    boost::posix_time::microsec_clock::local_time());
+    stream->PushFrame(std::move(frame));
+  }
+  auto stop_frame = std::make_unique<Frame>();
+  stop_frame->SetStopFrame(true);
+  stream->PushFrame(std::move(stop_frame));
+
+  // Frames come out in the order in which they went in, followed by the stop
+  // frame.
+  for (decltype(num_frames) i = 0; i < num_frames; ++i) {
+    auto frame = reader->PopFrame();
+    ASSERT_NE(frame, nullptr);
+    ASSERT_EQ(frame->GetValue<unsigned long>(Frame::kFrameIdKey), i);
+  }
+  EXPECT_TRUE(reader->PopFrame()->IsStopFrame());
+
+  reader->UnSubscribe();
+  op->Stop();
+  EXPECT_GT(op->GetAvgProcessingLatencyMs(), 0);
+  auto processing_latency = op->GetProcessingLatencySummary();
+  EXPECT_EQ(processing_latency.count, num_frames);
+  // Every frame sleeps for 0, 2, 4, or 6 ms.
+  EXPECT_GE(processing_latency.p90_ms, 4);
+  EXPECT_LT(processing_latency.p50_ms, processing_latency.max_ms);
+  EXPECT_EQ(op->GetQueueLatencySummary().count, num_frames + 1);
+  EXPECT_EQ(op->GetEndToEndLatencySummary().count, num_frames);
+}
+
+TEST(OPERATOR_TEST, EXECUTOR_TEST) {
+  unsigned long num_frames = 100;
+
+  auto executor = std::make_shared<Executor>(2);
+  EXPECT_EQ(executor->GetNumThreads(), 2);
+  auto stream = std::make_shared<Stream>();
+  std::vector<std::shared_ptr<Operator>> ops;
+  StreamPtr input = stream;
+  for (int i = 0; i < 3; ++i) {
+    auto op = std::make_shared<PassThroughOperator>();
+    op->SetSource("input", input);
+    op->SetExecutor(executor);
+    input = op->GetSink("output");
+    ops.push_back(op);
+  }
+
+  auto reader = input->Subscribe(num_frames + 1);
+  for (const auto& op : ops) {
+    op->Start(num_frames + 1);
+  }
+
+  for (decltype(num_frames) i = 0; i < num_frames; ++i) {
+    auto frame = std::make_unique<Frame>();
+    frame->SetValue(Frame::kFrameIdKey, i);
+    frame->SetValue(Camera::kCaptureTimeMicrosKey,
+                    boost::posix_time::microsec_clock::local_time());
+    stream->PushFrame(std::move(frame));
+  }
+  auto stop_frame = std::make_unique<Frame>();
+  stop_frame->SetStopFrame(true);
+  stream->PushFrame(std::move(stop_frame));
+
+  // Every frame makes it through the chain in order, even though each operator
+  // may run on either thread.
+  for (decltype(num_frames) i = 0; i < num_frames; ++i) {
+    auto frame = reader->PopFrame(5000);
+    ASSERT_NE(frame, nullptr);
+    ASSERT_EQ(frame->GetValue<unsigned long>(Frame::kFrameIdKey), i);
+  }
+  auto last_frame = reader->PopFrame(5000);
+  ASSERT_NE(last_frame, nullptr);
+  EXPECT_TRUE(last_frame->IsStopFrame());
+
+  reader->UnSubscribe();
+  for (const auto& op : ops) {
+    op->Stop();
+  }
+}
+
+TEST(OPERATOR_TEST, EXECUTOR_BLOCKING_CONSUMER_TEST) {
+  unsigned long num_frames = 50;
+
+  // One thread for three operators, the second of which blocks the first when
+  // its small queue is full. If the first were on the Executor, then it would
+  // park the only thread while the second waits for it.
+  auto executor = std::make_shared<Executor>(1);
+  auto stream = std::make_shared<Stream>();
+  std::vector<std::shared_ptr<Operator>> ops;
+  StreamPtr input = stream;
+  for (int i = 0; i < 3; ++i) {
+    auto op = std::make_shared<PassThroughOperator>();
+    op->SetSource("input", input);
+    op->SetExecutor(executor);
+    input = op->GetSink("output");
+    ops.push_back(op);
+  }
+  ops.at(1)->SetOverflowPolicy(OverflowPolicy::BLOCK);
+
+  auto reader = input->Subscribe(num_frames + 1);
+  // Consumers start first, so that the first operator sees the blocking one.
+  ops.at(2)->Start(num_frames + 1);
+  ops.at(1)->Start(2);
+  ops.at(0)->Start(num_frames + 1);
+  // The first operator got a thread of its own, so the second may block. The
+  // third is fed from the Executor, so it must not.
+  EXPECT_TRUE(ops.at(1)->SetParameter("overflow_policy", "block"));
+  EXPECT_FALSE(ops.at(2)->SetParameter("overflow_policy", "block"));
+
+  // Pushing all frames at once makes the first operator fill the second's
+  // queue in one go.
+  FrameBatch frames;
+  for (decltype(num_frames) i = 0; i < num_frames; ++i) {
+    auto frame = std::make_unique<Frame>();
+    frame->SetValue(Frame::kFrameIdKey, i);
+    frame->SetValue(Camera::kCaptureTimeMicrosKey,
+                    boost::posix_time::microsec_clock::local_time());
+    frames.push_back(std::move(frame));
+  }
+  auto stop_frame = std::make_unique<Frame>();
+  stop_frame->SetStopFrame(true);
+  frames.push_back(std::move(stop_frame));
+  stream->PushFrames(std::move(frames));
+
+  for (decltype(num_frames) i = 0; i < num_frames; ++i) {
+    auto frame = reader->PopFrame(5000);
+    ASSERT_NE(frame, nullptr);
+    ASSERT_EQ(frame->GetValue<unsigned long>(Frame::kFrameIdKey), i);
+  }
+  auto last_frame = reader->PopFrame(5000);
+  ASSERT_NE(last_frame, nullptr);
+  EXPECT_TRUE(last_frame->IsStopFrame());
+
+  reader->UnSubscribe();
+  for (const auto& op : ops) {
+    op->Stop();
+  }
+}
+
+TEST(OPERATOR_TEST, FUSION_TEST) {
+  unsigned long num_frames = 20;
+
+  auto stream = std::make_shared<Stream>();
+  auto producer = std::make_shared<ThreadRecordingOperator>();
+  auto consumer = std::make_shared<ThreadRecordingOperator>();
+  producer->SetSource("input", stream);
+  consumer->SetSource("input", producer->GetSink("output"));
+  ASSERT_TRUE(producer->CanFuse(*consumer));
+  // Fusing would bypass a configured input queue.
+  consumer->SetOverflowPolicy(OverflowPolicy::BLOCK);
+  EXPECT_FALSE(producer->CanFuse(*consumer));
+  consumer->SetOverflowPolicy(OverflowPolicy::DROP_NEWEST);
+  consumer->SetMaxQueueBytes(1024);
+  EXPECT_FALSE(producer->CanFuse(*consumer));
+  consumer->SetMaxQueueBytes(0);
+  producer->FuseSink("output", consumer.get());
+  EXPECT_TRUE(consumer->IsFused());
+  EXPECT_FALSE(producer->IsFused());
+  EXPECT_FALSE(consumer->SetParameter("overflow_policy", "block"));
+
+  // Readers outside of the fused chain still see every frame.
+  auto middle_reader = producer->GetSink("output")->Subscribe(num_frames + 1);
+  auto reader = consumer->GetSink("output")->Subscribe(num_frames + 1);
+  consumer->Start();
+  producer->Start(num_frames + 1);
+
+  for (decltype(num_frames) i = 0; i < num_frames; ++i) {
+    auto frame = std::make_unique<Frame>();
+    frame->SetValue(Frame::kFrameIdKey, i);
+    frame->SetValue(Camera::kCaptureTimeMicrosKey,
+                    boost::posix_time::microsec_clock::local_time());
+    stream->PushFrame(std::move(frame));
+  }
+  auto stop_frame = std::make_unique<Frame>();
+  stop_frame->SetStopFrame(true);
+  stream->PushFrame(std::move(stop_frame));
+
+  for (auto r : {middle_reader, reader}) {
+    for (decltype(num_frames) i = 0; i < num_frames; ++i) {
+      auto frame = r->PopFrame(5000);
+      ASSERT_NE(frame, nullptr);
+      ASSERT_EQ(frame->GetValue<unsigned long>(Frame::kFrameIdKey), i);
+    }
+    auto last_frame = r->PopFrame(5000);
+    ASSERT_NE(last_frame, nullptr);
+    EXPECT_TRUE(last_frame->IsStopFrame());
+  }
+
+  // The consumer ran on the producer's thread.
+  EXPECT_EQ(consumer->GetProcessThreadId(), producer->GetProcessThreadId());
+
+  middle_reader->UnSubscribe();
+  reader->UnSubscribe();
+  producer->Stop();
+  consumer->Stop();
+}
+
+TEST(OPERATOR_TEST, BATCH_DELAY_TEST) {
+  unsigned long num_frames = 60;
+
+  auto op = std::make_shared<SlowBatchOperator>();
+  auto stream = std::make_shared<Stream>();
+  op->SetSource("input", stream);
+  op->SetMaxBatchSize(16);
+  op->SetMaxBatchDelay(20);
+  // Nothing is known about the traffic yet, so batches do not wait.
+  EXPECT_EQ(op->GetTargetBatchSize(), 1);
+
+  auto reader = op->GetSink("output")->Subscribe(num_frames + 1);
+  op->Start(num_frames + 1);
+
+  // A frame arrives every millisecond, several times per batch.
+  for (decltype(num_frames) i = 0; i < num_frames; ++i) {
+    auto frame = std::make_unique<Frame>();
+    frame->SetValue(Frame::kFrameIdKey, i);
+    frame->SetValue(Camera::kCaptureTimeMicrosKey,
+                    boost::posix_time::microsec_clock::local_time());
+    stream->PushFrame(std::move(frame));
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  auto stop_frame = std::make_unique<Frame>();
+  stop_frame->SetStopFrame(true);
+  stream->PushFrame(std::move(stop_frame));
+
+  // Every frame comes out, including those in the last, partial batch.
+  for (decltype(num_frames) i = 0; i < num_frames; ++i) {
+    auto frame = reader->PopFrame(5000);
+    ASSERT_NE(frame, nullptr);
+    ASSERT_EQ(frame->GetValue<unsigned long>(Frame::kFrameIdKey), i);
+  }
+  auto last_frame = reader->PopFrame(5000);
+  ASSERT_NE(last_frame, nullptr);
+  EXPECT_TRUE(last_frame->IsStopFrame());
+
+  reader->UnSubscribe();
+  op->Stop();
+  EXPECT_GT(op->GetMaxBatchSizeSeen(), 1);
+  EXPECT_GT(op->GetTargetBatchSize(), 1);
+  EXPECT_LE(op->GetTargetBatchSize(), 16);
+}
+
+TEST(OPERATOR_TEST, SET_PARAMETER_TEST) {
+  auto op = std::make_shared<PassThroughOperator>();
+  auto stream = std::make_shared<Stream>();
+  op->SetSource("input", stream);
+
+  // Before Start(), parameters are applied immediately.
+  EXPECT_TRUE(op->SetParameter("max_batch_size", "4"));
+  EXPECT_FALSE(op->SetParameter("max_batch_size", "many"));
+  EXPECT_FALSE(op->SetParameter("no_such_parameter", "1"));
+
+  auto reader = op->GetSink("output")->Subscribe(8);
+  op->Start(8);
+
+  // While running, they are applied by the processing thread.
+  EXPECT_TRUE(op->SetParameter("queue_size", "2"));
+  // The queue cannot grow beyond the size that it was created with.
+  EXPECT_FALSE(op->SetParameter("queue_size", "9"));
+  EXPECT_TRUE(op->SetParameter("overflow_policy", "drop_oldest"));
+  EXPECT_FALSE(op->SetParameter("overflow_policy", "bogus"));
+  EXPECT_TRUE(op->SetParameter("max_batch_delay_ms", "0"));
+  EXPECT_TRUE(op->SetParameter("cpu_accounting", "true"));
+  EXPECT_FALSE(op->SetParameter("cpu_accounting", "yes"));
+  EXPECT_TRUE(op->IsCpuAccounting());
+
+  // Frames still flow.
+  auto frame = std::make_unique<Frame>();
+  frame->SetValue(Frame::kFrameIdKey, 7UL);
+  frame->SetValue(Camera::kCaptureTimeMicrosKey,
+                  boost::posix_time::microsec_clock::local_time());
+  stream->PushFrame(std::move(frame));
+  auto out = reader->PopFrame(5000);
+  ASSERT_NE(out, nullptr);
+  EXPECT_EQ(out->GetValue<unsigned long>(Frame::kFrameIdKey), 7);
+
+  reader->UnSubscribe();
+  op->Stop();
+}
+
+TEST(OPERATOR_TEST, QUEUE_SIZE_PARAMETER_TEST) {
+  unsigned long num_frames = 6;
+
+  auto op = std::make_shared<GatedOperator>();
+  auto stream = std::make_shared<Stream>();
+  op->SetSource("input", stream);
+  auto reader = op->GetSink("output")->Subscribe(num_frames);
+  op->Start(num_frames);
+
+  // With room for 2 frames, and at most 1 more held by the operator, the rest
+  // are dropped instead of queued.
+  ASSERT_TRUE(op->SetParameter("queue_size", "2"));
+  for (decltype(num_frames) i = 0; i < num_frames; ++i) {
+    stream->PushFrame(MakeFrame(i));
+  }
+  unsigned long num_dropped = op->GetNumFramesDropped();
+  EXPECT_GE(num_dropped, 3);
+
+  op->Release();
+  for (decltype(num_frames) i = 0; i < num_frames - num_dropped; ++i) {
+    ASSERT_NE(reader->PopFrame(5000), nullptr);
+  }
+  EXPECT_EQ(reader->PopFrame(100), nullptr);
+
+  reader->UnSubscribe();
+  op->Stop();
+}
+
+TEST(OPERATOR_TEST, THROTTLER_PARAMETER_TEST) {
+  unsigned long num_frames = 5;
+
+  // Lets through one frame every 1000 s, until throttling is turned off.
+  auto throttler = std::make_shared<Throttler>(0.001);
+  auto stream = std::make_shared<Stream>();
+  throttler->SetSource(stream);
+  auto reader = throttler->GetSink()->Subscribe(num_frames);
+  throttler->Start(num_frames);
+
+  EXPECT_FALSE(throttler->SetParameter("fps", "fast"));
+  EXPECT_FALSE(throttler->SetParameter("fps", "-1"));
+  EXPECT_TRUE(throttler->SetParameter("fps", "0"));
+  for (decltype(num_frames) i = 0; i < num_frames; ++i) {
+    stream->PushFrame(MakeFrame(i));
+  }
+  for (decltype(num_frames) i = 0; i < num_frames; ++i) {
+    auto frame = reader->PopFrame(5000);
+    ASSERT_NE(frame, nullptr);
+    EXPECT_EQ(frame->GetValue<unsigned long>(Frame::kFrameIdKey), i);
+  }
+
+  reader->UnSubscribe();
+  throttler->Stop();
+}
+
+TEST(OPERATOR_TEST, OBJECT_DETECTOR_PARAMETER_TEST) {
+  // The detector itself is only loaded by Start(), so its parameters can be
+  // set without a model.
+  ObjectDetector detector("opencv-face", {});
+  EXPECT_TRUE(detector.SetParameter("confidence_threshold", "0.8"));
+  EXPECT_FALSE(detector.SetParameter("confidence_threshold", "high"));
+  EXPECT_TRUE(detector.SetParameter("idle_duration", "2.5"));
+  EXPECT_FALSE(detector.SetParameter("idle_duration", ""));
+  // The base class's parameters still apply.
+  EXPECT_TRUE(detector.SetParameter("max_batch_delay_ms", "5"));
+  EXPECT_FALSE(detector.SetParameter("stride", "2"));
+}
+
+TEST(OPERATOR_TEST, METRICS_TEST) {
+  auto op = std::make_shared<PassThroughOperator>();
+  auto stream = std::make_shared<Stream>();
+  op->SetSource("input", stream);
+  op->SetMetricLabels({{"pipeline", "test"}, {"operator", "pass"}});
+
+  auto reader = op->GetSink("output")->Subscribe();
+  op->Start();
+  auto frame = std::make_unique<Frame>();
+  frame->SetValue(Frame::kFrameIdKey, 0UL);
+  frame->SetValue(Camera::kCaptureTimeMicrosKey,
+                  boost::posix_time::microsec_clock::local_time());
+  stream->PushFrame(std::move(frame));
+  ASSERT_NE(reader->PopFrame(5000), nullptr);
+
+  std::string text = MetricsRegistry::GetInstance().Serialize();
+  EXPECT_NE(text.find("\nsaf_stream_frames_pushed_total{operator=\"pass\","
+                      "pipeline=\"test\",source=\"input\"} 1\n"),
+            std::string::npos);
+  EXPECT_NE(text.find("\nsaf_operator_frames_processed_total{operator="
+                      "\"pass\",pipeline=\"test\"} "),
+            std::string::npos);
+
+  // The metrics go away with the readers.
+  reader->UnSubscribe();
+  op->Stop();
+  text = MetricsRegistry::GetInstance().Serialize();
+  EXPECT_EQ(text.find("pipeline=\"test\""), std::string::npos);
+}
+
+TEST(OPERATOR_TEST, CPU_ACCOUNTING_TEST) {
+  unsigned long num_frames = 10;
+
+  auto stream = std::make_shared<Stream>();
+  auto producer = std::make_shared<PassThroughOperator>();
+  auto consumer = std::make_shared<BusyOperator>();
+  producer->SetSource("input", stream);
+  consumer->SetSource("input", producer->GetSink("output"));
+  producer->FuseSink("output", consumer.get());
+  producer->SetCpuAccounting(true);
+  consumer->SetCpuAccounting(true);
+
+  auto reader = consumer->GetSink("output")->Subscribe(num_frames + 1);
+  consumer->Start();
+  producer->Start(num_frames + 1);
+  for (decltype(num_frames) i = 0; i < num_frames; ++i) {
+    auto frame = std::make_unique<Frame>();
+    frame->SetValue(Frame::kFrameIdKey, i);
+    frame->SetValue(Camera::kCaptureTimeMicrosKey,
+                    boost::posix_time::microsec_clock::local_time());
+    stream->PushFrame(std::move(frame));
+  }
+  for (decltype(num_frames) i = 0; i < num_frames; ++i) {
+    ASSERT_NE(reader->PopFrame(5000), nullptr);
+  }
+  reader->UnSubscribe();
+  producer->Stop();
+  consumer->Stop();
+
+  EXPECT_GE(consumer->GetCpuStats().cpu_micros, num_frames * 2000);
+  // The fused consumer ran inside the producer's Process(), but is not
+  // counted against it.
+  EXPECT_LT(producer->GetCpuStats().cpu_micros, num_frames * 1000);
+}
@@ -0,0 +1,150 @@
+// Copyright 2018 The SAF Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <thread>
+
+#include <gtest/gtest.h>
+#include "utils/pooled_mat_allocator.h"
+
+// Allocates the buffer for a "rows" x "cols" 8-bit, 3-channel image.
+static cv::UMatData* AllocateImage(const PooledMatAllocator& allocator,
+                                   int rows, int cols) {
+  int sizes[] = {rows, cols};
+  size_t steps[] = {CV_AUTOSTEP, CV_AUTOSTEP};
+  return allocator.allocate(2, sizes, CV_8UC3, nullptr, steps, 0,
+                            cv::USAGE_DEFAULT);
+}
+
+TEST(POOLED_MAT_ALLOCATOR_TEST, REUSE_TEST) {
+  const PooledMatAllocator& allocator = PooledMatAllocator::GetInstance();
+  auto counters = PooledMatAllocator::GetThreadCounters();
+  MatAllocationStats before = counters->Get();
+
+  // A freed buffer is handed out again for a same-sized image.
+  cv::UMatData* first = AllocateImage(allocator, 100, 100);
+  uchar* data = first->data;
+  EXPECT_GE(first->size, 100 * 100 * CV_ELEM_SIZE(CV_8UC3));
+  allocator.deallocate(first);
+  cv::UMatData* second = AllocateImage(allocator, 100, 100);
+  EXPECT_EQ(second->data, data);
+  allocator.deallocate(second);
+
+  MatAllocationStats after = counters->Get();
+  EXPECT_EQ(after.num_allocations - before.num_allocations, 2);
+  EXPECT_EQ(after.num_pool_hits - before.num_pool_hits, 1);
+}
+
+TEST(POOLED_MAT_ALLOCATOR_TEST, SCOPE_TEST) {
+  const PooledMatAllocator& allocator = PooledMatAllocator::GetInstance();
+  MatAllocationCounters outer;
+  MatAllocationCounters inner;
+  {
+    MatAllocationScope outer_scope(&outer);
+    allocator.deallocate(AllocateImage(allocator, 10, 10));
+    {
+      // Only the innermost scope is charged, e.g., for a fused operator.
+      MatAllocationScope inner_scope(&inner);
+      allocator.deallocate(AllocateImage(allocator, 10, 10));
+    }
+    // Scopes on other threads charge the same counters, e.g., for replicas.
+    std::thread replica([&allocator, &outer] {
+      MatAllocationScope scope(&outer);
+      allocator.deallocate(AllocateImage(allocator, 10, 10));
+    });
+    replica.join();
+  }
+  allocator.deallocate(AllocateImage(allocator, 10, 10));
+
+  EXPECT_EQ(outer.Get().num_allocations, 2);
+  EXPECT_EQ(inner.Get().num_allocations, 1);
+  EXPECT_EQ(inner.Get().bytes_allocated, 10 * 10 * CV_ELEM_SIZE(CV_8UC3));
+}
+
+TEST(POOLED_MAT_ALLOCATOR_TEST, CROSS_THREAD_TEST) {
+  const PooledMatAllocator& allocator = PooledMatAllocator::GetInstance();
+
+  // Large buffers freed by one thread are reused by another, as happens when
+  // a camera allocates a frame and a downstream operator destroys it.
+  cv::UMatData* frame = AllocateImage(allocator, 1080, 1920);
+  uchar* data = frame->data;
+  size_t capacity = frame->size;
+  std::thread consumer([&allocator, frame] { allocator.deallocate(frame); });
+  consumer.join();
+  EXPECT_GE(allocator.GetPooledBytes(), capacity);
+
+  cv::UMatData* next = AllocateImage(allocator, 1080, 1920);
+  EXPECT_EQ(next->data, data);
+  allocator.deallocate(next);
+}
+
+TEST(POOLED_MAT_ALLOCATOR_TEST, NUMA_NODE_TEST) {
+  const PooledMatAllocator& allocator = PooledMatAllocator::GetInstance();
+
+  // A large buffer allocated on node 0 is only reused on node 0.
+  cv::UMatData* frame = nullptr;
+  std::thread producer([&allocator, &frame] {
+    PooledMatAllocator::SetThreadNumaNode(0);
+    frame = AllocateImage(allocator, 1080, 1920);
+  });
+  producer.join();
+  uchar* data = frame->data;
+  allocator.deallocate(frame);
+
+  uchar* other_node_data = nullptr;
+  std::thread other_node([&allocator, &other_node_data] {
+    PooledMatAllocator::SetThreadNumaNode(1);
+    cv::UMatData* u = AllocateImage(allocator, 1080, 1920);
+    other_node_data = u->data;
+    allocator.deallocate(u);
+  });
+  other_node.join();
+  EXPECT_NE(other_node_data, data);
+
+  uchar* same_node_data = nullptr;
+  std::thread same_node([&allocator, &same_node_data] {
+    PooledMatAllocator::SetThreadNumaNode(0);
+    cv::UMatData* u = AllocateImage(allocator, 1080, 1920);
+    same_node_data = u->data;
+    allocator.deallocate(u);
+  });
+  same_node.join();
+  EXPECT_EQ(same_node_data, data);
+}
+
+TEST(POOLED_MAT_ALLOCATOR_TEST, UNPOOLED_TEST) {
+  const PooledMatAllocator& allocator = PooledMatAllocator::GetInstance();
+
+  // Buffers too large to pool still span whole huge pages, so that they can be
+  // unmapped, and go back to the system when freed.
+  cv::UMatData* u = AllocateImage(allocator, 4321, 15678);
+  EXPECT_GE(u->size, 4321 * 15678 * CV_ELEM_SIZE(CV_8UC3));
+  EXPECT_EQ(u->size % PooledMatAllocator::kHugePageSize, 0);
+  size_t pooled_bytes = allocator.GetPooledBytes();
+  allocator.deallocate(u);
+  EXPECT_EQ(allocator.GetPooledBytes(), pooled_bytes);
+}
+
+TEST(POOLED_MAT_ALLOCATOR_TEST, USER_DATA_TEST) {
+  const PooledMatAllocator& allocator = PooledMatAllocator::GetInstance();
+
+  // Buffers owned by the caller are wrapped, never pooled or freed.
+  std::vector<uchar> buffer(64 * 64);
+  int sizes[] = {64, 64};
+  size_t steps[] = {64, 1};
+  cv::UMatData* u = allocator.allocate(2, sizes, CV_8UC1, buffer.data(), steps,
+                                       0, cv::USAGE_DEFAULT);
+  EXPECT_EQ(u->data, buffer.data());
+  EXPECT_TRUE(u->flags & cv::UMatData::USER_ALLOCATED);
+  allocator.deallocate(u);
+}
@@ -12,7 +12,11 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <chrono>
+#include <thread>
+
 #include <gtest/gtest.h>
+#include "stream/frame_memory_budget.h"
 #include "stream/stream.h"
 
 TEST(STREAM_TEST, BASIC_TEST) {
@@ -49,3 +53,403 @@ TEST(STREAM_TEST, SUBSCRIBE_TEST) {
   reader1->UnSubscribe();
   reader2->UnSubscribe();
 }
+
+TEST(STREAM_TEST, COPY_ON_WRITE_TEST) {
+  std::shared_ptr<Stream> stream(new Stream);
+  auto reader1 = stream->Subscribe();
+  auto reader2 = stream->Subscribe();
+
+  auto input_frame = std::make_unique<Frame>();
+  input_frame->SetValue("frame_id", 1UL);
+  input_frame->SetValue("original_bytes", std::vector<char>(16, 'a'));
+  stream->PushFrame(std::move(input_frame));
+
+  auto frame1 = reader1->PopFrame();
+  auto frame2 = reader2->PopFrame();
+
+  // Modifying one reader's frame must not be visible through the other's.
+  frame1->SetValue("frame_id", 2UL);
+  frame1->SetValue("original_bytes", std::vector<char>(4, 'b'));
+  frame1->Delete("frame_id");
+  frame1->SetValue("new_field", std::string("new"));
+
+  EXPECT_EQ(frame1->Count("frame_id"), 0);
+  EXPECT_EQ(frame1->GetValue<std::vector<char>>("original_bytes").size(), 4);
+  EXPECT_EQ(frame2->GetValue<unsigned long>("frame_id"), 1UL);
+  EXPECT_EQ(frame2->GetValue<std::vector<char>>("original_bytes"),
+            std::vector<char>(16, 'a'));
+  EXPECT_EQ(frame2->Count("new_field"), 0);
+
+  reader1->UnSubscribe();
+  reader2->UnSubscribe();
+}
+
+TEST(STREAM_TEST, FIELD_KEY_TEST) {
+  const FieldKey<unsigned long> frame_id_key("frame_id");
+  EXPECT_EQ(frame_id_key.GetId(), Frame::kFrameIdField.GetId());
+  EXPECT_EQ(frame_id_key.GetName(), "frame_id");
+  EXPECT_EQ(FieldRegistry::GetName(FieldRegistry::GetId("new_field")),
+            "new_field");
+  // Names interned on another thread after this one cached the earlier ones.
+  FieldId other_id;
+  std::thread([&other_id] {
+    other_id = FieldRegistry::GetId("other_thread_field");
+  }).join();
+  EXPECT_EQ(FieldRegistry::GetName(other_id), "other_thread_field");
+  EXPECT_THROW(FieldRegistry::GetName(other_id + 1000), std::out_of_range);
+
+  // Typed keys and names address the same field.
+  Frame frame;
+  frame.SetValue(frame_id_key, 1UL);
+  EXPECT_EQ(frame.GetValue<unsigned long>("frame_id"), 1UL);
+  frame.SetValue("frame_id", 2UL);
+  EXPECT_EQ(frame.GetValue(frame_id_key), 2UL);
+  EXPECT_EQ(frame.Count(frame_id_key.GetId()), 1);
+
+  // A copy shares its fields until one side writes.
+  Frame copy(frame);
+  copy.Delete(frame_id_key.GetId());
+  EXPECT_EQ(copy.Count("frame_id"), 0);
+  EXPECT_EQ(frame.GetValue(Frame::kFrameIdField), 2UL);
+  EXPECT_THROW(copy.GetValue(frame_id_key), std::runtime_error);
+}
+
+TEST(STREAM_TEST, FIELD_REFERENCE_TEST) {
+  Frame frame;
+  frame.SetValue("original_bytes", std::vector<char>(16, 'a'));
+  const auto& bytes = frame.GetRef<std::vector<char>>("original_bytes");
+  EXPECT_EQ(bytes.size(), 16);
+
+  // Modifying a shared value in place copies it first.
+  Frame copy(frame);
+  copy.GetMutable<std::vector<char>>("original_bytes").push_back('b');
+  EXPECT_EQ(copy.GetRef<std::vector<char>>("original_bytes").size(), 17);
+  EXPECT_EQ(bytes.size(), 16);
+
+  // An unshared value is modified in place.
+  const char* data = copy.GetRef<std::vector<char>>("original_bytes").data();
+  copy.GetMutable<std::vector<char>>("original_bytes")[0] = 'c';
+  EXPECT_EQ(copy.GetRef<std::vector<char>>("original_bytes").data(), data);
+
+  // Taking a value moves it out of the frame.
+  auto taken = copy.TakeValue<std::vector<char>>("original_bytes");
+  EXPECT_EQ(taken.data(), data);
+  EXPECT_EQ(copy.Count("original_bytes"), 0);
+  EXPECT_EQ(frame.GetRef<std::vector<char>>("original_bytes"),
+            std::vector<char>(16, 'a'));
+  EXPECT_THROW(copy.GetRef<std::vector<char>>("original_bytes"),
+               std::runtime_error);
+
+  // The original gave up its value when it was copied, so it copies the value
+  // before modifying it, even though nothing else refers to it anymore.
+  const char* original_data = bytes.data();
+  EXPECT_NE(frame.GetMutable<std::vector<char>>("original_bytes").data(),
+            original_data);
+}
+
+TEST(STREAM_TEST, BYTE_VIEW_TEST) {
+  Frame frame;
+  cv::Mat image(10, 20, CV_8UC3);
+  frame.SetValue("original_image", image);
+
+  // Without a separate "original_bytes" field, the image's pixels are used.
+  Frame::ByteView bytes = frame.GetBytes("original_bytes");
+  EXPECT_EQ(bytes.data, (const char*)image.data);
+  EXPECT_EQ(bytes.size, 10 * 20 * 3);
+  EXPECT_EQ(frame.GetValue<std::vector<char>>("original_bytes").size(),
+            bytes.size);
+  EXPECT_EQ(frame.Count("original_bytes"), 1);
+  EXPECT_EQ(frame.GetRawSizeBytes({"original_bytes"}), bytes.size);
+
+  // Selecting "original_bytes" keeps the image that it is served from.
+  Frame selected(frame, {"original_bytes"});
+  EXPECT_EQ(selected.GetBytes("original_bytes").data, bytes.data);
+  EXPECT_EQ(selected.GetRawSizeBytes(), bytes.size);
+  EXPECT_EQ(Frame(frame, {"original_bytes", "original_image"})
+                .GetRawSizeBytes(),
+            bytes.size);
+
+  // There is no std::vector<char> to refer to, and deleting the alias leaves
+  // the image in place.
+  EXPECT_THROW(frame.GetRef<std::vector<char>>("original_bytes"),
+               std::runtime_error);
+  EXPECT_THROW(frame.GetMutable<std::vector<char>>("original_bytes"),
+               std::runtime_error);
+  EXPECT_THROW(frame.TakeValue<std::vector<char>>("original_bytes"),
+               std::runtime_error);
+  frame.Delete("original_bytes");
+  EXPECT_EQ(frame.Count("original_bytes"), 1);
+  EXPECT_EQ(frame.Count("original_image"), 1);
+
+  // A stored "original_bytes" field takes precedence.
+  frame.SetValue("original_bytes", std::vector<char>(16, 'a'));
+  EXPECT_EQ(frame.GetBytes("original_bytes").size, 16);
+  EXPECT_EQ(frame.GetBytes("original_bytes").data,
+            frame.GetRef<std::vector<char>>("original_bytes").data());
+  EXPECT_THROW(frame.GetBytes("missing"), std::runtime_error);
+}
+
+TEST(STREAM_TEST, DELETE_ALL_EXCEPT_TEST) {
+  Frame frame;
+  frame.SetValue("frame_id", 1UL);
+  frame.SetValue("image", cv::Mat(10, 20, CV_8UC3));
+  frame.SetValue("flow", cv::Mat(10, 20, CV_8UC3));
+
+  // Only the copy loses its dead fields.
+  Frame copy(frame);
+  copy.DeleteAllExcept(
+      {Frame::kFrameIdField.GetId(), FieldRegistry::GetId("image")});
+  EXPECT_EQ(copy.Count("frame_id"), 1);
+  EXPECT_EQ(copy.Count("image"), 1);
+  EXPECT_EQ(copy.Count("flow"), 0);
+  EXPECT_EQ(frame.Count("flow"), 1);
+}
+
+TEST(STREAM_TEST, POP_TIMEOUT_TEST) {
+  std::shared_ptr<Stream> stream(new Stream);
+  auto reader = stream->Subscribe();
+
+  // Nothing has been pushed, so a timed pop must give up and return nullptr.
+  EXPECT_EQ(reader->PopFrame(10), nullptr);
+
+  reader->UnSubscribe();
+}
+
+TEST(STREAM_TEST, BLOCKING_PUSH_TEST) {
+  std::shared_ptr<Stream> stream(new Stream);
+  size_t buffer_size = 2;
+  auto reader = stream->Subscribe(buffer_size);
+
+  unsigned long num_frames = 100;
+  std::thread producer([stream, num_frames] {
+    for (unsigned long i = 0; i < num_frames; ++i) {
+      auto frame = std::make_unique<Frame>();
+      frame->SetValue("frame_id", i);
+      stream->PushFrame(std::move(frame), true);
+    }
+  });
+
+  // Blocking pushes must not drop frames even though the queue is tiny.
+  for (unsigned long i = 0; i < num_frames; ++i) {
+    auto frame = reader->PopFrame();
+    ASSERT_NE(frame, nullptr);
+    EXPECT_EQ(frame->GetValue<unsigned long>("frame_id"), i);
+  }
+
+  producer.join();
+  reader->UnSubscribe();
+}
+
+TEST(STREAM_TEST, DROP_OLDEST_TEST) {
+  std::shared_ptr<Stream> stream(new Stream);
+  auto reader = stream->Subscribe(2, OverflowPolicy::DROP_OLDEST);
+
+  for (unsigned long i = 0; i < 5; ++i) {
+    auto frame = std::make_unique<Frame>();
+    frame->SetValue("frame_id", i);
+    stream->PushFrame(std::move(frame));
+  }
+
+  // Only the two newest frames survive.
+  EXPECT_EQ(reader->PopFrame()->GetValue<unsigned long>("frame_id"), 3UL);
+  EXPECT_EQ(reader->PopFrame()->GetValue<unsigned long>("frame_id"), 4UL);
+  EXPECT_EQ(reader->GetNumFramesPushed(), 5UL);
+  EXPECT_EQ(reader->GetNumFramesDroppedOldest(), 3UL);
+  EXPECT_EQ(reader->GetNumFramesDroppedNewest(), 0UL);
+
+  reader->UnSubscribe();
+}
+
+TEST(STREAM_TEST, DROP_NEWEST_TEST) {
+  std::shared_ptr<Stream> stream(new Stream);
+  auto reader = stream->Subscribe(2);
+  EXPECT_EQ(reader->GetOverflowPolicy(), OverflowPolicy::DROP_NEWEST);
+
+  for (unsigned long i = 0; i < 5; ++i) {
+    auto frame = std::make_unique<Frame>();
+    frame->SetValue("frame_id", i);
+    stream->PushFrame(std::move(frame));
+  }
+
+  // Only the two oldest frames survive.
+  EXPECT_EQ(reader->PopFrame()->GetValue<unsigned long>("frame_id"), 0UL);
+  EXPECT_EQ(reader->PopFrame()->GetValue<unsigned long>("frame_id"), 1UL);
+  EXPECT_EQ(reader->GetNumFramesPushed(), 2UL);
+  EXPECT_EQ(reader->GetNumFramesDroppedNewest(), 3UL);
+
+  reader->UnSubscribe();
+}
+
+TEST(STREAM_TEST, LATEST_ONLY_TEST) {
+  std::shared_ptr<Stream> stream(new Stream);
+  auto reader = stream->Subscribe(4, OverflowPolicy::LATEST_ONLY);
+
+  for (unsigned long i = 0; i < 5; ++i) {
+    auto frame = std::make_unique<Frame>();
+    frame->SetValue("frame_id", i);
+    stream->PushFrame(std::move(frame));
+  }
+
+  // The reader only ever sees the most recent frame.
+  EXPECT_EQ(reader->PopFrame()->GetValue<unsigned long>("frame_id"), 4UL);
+  EXPECT_EQ(reader->PopFrame(10), nullptr);
+  EXPECT_EQ(reader->GetNumFramesConflated(), 4UL);
+
+  reader->UnSubscribe();
+}
+
+TEST(STREAM_TEST, OVERFLOW_POLICY_STRING_TEST) {
+  for (auto policy :
+       {OverflowPolicy::BLOCK, OverflowPolicy::DROP_NEWEST,
+        OverflowPolicy::DROP_OLDEST, OverflowPolicy::LATEST_ONLY}) {
+    EXPECT_EQ(
+        GetOverflowPolicyByString(GetStringForOverflowPolicy(policy)),
+        policy);
+  }
+  EXPECT_THROW(GetOverflowPolicyByString("unknown"), std::invalid_argument);
+}
+
+TEST(STREAM_TEST, WAIT_SET_TEST) {
+  std::shared_ptr<Stream> stream1(new Stream);
+  std::shared_ptr<Stream> stream2(new Stream);
+  auto reader1 = stream1->Subscribe();
+  auto reader2 = stream2->Subscribe();
+
+  StreamWaitSet wait_set;
+  EXPECT_EQ(wait_set.Add(reader1), 0);
+  EXPECT_EQ(wait_set.Add(reader2), 1);
+
+  // Nothing has been pushed, so the wait must time out.
+  EXPECT_TRUE(wait_set.Wait(10).empty());
+
+  // A push to either stream wakes up the waiter, which sees only that reader.
+  std::thread producer([stream2] {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    stream2->PushFrame(std::make_unique<Frame>());
+  });
+  auto ready = wait_set.Wait();
+  producer.join();
+  ASSERT_EQ(ready.size(), 1);
+  EXPECT_EQ(ready.at(0), 1);
+  EXPECT_NE(reader2->TryPopFrame(), nullptr);
+  EXPECT_EQ(reader2->TryPopFrame(), nullptr);
+
+  // Stopping a reader also wakes up the waiter.
+  std::thread stopper([reader1] {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    reader1->Stop();
+  });
+  EXPECT_TRUE(wait_set.Wait().empty());
+  stopper.join();
+
+  wait_set.Clear();
+  reader1->UnSubscribe();
+  reader2->UnSubscribe();
+}
+
+TEST(STREAM_TEST, BATCH_TEST) {
+  std::shared_ptr<Stream> stream(new Stream);
+  auto reader1 = stream->Subscribe(16);
+  auto reader2 = stream->Subscribe(16);
+
+  FrameBatch input_frames;
+  for (unsigned long i = 0; i < 10; ++i) {
+    auto frame = std::make_unique<Frame>();
+    frame->SetValue("frame_id", i);
+    input_frames.push_back(std::move(frame));
+  }
+  stream->PushFrames(std::move(input_frames));
+
+  // Both readers get every frame, in order, and a batch never exceeds the
+  // requested size.
+  for (const auto& reader : {reader1, reader2}) {
+    auto first = reader->PopFrames(8);
+    ASSERT_EQ(first.size(), 8);
+    auto second = reader->PopFrames(8);
+    ASSERT_EQ(second.size(), 2);
+    for (unsigned long i = 0; i < 8; ++i) {
+      EXPECT_EQ(first.at(i)->GetValue<unsigned long>("frame_id"), i);
+    }
+    EXPECT_EQ(second.at(1)->GetValue<unsigned long>("frame_id"), 9UL);
+    EXPECT_TRUE(reader->PopFrames(8, 10).empty());
+  }
+
+  reader1->UnSubscribe();
+  reader2->UnSubscribe();
+}
+
+// Returns a frame whose data takes 608 bytes.
+static std::unique_ptr<Frame> MakeSizedFrame(unsigned long id) {
+  auto frame = std::make_unique<Frame>();
+  frame->SetValue("frame_id", id);
+  frame->SetValue("image", cv::Mat(10, 20, CV_8UC3));
+  return frame;
+}
+
+TEST(STREAM_TEST, BYTE_LIMIT_TEST) {
+  EXPECT_EQ(MakeSizedFrame(0)->GetRawSizeBytes(),
+            sizeof(unsigned long) + 10 * 20 * 3);
+
+  std::shared_ptr<Stream> stream(new Stream);
+  auto reader = stream->Subscribe(16);
+  reader->SetMaxBufferBytes(1500);
+
+  // Only two frames fit within the byte limit.
+  for (unsigned long i = 0; i < 4; ++i) {
+    stream->PushFrame(MakeSizedFrame(i));
+  }
+  EXPECT_EQ(reader->GetNumFramesPushed(), 2UL);
+  EXPECT_EQ(reader->GetNumFramesDroppedNewest(), 2UL);
+  EXPECT_EQ(reader->GetQueuedBytes(), 2 * 608UL);
+  EXPECT_EQ(reader->PopFrame()->GetValue<unsigned long>("frame_id"), 0UL);
+  EXPECT_EQ(reader->GetQueuedBytes(), 608UL);
+
+  // A frame that is larger than the limit still fits into an empty queue.
+  reader->SetMaxBufferBytes(100);
+  EXPECT_EQ(reader->PopFrame()->GetValue<unsigned long>("frame_id"), 1UL);
+  stream->PushFrame(MakeSizedFrame(4));
+  stream->PushFrame(MakeSizedFrame(5));
+  EXPECT_EQ(reader->PopFrame()->GetValue<unsigned long>("frame_id"), 4UL);
+  EXPECT_EQ(reader->PopFrame(10), nullptr);
+
+  reader->UnSubscribe();
+}
+
+TEST(STREAM_TEST, MEMORY_BUDGET_TEST) {
+  FrameMemoryBudget& budget = FrameMemoryBudget::GetInstance();
+  budget.SetLimitBytes(1500);
+
+  std::shared_ptr<Stream> stream1(new Stream);
+  std::shared_ptr<Stream> stream2(new Stream);
+  auto reader1 = stream1->Subscribe(16);
+  auto reader2 = stream2->Subscribe(16);
+
+  // The first stream takes most of the budget, so the second one only gets
+  // the one frame that always fits into an empty queue.
+  stream1->PushFrame(MakeSizedFrame(0));
+  stream1->PushFrame(MakeSizedFrame(1));
+  stream2->PushFrame(MakeSizedFrame(2));
+  stream2->PushFrame(MakeSizedFrame(3));
+  EXPECT_EQ(reader1->GetNumFramesPushed(), 2UL);
+  EXPECT_EQ(reader2->GetNumFramesPushed(), 1UL);
+  EXPECT_EQ(reader2->GetNumFramesDroppedNewest(), 1UL);
+  EXPECT_EQ(budget.GetUsedBytes(), 3 * 608UL);
+
+  // A blocking push waits until another stream frees up some of the budget.
+  std::thread producer(
+      [stream2] { stream2->PushFrame(MakeSizedFrame(4), true); });
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  EXPECT_EQ(reader2->GetNumFramesPushed(), 1UL);
+  reader1->PopFrame();
+  reader1->PopFrame();
+  producer.join();
+  EXPECT_EQ(reader2->GetNumFramesPushed(), 2UL);
+  EXPECT_EQ(budget.GetUsedBytes(), 2 * 608UL);
+
+  // Frames that are never popped give their bytes back when the reader goes
+  // away.
+  reader1->UnSubscribe();
+  reader2->UnSubscribe();
+  EXPECT_EQ(budget.GetUsedBytes(), 0UL);
+  budget.SetLimitBytes(0);
+}
@@ -52,3 +52,71 @@ TEST(TestStrider, TestBasic) {
   reader->UnSubscribe();
   strider->Stop();
 }
+
+TEST(TestStrider, TestBatch) {
+  unsigned long num_output_frames = 5;
+  unsigned long stride = 10;
+
+  auto strider = std::make_shared<Strider>(stride);
+  auto stream = std::make_shared<Stream>();
+  strider->SetSource(stream);
+  strider->SetMaxBatchSize(8);
+
+  unsigned long num_total_frames = num_output_frames * stride;
+  auto reader = strider->GetSink()->Subscribe(num_total_frames);
+  strider->Start(num_total_frames);
+
+  FrameBatch frames;
+  for (decltype(num_total_frames) i = 0; i < num_total_frames; ++i) {
+    auto frame = std::make_unique<Frame>();
+    frame->SetValue(Frame::kFrameIdKey, i);
+    frame->SetValue(Camera::kCaptureTimeMicrosKey,
+                    boost::posix_time::microsec_clock::local_time());
+    frames.push_back(std::move(frame));
+  }
+  stream->PushFrames(std::move(frames));
+
+  for (decltype(num_output_frames) i = 0; i < num_output_frames; ++i) {
+    unsigned long expected_id = i * stride;
+    auto id = reader->PopFrame()->GetValue<unsigned long>("frame_id");
+    ASSERT_EQ(expected_id, id);
+  }
+
+  reader->UnSubscribe();
+  strider->Stop();
+}
+
+TEST(TestStrider, TestSetParameter) {
+  auto strider = std::make_shared<Strider>(2);
+  auto stream = std::make_shared<Stream>();
+  strider->SetSource(stream);
+  auto reader = strider->GetSink()->Subscribe(8);
+  strider->Start(8);
+
+  EXPECT_FALSE(strider->SetParameter("stride", "0"));
+  EXPECT_FALSE(strider->SetParameter("stride", "often"));
+
+  auto push_frames = [&stream](unsigned long first, unsigned long last) {
+    for (unsigned long i = first; i <= last; ++i) {
+      auto frame = std::make_unique<Frame>();
+      frame->SetValue(Frame::kFrameIdKey, i);
+      frame->SetValue(Camera::kCaptureTimeMicrosKey,
+                      boost::posix_time::microsec_clock::local_time());
+      stream->PushFrame(std::move(frame));
+    }
+  };
+
+  // Frames 0 and 2 pass, so frame 1 has been counted too.
+  push_frames(0, 2);
+  EXPECT_EQ(reader->PopFrame(5000)->GetValue<unsigned long>("frame_id"), 0);
+  EXPECT_EQ(reader->PopFrame(5000)->GetValue<unsigned long>("frame_id"), 2);
+
+  // A new stride starts counting afresh, so the next frame passes.
+  EXPECT_TRUE(strider->SetParameter("stride", "4"));
+  push_frames(3, 7);
+  EXPECT_EQ(reader->PopFrame(5000)->GetValue<unsigned long>("frame_id"), 3);
+  EXPECT_EQ(reader->PopFrame(5000)->GetValue<unsigned long>("frame_id"), 7);
+
+  reader->UnSubscribe();
+  strider->Stop();
+}
@@ -0,0 +1,118 @@
+// Copyright 2018 The SAF Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <chrono>
+#include <cstring>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include "camera/synthetic_camera.h"
+
+// Returns whether "a" and "b" have the same size and pixels.
+static bool SamePixels(const cv::Mat& a, const cv::Mat& b) {
+  return a.rows == b.rows && a.cols == b.cols && a.type() == b.type() &&
+         memcmp(a.data, b.data, a.total() * a.elemSize()) == 0;
+}
+
+TEST(SYNTHETIC_CAMERA_TEST, GENERATE_IMAGES_TEST) {
+  auto images = SyntheticCamera::GenerateImages(64, 48, 4, 7);
+  ASSERT_EQ(images.size(), 4);
+  EXPECT_EQ(images.at(0).cols, 64);
+  EXPECT_EQ(images.at(0).rows, 48);
+  EXPECT_EQ(images.at(0).type(), CV_8UC3);
+
+  // The same seed gives the same images, and the box moves between them.
+  auto again = SyntheticCamera::GenerateImages(64, 48, 4, 7);
+  for (size_t i = 0; i < images.size(); ++i) {
+    EXPECT_TRUE(SamePixels(images.at(i), again.at(i)));
+  }
+  EXPECT_FALSE(SamePixels(images.at(0), images.at(1)));
+}
+
+TEST(SYNTHETIC_CAMERA_TEST, NUM_FRAMES_TEST) {
+  auto images = SyntheticCamera::GenerateImages(32, 24, 3);
+  SyntheticCamera camera("synthetic", images, 10);
+  EXPECT_EQ(camera.GetWidth(), 32);
+  EXPECT_EQ(camera.GetHeight(), 24);
+
+  auto reader = camera.GetStream()->Subscribe();
+  camera.Start();
+  for (unsigned long i = 0; i < 10; ++i) {
+    auto frame = reader->PopFrame();
+    ASSERT_NE(frame, nullptr);
+    ASSERT_FALSE(frame->IsStopFrame());
+    EXPECT_EQ(frame->GetValue<unsigned long>(Frame::kFrameIdKey), i);
+    EXPECT_TRUE(SamePixels(frame->GetValue<cv::Mat>("original_image"),
+                           images.at(i % images.size())));
+  }
+  // Then the camera ends the stream.
+  auto frame = reader->PopFrame();
+  ASSERT_NE(frame, nullptr);
+  EXPECT_TRUE(frame->IsStopFrame());
+  EXPECT_TRUE(camera.HasFinished());
+  EXPECT_EQ(camera.GetNumFramesPushed(), 10);
+
+  reader->UnSubscribe();
+  camera.Stop();
+}
+
+TEST(SYNTHETIC_CAMERA_TEST, FRAME_RATE_TEST) {
+  // 10 frames at 100 fps are 90 ms apart from the first to the last.
+  SyntheticCamera camera("synthetic", SyntheticCamera::GenerateImages(32, 24),
+                         10, 100);
+  auto reader = camera.GetStream()->Subscribe();
+  auto start = std::chrono::steady_clock::now();
+  camera.Start();
+  unsigned long num_frames = 0;
+  while (true) {
+    auto frame = reader->PopFrame();
+    ASSERT_NE(frame, nullptr);
+    if (frame->IsStopFrame()) {
+      break;
+    }
+    ++num_frames;
+  }
+  auto elapsed_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                        std::chrono::steady_clock::now() - start)
+                        .count();
+  EXPECT_EQ(num_frames, 10);
+  EXPECT_GE(elapsed_ms, 90);
+
+  reader->UnSubscribe();
+  camera.Stop();
+}
+
+TEST(SYNTHETIC_CAMERA_TEST, STOP_FRAME_NOT_DROPPED_TEST) {
+  // At a fixed frame rate, frames that do not fit in a full queue are dropped,
+  // but the stop frame waits for room.
+  SyntheticCamera camera("synthetic", SyntheticCamera::GenerateImages(32, 24),
+                         10, 1000);
+  auto reader = camera.GetStream()->Subscribe(2);
+  camera.Start();
+  while (camera.GetNumFramesPushed() < 10) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  while (true) {
+    auto frame = reader->PopFrame(5000);
+    ASSERT_NE(frame, nullptr);
+    if (frame->IsStopFrame()) {
+      break;
+    }
+  }
+  EXPECT_TRUE(camera.HasFinished());
+
+  reader->UnSubscribe();
+  camera.Stop();
+}
@@ -0,0 +1,65 @@
+// Copyright 2018 The SAF Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <pthread.h>
+#include <sched.h>
+
+#include <stdexcept>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include "utils/thread_utils.h"
+
+TEST(THREAD_UTILS_TEST, CPU_LIST_TEST) {
+  EXPECT_EQ(ParseCpuList("0-3,8, 10-11"),
+            std::vector<int>({0, 1, 2, 3, 8, 10, 11}));
+  EXPECT_EQ(ParseCpuList("5,2,2"), std::vector<int>({2, 5}));
+  EXPECT_TRUE(ParseCpuList("").empty());
+  EXPECT_THROW(ParseCpuList("3-1"), std::invalid_argument);
+  EXPECT_THROW(ParseCpuList("a"), std::invalid_argument);
+  EXPECT_THROW(ParseCpuList("1-2-3"), std::invalid_argument);
+
+  EXPECT_EQ(CpuListToString({11, 0, 1, 2, 3, 8, 10}), "0-3,8,10-11");
+  EXPECT_EQ(CpuListToString({}), "");
+}
+
+TEST(THREAD_UTILS_TEST, PLACEMENT_TEST) {
+  ThreadPlacement placement;
+  EXPECT_TRUE(placement.IsDefault());
+  EXPECT_TRUE(ApplyThreadPlacement(placement));
+
+  // Pin a new thread to the CPU that this thread is running on, which is
+  // always allowed.
+  int cpu = sched_getcpu();
+  ASSERT_GE(cpu, 0);
+  placement.cpus = {cpu};
+  EXPECT_FALSE(placement.IsDefault());
+  EXPECT_NE(placement, ThreadPlacement());
+
+  bool applied = false;
+  bool pinned = false;
+  std::thread thread([&placement, &applied, &pinned, cpu] {
+    applied = ApplyThreadPlacement(placement);
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    pthread_getaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set);
+    pinned = CPU_COUNT(&cpu_set) == 1 && CPU_ISSET(cpu, &cpu_set);
+  });
+  thread.join();
+  EXPECT_TRUE(applied);
+  EXPECT_TRUE(pinned);
+
+  EXPECT_GE(GetNumNumaNodes(), 1);
+}
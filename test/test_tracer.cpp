@@ -0,0 +1,129 @@
+// Copyright 2018 The SAF Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <sstream>
+
+#include <gtest/gtest.h>
+
+#include "stream/frame.h"
+#include "stream/tracer.h"
+
+// The tracer is a singleton, so every test starts from a tracer that is off
+// and empty.
+static Tracer& ResetTracer() {
+  Tracer& tracer = Tracer::GetInstance();
+  tracer.SetSamplingRate(0);
+  tracer.SetMaxSpans(Tracer::kDefaultMaxSpans);
+  return tracer;
+}
+
+TEST(TRACER_TEST, SAMPLING_TEST) {
+  Tracer& tracer = ResetTracer();
+  EXPECT_FALSE(Tracer::IsEnabled());
+  tracer.SetSamplingRate(0.25);
+  EXPECT_TRUE(Tracer::IsEnabled());
+
+  int lane = tracer.RegisterLane("source");
+  int num_traced = 0;
+  for (unsigned long i = 0; i < 100; ++i) {
+    Frame frame;
+    frame.SetValue(Frame::kFrameIdKey, i);
+    tracer.OnPush(frame, lane, true);
+    if (Tracer::IsTraced(frame)) {
+      ++num_traced;
+      EXPECT_EQ(frame.Count(Tracer::kTracePushMicrosKey), 1);
+    }
+  }
+  EXPECT_EQ(num_traced, 25);
+
+  // Only operators without sources sample frames.
+  Frame frame;
+  for (int i = 0; i < 4; ++i) {
+    tracer.OnPush(frame, lane, false);
+  }
+  EXPECT_FALSE(Tracer::IsTraced(frame));
+  ResetTracer();
+}
+
+TEST(TRACER_TEST, SPAN_TEST) {
+  Tracer& tracer = ResetTracer();
+  tracer.SetSamplingRate(1);
+  int source_lane = tracer.RegisterLane("source");
+  int sink_lane = tracer.RegisterLane("sink");
+
+  Frame frame;
+  frame.SetValue(Frame::kFrameIdKey, (unsigned long)7);
+  tracer.OnPush(frame, source_lane, true);
+  ASSERT_TRUE(Tracer::IsTraced(frame));
+  {
+    TraceScope trace(sink_lane);
+    trace.AddInput(frame);
+  }
+
+  auto spans = tracer.GetSpans();
+  ASSERT_EQ(spans.size(), 2);
+  EXPECT_EQ(spans[0].type, Tracer::SpanType::QUEUE);
+  EXPECT_EQ(spans[1].type, Tracer::SpanType::PROCESS);
+  for (const auto& span : spans) {
+    EXPECT_EQ(span.trace_id,
+              frame.GetValue<unsigned long>(Tracer::kTraceIdKey));
+    EXPECT_EQ(span.frame_id, 7);
+    EXPECT_EQ(span.lane, sink_lane);
+    EXPECT_GE(span.duration_micros, 0);
+  }
+
+  // A traced frame that arrives at an origin operator, e.g., a receiver,
+  // records the time in transit.
+  tracer.OnSend(frame);
+  tracer.OnPush(frame, source_lane, true);
+  spans = tracer.GetSpans();
+  ASSERT_EQ(spans.size(), 3);
+  EXPECT_EQ(spans[2].type, Tracer::SpanType::TRANSFER);
+
+  std::ostringstream out;
+  tracer.WriteChromeTrace(out);
+  std::string trace = out.str();
+  EXPECT_NE(trace.find("\"traceEvents\""), std::string::npos);
+  EXPECT_NE(trace.find("\"name\":\"sink\""), std::string::npos);
+  EXPECT_NE(trace.find("\"name\":\"process\""), std::string::npos);
+  EXPECT_NE(trace.find("\"name\":\"transfer\""), std::string::npos);
+  ResetTracer();
+}
+
+TEST(TRACER_TEST, FLIGHT_RECORDER_TEST) {
+  Tracer& tracer = ResetTracer();
+  tracer.SetMaxSpans(4);
+  for (unsigned long i = 0; i < 10; ++i) {
+    tracer.RecordSpan(1, i, 0, Tracer::SpanType::PROCESS, 0, 1);
+  }
+  // Only the most recent spans are kept, oldest first.
+  auto spans = tracer.GetSpans();
+  ASSERT_EQ(spans.size(), 4);
+  for (unsigned long i = 0; i < 4; ++i) {
+    EXPECT_EQ(spans[i].frame_id, 6 + i);
+  }
+
+  tracer.Clear();
+  EXPECT_TRUE(tracer.GetSpans().empty());
+}
+
+TEST(TRACER_TEST, LANE_NAME_ESCAPING_TEST) {
+  Tracer& tracer = ResetTracer();
+  tracer.RegisterLane("say \"hi\"\\\n\t");
+
+  std::ostringstream out;
+  tracer.WriteChromeTrace(out);
+  EXPECT_NE(out.str().find("\"name\":\"say \\\"hi\\\"\\\\\\n\\u0009\""),
+            std::string::npos);
+}
@@ -117,6 +117,9 @@ TEST(TestTypes, TestOperatorTypesStringConversion) {
   EXPECT_EQ(OPERATOR_TYPE_FRAME_SUBSCRIBER,
             GetOperatorTypeByString(
                 GetStringForOperatorType(OPERATOR_TYPE_FRAME_SUBSCRIBER)));
+  EXPECT_EQ(OPERATOR_TYPE_FRAME_SYNCHRONIZER,
+            GetOperatorTypeByString(
+                GetStringForOperatorType(OPERATOR_TYPE_FRAME_SYNCHRONIZER)));
   EXPECT_EQ(OPERATOR_TYPE_FRAME_WRITER,
             GetOperatorTypeByString(
                 GetStringForOperatorType(OPERATOR_TYPE_FRAME_WRITER)));